@@ -76,6 +76,28 @@ IROperand *generateFunctionCall(IRBlock *b, IROperand *fun, IROperand **args,
     }
   }
 }
+bool tailCallPossible(Type const *funType) {
+  switch (options.arch) {
+    case OPTION_A_X86_64_LINUX: {
+      return x86_64LinuxTailCallPossible(funType);
+    }
+    default: {
+      error(__FILE__, __LINE__, "unrecognized architecture");
+    }
+  }
+}
+void generateTailCall(IRBlock *b, IROperand *fun, IROperand **args,
+                      Type const *funType, FileListEntry *file) {
+  switch (options.arch) {
+    case OPTION_A_X86_64_LINUX: {
+      x86_64LinuxGenerateTailCall(b, fun, args, funType, file);
+      break;
+    }
+    default: {
+      error(__FILE__, __LINE__, "unrecognized architecture");
+    }
+  }
+}
 
 int validateIRArchSpecific(char const *phase, bool blocked) {
   switch (options.arch) {
@@ -88,11 +110,10 @@ int validateIRArchSpecific(char const *phase, bool blocked) {
   }
 }
 
-void backend(void) {
+int backend(int *exitCode) {
   switch (options.arch) {
     case OPTION_A_X86_64_LINUX: {
-      x86_64LinuxBackend();
-      break;
+      return x86_64LinuxBackend(exitCode);
     }
     default: {
       error(__FILE__, __LINE__, "unrecognized architecture");
@@ -76,6 +76,26 @@ void generateFunctionExit(LinkedList *blocks, SymbolTableEntry const *entry,
 IROperand *generateFunctionCall(IRBlock *b, IROperand *fun, IROperand **args,
                                 Type const *funType, FileListEntry *file);
 
+/**
+ * can a call to a function of this type be made as a tail call
+ *
+ * @param funType type of function to call
+ * @returns true if generateTailCall may be used for calls of this type
+ */
+bool tailCallPossible(Type const *funType);
+/**
+ * generate a tail call sequence - the callee returns directly to our caller
+ *
+ * @param b block to insert code into
+ * @param fun function to call
+ * @param args array of arguments to use in this call (length determined by
+ * funType, owning)
+ * @param funType type of function to call
+ * @param file file this is going to be in
+ */
+void generateTailCall(IRBlock *b, IROperand *fun, IROperand **args,
+                      Type const *funType, FileListEntry *file);
+
 /**
  * validate generated IR
  *
@@ -87,7 +107,11 @@ int validateIRArchSpecific(char const *phase, bool blocked);
 
 /**
  * run the backend
+ *
+ * @param exitCode output parameter for the program's exit code, set only if
+ *                 the program is run in-process
+ * @returns -1 on failure, 0 on success
  */
-void backend(void);
+int backend(int *exitCode);
 
 #endif  // TLC_ARCH_INTERFACE_H_
\ No newline at end of file
@@ -260,6 +260,119 @@ static size_t padToDirectRegisterMovableSize(size_t size) {
     return 8 + 8;
 }
 
+/**
+ * move arguments into their registers or stack slots for a call
+ *
+ * @param b block to insert code into
+ * @param args arguments to pass (borrowed array, owned operands)
+ * @param argumentTypes types of the arguments
+ * @param gpArgIdx number of general purpose argument registers already taken
+ * @param file file this is going to be in
+ * @returns number of bytes of stack used to pass arguments
+ */
+static size_t generateArgumentMoves(IRBlock *b, IROperand **args,
+                                    Vector const *argumentTypes,
+                                    size_t gpArgIdx, FileListEntry *file) {
+  size_t sseArgIdx = 0;
+  size_t stackOffset = 0;
+
+  // for each argument, left to right
+  for (size_t idx = 0; idx < argumentTypes->size; ++idx) {
+    Type const *argType = argumentTypes->elements[idx];
+    IROperand *arg = args[idx];
+
+    TypeClass argTypeClass[2];
+    classify(argType, argTypeClass);
+    size_t numGP = (argTypeClass[0] == X86_64_LINUX_TC_GP ? 1U : 0U) +
+                   (argTypeClass[1] == X86_64_LINUX_TC_GP ? 1U : 0U);
+    size_t numSSE = (argTypeClass[0] == X86_64_LINUX_TC_SSE ? 1U : 0U) +
+                    (argTypeClass[1] == X86_64_LINUX_TC_SSE ? 1U : 0U);
+
+    if (argTypeClass[0] == X86_64_LINUX_TC_MEMORY ||
+        gpArgIdx + numGP > GP_ARG_REG_MAX ||
+        sseArgIdx + numSSE > SSE_ARG_REG_MAX) {
+      // passed in memory
+      IR(b, STK_STORE(OFFSET((int64_t)stackOffset), arg));
+      stackOffset +=
+          incrementToMultiple(typeSizeof(argType), X86_64_LINUX_REGISTER_WIDTH);
+    } else {
+      // passed in registers
+
+      IROperand *passingTemp;
+      if (!isDirectRegisterMovableSize(typeSizeof(argType))) {
+        passingTemp = TEMP(fresh(file), typeAlignof(argType),
+                           padToDirectRegisterMovableSize(typeSizeof(argType)),
+                           typeAllocation(argType));
+        IR(b, OFFSET_STORE(irOperandCopy(passingTemp), arg, OFFSET(0)));
+      } else {
+        passingTemp = arg;
+      }
+      if (argTypeClass[0] == X86_64_LINUX_TC_GP &&
+          argTypeClass[1] == X86_64_LINUX_TC_NO_CLASS)
+        IR(b, MOVE(REG(GP_ARG_REGS[gpArgIdx++],
+                       padToDirectRegisterMovableSize(typeSizeof(argType))),
+                   passingTemp));
+      else if (argTypeClass[0] == X86_64_LINUX_TC_GP)
+        IR(b, OFFSET_LOAD(
+                  REG(GP_ARG_REGS[gpArgIdx++], X86_64_LINUX_REGISTER_WIDTH),
+                  irOperandCopy(passingTemp), OFFSET(0)));
+      else if (argTypeClass[0] == X86_64_LINUX_TC_SSE &&
+               argTypeClass[1] == X86_64_LINUX_TC_NO_CLASS)
+        IR(b, MOVE(REG(SSE_ARG_REGS[sseArgIdx++],
+                       padToDirectRegisterMovableSize(typeSizeof(argType))),
+                   passingTemp));
+      else if (argTypeClass[0] == X86_64_LINUX_TC_SSE)
+        IR(b, OFFSET_LOAD(
+                  REG(SSE_ARG_REGS[sseArgIdx++], X86_64_LINUX_REGISTER_WIDTH),
+                  irOperandCopy(passingTemp), OFFSET(0)));
+
+      if (argTypeClass[1] == X86_64_LINUX_TC_GP)
+        IR(b, OFFSET_LOAD(
+                  REG(GP_ARG_REGS[gpArgIdx++],
+                      padToDirectRegisterMovableSize(
+                          typeSizeof(argType) - X86_64_LINUX_REGISTER_WIDTH)),
+                  passingTemp, OFFSET((int64_t)X86_64_LINUX_REGISTER_WIDTH)));
+      else if (argTypeClass[1] == X86_64_LINUX_TC_SSE)
+        IR(b, OFFSET_LOAD(
+                  REG(SSE_ARG_REGS[sseArgIdx++],
+                      padToDirectRegisterMovableSize(
+                          typeSizeof(argType) - X86_64_LINUX_REGISTER_WIDTH)),
+                  passingTemp, OFFSET((int64_t)X86_64_LINUX_REGISTER_WIDTH)));
+    }
+  }
+
+  return stackOffset;
+}
+/**
+ * number of bytes of stack needed to pass the arguments to a function
+ */
+static size_t argumentStackSize(Type const *funType, size_t gpArgIdx) {
+  size_t sseArgIdx = 0;
+  size_t stackSize = 0;
+  Vector const *argumentTypes = &funType->data.funPtr.argTypes;
+  for (size_t idx = 0; idx < argumentTypes->size; ++idx) {
+    Type const *argType = argumentTypes->elements[idx];
+
+    TypeClass argTypeClass[2];
+    classify(argType, argTypeClass);
+    size_t numGP = (argTypeClass[0] == X86_64_LINUX_TC_GP ? 1U : 0U) +
+                   (argTypeClass[1] == X86_64_LINUX_TC_GP ? 1U : 0U);
+    size_t numSSE = (argTypeClass[0] == X86_64_LINUX_TC_SSE ? 1U : 0U) +
+                    (argTypeClass[1] == X86_64_LINUX_TC_SSE ? 1U : 0U);
+
+    if (argTypeClass[0] == X86_64_LINUX_TC_MEMORY ||
+        gpArgIdx + numGP > GP_ARG_REG_MAX ||
+        sseArgIdx + numSSE > SSE_ARG_REG_MAX) {
+      stackSize +=
+          incrementToMultiple(typeSizeof(argType), X86_64_LINUX_REGISTER_WIDTH);
+    } else {
+      gpArgIdx += numGP;
+      sseArgIdx += numSSE;
+    }
+  }
+  return stackSize;
+}
+
 void x86_64LinuxGenerateFunctionEntry(LinkedList *blocks,
                                       SymbolTableEntry *entry,
                                       size_t returnValueAddressTemp,
@@ -438,8 +551,6 @@ IROperand *x86_64LinuxGenerateFunctionCall(IRBlock *b, IROperand *fun,
                                            Type const *funType,
                                            FileListEntry *file) {
   size_t gpArgIdx = 0;
-  size_t sseArgIdx = 0;
-  size_t stackOffset = 0;
 
   IRDatum *stackAllocationSize = longDatumCreate(0);
   IRInstruction *stackAllocationInstruction =
@@ -455,71 +566,9 @@ IROperand *x86_64LinuxGenerateFunctionCall(IRBlock *b, IROperand *fun,
   // reserve register for passing return value address
   if (returnTypeClass[0] == X86_64_LINUX_TC_MEMORY) gpArgIdx++;
 
-  // for each argument, left to right
-  Vector const *argumentTypes = &funType->data.funPtr.argTypes;
-  for (size_t idx = 0; idx < argumentTypes->size; ++idx) {
-    Type const *argType = argumentTypes->elements[idx];
-    IROperand *arg = args[idx];
-
-    TypeClass argTypeClass[2];
-    classify(argType, argTypeClass);
-    size_t numGP = (argTypeClass[0] == X86_64_LINUX_TC_GP ? 1U : 0U) +
-                   (argTypeClass[1] == X86_64_LINUX_TC_GP ? 1U : 0U);
-    size_t numSSE = (argTypeClass[0] == X86_64_LINUX_TC_SSE ? 1U : 0U) +
-                    (argTypeClass[1] == X86_64_LINUX_TC_SSE ? 1U : 0U);
-
-    if (argTypeClass[0] == X86_64_LINUX_TC_MEMORY ||
-        gpArgIdx + numGP > GP_ARG_REG_MAX ||
-        sseArgIdx + numSSE > SSE_ARG_REG_MAX) {
-      // passed in memory
-      IR(b, STK_STORE(OFFSET((int64_t)stackOffset), arg));
-      stackOffset +=
-          incrementToMultiple(typeSizeof(argType), X86_64_LINUX_REGISTER_WIDTH);
-    } else {
-      // passed in registers
-
-      IROperand *passingTemp;
-      if (!isDirectRegisterMovableSize(typeSizeof(argType))) {
-        passingTemp = TEMP(fresh(file), typeAlignof(argType),
-                           padToDirectRegisterMovableSize(typeSizeof(argType)),
-                           typeAllocation(argType));
-        IR(b, OFFSET_STORE(irOperandCopy(passingTemp), arg, OFFSET(0)));
-      } else {
-        passingTemp = arg;
-      }
-      if (argTypeClass[0] == X86_64_LINUX_TC_GP &&
-          argTypeClass[1] == X86_64_LINUX_TC_NO_CLASS)
-        IR(b, MOVE(REG(GP_ARG_REGS[gpArgIdx++],
-                       padToDirectRegisterMovableSize(typeSizeof(argType))),
-                   passingTemp));
-      else if (argTypeClass[0] == X86_64_LINUX_TC_GP)
-        IR(b, OFFSET_LOAD(
-                  REG(GP_ARG_REGS[gpArgIdx++], X86_64_LINUX_REGISTER_WIDTH),
-                  irOperandCopy(passingTemp), OFFSET(0)));
-      else if (argTypeClass[0] == X86_64_LINUX_TC_SSE &&
-               argTypeClass[1] == X86_64_LINUX_TC_NO_CLASS)
-        IR(b, MOVE(REG(SSE_ARG_REGS[sseArgIdx++],
-                       padToDirectRegisterMovableSize(typeSizeof(argType))),
-                   passingTemp));
-      else if (argTypeClass[0] == X86_64_LINUX_TC_SSE)
-        IR(b, OFFSET_LOAD(
-                  REG(SSE_ARG_REGS[sseArgIdx++], X86_64_LINUX_REGISTER_WIDTH),
-                  irOperandCopy(passingTemp), OFFSET(0)));
-
-      if (argTypeClass[1] == X86_64_LINUX_TC_GP)
-        IR(b, OFFSET_LOAD(
-                  REG(GP_ARG_REGS[gpArgIdx++],
-                      padToDirectRegisterMovableSize(
-                          typeSizeof(argType) - X86_64_LINUX_REGISTER_WIDTH)),
-                  passingTemp, OFFSET((int64_t)X86_64_LINUX_REGISTER_WIDTH)));
-      else if (argTypeClass[1] == X86_64_LINUX_TC_SSE)
-        IR(b, OFFSET_LOAD(
-                  REG(SSE_ARG_REGS[sseArgIdx++],
-                      padToDirectRegisterMovableSize(
-                          typeSizeof(argType) - X86_64_LINUX_REGISTER_WIDTH)),
-                  passingTemp, OFFSET((int64_t)X86_64_LINUX_REGISTER_WIDTH)));
-    }
-  }
+  size_t stackOffset =
+      generateArgumentMoves(b, args, &funType->data.funPtr.argTypes, gpArgIdx,
+                            file);
   free(args);
 
   // deal with return value
@@ -615,4 +664,21 @@ IROperand *x86_64LinuxGenerateFunctionCall(IRBlock *b, IROperand *fun,
                 CONSTANT(LONG_WIDTH, longDatumCreate(stackOffset))));
 
   return retval;
-}
\ No newline at end of file
+}
+bool x86_64LinuxTailCallPossible(Type const *funType) {
+  // the callee would need a pointer into our frame to return into
+  TypeClass returnTypeClass[2];
+  classify(funType->data.funPtr.returnType, returnTypeClass);
+  if (returnTypeClass[0] == X86_64_LINUX_TC_MEMORY) return false;
+
+  // stack-passed arguments would have to overwrite our own incoming arguments
+  // while they might still be live - only take calls passing everything in
+  // registers
+  return argumentStackSize(funType, 0) == 0;
+}
+void x86_64LinuxGenerateTailCall(IRBlock *b, IROperand *fun, IROperand **args,
+                                 Type const *funType, FileListEntry *file) {
+  generateArgumentMoves(b, args, &funType->data.funPtr.argTypes, 0, file);
+  free(args);
+  IR(b, TAIL_CALL(fun));
+}
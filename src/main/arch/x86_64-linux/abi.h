@@ -40,5 +40,8 @@ IROperand *x86_64LinuxGenerateFunctionCall(IRBlock *b, IROperand *fun,
                                            IROperand **args,
                                            Type const *funType,
                                            FileListEntry *file);
+bool x86_64LinuxTailCallPossible(Type const *funType);
+void x86_64LinuxGenerateTailCall(IRBlock *b, IROperand *fun, IROperand **args,
+                                 Type const *funType, FileListEntry *file);
 
 #endif  // TLC_ARCH_X86_64_LINUX_ABI_H_
\ No newline at end of file
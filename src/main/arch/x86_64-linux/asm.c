@@ -19,6 +19,10 @@
 
 #include "arch/x86_64-linux/asm.h"
 
+#include <inttypes.h>
+#include <stdio.h>
+#include <string.h>
+
 #include "fileList.h"
 #include "ir/ir.h"
 #include "translation/translation.h"
@@ -40,14 +44,53 @@ char const *x86_64LinuxPrettyPrintRegister(size_t reg) {
   return REGISTER_NAMES[reg];
 }
 
+/** registers that may carry arguments into a call */
+static X86_64LinuxRegister const ARGUMENT_REGISTERS[] = {
+    X86_64_LINUX_RDI,  X86_64_LINUX_RSI,  X86_64_LINUX_RDX,  X86_64_LINUX_RCX,
+    X86_64_LINUX_R8,   X86_64_LINUX_R9,   X86_64_LINUX_XMM0, X86_64_LINUX_XMM1,
+    X86_64_LINUX_XMM2, X86_64_LINUX_XMM3, X86_64_LINUX_XMM4, X86_64_LINUX_XMM5,
+    X86_64_LINUX_XMM6, X86_64_LINUX_XMM7,
+};
+static size_t const NUM_ARGUMENT_REGISTERS =
+    sizeof(ARGUMENT_REGISTERS) / sizeof(X86_64LinuxRegister);
+/** registers that may carry a return value out of a function */
+static X86_64LinuxRegister const RETURN_REGISTERS[] = {
+    X86_64_LINUX_RAX,
+    X86_64_LINUX_RDX,
+    X86_64_LINUX_XMM0,
+    X86_64_LINUX_XMM1,
+};
+static size_t const NUM_RETURN_REGISTERS =
+    sizeof(RETURN_REGISTERS) / sizeof(X86_64LinuxRegister);
+/** registers a call may overwrite */
+static X86_64LinuxRegister const CALLER_SAVE_REGISTERS[] = {
+    X86_64_LINUX_RAX,   X86_64_LINUX_RDI,   X86_64_LINUX_RSI,
+    X86_64_LINUX_RDX,   X86_64_LINUX_RCX,   X86_64_LINUX_R8,
+    X86_64_LINUX_R9,    X86_64_LINUX_R10,   X86_64_LINUX_R11,
+    X86_64_LINUX_XMM0,  X86_64_LINUX_XMM1,  X86_64_LINUX_XMM2,
+    X86_64_LINUX_XMM3,  X86_64_LINUX_XMM4,  X86_64_LINUX_XMM5,
+    X86_64_LINUX_XMM6,  X86_64_LINUX_XMM7,  X86_64_LINUX_XMM8,
+    X86_64_LINUX_XMM9,  X86_64_LINUX_XMM10, X86_64_LINUX_XMM11,
+    X86_64_LINUX_XMM12, X86_64_LINUX_XMM13, X86_64_LINUX_XMM14,
+    X86_64_LINUX_XMM15,
+};
+static size_t const NUM_CALLER_SAVE_REGISTERS =
+    sizeof(CALLER_SAVE_REGISTERS) / sizeof(X86_64LinuxRegister);
+X86_64LinuxRegister const X86_64_LINUX_CALLEE_SAVE_REGISTERS[] = {
+    X86_64_LINUX_RBX, X86_64_LINUX_R12, X86_64_LINUX_R13,
+    X86_64_LINUX_R14, X86_64_LINUX_R15,
+};
+size_t const X86_64_LINUX_NUM_CALLEE_SAVE_REGISTERS =
+    sizeof(X86_64_LINUX_CALLEE_SAVE_REGISTERS) / sizeof(X86_64LinuxRegister);
+
 static X86_64LinuxOperand *x86_64LinuxOperandCreateBase(
     X86_64LinuxOperandKind kind) {
   X86_64LinuxOperand *retval = malloc(sizeof(X86_64LinuxOperand));
   retval->kind = kind;
   return retval;
 }
-static X86_64LinuxOperand *x86_64LinuxRegOperandCreate(X86_64LinuxRegister reg,
-                                                       size_t size) {
+X86_64LinuxOperand *x86_64LinuxRegOperandCreate(X86_64LinuxRegister reg,
+                                                size_t size) {
   X86_64LinuxOperand *retval =
       x86_64LinuxOperandCreateBase(X86_64_LINUX_OK_REG);
   retval->data.reg.reg = reg;
@@ -92,12 +135,56 @@ static X86_64LinuxOperand *x86_64LinuxTempOperandCreatePatch(
   retval->data.temp.escapes = false;
   return retval;
 }
+/**
+ * create a temp operand for a fresh temp introduced by instruction selection
+ */
+static X86_64LinuxOperand *x86_64LinuxScratchOperandCreate(size_t name,
+                                                           size_t size,
+                                                           AllocHint kind) {
+  X86_64LinuxOperand *retval =
+      x86_64LinuxOperandCreateBase(X86_64_LINUX_OK_TEMP);
+  retval->data.temp.name = name;
+  retval->data.temp.alignment = size;
+  retval->data.temp.size = size;
+  retval->data.temp.kind = kind;
+  retval->data.temp.escapes = false;
+  return retval;
+}
 static X86_64LinuxOperand *x86_64LinuxOffsetOperandCreate(int64_t offset) {
   X86_64LinuxOperand *retval =
       x86_64LinuxOperandCreateBase(X86_64_LINUX_OK_OFFSET);
   retval->data.offset.offset = offset;
   return retval;
 }
+/**
+ * create an operand for part of a memory temp
+ *
+ * @param temp memory temp the part is in
+ * @param offset offset of the part from the start of the temp
+ * @param size size of the part
+ * @param offsetOnly should the operand become the part's offset from the frame
+ * base, instead of the part itself
+ */
+static X86_64LinuxOperand *x86_64LinuxPartOperandCreate(IROperand const *temp,
+                                                        int64_t offset,
+                                                        size_t size,
+                                                        bool offsetOnly) {
+  X86_64LinuxOperand *retval =
+      x86_64LinuxOperandCreateBase(X86_64_LINUX_OK_PART);
+  retval->data.part.name = temp->data.temp.name;
+  retval->data.part.alignment = temp->data.temp.alignment;
+  retval->data.part.size = temp->data.temp.size;
+  retval->data.part.offset = offset;
+  retval->data.part.partSize = size;
+  retval->data.part.offsetOnly = offsetOnly;
+  return retval;
+}
+static X86_64LinuxOperand *x86_64LinuxOperandCopy(
+    X86_64LinuxOperand const *o) {
+  X86_64LinuxOperand *retval = malloc(sizeof(X86_64LinuxOperand));
+  memcpy(retval, o, sizeof(X86_64LinuxOperand));
+  return retval;
+}
 static X86_64LinuxOperand *x86_64LinuxOperandCreate(IROperand const *op) {
   switch (op->kind) {
     case OK_REG: {
@@ -112,12 +199,13 @@ static X86_64LinuxOperand *x86_64LinuxOperandCreate(IROperand const *op) {
     }
   }
 }
-static void x86_64LinuxOperandFree(X86_64LinuxOperand *o) { free(o); }
+void x86_64LinuxOperandFree(X86_64LinuxOperand *o) { free(o); }
 
-static void x86_64LinuxInstructionFree(X86_64LinuxInstruction *i) {
+void x86_64LinuxInstructionFree(X86_64LinuxInstruction *i) {
   free(i->skeleton);
   vectorUninit(&i->defines, (void (*)(void *))x86_64LinuxOperandFree);
   vectorUninit(&i->uses, (void (*)(void *))x86_64LinuxOperandFree);
+  vectorUninit(&i->other, (void (*)(void *))x86_64LinuxOperandFree);
   switch (i->kind) {
     case X86_64_LINUX_IK_JUMP:
     case X86_64_LINUX_IK_JUMPTABLE:
@@ -142,14 +230,15 @@ static X86_64LinuxFrag *x86_64LinuxDataFragCreate(char *data) {
   retval->data.data.data = data;
   return retval;
 }
-static X86_64LinuxFrag *x86_64LinuxTextFragCreate(char *header, char *footer) {
+X86_64LinuxFrag *x86_64LinuxTextFragCreate(char *header, char *footer) {
   X86_64LinuxFrag *retval = x86_64LinuxFragCreate(X86_64_LINUX_FK_TEXT);
   retval->data.text.header = header;
   retval->data.text.footer = footer;
   linkedListInit(&retval->data.text.instructions);
+  retval->data.text.coldLabel = 0;
   return retval;
 }
-static void x86_64LinuxFragFree(X86_64LinuxFrag *frag) {
+void x86_64LinuxFragFree(X86_64LinuxFrag *frag) {
   switch (frag->kind) {
     case X86_64_LINUX_FK_TEXT: {
       free(frag->data.text.header);
@@ -169,89 +258,239 @@ static void x86_64LinuxFragFree(X86_64LinuxFrag *frag) {
   free(frag);
 }
 
+/** a constant in a file's constant pool */
+typedef struct {
+  char *key; /**< alignment and data of the constant */
+  size_t name;
+} PooledConstant;
+static void pooledConstantFree(PooledConstant *c) {
+  free(c->key);
+  free(c);
+}
+
 static X86_64LinuxFile *x86_64LinuxFileCreate(char *header, char *footer) {
   X86_64LinuxFile *retval = malloc(sizeof(X86_64LinuxFile));
   retval->header = header;
   retval->footer = footer;
   vectorInit(&retval->frags);
+  hashMapInit(&retval->constants);
   return retval;
 }
 void x86_64LinuxFileFree(X86_64LinuxFile *file) {
   free(file->header);
   free(file->footer);
   vectorUninit(&file->frags, (void (*)(void *))x86_64LinuxFragFree);
+  hashMapUninit(&file->constants, (void (*)(void *))pooledConstantFree);
   free(file);
 }
 
-static char *x86_64LinuxDataToString(Vector *v) {
-  char *data = strdup("");
-  for (size_t idx = 0; idx < v->size; ++idx) {
-    IRDatum *d = v->elements[idx];
-    switch (d->type) {
-      case DT_BYTE: {
-        char *old = data;
-        data = format("%s\tdb %hhu\n", old, d->data.byteVal);
-        free(old);
-        break;
-      }
-      case DT_SHORT: {
-        char *old = data;
-        data = format("%s\tdw %hu\n", old, d->data.shortVal);
-        free(old);
-        break;
-      }
-      case DT_INT: {
-        char *old = data;
-        data = format("%s\tdd %u\n", old, d->data.intVal);
-        free(old);
-        break;
-      }
-      case DT_LONG: {
-        char *old = data;
-        data = format("%s\tdq %lu\n", old, d->data.longVal);
-        free(old);
-        break;
+/** most values written on one line of data */
+#define DATA_VALUES_PER_LINE 16
+/** most bytes written on one line of string data */
+#define DATA_STRING_LINE_LENGTH 64
+
+static void appendUnsigned(StringBuilder *sb, uint64_t n) {
+  char buffer[21];
+  int length = snprintf(buffer, sizeof(buffer), "%" PRIu64, n);
+  stringBuilderAppend(sb, buffer, (size_t)length);
+}
+
+/**
+ * get the directive and value of a scalar datum
+ *
+ * @returns whether the datum was a scalar
+ */
+static bool scalarDatum(IRDatum const *d, char const **directive,
+                        uint64_t *value) {
+  switch (d->type) {
+    case DT_BYTE: {
+      *directive = "\tdb ";
+      *value = d->data.byteVal;
+      return true;
+    }
+    case DT_SHORT: {
+      *directive = "\tdw ";
+      *value = d->data.shortVal;
+      return true;
+    }
+    case DT_INT: {
+      *directive = "\tdd ";
+      *value = d->data.intVal;
+      return true;
+    }
+    case DT_LONG: {
+      *directive = "\tdq ";
+      *value = d->data.longVal;
+      return true;
+    }
+    default: {
+      return false;
+    }
+  }
+}
+
+/**
+ * can this character go in a quoted nasm string
+ */
+static bool quotable(uint8_t c) { return c >= ' ' && c <= '~' && c != '"'; }
+
+/**
+ * write a null-terminated string as db lines, quoting printable runs
+ */
+static void appendByteString(StringBuilder *sb, uint8_t const *string) {
+  stringBuilderAppendString(sb, "\tdb ");
+  size_t lineBytes = 0;
+  for (uint8_t const *in = string; *in != 0;) {
+    if (lineBytes >= DATA_STRING_LINE_LENGTH) {
+      stringBuilderAppendString(sb, "\n\tdb ");
+      lineBytes = 0;
+    } else if (lineBytes != 0) {
+      stringBuilderAppendString(sb, ", ");
+    }
+
+    if (quotable(*in)) {
+      size_t length = 0;
+      while (lineBytes + length < DATA_STRING_LINE_LENGTH &&
+             quotable(in[length]))
+        ++length;
+      stringBuilderPush(sb, '"');
+      stringBuilderAppend(sb, (char const *)in, length);
+      stringBuilderPush(sb, '"');
+      in += length;
+      lineBytes += length;
+    } else {
+      appendUnsigned(sb, *in++);
+      ++lineBytes;
+    }
+  }
+  stringBuilderAppendString(sb, lineBytes == 0 ? "0\n" : ", 0\n");
+}
+
+/**
+ * write a null-terminated wide string as dd lines
+ */
+static void appendWideString(StringBuilder *sb, uint32_t const *string) {
+  stringBuilderAppendString(sb, "\tdd ");
+  size_t lineItems = 0;
+  for (uint32_t const *in = string; *in != 0; ++in) {
+    if (lineItems == DATA_VALUES_PER_LINE) {
+      stringBuilderAppendString(sb, "\n\tdd ");
+      lineItems = 0;
+    } else if (lineItems != 0) {
+      stringBuilderAppendString(sb, ", ");
+    }
+    appendUnsigned(sb, *in);
+    ++lineItems;
+  }
+  stringBuilderAppendString(sb, lineItems == 0 ? "0\n" : ", 0\n");
+}
+
+/**
+ * write a blob as db lines
+ */
+static void appendBlob(StringBuilder *sb, uint8_t const *bytes,
+                       size_t length) {
+  for (size_t idx = 0; idx < length; ++idx) {
+    if (idx % DATA_VALUES_PER_LINE == 0) {
+      if (idx != 0) stringBuilderPush(sb, '\n');
+      stringBuilderAppendString(sb, "\tdb ");
+    } else {
+      stringBuilderAppendString(sb, ", ");
+    }
+    appendUnsigned(sb, bytes[idx]);
+  }
+  if (length != 0) stringBuilderPush(sb, '\n');
+}
+
+/**
+ * write a fill as a single repeated data directive
+ */
+static void appendFill(StringBuilder *sb, uint64_t value, size_t width,
+                       size_t count) {
+  stringBuilderAppendString(sb, "\ttimes ");
+  appendUnsigned(sb, count);
+  if (width == BYTE_WIDTH)
+    stringBuilderAppendString(sb, " db ");
+  else if (width == SHORT_WIDTH)
+    stringBuilderAppendString(sb, " dw ");
+  else if (width == INT_WIDTH)
+    stringBuilderAppendString(sb, " dd ");
+  else if (width == LONG_WIDTH)
+    stringBuilderAppendString(sb, " dq ");
+  else
+    error(__FILE__, __LINE__, "invalid fill width");
+  appendUnsigned(sb, value);
+  stringBuilderPush(sb, '\n');
+}
+
+/**
+ * write data as assembly, putting runs of same-sized scalars on shared lines
+ */
+static void x86_64LinuxDataToString(StringBuilder *sb, Vector const *v) {
+  for (size_t idx = 0; idx < v->size;) {
+    IRDatum const *d = v->elements[idx];
+    char const *directive;
+    uint64_t value;
+    if (scalarDatum(d, &directive, &value)) {
+      stringBuilderAppendString(sb, directive);
+      appendUnsigned(sb, value);
+      ++idx;
+
+      size_t lineItems = 1;
+      for (; idx < v->size; ++idx) {
+        IRDatum const *next = v->elements[idx];
+        if (next->type != d->type) break;
+        scalarDatum(next, &directive, &value);
+        if (lineItems == DATA_VALUES_PER_LINE) {
+          stringBuilderPush(sb, '\n');
+          stringBuilderAppendString(sb, directive);
+          lineItems = 0;
+        } else {
+          stringBuilderAppendString(sb, ", ");
+        }
+        appendUnsigned(sb, value);
+        ++lineItems;
       }
+      stringBuilderPush(sb, '\n');
+      continue;
+    }
+
+    switch (d->type) {
       case DT_PADDING: {
-        char *old = data;
-        data = format("%s\tresb %zu\n", old, d->data.paddingLength);
-        free(old);
+        stringBuilderAppendString(sb, "\tresb ");
+        appendUnsigned(sb, d->data.paddingLength);
+        stringBuilderPush(sb, '\n');
         break;
       }
       case DT_STRING: {
-        for (uint8_t *in = d->data.string; *in != 0; ++in) {
-          char *old = data;
-          data = format("%s\tdb %hhu\n", old, *in);
-          free(old);
-        }
-        char *old = data;
-        data = format("%s\tdb 0\n", old);
-        free(old);
+        appendByteString(sb, d->data.string);
         break;
       }
       case DT_WSTRING: {
-        for (uint32_t *in = d->data.wstring; *in != 0; ++in) {
-          char *old = data;
-          data = format("%s\tdd %u\n", old, *in);
-          free(old);
-        }
-        char *old = data;
-        data = format("%s\tdd 0\n", old);
-        free(old);
+        appendWideString(sb, d->data.wstring);
         break;
       }
       case DT_LOCAL: {
-        char *old = data;
-        data = format("%s\tdq L%zu\n", old, d->data.localLabel);
-        free(old);
+        stringBuilderAppendString(sb, "\tdq L");
+        appendUnsigned(sb, d->data.localLabel);
+        stringBuilderPush(sb, '\n');
+        break;
+      }
+      case DT_BLOB: {
+        appendBlob(sb, d->data.blob.bytes, d->data.blob.length);
+        break;
+      }
+      case DT_FILL: {
+        appendFill(sb, d->data.fill.value, d->data.fill.width,
+                   d->data.fill.count);
         break;
       }
       default: {
         error(__FILE__, __LINE__, "invalid datum type");
       }
     }
+    ++idx;
   }
-  return data;
 }
 
 static X86_64LinuxFrag *x86_64LinuxGenerateDataAsm(IRFrag *frag) {
@@ -289,13 +528,17 @@ static X86_64LinuxFrag *x86_64LinuxGenerateDataAsm(IRFrag *frag) {
       error(__FILE__, __LINE__, "invalid fragment name type");
     }
   }
-  char *data = x86_64LinuxDataToString(&frag->data.data.data);
-
-  X86_64LinuxFrag *retval =
-      x86_64LinuxDataFragCreate(format("%s%s%s.end\n", section, name, data));
+  StringBuilder sb;
+  stringBuilderInit(&sb);
+  stringBuilderAppendString(&sb, section);
+  stringBuilderAppendString(&sb, name);
+  x86_64LinuxDataToString(&sb, &frag->data.data.data);
+  stringBuilderAppendString(&sb, ".end\n");
   free(section);
   free(name);
-  free(data);
+
+  X86_64LinuxFrag *retval = x86_64LinuxDataFragCreate(stringBuilderData(&sb));
+  stringBuilderUninit(&sb);
   return retval;
 }
 
@@ -306,6 +549,7 @@ static X86_64LinuxInstruction *INST(X86_64LinuxInstructionKind kind,
   retval->skeleton = skeleton;
   vectorInit(&retval->defines);
   vectorInit(&retval->uses);
+  vectorInit(&retval->other);
   switch (retval->kind) {
     case X86_64_LINUX_IK_JUMP:
     case X86_64_LINUX_IK_JUMPTABLE:
@@ -324,6 +568,10 @@ static X86_64LinuxInstruction *INST(X86_64LinuxInstructionKind kind,
   }
   return retval;
 }
+X86_64LinuxInstruction *x86_64LinuxInstructionCreate(
+    X86_64LinuxInstructionKind kind, char *skeleton) {
+  return INST(kind, skeleton);
+}
 static void DEFINES(X86_64LinuxInstruction *i, X86_64LinuxOperand *arg) {
   vectorInsert(&i->defines, arg);
 }
@@ -340,6 +588,18 @@ static void MOVES(X86_64LinuxInstruction *i, size_t dest, size_t src) {
 static void DONE(X86_64LinuxFrag *assembly, X86_64LinuxInstruction *i) {
   insertNodeEnd(&assembly->data.text.instructions, i);
 }
+X86_64LinuxInstruction *x86_64LinuxMoveInstructionCreate(
+    X86_64LinuxOperand *to, X86_64LinuxOperand *from) {
+  size_t size = to->kind == X86_64_LINUX_OK_REG ? to->data.reg.size
+                                                : to->data.temp.size;
+  X86_64LinuxInstruction *i =
+      INST(X86_64_LINUX_IK_REGULAR, strdup(size == 16 ? "\tmovdqu `d, `u\n"
+                                                      : "\tmov `d, `u\n"));
+  DEFINES(i, to);
+  USES(i, from);
+  MOVES(i, 0, 0);
+  return i;
+}
 
 static bool isMemTemp(IROperand const *o) {
   return o->kind == OK_TEMP && o->data.temp.kind == AH_MEM;
@@ -366,7 +626,7 @@ static bool isFpReg(IROperand const *o) {
  * @param constant constant to encode - must be 8 bytes or smaller
  * @returns encoded value
  */
-static uint64_t x86_64LinuxConstantToNumber(IROperand *constant) {
+static uint64_t x86_64LinuxConstantToNumber(IROperand const *constant) {
   uint8_t bytes[8];
   memset(&bytes, 0, 8);
 
@@ -421,6 +681,15 @@ static uint64_t x86_64LinuxConstantToNumber(IROperand *constant) {
         next += datum->data.paddingLength;
         break;
       }
+      case DT_FILL: {
+        for (size_t count = 0; count < datum->data.fill.count; ++count) {
+          for (size_t byte = 0; byte < datum->data.fill.width; ++byte) {
+            bytes[next] = (uint8_t)(datum->data.fill.value >> (byte * 8));
+            next += 1;
+          }
+        }
+        break;
+      }
       default: {
         error(__FILE__, __LINE__, "invalid datum type");
       }
@@ -429,137 +698,1754 @@ static uint64_t x86_64LinuxConstantToNumber(IROperand *constant) {
 
   // encode into little-endian
   uint64_t out = 0;
-  for (size_t idx = 0; idx < 8; ++idx) {
+  for (size_t idx = 8; idx-- > 0;) {
     out <<= 8;
     out |= bytes[idx];
   }
   return out;
 }
 
+/** largest copy that is unrolled instead of using rep movsb */
+static size_t const MEMCPY_UNROLL_LIMIT = 128;
+/** width of an sse register */
+static size_t const SSE_WIDTH = 16;
+
+/**
+ * load the address of a memory temp into a fresh temp
+ *
+ * @returns name of the fresh temp
+ */
+static size_t x86_64LinuxGenerateTempAddress(X86_64LinuxFrag *assembly,
+                                             FileListEntry *file,
+                                             IROperand const *temp) {
+  size_t address = fresh(file);
+  X86_64LinuxInstruction *i =
+      INST(X86_64_LINUX_IK_REGULAR, strdup("\tlea `d, `u\n"));
+  DEFINES(i, x86_64LinuxScratchOperandCreate(
+                 address, X86_64_LINUX_REGISTER_WIDTH, AH_GP));
+  USES(i, x86_64LinuxOperandCreate(temp));
+  DONE(assembly, i);
+  return address;
+}
+
+/**
+ * load the address of a local label into a fresh temp
+ *
+ * @returns name of the fresh temp
+ */
+static size_t x86_64LinuxGenerateLabelAddress(X86_64LinuxFrag *assembly,
+                                              FileListEntry *file,
+                                              size_t label) {
+  size_t address = fresh(file);
+  X86_64LinuxInstruction *i =
+      INST(X86_64_LINUX_IK_REGULAR, format("\tlea `d, L%lu\n", label));
+  DEFINES(i, x86_64LinuxScratchOperandCreate(
+                 address, X86_64_LINUX_REGISTER_WIDTH, AH_GP));
+  DONE(assembly, i);
+  return address;
+}
+
+/**
+ * generate one piece of an unrolled memcpy, through a fresh temp
+ *
+ * @param toAddress temp holding the destination address
+ * @param fromAddress temp holding the source address
+ * @param offset offset of the piece from both addresses
+ * @param width size of the piece
+ */
+static void x86_64LinuxGenerateMemcpyPiece(X86_64LinuxFrag *assembly,
+                                           FileListEntry *file,
+                                           size_t toAddress,
+                                           size_t fromAddress, size_t offset,
+                                           size_t width) {
+  size_t scratch = fresh(file);
+  AllocHint kind = width == SSE_WIDTH ? AH_FP : AH_GP;
+  char const *mnemonic = width == SSE_WIDTH ? "movdqu" : "mov";
+  char *address = offset == 0 ? strdup("`u") : format("`u + %lu", offset);
+
+  X86_64LinuxInstruction *i = INST(
+      X86_64_LINUX_IK_REGULAR, format("\t%s `d, [%s]\n", mnemonic, address));
+  DEFINES(i, x86_64LinuxScratchOperandCreate(scratch, width, kind));
+  USES(i, x86_64LinuxScratchOperandCreate(
+              fromAddress, X86_64_LINUX_REGISTER_WIDTH, AH_GP));
+  DONE(assembly, i);
+
+  i = INST(X86_64_LINUX_IK_REGULAR,
+           format("\t%s [%s], `u\n", mnemonic, address));
+  free(address);
+  USES(i, x86_64LinuxScratchOperandCreate(toAddress,
+                                          X86_64_LINUX_REGISTER_WIDTH, AH_GP));
+  USES(i, x86_64LinuxScratchOperandCreate(scratch, width, kind));
+  DONE(assembly, i);
+}
+
+/**
+ * generate a copy between two addresses
+ *
+ * Small copies are unrolled into general purpose moves, and medium copies
+ * into sse moves, where sizes that aren't a multiple of the move width end
+ * with a move overlapping the previous one. Large copies use rep movsb.
+ *
+ * @param size number of bytes to copy
+ * @param toAddress temp holding the destination address
+ * @param fromAddress temp holding the source address
+ * @param to memory temp being written, or NULL if not copying into a temp
+ * @param from memory temp being read, or NULL if not copying from a temp
+ */
+static void x86_64LinuxGenerateMemcpy(X86_64LinuxFrag *assembly,
+                                      FileListEntry *file, size_t size,
+                                      size_t toAddress, size_t fromAddress,
+                                      IROperand const *to,
+                                      IROperand const *from) {
+  X86_64LinuxInstruction *i;
+  if (size > MEMCPY_UNROLL_LIMIT) {
+    i = INST(X86_64_LINUX_IK_REGULAR, strdup("\tmov `d, `u\n"));
+    DEFINES(i, x86_64LinuxRegOperandCreate(X86_64_LINUX_RDI, 8));
+    USES(i, x86_64LinuxScratchOperandCreate(
+                toAddress, X86_64_LINUX_REGISTER_WIDTH, AH_GP));
+    MOVES(i, 0, 0);
+    DONE(assembly, i);
+
+    i = INST(X86_64_LINUX_IK_REGULAR, strdup("\tmov `d, `u\n"));
+    DEFINES(i, x86_64LinuxRegOperandCreate(X86_64_LINUX_RSI, 8));
+    USES(i, x86_64LinuxScratchOperandCreate(
+                fromAddress, X86_64_LINUX_REGISTER_WIDTH, AH_GP));
+    MOVES(i, 0, 0);
+    DONE(assembly, i);
+
+    i = INST(X86_64_LINUX_IK_REGULAR, format("\tmov `d, %lu\n", size));
+    DEFINES(i, x86_64LinuxRegOperandCreate(X86_64_LINUX_RCX, 8));
+    DONE(assembly, i);
+
+    i = INST(X86_64_LINUX_IK_REGULAR, strdup("\trep movsb\n"));
+    USES(i, x86_64LinuxRegOperandCreate(X86_64_LINUX_RSI, 8));
+    USES(i, x86_64LinuxRegOperandCreate(X86_64_LINUX_RDI, 8));
+    USES(i, x86_64LinuxRegOperandCreate(X86_64_LINUX_RCX, 8));
+    DEFINES(i, x86_64LinuxRegOperandCreate(X86_64_LINUX_RSI, 8));
+    DEFINES(i, x86_64LinuxRegOperandCreate(X86_64_LINUX_RDI, 8));
+    DEFINES(i, x86_64LinuxRegOperandCreate(X86_64_LINUX_RCX, 8));
+    if (to != NULL) DEFINES(i, x86_64LinuxOperandCreate(to));
+    if (from != NULL) USES(i, x86_64LinuxOperandCreate(from));
+    DONE(assembly, i);
+    return;
+  }
+
+  // widest moves that fit, then one overlapping move for the remainder
+  size_t width;
+  if (size >= SSE_WIDTH)
+    width = SSE_WIDTH;
+  else if (size >= 8)
+    width = 8;
+  else if (size >= 4)
+    width = 4;
+  else if (size >= 2)
+    width = 2;
+  else
+    width = 1;
+  size_t offset = 0;
+  for (; offset + width <= size; offset += width)
+    x86_64LinuxGenerateMemcpyPiece(assembly, file, toAddress, fromAddress,
+                                   offset, width);
+  if (offset != size)
+    x86_64LinuxGenerateMemcpyPiece(assembly, file, toAddress, fromAddress,
+                                   size - width, width);
+
+  // the copy as a whole reads from and writes to the temps
+  if (to != NULL || from != NULL) {
+    i = INST(X86_64_LINUX_IK_REGULAR, strdup(""));  // empty instruction
+    if (to != NULL) DEFINES(i, x86_64LinuxOperandCreate(to));
+    if (from != NULL) USES(i, x86_64LinuxOperandCreate(from));
+    DONE(assembly, i);
+  }
+}
+
+/** largest fill that is unrolled instead of using rep stosq */
+static size_t const MEMSET_UNROLL_LIMIT = 256;
+
+/**
+ * get the fill datum a constant consists of
+ *
+ * @returns the fill, or NULL if the constant isn't a single fill
+ */
+static IRDatum const *x86_64LinuxConstantFill(IROperand const *constant) {
+  if (constant->data.constant.data.size != 1) return NULL;
+  IRDatum const *d = constant->data.constant.data.elements[0];
+  return d->type == DT_FILL ? d : NULL;
+}
+
+/**
+ * repeat a fill's value to fill eight bytes
+ */
+static uint64_t x86_64LinuxFillPattern(IRDatum const *fill) {
+  uint64_t pattern = 0;
+  for (size_t idx = 0; idx < 8; idx += fill->data.fill.width)
+    pattern |= fill->data.fill.value << (idx * 8);
+  return pattern;
+}
+
+/**
+ * generate one store of an unrolled memset
+ *
+ * @param toAddress temp holding the destination address
+ * @param offset offset of the store from the address
+ * @param value temp holding the pattern to store
+ * @param width size of the store
+ */
+static void x86_64LinuxGenerateMemsetPiece(X86_64LinuxFrag *assembly,
+                                           size_t toAddress, size_t offset,
+                                           size_t value, size_t width) {
+  char const *mnemonic = width == SSE_WIDTH ? "movdqu" : "mov";
+  char *address = offset == 0 ? strdup("`u") : format("`u + %lu", offset);
+  X86_64LinuxInstruction *i = INST(
+      X86_64_LINUX_IK_REGULAR, format("\t%s [%s], `u\n", mnemonic, address));
+  free(address);
+  USES(i, x86_64LinuxScratchOperandCreate(toAddress,
+                                          X86_64_LINUX_REGISTER_WIDTH, AH_GP));
+  USES(i, x86_64LinuxScratchOperandCreate(value, width,
+                                          width == SSE_WIDTH ? AH_FP : AH_GP));
+  DONE(assembly, i);
+}
+
 /**
- * generates the rest of a memcpy, returning the actual movs instruction
+ * generate a fill of a memory temp with a repeated value
  *
- * assumes that RSI and RDI are already set
+ * Small fills are unrolled into general purpose stores and medium fills into
+ * sse stores, where sizes that aren't a multiple of the store width end with
+ * a store overlapping the previous one. Large fills use rep stosq.
+ *
+ * @param to memory temp to fill
+ * @param fill fill datum covering all of to
  */
-static X86_64LinuxInstruction *x86_64LinuxGenerateMemcpy(
-    X86_64LinuxFrag *assembly, size_t size) {
+static void x86_64LinuxGenerateMemset(X86_64LinuxFrag *assembly,
+                                      FileListEntry *file, IROperand *to,
+                                      IRDatum const *fill) {
+  size_t size = to->data.temp.size;
+  uint64_t pattern = x86_64LinuxFillPattern(fill);
   X86_64LinuxInstruction *i;
 
-  size_t factor;
-  char const *postfix;
-  if (size % 8 == 0) {
-    factor = 8;
-    postfix = "q";
-  } else if (size % 4 == 0) {
-    factor = 4;
-    postfix = "d";
-  } else if (size % 2 == 0) {
-    factor = 2;
-    postfix = "w";
+  if (size > MEMSET_UNROLL_LIMIT) {
+    i = INST(X86_64_LINUX_IK_REGULAR, strdup("\tlea `d, `u\n"));
+    DEFINES(i, x86_64LinuxRegOperandCreate(X86_64_LINUX_RDI, 8));
+    USES(i, x86_64LinuxOperandCreate(to));
+    DONE(assembly, i);
+
+    i = INST(X86_64_LINUX_IK_REGULAR,
+             pattern == 0 ? strdup("\txor `d, `d\n")
+                          : format("\tmov `d, %lu\n", pattern));
+    DEFINES(i, x86_64LinuxRegOperandCreate(X86_64_LINUX_RAX, 8));
+    if (pattern == 0)
+      DEFINES(i, x86_64LinuxRegOperandCreate(X86_64_LINUX_RAX, 8));
+    DONE(assembly, i);
+
+    i = INST(X86_64_LINUX_IK_REGULAR, format("\tmov `d, %lu\n", size / 8));
+    DEFINES(i, x86_64LinuxRegOperandCreate(X86_64_LINUX_RCX, 8));
+    DONE(assembly, i);
+
+    i = INST(X86_64_LINUX_IK_REGULAR, strdup("\trep stosq\n"));
+    USES(i, x86_64LinuxRegOperandCreate(X86_64_LINUX_RAX, 8));
+    USES(i, x86_64LinuxRegOperandCreate(X86_64_LINUX_RDI, 8));
+    USES(i, x86_64LinuxRegOperandCreate(X86_64_LINUX_RCX, 8));
+    DEFINES(i, x86_64LinuxRegOperandCreate(X86_64_LINUX_RDI, 8));
+    DEFINES(i, x86_64LinuxRegOperandCreate(X86_64_LINUX_RCX, 8));
+    DEFINES(i, x86_64LinuxOperandCreate(to));
+    DONE(assembly, i);
+
+    if (size % 8 != 0) {
+      // rdi is just past the last qword - end with an overlapping store
+      i = INST(X86_64_LINUX_IK_REGULAR,
+               format("\tmov [`u - %lu], `u\n", 8 - size % 8));
+      USES(i, x86_64LinuxRegOperandCreate(X86_64_LINUX_RDI, 8));
+      USES(i, x86_64LinuxRegOperandCreate(X86_64_LINUX_RAX, 8));
+      DEFINES(i, x86_64LinuxOperandCreate(to));
+      DONE(assembly, i);
+    }
+    return;
+  }
+
+  size_t toAddress = x86_64LinuxGenerateTempAddress(assembly, file, to);
+
+  size_t width;
+  if (size >= SSE_WIDTH)
+    width = SSE_WIDTH;
+  else if (size >= 8)
+    width = 8;
+  else if (size >= 4)
+    width = 4;
+  else if (size >= 2)
+    width = 2;
+  else
+    width = 1;
+
+  size_t value = fresh(file);
+  if (width == SSE_WIDTH) {
+    if (pattern == 0) {
+      i = INST(X86_64_LINUX_IK_REGULAR, strdup("\tpxor `d, `d\n"));
+      DEFINES(i, x86_64LinuxScratchOperandCreate(value, SSE_WIDTH, AH_FP));
+      DEFINES(i, x86_64LinuxScratchOperandCreate(value, SSE_WIDTH, AH_FP));
+      DONE(assembly, i);
+    } else {
+      size_t half = fresh(file);
+      i = INST(X86_64_LINUX_IK_REGULAR, format("\tmov `d, %lu\n", pattern));
+      DEFINES(i, x86_64LinuxScratchOperandCreate(half, 8, AH_GP));
+      DONE(assembly, i);
+
+      i = INST(X86_64_LINUX_IK_REGULAR, strdup("\tmovq `d, `u\n"));
+      DEFINES(i, x86_64LinuxScratchOperandCreate(value, SSE_WIDTH, AH_FP));
+      USES(i, x86_64LinuxScratchOperandCreate(half, 8, AH_GP));
+      DONE(assembly, i);
+
+      i = INST(X86_64_LINUX_IK_REGULAR, strdup("\tpunpcklqdq `d, `u\n"));
+      DEFINES(i, x86_64LinuxScratchOperandCreate(value, SSE_WIDTH, AH_FP));
+      USES(i, x86_64LinuxScratchOperandCreate(value, SSE_WIDTH, AH_FP));
+      DONE(assembly, i);
+    }
   } else {
-    factor = 1;
-    postfix = "b";
+    i = INST(X86_64_LINUX_IK_REGULAR,
+             pattern == 0 ? strdup("\txor `d, `d\n")
+                          : format("\tmov `d, %lu\n", pattern));
+    DEFINES(i, x86_64LinuxScratchOperandCreate(value, width, AH_GP));
+    if (pattern == 0)
+      DEFINES(i, x86_64LinuxScratchOperandCreate(value, width, AH_GP));
+    DONE(assembly, i);
   }
 
-  i = INST(X86_64_LINUX_IK_REGULAR, format("\tmov `d, %lu\n", size / factor));
-  DEFINES(i, x86_64LinuxRegOperandCreate(X86_64_LINUX_RCX, 8));
+  size_t offset = 0;
+  for (; offset + width <= size; offset += width)
+    x86_64LinuxGenerateMemsetPiece(assembly, toAddress, offset, value, width);
+  if (offset != size)
+    x86_64LinuxGenerateMemsetPiece(assembly, toAddress, size - width, value,
+                                   width);
+
+  i = INST(X86_64_LINUX_IK_REGULAR, strdup(""));  // empty instruction
+  DEFINES(i, x86_64LinuxOperandCreate(to));
   DONE(assembly, i);
+}
 
-  i = INST(X86_64_LINUX_IK_REGULAR, format("\trep mov%s\n", postfix));
-  USES(i, x86_64LinuxRegOperandCreate(X86_64_LINUX_RSI, 8));
-  USES(i, x86_64LinuxRegOperandCreate(X86_64_LINUX_RDI, 8));
-  USES(i, x86_64LinuxRegOperandCreate(X86_64_LINUX_RCX, 8));
-  DEFINES(i, x86_64LinuxRegOperandCreate(X86_64_LINUX_RSI, 8));
-  DEFINES(i, x86_64LinuxRegOperandCreate(X86_64_LINUX_RDI, 8));
-  DEFINES(i, x86_64LinuxRegOperandCreate(X86_64_LINUX_RCX, 8));
-  return i;
+/**
+ * get the label of a rodata constant, reusing an identical earlier constant in
+ * the same file if possible
+ *
+ * @param alignment alignment of the constant
+ * @param data Vector of IRDatum
+ */
+static size_t x86_64LinuxPoolConstant(FileListEntry *file, size_t alignment,
+                                      Vector const *data) {
+  X86_64LinuxFile *asmFile = file->asmFile;
+  StringBuilder sb;
+  stringBuilderInit(&sb);
+  char *header = format("section .rodata align=%lu\n", alignment);
+  stringBuilderAppendString(&sb, header);
+  free(header);
+  x86_64LinuxDataToString(&sb, data);
+  char *key = stringBuilderData(&sb);
+  stringBuilderUninit(&sb);
+
+  PooledConstant *pooled = hashMapGet(&asmFile->constants, key);
+  if (pooled != NULL) {
+    free(key);
+    return pooled->name;
+  }
+
+  pooled = malloc(sizeof(PooledConstant));
+  pooled->key = key;
+  pooled->name = fresh(file);
+  hashMapPut(&asmFile->constants, pooled->key, pooled);
+
+  char *body = strchr(key, '\n') + 1;
+  vectorInsert(&asmFile->frags,
+               x86_64LinuxDataFragCreate(format(
+                   "%.*sL%lu:\n%s.end\n", (int)(body - key), key,
+                   pooled->name, body)));
+  return pooled->name;
 }
 
 /**
- * generate a fragment holding a constant
+ * generate a floating point constant in an xmm register or fp temp - zero is
+ * generated directly, and anything else is loaded from the constant pool
  */
-static X86_64LinuxFrag *x86_64LinuxConstantToFrag(IROperand *constant,
-                                                  size_t name) {
-  char *data = x86_64LinuxDataToString(&constant->data.constant.data);
-  X86_64LinuxFrag *retval = x86_64LinuxDataFragCreate(
-      format("section .rodata align=%zu\nL%zu:\n%s.end\n",
-             constant->data.constant.alignment, name, data));
-  free(data);
-  return retval;
+static void x86_64LinuxGenerateFpConstant(X86_64LinuxFrag *assembly,
+                                          FileListEntry *file,
+                                          IROperand const *to,
+                                          IROperand const *constant) {
+  size_t size = irOperandSizeof(to);
+  uint64_t bits = x86_64LinuxConstantToNumber(constant);
+  if (size == INT_WIDTH) bits &= 0xffffffff;
+
+  X86_64LinuxInstruction *i;
+  if (bits == 0) {
+    i = INST(X86_64_LINUX_IK_REGULAR, strdup("\tpxor `d, `d\n"));
+    DEFINES(i, x86_64LinuxOperandCreate(to));
+    DEFINES(i, x86_64LinuxOperandCreate(to));
+    DONE(assembly, i);
+    return;
+  }
+
+  Vector data;
+  vectorInit(&data);
+  vectorInsert(&data, size == INT_WIDTH ? intDatumCreate((uint32_t)bits)
+                                        : longDatumCreate(bits));
+  size_t constantName = x86_64LinuxPoolConstant(file, size, &data);
+  vectorUninit(&data, (void (*)(void *))irDatumFree);
+
+  size_t address = x86_64LinuxGenerateLabelAddress(assembly, file,
+                                                   constantName);
+  i = INST(X86_64_LINUX_IK_REGULAR,
+           strdup(size == INT_WIDTH ? "\tmovd `d, [`u]\n"
+                                    : "\tmovq `d, [`u]\n"));
+  DEFINES(i, x86_64LinuxOperandCreate(to));
+  USES(i, x86_64LinuxScratchOperandCreate(address, X86_64_LINUX_REGISTER_WIDTH,
+                                          AH_GP));
+  DONE(assembly, i);
 }
 
-static X86_64LinuxFrag *x86_64LinuxGenerateTextAsm(IRFrag *frag,
-                                                   FileListEntry *file) {
-  X86_64LinuxFile *asmFile = file->asmFile;
-  X86_64LinuxFrag *assembly = x86_64LinuxTextFragCreate(
-      format("section .text\nglobal %s:function\n%s:\n", frag->name.global,
-             frag->name.global),
-      strdup(".end\n"));
-  IRBlock *b = frag->data.text.blocks.head->next->data;
-  for (ListNode *currInst = b->instructions.head->next;
-       currInst != b->instructions.tail; currInst = currInst->next) {
-    IRInstruction *ir = currInst->data;
-    X86_64LinuxInstruction *i;
-    switch (ir->op) {
-      case IO_LABEL: {
-        // arg 0: local
-        i = INST(X86_64_LINUX_IK_LABEL,
-                 format("L%zu:\n", localOperandName(ir->args[0])));
-        i->data.labelName = localOperandName(ir->args[0]);
-        DONE(assembly, i);
-        break;
-      }
-      case IO_VOLATILE: {
-        // arg 0: temp
-        i = INST(X86_64_LINUX_IK_REGULAR, strdup(""));  // empty instruction
-        USES(i, x86_64LinuxOperandCreate(ir->args[0]));
-        DONE(assembly, i);
-        break;
-      }
-      case IO_UNINITIALIZED:
-      case IO_NOP: {
-        break;  // not translated
-      }
-      case IO_ADDROF: {
-        // arg 0: reg, gp temp, mem temp
-        // arg 1: mem temp
+/**
+ * an offset folded into the index and displacement of a memory operand
+ *
+ * The index is multiplied by 3, 5, or 9 with a lea if the scale alone can't
+ * express its factor.
+ */
+typedef struct {
+  bool folded;            /**< could the offset be folded */
+  IROperand const *index; /**< gp temp or reg to scale, or NULL */
+  uint64_t multiplier;    /**< 1, 3, 5, or 9 */
+  uint64_t scale;         /**< 1, 2, 4, or 8 */
+  int64_t displacement;
+} FoldedOffset;
 
-        if (ir->args[0]->kind == OK_REG || isGpTemp(ir->args[0])) {
-          // to register-ish
-          i = INST(X86_64_LINUX_IK_REGULAR, strdup("\tlea `d, `u\n"));
-          DEFINES(i, x86_64LinuxOperandCreate(ir->args[0]));
-          USES(i, x86_64LinuxTempOperandCreateEscaping(ir->args[1]));
-          DONE(assembly, i);
-        } else {
-          // to memory
-          size_t patchTemp = fresh(file);
-          i = INST(X86_64_LINUX_IK_REGULAR, strdup("\tmov `d, `u\n"));
-          DEFINES(i, x86_64LinuxTempOperandCreatePatch(ir->args[0], patchTemp,
-                                                       AH_GP));
-          USES(i, x86_64LinuxTempOperandCreateEscaping(ir->args[1]));
-          DONE(assembly, i);
+/**
+ * the address arithmetic in a block that can be folded into memory operands,
+ * along with the zeros that comparisons can test against instead
+ */
+typedef struct {
+  IRInstruction **instructions; /**< the block's instructions, in order */
+  size_t numInstructions;
+  size_t *references;    /**< number of mentions of each temp */
+  FoldedOffset *offsets; /**< folded offset of each memory access */
+  bool *skipped;         /**< is each instruction folded into an access */
+} AddressFolding;
 
-          i = INST(X86_64_LINUX_IK_REGULAR, strdup("\tmov `d, `u\n"));
-          DEFINES(i, x86_64LinuxOperandCreate(ir->args[0]));
-          USES(i, x86_64LinuxTempOperandCreatePatch(ir->args[0], patchTemp,
-                                                    AH_GP));
-          MOVES(i, 0, 0);
-          DONE(assembly, i);
-        }
-        break;
-      }
-      case IO_MOVE: {
-        // arg 0: reg, non-mem temp, mem temp
-        // arg 1: reg, non-mem temp, mem temp, const
+static bool isMemoryAccess(IROperator op) {
+  return op == IO_MEM_STORE || op == IO_MEM_LOAD || op == IO_OFFSET_STORE ||
+         op == IO_OFFSET_LOAD;
+}
+static bool isIntegralConstant(IROperand const *o) {
+  return o->kind == OK_CONSTANT && !irOperandIsLabel(o);
+}
+static bool isTempNamed(IROperand const *o, size_t name) {
+  return o->kind == OK_TEMP && o->data.temp.name == name;
+}
 
-        if (ir->args[0]->kind == OK_REG || isNonMemTemp(ir->args[0])) {
-          if (ir->args[1]->kind == OK_REG || ir->args[0]->kind == OK_TEMP) {
-            // register-ish/memory to register-ish
-            i = INST(X86_64_LINUX_IK_REGULAR, strdup("\tmov `d, `u\n"));
-            DEFINES(i, x86_64LinuxOperandCreate(ir->args[0]));
-            USES(i, x86_64LinuxOperandCreate(ir->args[1]));
-            MOVES(i, 0, 0);
+/**
+ * find the definition of a temp that is only read by the instruction at
+ * position reader, if it's in the same straight-line code as the reader
+ *
+ * @returns position of the definition, or SIZE_MAX if there is none
+ */
+static size_t foldableDefinition(AddressFolding const *f,
+                                 IROperand const *temp, size_t reader) {
+  size_t name = temp->data.temp.name;
+  if (f->references[name] != 2) return SIZE_MAX;
+  for (size_t idx = reader; idx-- > 0;) {
+    IRInstruction const *ir = f->instructions[idx];
+    if (ir->op == IO_LABEL) return SIZE_MAX;
+    for (size_t arg = 0; arg < irOperatorArity(ir->op); ++arg) {
+      if (isTempNamed(ir->args[arg], name))
+        return arg == 0 ? idx : SIZE_MAX;
+    }
+  }
+  return SIZE_MAX;
+}
+
+/**
+ * get the value of a move or extension of a constant
+ *
+ * @returns whether the instruction is a move or extension of a constant
+ */
+static bool constantDefinitionValue(IRInstruction const *ir, uint64_t *value) {
+  if ((ir->op != IO_MOVE && ir->op != IO_SX && ir->op != IO_ZX) ||
+      !isIntegralConstant(ir->args[1]))
+    return false;
+  *value = x86_64LinuxConstantToNumber(ir->args[1]);
+  size_t bits = irOperandSizeof(ir->args[1]) * 8;
+  if (ir->op == IO_SX && bits < 64 && (*value >> (bits - 1) & 1) != 0)
+    *value |= UINT64_MAX << bits;
+  return true;
+}
+
+/**
+ * find the value of a temp that is last set to a constant in the same
+ * straight-line code as the instruction at position reader
+ *
+ * @returns whether the temp is known to be constant
+ */
+static bool constantTemp(AddressFolding const *f, IROperand const *temp,
+                         size_t reader, uint64_t *value) {
+  size_t name = temp->data.temp.name;
+  for (size_t idx = reader; idx-- > 0;) {
+    IRInstruction const *ir = f->instructions[idx];
+    if (ir->op == IO_LABEL) return false;
+    if (irOperatorArity(ir->op) != 0 && isTempNamed(ir->args[0], name))
+      return constantDefinitionValue(ir, value);
+  }
+  return false;
+}
+
+/**
+ * is a temp left unwritten by the straight-line code between two positions
+ */
+static bool unchangedBetween(AddressFolding const *f, IROperand const *temp,
+                             size_t from, size_t to) {
+  for (size_t idx = from + 1; idx < to; ++idx) {
+    IRInstruction const *ir = f->instructions[idx];
+    if (ir->op == IO_LABEL ||
+        (irOperatorArity(ir->op) != 0 &&
+         isTempNamed(ir->args[0], temp->data.temp.name)))
+      return false;
+  }
+  return true;
+}
+
+static bool foldOffset(AddressFolding const *f, FoldedOffset *out,
+                       IROperand const *value, uint64_t scale, size_t reader,
+                       size_t use, SizeVector *folded);
+
+/**
+ * fold the value an instruction computes into an offset
+ *
+ * @returns whether the instruction could be folded
+ */
+static bool foldDefinition(AddressFolding const *f, FoldedOffset *out,
+                           IRInstruction const *ir, uint64_t scale,
+                           size_t position, size_t use, SizeVector *folded) {
+  switch (ir->op) {
+    case IO_MOVE: {
+      return foldOffset(f, out, ir->args[1], scale, position, use, folded);
+    }
+    case IO_ADD: {
+      return foldOffset(f, out, ir->args[1], scale, position, use, folded) &&
+             foldOffset(f, out, ir->args[2], scale, position, use, folded);
+    }
+    case IO_SLL: {
+      if (!isIntegralConstant(ir->args[2])) return false;
+      uint64_t amount = x86_64LinuxConstantToNumber(ir->args[2]);
+      if (amount >= 64) return false;
+      return foldOffset(f, out, ir->args[1], scale << amount, position, use,
+                        folded);
+    }
+    case IO_SMUL:
+    case IO_UMUL: {
+      IROperand const *factor = ir->args[2];
+      IROperand const *multiplicand = ir->args[1];
+      if (!isIntegralConstant(factor)) {
+        factor = ir->args[1];
+        multiplicand = ir->args[2];
+      }
+      if (!isIntegralConstant(factor)) return false;
+      return foldOffset(f, out, multiplicand,
+                        scale * x86_64LinuxConstantToNumber(factor), position,
+                        use, folded);
+    }
+    default: {
+      return false;
+    }
+  }
+}
+
+/**
+ * add value * scale to an offset, folding in the single-use arithmetic that
+ * computes the value
+ *
+ * @param value operand read by the instruction at position reader
+ * @param use position of the memory access
+ * @param folded positions of the instructions folded in so far
+ * @returns whether the value could be added
+ */
+static bool foldOffset(AddressFolding const *f, FoldedOffset *out,
+                       IROperand const *value, uint64_t scale, size_t reader,
+                       size_t use, SizeVector *folded) {
+  if (value->kind == OK_CONSTANT) {
+    if (irOperandIsLabel(value)) return false;
+    out->displacement +=
+        (int64_t)(x86_64LinuxConstantToNumber(value) * scale);
+    return true;
+  }
+
+  if (irOperandSizeof(value) != X86_64_LINUX_REGISTER_WIDTH) return false;
+  if (value->kind == OK_REG) {
+    // registers may be clobbered before the access
+    if (!isGpReg(value) || reader != use) return false;
+  } else if (!isGpTemp(value) || !unchangedBetween(f, value, reader, use)) {
+    return false;
+  } else {
+    uint64_t constant;
+    if (constantTemp(f, value, reader, &constant)) {
+      // only still computed if it's also used elsewhere
+      out->displacement += (int64_t)(constant * scale);
+      size_t definition = foldableDefinition(f, value, reader);
+      if (definition != SIZE_MAX) sizeVectorInsert(folded, definition);
+      return true;
+    }
+
+    size_t definition = foldableDefinition(f, value, reader);
+    if (definition != SIZE_MAX) {
+      FoldedOffset saved = *out;
+      size_t numFolded = folded->size;
+      if (foldDefinition(f, out, f->instructions[definition], scale,
+                         definition, use, folded)) {
+        sizeVectorInsert(folded, definition);
+        return true;
+      }
+      *out = saved;
+      folded->size = numFolded;
+    }
+  }
+
+  if (out->index == NULL) {
+    out->index = value;
+    out->scale = scale;
+    return true;
+  } else if (value->kind == OK_TEMP &&
+             isTempNamed(out->index, value->data.temp.name)) {
+    out->scale += scale;  // x * 2 + x and the like
+    return true;
+  } else {
+    return false;
+  }
+}
+
+/**
+ * split the factor an index was folded with into a multiplier and a scale
+ *
+ * @returns whether the factor can be split
+ */
+static bool splitFactor(FoldedOffset *offset) {
+  uint64_t const multipliers[] = {1, 3, 5, 9};
+  for (size_t idx = 0; idx < sizeof(multipliers) / sizeof(uint64_t); ++idx) {
+    for (uint64_t scale = 1; scale <= 8; scale *= 2) {
+      if (multipliers[idx] * scale == offset->scale) {
+        offset->multiplier = multipliers[idx];
+        offset->scale = scale;
+        return true;
+      }
+    }
+  }
+  return false;
+}
+
+static bool isIntegerComparison(IROperator op) {
+  return (IO_L <= op && op <= IO_BE) || (IO_J1L <= op && op <= IO_J1BE);
+}
+
+/**
+ * is an operand of the instruction at position known to be zero - either a
+ * zero constant or a gp temp last set to zero in the same straight-line code
+ */
+static bool knownZero(AddressFolding const *f, IROperand const *o,
+                      size_t position) {
+  uint64_t value;
+  if (isIntegralConstant(o))
+    value = x86_64LinuxConstantToNumber(o);
+  else if (!isGpTemp(o) || !constantTemp(f, o, position, &value))
+    return false;
+  size_t bits = irOperandSizeof(o) * 8;
+  return (bits < 64 ? value & ~(UINT64_MAX << bits) : value) == 0;
+}
+
+/**
+ * find the offsets of a block's memory accesses that can be folded into
+ * memory operands, along with the instructions folded away
+ *
+ * Zeros that are only compared against are folded away too, since the
+ * comparisons become tests.
+ */
+static void addressFoldingInit(AddressFolding *f, IRBlock *b,
+                               FileListEntry *file) {
+  f->numInstructions = 0;
+  for (ListNode *curr = b->instructions.head->next;
+       curr != b->instructions.tail; curr = curr->next)
+    ++f->numInstructions;
+  f->instructions = malloc(f->numInstructions * sizeof(IRInstruction *));
+  f->references = calloc(file->nextId, sizeof(size_t));
+  f->offsets = calloc(f->numInstructions, sizeof(FoldedOffset));
+  f->skipped = calloc(f->numInstructions, sizeof(bool));
+
+  size_t position = 0;
+  for (ListNode *curr = b->instructions.head->next;
+       curr != b->instructions.tail; curr = curr->next) {
+    IRInstruction *ir = curr->data;
+    f->instructions[position++] = ir;
+    for (size_t arg = 0; arg < irOperatorArity(ir->op); ++arg) {
+      if (ir->args[arg]->kind == OK_TEMP)
+        ++f->references[ir->args[arg]->data.temp.name];
+    }
+  }
+
+  SizeVector folded;
+  sizeVectorInit(&folded);
+  for (position = 0; position < f->numInstructions; ++position) {
+    IRInstruction *ir = f->instructions[position];
+    if (!isMemoryAccess(ir->op)) continue;
+
+    FoldedOffset *offset = &f->offsets[position];
+    folded.size = 0;
+    if (!foldOffset(f, offset, ir->args[2], 1, position, position,
+                    &folded) ||
+        offset->displacement < INT32_MIN ||
+        offset->displacement > INT32_MAX ||
+        (offset->index != NULL && !splitFactor(offset)))
+      continue;
+
+    offset->folded = true;
+    for (size_t idx = 0; idx < folded.size; ++idx)
+      f->skipped[folded.elements[idx]] = true;
+  }
+  sizeVectorUninit(&folded);
+
+  for (position = 0; position < f->numInstructions; ++position) {
+    IRInstruction *ir = f->instructions[position];
+    if (!isIntegerComparison(ir->op) || !isGpTemp(ir->args[2]) ||
+        !knownZero(f, ir->args[2], position))
+      continue;
+    size_t definition = foldableDefinition(f, ir->args[2], position);
+    if (definition != SIZE_MAX) f->skipped[definition] = true;
+  }
+}
+static void addressFoldingUninit(AddressFolding *f) {
+  free(f->instructions);
+  free(f->references);
+  free(f->offsets);
+  free(f->skipped);
+}
+
+/**
+ * a memory location read or written by a load or store
+ *
+ * Locations at constant offsets in memory temps are parts of the temps.
+ * Other locations in memory temps are addressed relative to the frame base,
+ * which is rbp unless frame layout finds the function doesn't need a frame.
+ */
+typedef struct {
+  X86_64LinuxOperand *part;  /**< part of a memory temp, or NULL */
+  X86_64LinuxOperand *frame; /**< offset of the temp in the frame, or NULL */
+  X86_64LinuxOperand *base;  /**< register or gp temp, or NULL */
+  X86_64LinuxOperand *index; /**< register or gp temp, or NULL */
+  uint64_t scale;
+  int64_t displacement;
+  IROperand const *temp; /**< memory temp the location is in, or NULL */
+} MemoryLocation;
+
+/**
+ * get a register or gp temp holding a value, loading memory temps and
+ * constants into a fresh temp
+ */
+static X86_64LinuxOperand *x86_64LinuxGenerateRegisterValue(
+    X86_64LinuxFrag *assembly, FileListEntry *file, IROperand const *value) {
+  if (isGpReg(value) || isGpTemp(value))
+    return x86_64LinuxOperandCreate(value);
+
+  size_t size = irOperandSizeof(value);
+  size_t scratch = fresh(file);
+  X86_64LinuxInstruction *i;
+  if (value->kind == OK_TEMP) {
+    i = INST(X86_64_LINUX_IK_REGULAR, strdup("\tmov `d, `u\n"));
+    USES(i, x86_64LinuxOperandCreate(value));
+  } else if (irOperandIsLocal(value)) {
+    i = INST(X86_64_LINUX_IK_REGULAR,
+             format("\tmov `d, L%lu\n", localOperandName(value)));
+  } else if (irOperandIsGlobal(value)) {
+    i = INST(X86_64_LINUX_IK_REGULAR,
+             format("\tmov `d, %s\n", globalOperandName(value)));
+  } else {
+    i = INST(X86_64_LINUX_IK_REGULAR,
+             format("\tmov `d, %lu\n", x86_64LinuxConstantToNumber(value)));
+  }
+  DEFINES(i, x86_64LinuxScratchOperandCreate(scratch, size, AH_GP));
+  DONE(assembly, i);
+  return x86_64LinuxScratchOperandCreate(scratch, size, AH_GP);
+}
+
+/**
+ * get the location a memory access reads or writes, generating the
+ * instructions that compute any part of its address not folded into it
+ *
+ * @param pointer pointer to the memory, or NULL to access part of temp
+ * @param temp memory temp to access, if pointer is NULL
+ * @param offset offset from the pointer or the start of the temp
+ * @param folded offset, as folded by addressFoldingInit
+ * @param size size of the access
+ */
+static void memoryLocationInit(MemoryLocation *m, X86_64LinuxFrag *assembly,
+                               FileListEntry *file, IROperand const *pointer,
+                               IROperand const *temp, IROperand const *offset,
+                               FoldedOffset const *folded, size_t size) {
+  m->part = NULL;
+  m->frame = NULL;
+  m->base = NULL;
+  m->index = NULL;
+  m->scale = 1;
+  m->displacement = 0;
+  m->temp = temp;
+
+  if (folded->folded) {
+    if (folded->index != NULL && folded->multiplier != 1) {
+      size_t multiplied = fresh(file);
+      X86_64LinuxInstruction *i =
+          INST(X86_64_LINUX_IK_REGULAR,
+               format("\tlea `d, [`u + `u*%lu]\n", folded->multiplier - 1));
+      DEFINES(i, x86_64LinuxScratchOperandCreate(
+                     multiplied, X86_64_LINUX_REGISTER_WIDTH, AH_GP));
+      USES(i, x86_64LinuxOperandCreate(folded->index));
+      USES(i, x86_64LinuxOperandCreate(folded->index));
+      DONE(assembly, i);
+      m->index = x86_64LinuxScratchOperandCreate(
+          multiplied, X86_64_LINUX_REGISTER_WIDTH, AH_GP);
+    } else if (folded->index != NULL) {
+      m->index = x86_64LinuxOperandCreate(folded->index);
+    }
+    m->scale = folded->scale;
+    m->displacement = folded->displacement;
+  } else {
+    m->index = x86_64LinuxGenerateRegisterValue(assembly, file, offset);
+  }
+
+  if (pointer != NULL) {
+    m->base = x86_64LinuxGenerateRegisterValue(assembly, file, pointer);
+  } else {
+    bool offsetOnly = m->index != NULL;
+    X86_64LinuxOperand *part = x86_64LinuxPartOperandCreate(
+        temp, m->displacement, size, offsetOnly);
+    *(offsetOnly ? &m->frame : &m->part) = part;
+    m->displacement = 0;
+  }
+}
+static void memoryLocationUninit(MemoryLocation *m) {
+  if (m->part != NULL) x86_64LinuxOperandFree(m->part);
+  if (m->frame != NULL) x86_64LinuxOperandFree(m->frame);
+  if (m->base != NULL) x86_64LinuxOperandFree(m->base);
+  if (m->index != NULL) x86_64LinuxOperandFree(m->index);
+}
+
+/**
+ * get the location of an argument passed on the stack
+ *
+ * outgoing arguments are at rsp, which the caller has already moved down to
+ * make room for them; incoming arguments are given relative to rsp on entry,
+ * which is just above the saved rbp, and frame layout adjusts their offset if
+ * there's no frame
+ *
+ * @param incoming is this an incoming argument
+ */
+static void stackLocationInit(MemoryLocation *m, IROperand const *offset,
+                              bool incoming) {
+  if (!isIntegralConstant(offset))
+    error(__FILE__, __LINE__, "stack argument offset is not constant");
+  int64_t displacement = (int64_t)x86_64LinuxConstantToNumber(offset);
+
+  m->part = NULL;
+  m->frame = NULL;
+  m->base = NULL;
+  m->index = NULL;
+  m->scale = 1;
+  m->displacement = 0;
+  m->temp = NULL;
+  if (incoming) {
+    m->frame = x86_64LinuxOffsetOperandCreate(
+        displacement + (int64_t)X86_64_LINUX_REGISTER_WIDTH);
+  } else {
+    m->base = x86_64LinuxRegOperandCreate(X86_64_LINUX_RSP,
+                                          X86_64_LINUX_REGISTER_WIDTH);
+    m->displacement = displacement;
+  }
+}
+
+/**
+ * write a memory location as an operand in a skeleton
+ *
+ * @param write is the location written - parts of temps are then defined
+ * @param keyword size keyword to put before an address, or NULL
+ */
+static char *memoryLocationString(MemoryLocation const *m, bool write,
+                                  char const *keyword) {
+  if (m->part != NULL) return strdup(write ? "`d" : "`u");
+
+  StringBuilder sb;
+  stringBuilderInit(&sb);
+  if (keyword != NULL) {
+    stringBuilderAppendString(&sb, keyword);
+    stringBuilderPush(&sb, ' ');
+  }
+  stringBuilderAppendString(&sb, m->frame != NULL ? "[`o" : "[`u");
+  if (m->index != NULL) {
+    stringBuilderAppendString(&sb, " + `u");
+    if (m->scale != 1) {
+      stringBuilderPush(&sb, '*');
+      appendUnsigned(&sb, m->scale);
+    }
+  }
+  if (m->frame != NULL) stringBuilderAppendString(&sb, " + `o");
+  if (m->displacement > 0) {
+    stringBuilderAppendString(&sb, " + ");
+    appendUnsigned(&sb, (uint64_t)m->displacement);
+  } else if (m->displacement < 0) {
+    stringBuilderAppendString(&sb, " - ");
+    appendUnsigned(&sb, -(uint64_t)m->displacement);
+  }
+  stringBuilderPush(&sb, ']');
+  char *retval = stringBuilderData(&sb);
+  stringBuilderUninit(&sb);
+  return retval;
+}
+
+/**
+ * add the operands of a memory location to an instruction, in skeleton order
+ */
+static void memoryLocationOperands(X86_64LinuxInstruction *i,
+                                   MemoryLocation const *m, bool write) {
+  if (m->part != NULL) {
+    if (write)
+      DEFINES(i, x86_64LinuxOperandCopy(m->part));
+    else
+      USES(i, x86_64LinuxOperandCopy(m->part));
+  } else {
+    if (m->frame != NULL) {
+      OTHER(i, x86_64LinuxRegOperandCreate(X86_64_LINUX_RBP, 8));
+      OTHER(i, x86_64LinuxOperandCopy(m->frame));
+    } else {
+      USES(i, x86_64LinuxOperandCopy(m->base));
+    }
+    if (m->index != NULL) USES(i, x86_64LinuxOperandCopy(m->index));
+  }
+}
+
+/**
+ * note that an instruction accesses the memory temp a location is in, if it
+ * does so through an address
+ */
+static void memoryLocationTouch(X86_64LinuxInstruction *i,
+                                MemoryLocation const *m, bool write) {
+  if (m->temp == NULL || m->part != NULL) return;
+  USES(i, x86_64LinuxOperandCreate(m->temp));
+  if (write) DEFINES(i, x86_64LinuxOperandCreate(m->temp));
+}
+
+/**
+ * load the address of a memory location into a fresh temp
+ *
+ * @returns name of the fresh temp
+ */
+static size_t x86_64LinuxGenerateLocationAddress(X86_64LinuxFrag *assembly,
+                                                 FileListEntry *file,
+                                                 MemoryLocation const *m) {
+  size_t address = fresh(file);
+  if (m->part == NULL && m->frame == NULL && m->index == NULL &&
+      m->displacement == 0) {
+    // the address is just the base - copy it, so the copy can be coalesced
+    X86_64LinuxInstruction *i =
+        INST(X86_64_LINUX_IK_REGULAR, strdup("\tmov `d, `u\n"));
+    DEFINES(i, x86_64LinuxScratchOperandCreate(
+                   address, X86_64_LINUX_REGISTER_WIDTH, AH_GP));
+    USES(i, x86_64LinuxOperandCopy(m->base));
+    MOVES(i, 0, 0);
+    DONE(assembly, i);
+    return address;
+  }
+
+  char *location = memoryLocationString(m, false, NULL);
+  X86_64LinuxInstruction *i =
+      INST(X86_64_LINUX_IK_REGULAR, format("\tlea `d, %s\n", location));
+  free(location);
+  DEFINES(i, x86_64LinuxScratchOperandCreate(
+                 address, X86_64_LINUX_REGISTER_WIDTH, AH_GP));
+  memoryLocationOperands(i, m, false);
+  DONE(assembly, i);
+  return address;
+}
+
+static bool isScalarSize(size_t size) {
+  return size == 1 || size == 2 || size == 4 || size == 8;
+}
+static char const *sizeKeyword(size_t size) {
+  switch (size) {
+    case 1: {
+      return "byte";
+    }
+    case 2: {
+      return "word";
+    }
+    case 4: {
+      return "dword";
+    }
+    default: {
+      return "qword";
+    }
+  }
+}
+
+/**
+ * generate a load from a memory location into a register, temp, or memory
+ * temp
+ */
+static void x86_64LinuxGenerateLoad(X86_64LinuxFrag *assembly,
+                                    FileListEntry *file,
+                                    IROperand const *dest,
+                                    MemoryLocation const *m) {
+  size_t size = irOperandSizeof(dest);
+  X86_64LinuxInstruction *i;
+  if (isMemTemp(dest) && !isScalarSize(size)) {
+    // memcpy memory to memory
+    size_t toAddress = x86_64LinuxGenerateTempAddress(assembly, file, dest);
+    size_t fromAddress = x86_64LinuxGenerateLocationAddress(assembly, file, m);
+    x86_64LinuxGenerateMemcpy(assembly, file, size, toAddress, fromAddress,
+                              dest, m->temp);
+    return;
+  }
+
+  size_t patchTemp = fresh(file);
+  char *location = memoryLocationString(m, false, NULL);
+  i = INST(X86_64_LINUX_IK_REGULAR, format("\tmov `d, %s\n", location));
+  free(location);
+  if (isMemTemp(dest))
+    DEFINES(i, x86_64LinuxTempOperandCreatePatch(dest, patchTemp, AH_GP));
+  else
+    DEFINES(i, x86_64LinuxOperandCreate(dest));
+  memoryLocationOperands(i, m, false);
+  memoryLocationTouch(i, m, false);
+  DONE(assembly, i);
+
+  if (isMemTemp(dest)) {
+    // patchable memory to memory
+    i = INST(X86_64_LINUX_IK_REGULAR, strdup("\tmov `d, `u\n"));
+    DEFINES(i, x86_64LinuxOperandCreate(dest));
+    USES(i, x86_64LinuxTempOperandCreatePatch(dest, patchTemp, AH_GP));
+    MOVES(i, 0, 0);
+    DONE(assembly, i);
+  }
+}
+
+/**
+ * generate a store of a register, temp, memory temp, or constant to a memory
+ * location
+ */
+static void x86_64LinuxGenerateStore(X86_64LinuxFrag *assembly,
+                                     FileListEntry *file,
+                                     MemoryLocation const *m,
+                                     IROperand *value) {
+  size_t size = irOperandSizeof(value);
+  X86_64LinuxInstruction *i;
+  if (!isScalarSize(size)) {
+    // memcpy memory or constant to memory
+    size_t fromAddress;
+    if (value->kind == OK_CONSTANT) {
+      size_t constantName = x86_64LinuxPoolConstant(
+          file, value->data.constant.alignment, &value->data.constant.data);
+      fromAddress =
+          x86_64LinuxGenerateLabelAddress(assembly, file, constantName);
+    } else {
+      fromAddress = x86_64LinuxGenerateTempAddress(assembly, file, value);
+    }
+    size_t toAddress = x86_64LinuxGenerateLocationAddress(assembly, file, m);
+    x86_64LinuxGenerateMemcpy(assembly, file, size, toAddress, fromAddress,
+                              m->temp, isMemTemp(value) ? value : NULL);
+    return;
+  }
+
+  if (isIntegralConstant(value)) {
+    // sign extend, so negative values are written as such
+    int64_t number = (int64_t)(x86_64LinuxConstantToNumber(value)
+                               << (64 - 8 * size)) >>
+                     (64 - 8 * size);
+    if (number >= INT32_MIN && number <= INT32_MAX) {
+      char *location = memoryLocationString(m, true, sizeKeyword(size));
+      i = INST(X86_64_LINUX_IK_REGULAR,
+               format("\tmov %s, %" PRId64 "\n", location, number));
+      free(location);
+      memoryLocationOperands(i, m, true);
+      memoryLocationTouch(i, m, true);
+      DONE(assembly, i);
+      return;
+    }
+  }
+
+  X86_64LinuxOperand *source =
+      value->kind == OK_REG || isNonMemTemp(value)
+          ? x86_64LinuxOperandCreate(value)
+          : x86_64LinuxGenerateRegisterValue(assembly, file, value);
+  char *location = memoryLocationString(m, true, NULL);
+  i = INST(X86_64_LINUX_IK_REGULAR, format("\tmov %s, `u\n", location));
+  free(location);
+  memoryLocationOperands(i, m, true);
+  USES(i, source);
+  memoryLocationTouch(i, m, true);
+  DONE(assembly, i);
+}
+
+/**
+ * is the integer comparison at position only computing the condition of the
+ * select right after it, so the select can use the flags it sets
+ */
+static bool fusedIntoSelect(AddressFolding const *f, size_t position) {
+  if (position + 1 >= f->numInstructions) return false;
+  IRInstruction const *cmp = f->instructions[position];
+  IRInstruction const *select = f->instructions[position + 1];
+  return IO_L <= cmp->op && cmp->op <= IO_BE && select->op == IO_SELECT &&
+         cmp->args[0]->kind == OK_TEMP &&
+         isTempNamed(select->args[1], cmp->args[0]->data.temp.name) &&
+         f->references[cmp->args[0]->data.temp.name] == 2;
+}
+
+/** cmov condition code for each integer comparison, from IO_L to IO_BE */
+static char const *const COMPARISON_CONDITIONS[] = {
+    "l", "le", "e", "ne", "g", "ge", "a", "ae", "b", "be",
+};
+
+/**
+ * generate a select as a cmov, testing the condition or, if one is given,
+ * redoing the comparison that computed it
+ *
+ * @param cmp comparison fused into the select, or NULL
+ * @param zeroRhs is the fused comparison against a known zero
+ */
+static void x86_64LinuxGenerateSelect(X86_64LinuxFrag *assembly,
+                                      FileListEntry *file,
+                                      IRInstruction const *select,
+                                      IRInstruction const *cmp, bool zeroRhs) {
+  // materialize everything first - the moves might be turned into flag
+  // clobbering xors
+  X86_64LinuxOperand *consequent =
+      x86_64LinuxGenerateRegisterValue(assembly, file, select->args[2]);
+  X86_64LinuxOperand *alternative =
+      x86_64LinuxGenerateRegisterValue(assembly, file, select->args[3]);
+  X86_64LinuxOperand *lhs;
+  X86_64LinuxOperand *rhs = NULL;  // NULL if comparing to an immediate
+  char const *condition;
+  if (cmp != NULL) {
+    lhs = x86_64LinuxGenerateRegisterValue(assembly, file, cmp->args[1]);
+    if (zeroRhs)
+      rhs = x86_64LinuxOperandCopy(lhs);
+    else if (!isIntegralConstant(cmp->args[2]) ||
+             x86_64LinuxConstantToNumber(cmp->args[2]) > INT8_MAX)
+      rhs = x86_64LinuxGenerateRegisterValue(assembly, file, cmp->args[2]);
+    condition = COMPARISON_CONDITIONS[cmp->op - IO_L];
+  } else {
+    lhs = x86_64LinuxGenerateRegisterValue(assembly, file, select->args[1]);
+    rhs = x86_64LinuxOperandCopy(lhs);
+    condition = "nz";
+  }
+
+  size_t size = irOperandSizeof(select->args[0]);
+  size_t scratch = fresh(file);
+  X86_64LinuxInstruction *i =
+      INST(X86_64_LINUX_IK_REGULAR, strdup("\tmov `d, `u\n"));
+  DEFINES(i, x86_64LinuxScratchOperandCreate(scratch, size, AH_GP));
+  USES(i, alternative);
+  MOVES(i, 0, 0);
+  DONE(assembly, i);
+
+  if (rhs != NULL) {
+    i = INST(X86_64_LINUX_IK_REGULAR,
+             strdup(cmp != NULL && !zeroRhs ? "\tcmp `u, `u\n"
+                                            : "\ttest `u, `u\n"));
+    USES(i, lhs);
+    USES(i, rhs);
+  } else {
+    i = INST(X86_64_LINUX_IK_REGULAR,
+             format("\tcmp `u, %lu\n",
+                    x86_64LinuxConstantToNumber(cmp->args[2])));
+    USES(i, lhs);
+  }
+  DONE(assembly, i);
+
+  i = INST(X86_64_LINUX_IK_REGULAR, format("\tcmov%s `d, `u\n", condition));
+  DEFINES(i, x86_64LinuxScratchOperandCreate(scratch, size, AH_GP));
+  USES(i, consequent);
+  USES(i, x86_64LinuxScratchOperandCreate(scratch, size, AH_GP));
+  DONE(assembly, i);
+
+  i = INST(X86_64_LINUX_IK_REGULAR, strdup("\tmov `d, `u\n"));
+  DEFINES(i, x86_64LinuxOperandCreate(select->args[0]));
+  USES(i, x86_64LinuxScratchOperandCreate(scratch, size, AH_GP));
+  MOVES(i, 0, 0);
+  DONE(assembly, i);
+}
+
+/** get the text of a constant, as it appears in a skeleton */
+static char *constantString(IROperand const *constant) {
+  if (irOperandIsLocal(constant))
+    return format("L%zu", localOperandName(constant));
+  else if (irOperandIsGlobal(constant))
+    return strdup(globalOperandName(constant));
+  else
+    return format("%lu", x86_64LinuxConstantToNumber(constant));
+}
+
+/**
+ * can a constant be an immediate operand of an instruction of its size -
+ * eight byte instructions only take sign-extended four byte immediates
+ */
+static bool isImmediate(IROperand const *o) {
+  if (!isIntegralConstant(o)) return false;
+  if (irOperandSizeof(o) != X86_64_LINUX_REGISTER_WIDTH) return true;
+  int64_t value = (int64_t)x86_64LinuxConstantToNumber(o);
+  return value >= INT32_MIN && value <= INT32_MAX;
+}
+
+/**
+ * get a register, gp temp, or memory temp holding a value, loading constants
+ * into a fresh temp
+ */
+static X86_64LinuxOperand *x86_64LinuxGenerateRmValue(X86_64LinuxFrag *assembly,
+                                                      FileListEntry *file,
+                                                      IROperand const *value) {
+  if (value->kind == OK_REG || isGpTemp(value) || isMemTemp(value))
+    return x86_64LinuxOperandCreate(value);
+  return x86_64LinuxGenerateRegisterValue(assembly, file, value);
+}
+
+/**
+ * create an operand for the low bytes of a register or gp temp
+ */
+static X86_64LinuxOperand *x86_64LinuxLowOperandCreate(IROperand const *o,
+                                                       size_t size) {
+  X86_64LinuxOperand *retval = x86_64LinuxOperandCreate(o);
+  if (retval->kind == X86_64_LINUX_OK_REG)
+    retval->data.reg.size = size;
+  else
+    retval->data.temp.size = size;
+  return retval;
+}
+
+/**
+ * copy a value into a fresh gp temp of the same size
+ *
+ * @returns name of the fresh temp
+ */
+static size_t x86_64LinuxGenerateScratchCopy(X86_64LinuxFrag *assembly,
+                                             FileListEntry *file,
+                                             IROperand const *value) {
+  size_t size = irOperandSizeof(value);
+  size_t scratch = fresh(file);
+  X86_64LinuxInstruction *i;
+  if (value->kind == OK_CONSTANT) {
+    char *constant = constantString(value);
+    i = INST(X86_64_LINUX_IK_REGULAR, format("\tmov `d, %s\n", constant));
+    free(constant);
+    DEFINES(i, x86_64LinuxScratchOperandCreate(scratch, size, AH_GP));
+  } else {
+    i = INST(X86_64_LINUX_IK_REGULAR, strdup("\tmov `d, `u\n"));
+    DEFINES(i, x86_64LinuxScratchOperandCreate(scratch, size, AH_GP));
+    USES(i, x86_64LinuxOperandCreate(value));
+    MOVES(i, 0, 0);
+  }
+  DONE(assembly, i);
+  return scratch;
+}
+
+/**
+ * load an integer into a fresh gp temp of at least four bytes, extending it
+ * if it's smaller
+ *
+ * @returns name of the fresh temp
+ */
+static size_t x86_64LinuxGenerateWidened(X86_64LinuxFrag *assembly,
+                                         FileListEntry *file,
+                                         IROperand const *value,
+                                         bool isSigned) {
+  size_t size = irOperandSizeof(value);
+  size_t wide = size < INT_WIDTH ? INT_WIDTH : size;
+  size_t scratch = fresh(file);
+  X86_64LinuxInstruction *i;
+  if (isIntegralConstant(value)) {
+    uint64_t number = x86_64LinuxConstantToNumber(value);
+    if (isSigned && size < wide && (number >> (8 * size - 1) & 1) != 0)
+      number |= UINT64_MAX << (8 * size);
+    if (wide == INT_WIDTH) number &= UINT32_MAX;
+    i = INST(X86_64_LINUX_IK_REGULAR, format("\tmov `d, %lu\n", number));
+    DEFINES(i, x86_64LinuxScratchOperandCreate(scratch, wide, AH_GP));
+    DONE(assembly, i);
+    return scratch;
+  } else if (value->kind == OK_CONSTANT) {
+    return x86_64LinuxGenerateScratchCopy(assembly, file, value);
+  }
+
+  if (size < wide) {
+    i = INST(X86_64_LINUX_IK_REGULAR,
+             strdup(isSigned ? "\tmovsx `d, `u\n" : "\tmovzx `d, `u\n"));
+    DEFINES(i, x86_64LinuxScratchOperandCreate(scratch, wide, AH_GP));
+    USES(i, x86_64LinuxOperandCreate(value));
+  } else {
+    i = INST(X86_64_LINUX_IK_REGULAR, strdup("\tmov `d, `u\n"));
+    DEFINES(i, x86_64LinuxScratchOperandCreate(scratch, wide, AH_GP));
+    USES(i, x86_64LinuxOperandCreate(value));
+    MOVES(i, 0, 0);
+  }
+  DONE(assembly, i);
+  return scratch;
+}
+
+/**
+ * move the result of an operation from the gp temp it was computed in to
+ * its destination
+ */
+static void x86_64LinuxGenerateResult(X86_64LinuxFrag *assembly,
+                                      IROperand const *dest, size_t scratch,
+                                      size_t size) {
+  X86_64LinuxInstruction *i =
+      INST(X86_64_LINUX_IK_REGULAR, strdup("\tmov `d, `u\n"));
+  DEFINES(i, x86_64LinuxOperandCreate(dest));
+  USES(i, x86_64LinuxScratchOperandCreate(scratch, size, AH_GP));
+  MOVES(i, 0, 0);
+  DONE(assembly, i);
+}
+
+/**
+ * generate a two-operand integer operation, computing into a fresh temp
+ *
+ * @param mnemonic instruction computing `d op= `u
+ * @param immediate can the instruction take an immediate second operand
+ */
+static void x86_64LinuxGenerateBinop(X86_64LinuxFrag *assembly,
+                                     FileListEntry *file,
+                                     IRInstruction const *ir,
+                                     char const *mnemonic, bool immediate) {
+  size_t size = irOperandSizeof(ir->args[0]);
+  X86_64LinuxOperand *rhs =
+      immediate && isImmediate(ir->args[2])
+          ? NULL
+          : x86_64LinuxGenerateRmValue(assembly, file, ir->args[2]);
+  size_t scratch = x86_64LinuxGenerateScratchCopy(assembly, file, ir->args[1]);
+
+  X86_64LinuxInstruction *i;
+  if (rhs == NULL) {
+    i = INST(X86_64_LINUX_IK_REGULAR,
+             format("\t%s `d, %lu\n", mnemonic,
+                    x86_64LinuxConstantToNumber(ir->args[2])));
+  } else {
+    i = INST(X86_64_LINUX_IK_REGULAR, format("\t%s `d, `u\n", mnemonic));
+    USES(i, rhs);
+  }
+  DEFINES(i, x86_64LinuxScratchOperandCreate(scratch, size, AH_GP));
+  USES(i, x86_64LinuxScratchOperandCreate(scratch, size, AH_GP));
+  DONE(assembly, i);
+
+  x86_64LinuxGenerateResult(assembly, ir->args[0], scratch, size);
+}
+
+/**
+ * generate an integer multiplication - bytes are multiplied as dwords, since
+ * there's no two-operand byte imul
+ */
+static void x86_64LinuxGenerateMultiplication(X86_64LinuxFrag *assembly,
+                                              FileListEntry *file,
+                                              IRInstruction const *ir) {
+  size_t size = irOperandSizeof(ir->args[0]);
+  if (size != BYTE_WIDTH) {
+    x86_64LinuxGenerateBinop(assembly, file, ir, "imul", false);
+    return;
+  }
+
+  size_t rhs = x86_64LinuxGenerateWidened(assembly, file, ir->args[2], false);
+  size_t lhs = x86_64LinuxGenerateWidened(assembly, file, ir->args[1], false);
+  X86_64LinuxInstruction *i =
+      INST(X86_64_LINUX_IK_REGULAR, strdup("\timul `d, `u\n"));
+  DEFINES(i, x86_64LinuxScratchOperandCreate(lhs, INT_WIDTH, AH_GP));
+  USES(i, x86_64LinuxScratchOperandCreate(rhs, INT_WIDTH, AH_GP));
+  USES(i, x86_64LinuxScratchOperandCreate(lhs, INT_WIDTH, AH_GP));
+  DONE(assembly, i);
+
+  x86_64LinuxGenerateResult(assembly, ir->args[0], lhs, size);
+}
+
+/**
+ * generate an integer division or modulo - bytes and words are divided as
+ * dwords, so only the dword and qword forms of div and idiv are needed
+ */
+static void x86_64LinuxGenerateDivision(X86_64LinuxFrag *assembly,
+                                        FileListEntry *file,
+                                        IRInstruction const *ir, bool isSigned,
+                                        bool remainder) {
+  size_t size = irOperandSizeof(ir->args[0]);
+  size_t wide = size < INT_WIDTH ? INT_WIDTH : size;
+  size_t divisor =
+      x86_64LinuxGenerateWidened(assembly, file, ir->args[2], isSigned);
+  size_t dividend =
+      x86_64LinuxGenerateWidened(assembly, file, ir->args[1], isSigned);
+
+  X86_64LinuxInstruction *i =
+      INST(X86_64_LINUX_IK_REGULAR, strdup("\tmov `d, `u\n"));
+  DEFINES(i, x86_64LinuxRegOperandCreate(X86_64_LINUX_RAX, wide));
+  USES(i, x86_64LinuxScratchOperandCreate(dividend, wide, AH_GP));
+  MOVES(i, 0, 0);
+  DONE(assembly, i);
+
+  if (isSigned) {
+    i = INST(X86_64_LINUX_IK_REGULAR,
+             strdup(wide == X86_64_LINUX_REGISTER_WIDTH ? "\tcqo\n"
+                                                        : "\tcdq\n"));
+    USES(i, x86_64LinuxRegOperandCreate(X86_64_LINUX_RAX, wide));
+  } else {
+    i = INST(X86_64_LINUX_IK_REGULAR, strdup("\tmov `d, 0\n"));
+  }
+  DEFINES(i, x86_64LinuxRegOperandCreate(X86_64_LINUX_RDX, wide));
+  DONE(assembly, i);
+
+  i = INST(X86_64_LINUX_IK_REGULAR,
+           strdup(isSigned ? "\tidiv `u\n" : "\tdiv `u\n"));
+  USES(i, x86_64LinuxScratchOperandCreate(divisor, wide, AH_GP));
+  USES(i, x86_64LinuxRegOperandCreate(X86_64_LINUX_RAX, wide));
+  USES(i, x86_64LinuxRegOperandCreate(X86_64_LINUX_RDX, wide));
+  DEFINES(i, x86_64LinuxRegOperandCreate(X86_64_LINUX_RAX, wide));
+  DEFINES(i, x86_64LinuxRegOperandCreate(X86_64_LINUX_RDX, wide));
+  DONE(assembly, i);
+
+  i = INST(X86_64_LINUX_IK_REGULAR, strdup("\tmov `d, `u\n"));
+  DEFINES(i, x86_64LinuxOperandCreate(ir->args[0]));
+  USES(i, x86_64LinuxRegOperandCreate(
+              remainder ? X86_64_LINUX_RDX : X86_64_LINUX_RAX, size));
+  MOVES(i, 0, 0);
+  DONE(assembly, i);
+}
+
+/**
+ * generate a shift, by an immediate or by cl
+ */
+static void x86_64LinuxGenerateShift(X86_64LinuxFrag *assembly,
+                                     FileListEntry *file,
+                                     IRInstruction const *ir,
+                                     char const *mnemonic) {
+  size_t size = irOperandSizeof(ir->args[0]);
+  size_t scratch = x86_64LinuxGenerateScratchCopy(assembly, file, ir->args[1]);
+
+  X86_64LinuxInstruction *i;
+  if (isIntegralConstant(ir->args[2])) {
+    // the processor masks the amount the same way
+    i = INST(X86_64_LINUX_IK_REGULAR,
+             format("\t%s `d, %lu\n", mnemonic,
+                    x86_64LinuxConstantToNumber(ir->args[2]) & 0x3f));
+  } else {
+    i = INST(X86_64_LINUX_IK_REGULAR, strdup("\tmov `d, `u\n"));
+    DEFINES(i, x86_64LinuxRegOperandCreate(X86_64_LINUX_RCX, BYTE_WIDTH));
+    USES(i, x86_64LinuxOperandCreate(ir->args[2]));
+    MOVES(i, 0, 0);
+    DONE(assembly, i);
+
+    i = INST(X86_64_LINUX_IK_REGULAR, format("\t%s `d, `u\n", mnemonic));
+    USES(i, x86_64LinuxRegOperandCreate(X86_64_LINUX_RCX, BYTE_WIDTH));
+  }
+  DEFINES(i, x86_64LinuxScratchOperandCreate(scratch, size, AH_GP));
+  USES(i, x86_64LinuxScratchOperandCreate(scratch, size, AH_GP));
+  DONE(assembly, i);
+
+  x86_64LinuxGenerateResult(assembly, ir->args[0], scratch, size);
+}
+
+/**
+ * generate a one-operand integer operation, computing into a fresh temp
+ */
+static void x86_64LinuxGenerateUnop(X86_64LinuxFrag *assembly,
+                                    FileListEntry *file,
+                                    IRInstruction const *ir,
+                                    char const *mnemonic) {
+  size_t size = irOperandSizeof(ir->args[0]);
+  size_t scratch = x86_64LinuxGenerateScratchCopy(assembly, file, ir->args[1]);
+  X86_64LinuxInstruction *i =
+      INST(X86_64_LINUX_IK_REGULAR, format("\t%s `d\n", mnemonic));
+  DEFINES(i, x86_64LinuxScratchOperandCreate(scratch, size, AH_GP));
+  USES(i, x86_64LinuxScratchOperandCreate(scratch, size, AH_GP));
+  DONE(assembly, i);
+
+  x86_64LinuxGenerateResult(assembly, ir->args[0], scratch, size);
+}
+
+/**
+ * generate a test of an integer against zero, setting the zero flag
+ */
+static void x86_64LinuxGenerateZeroTest(X86_64LinuxFrag *assembly,
+                                        FileListEntry *file,
+                                        IROperand const *value) {
+  if (isFpReg(value) || isFpTemp(value))
+    error(__FILE__, __LINE__,
+          "floating point operations are not yet supported");
+
+  X86_64LinuxInstruction *i;
+  if (isMemTemp(value)) {
+    i = INST(X86_64_LINUX_IK_REGULAR, strdup("\tcmp `u, 0\n"));
+    USES(i, x86_64LinuxOperandCreate(value));
+  } else {
+    X86_64LinuxOperand *reg =
+        x86_64LinuxGenerateRegisterValue(assembly, file, value);
+    i = INST(X86_64_LINUX_IK_REGULAR, strdup("\ttest `u, `u\n"));
+    USES(i, x86_64LinuxOperandCopy(reg));
+    USES(i, reg);
+  }
+  DONE(assembly, i);
+}
+
+/**
+ * generate a comparison of two integers, setting the flags
+ *
+ * @param zeroRhs is rhs known to be zero - the comparison is then a test,
+ * which sets the flags the same way
+ */
+static void x86_64LinuxGenerateCompare(X86_64LinuxFrag *assembly,
+                                       FileListEntry *file,
+                                       IROperand const *lhs,
+                                       IROperand const *rhs, bool zeroRhs) {
+  if (zeroRhs) {
+    x86_64LinuxGenerateZeroTest(assembly, file, lhs);
+    return;
+  }
+
+  // materialize everything first - the moves might be turned into flag
+  // clobbering xors
+  X86_64LinuxOperand *left = x86_64LinuxGenerateRmValue(assembly, file, lhs);
+  X86_64LinuxInstruction *i;
+  if (isImmediate(rhs)) {
+    i = INST(X86_64_LINUX_IK_REGULAR,
+             format("\tcmp `u, %lu\n", x86_64LinuxConstantToNumber(rhs)));
+    USES(i, left);
+  } else {
+    X86_64LinuxOperand *right =
+        isMemTemp(lhs) ? x86_64LinuxGenerateRegisterValue(assembly, file, rhs)
+                       : x86_64LinuxGenerateRmValue(assembly, file, rhs);
+    i = INST(X86_64_LINUX_IK_REGULAR, strdup("\tcmp `u, `u\n"));
+    USES(i, left);
+    USES(i, right);
+  }
+  DONE(assembly, i);
+}
+
+/**
+ * generate a setcc of a byte destination from the flags
+ */
+static void x86_64LinuxGenerateSet(X86_64LinuxFrag *assembly,
+                                   IROperand const *dest,
+                                   char const *condition) {
+  X86_64LinuxInstruction *i =
+      INST(X86_64_LINUX_IK_REGULAR, format("\tset%s `d\n", condition));
+  DEFINES(i, x86_64LinuxOperandCreate(dest));
+  DONE(assembly, i);
+}
+
+/**
+ * generate a conditional jump on the flags
+ */
+static void x86_64LinuxGenerateConditionalJump(X86_64LinuxFrag *assembly,
+                                               IROperand const *target,
+                                               char const *condition) {
+  size_t name = localOperandName(target);
+  X86_64LinuxInstruction *i =
+      INST(X86_64_LINUX_IK_CJUMP, format("\tj%s L%zu\n", condition, name));
+  sizeVectorInsert(&i->data.jumpTargets, name);
+  DONE(assembly, i);
+}
+
+/**
+ * generate a sign or zero extension
+ */
+static void x86_64LinuxGenerateExtension(X86_64LinuxFrag *assembly,
+                                         FileListEntry *file,
+                                         IRInstruction const *ir,
+                                         bool isSigned) {
+  size_t size = irOperandSizeof(ir->args[0]);
+  size_t fromSize = irOperandSizeof(ir->args[1]);
+  size_t scratch = fresh(file);
+  X86_64LinuxInstruction *i;
+  if (isIntegralConstant(ir->args[1])) {
+    uint64_t number = x86_64LinuxConstantToNumber(ir->args[1]);
+    if (isSigned && (number >> (8 * fromSize - 1) & 1) != 0)
+      number |= UINT64_MAX << (8 * fromSize);
+    if (size != X86_64_LINUX_REGISTER_WIDTH)
+      number &= (UINT64_C(1) << (8 * size)) - 1;
+    i = INST(X86_64_LINUX_IK_REGULAR, format("\tmov `d, %lu\n", number));
+    DEFINES(i, x86_64LinuxScratchOperandCreate(scratch, size, AH_GP));
+  } else if (!isSigned && fromSize == INT_WIDTH) {
+    // writing a dword clears the rest of the register
+    i = INST(X86_64_LINUX_IK_REGULAR, strdup("\tmov `d, `u\n"));
+    DEFINES(i, x86_64LinuxScratchOperandCreate(scratch, fromSize, AH_GP));
+    USES(i, x86_64LinuxOperandCreate(ir->args[1]));
+  } else {
+    i = INST(X86_64_LINUX_IK_REGULAR,
+             strdup(!isSigned                ? "\tmovzx `d, `u\n"
+                    : fromSize == INT_WIDTH ? "\tmovsxd `d, `u\n"
+                                            : "\tmovsx `d, `u\n"));
+    DEFINES(i, x86_64LinuxScratchOperandCreate(scratch, size, AH_GP));
+    USES(i, x86_64LinuxOperandCreate(ir->args[1]));
+  }
+  DONE(assembly, i);
+
+  x86_64LinuxGenerateResult(assembly, ir->args[0], scratch, size);
+}
+
+/**
+ * generate a truncation, reading the low bytes of the source
+ */
+static void x86_64LinuxGenerateTruncation(X86_64LinuxFrag *assembly,
+                                          FileListEntry *file,
+                                          IRInstruction const *ir) {
+  size_t size = irOperandSizeof(ir->args[0]);
+  size_t scratch = fresh(file);
+  X86_64LinuxInstruction *i;
+  if (isIntegralConstant(ir->args[1])) {
+    uint64_t number = x86_64LinuxConstantToNumber(ir->args[1]) &
+                      ((UINT64_C(1) << (8 * size)) - 1);
+    i = INST(X86_64_LINUX_IK_REGULAR, format("\tmov `d, %lu\n", number));
+  } else {
+    i = INST(X86_64_LINUX_IK_REGULAR, strdup("\tmov `d, `u\n"));
+    if (isMemTemp(ir->args[1])) {
+      USES(i, x86_64LinuxPartOperandCreate(ir->args[1], 0, size, false));
+    } else if (ir->args[1]->kind == OK_CONSTANT) {
+      X86_64LinuxOperand *label =
+          x86_64LinuxGenerateRegisterValue(assembly, file, ir->args[1]);
+      label->data.temp.size = size;
+      USES(i, label);
+    } else {
+      USES(i, x86_64LinuxLowOperandCreate(ir->args[1], size));
+    }
+  }
+  DEFINES(i, x86_64LinuxScratchOperandCreate(scratch, size, AH_GP));
+  DONE(assembly, i);
+
+  x86_64LinuxGenerateResult(assembly, ir->args[0], scratch, size);
+}
+
+/**
+ * generate a jump through a jump table entry, which may go to any of the
+ * table's labels
+ */
+static void x86_64LinuxGenerateJumpTable(X86_64LinuxFrag *assembly,
+                                         FileListEntry *file,
+                                         IRInstruction const *ir) {
+  X86_64LinuxOperand *entry =
+      x86_64LinuxGenerateRegisterValue(assembly, file, ir->args[0]);
+  X86_64LinuxInstruction *i =
+      INST(X86_64_LINUX_IK_JUMPTABLE, strdup("\tjmp [`u]\n"));
+  USES(i, entry);
+  IRFrag const *table = findFrag(&file->irFrags, localOperandName(ir->args[1]));
+  if (table == NULL) error(__FILE__, __LINE__, "jump table not found");
+  for (size_t idx = 0; idx < table->data.data.data.size; ++idx) {
+    IRDatum const *datum = table->data.data.data.elements[idx];
+    sizeVectorInsert(&i->data.jumpTargets, datum->data.localLabel);
+  }
+  DONE(assembly, i);
+}
+
+/** alignment of the tops of loops */
+static size_t const LOOP_ALIGNMENT = 16;
+
+/**
+ * find the tops of loops - labels that fall through to some jump back to them
+ *
+ * @returns array mapping label name to whether it's the top of a loop
+ */
+static bool *findLoopHeaders(AddressFolding const *f, size_t maxLabels) {
+  // which run of fall-through code each label is in, or zero if not yet seen
+  size_t *runs = calloc(maxLabels, sizeof(size_t));
+  bool *headers = calloc(maxLabels, sizeof(bool));
+  size_t run = 1;
+  for (size_t position = 0; position < f->numInstructions; ++position) {
+    IRInstruction const *ir = f->instructions[position];
+    if (ir->op == IO_LABEL) {
+      runs[localOperandName(ir->args[0])] = run;
+      continue;
+    }
+
+    if ((ir->op == IO_JUMP || (IO_J1L <= ir->op && ir->op <= IO_J1NZ)) &&
+        irOperandIsLocal(ir->args[0]) &&
+        runs[localOperandName(ir->args[0])] == run)
+      headers[localOperandName(ir->args[0])] = true;
+    if (ir->op == IO_JUMP || ir->op == IO_JUMPTABLE || ir->op == IO_RETURN ||
+        ir->op == IO_TAIL_CALL)
+      ++run;
+  }
+  free(runs);
+  return headers;
+}
+
+static X86_64LinuxFrag *x86_64LinuxGenerateTextAsm(IRFrag *frag,
+                                                   FileListEntry *file) {
+  X86_64LinuxFrag *assembly = x86_64LinuxTextFragCreate(
+      format("section .text\nglobal %s:function\n%s:\n", frag->name.global,
+             frag->name.global),
+      strdup(".end\n"));
+  assembly->data.text.coldLabel = frag->data.text.coldLabel;
+  IRBlock *b = frag->data.text.blocks.head->next->data;
+  AddressFolding folding;
+  addressFoldingInit(&folding, b, file);
+  bool *loopHeaders = findLoopHeaders(&folding, file->nextId);
+  for (size_t position = 0; position < folding.numInstructions; ++position) {
+    IRInstruction *ir = folding.instructions[position];
+    if (folding.skipped[position]) continue;  // folded into a memory access
+    if (fusedIntoSelect(&folding, position)) continue;  // done by the select
+
+    X86_64LinuxInstruction *i;
+    switch (ir->op) {
+      case IO_LABEL: {
+        // arg 0: local
+        size_t name = localOperandName(ir->args[0]);
+        if (loopHeaders[name])
+          i = INST(X86_64_LINUX_IK_LABEL,
+                   format("\talign %zu\nL%zu:\n", LOOP_ALIGNMENT, name));
+        else
+          i = INST(X86_64_LINUX_IK_LABEL, format("L%zu:\n", name));
+        i->data.labelName = name;
+        DONE(assembly, i);
+        break;
+      }
+      case IO_VOLATILE: {
+        // arg 0: temp
+        i = INST(X86_64_LINUX_IK_REGULAR, strdup(""));  // empty instruction
+        USES(i, x86_64LinuxOperandCreate(ir->args[0]));
+        DONE(assembly, i);
+        break;
+      }
+      case IO_UNINITIALIZED:
+      case IO_NOP: {
+        break;  // not translated
+      }
+      case IO_ADDROF: {
+        // arg 0: reg, gp temp, mem temp
+        // arg 1: mem temp
+
+        if (ir->args[0]->kind == OK_REG || isGpTemp(ir->args[0])) {
+          // to register-ish
+          i = INST(X86_64_LINUX_IK_REGULAR, strdup("\tlea `d, `u\n"));
+          DEFINES(i, x86_64LinuxOperandCreate(ir->args[0]));
+          USES(i, x86_64LinuxTempOperandCreateEscaping(ir->args[1]));
+          DONE(assembly, i);
+        } else {
+          // to memory
+          size_t patchTemp = fresh(file);
+          i = INST(X86_64_LINUX_IK_REGULAR, strdup("\tmov `d, `u\n"));
+          DEFINES(i, x86_64LinuxTempOperandCreatePatch(ir->args[0], patchTemp,
+                                                       AH_GP));
+          USES(i, x86_64LinuxTempOperandCreateEscaping(ir->args[1]));
+          DONE(assembly, i);
+
+          i = INST(X86_64_LINUX_IK_REGULAR, strdup("\tmov `d, `u\n"));
+          DEFINES(i, x86_64LinuxOperandCreate(ir->args[0]));
+          USES(i, x86_64LinuxTempOperandCreatePatch(ir->args[0], patchTemp,
+                                                    AH_GP));
+          MOVES(i, 0, 0);
+          DONE(assembly, i);
+        }
+        break;
+      }
+      case IO_MOVE: {
+        // arg 0: reg, non-mem temp, mem temp
+        // arg 1: reg, non-mem temp, mem temp, const
+
+        if (ir->args[0]->kind == OK_REG || isNonMemTemp(ir->args[0])) {
+          if (ir->args[1]->kind == OK_REG || ir->args[1]->kind == OK_TEMP) {
+            // register-ish/memory to register-ish
+            i = INST(X86_64_LINUX_IK_REGULAR, strdup("\tmov `d, `u\n"));
+            DEFINES(i, x86_64LinuxOperandCreate(ir->args[0]));
+            USES(i, x86_64LinuxOperandCreate(ir->args[1]));
+            MOVES(i, 0, 0);
             DONE(assembly, i);
+          } else if (isFpReg(ir->args[0]) || isFpTemp(ir->args[0])) {
+            // constant to xmm register-ish
+            x86_64LinuxGenerateFpConstant(assembly, file, ir->args[0],
+                                          ir->args[1]);
           } else {
             // constant to register-ish
             if (irOperandIsLocal(ir->args[1]))
@@ -578,342 +2464,19 @@ static X86_64LinuxFrag *x86_64LinuxGenerateTextAsm(IRFrag *frag,
             DONE(assembly, i);
           }
         } else {
-          if (ir->args[1]->kind == OK_REG || isNonMemTemp(ir->args[1])) {
-            // register-ish to memory
-            i = INST(X86_64_LINUX_IK_REGULAR, strdup("\tmov `d, `u\n"));
-            DEFINES(i, x86_64LinuxOperandCreate(ir->args[0]));
-            USES(i, x86_64LinuxOperandCreate(ir->args[1]));
-            DONE(assembly, i);
-          } else if (isMemTemp(ir->args[1])) {
-            // memory to memory
-            if (ir->args[0]->data.temp.size == 8 ||
-                ir->args[0]->data.temp.size == 4 ||
-                ir->args[0]->data.temp.size == 2 ||
-                ir->args[0]->data.temp.size == 1) {
-              // patchable memory to memory
-              size_t patchTemp = fresh(file);
-              i = INST(X86_64_LINUX_IK_REGULAR, strdup("\tmov `d, `u\n"));
-              DEFINES(i, x86_64LinuxTempOperandCreatePatch(ir->args[0],
-                                                           patchTemp, AH_GP));
-              USES(i, x86_64LinuxOperandCreate(ir->args[1]));
-              MOVES(i, 0, 0);
-              DONE(assembly, i);
-
-              i = INST(X86_64_LINUX_IK_REGULAR, strdup("\tmov `d, `u\n"));
-              DEFINES(i, x86_64LinuxOperandCreate(ir->args[0]));
-              USES(i, x86_64LinuxTempOperandCreatePatch(ir->args[0], patchTemp,
-                                                        AH_GP));
-              MOVES(i, 0, 0);
-              DONE(assembly, i);
-            } else {
-              // memcpy memory to memory
-              i = INST(X86_64_LINUX_IK_REGULAR, strdup("\tlea `d, `u\n"));
-              DEFINES(i, x86_64LinuxRegOperandCreate(X86_64_LINUX_RDI, 8));
-              USES(i, x86_64LinuxOperandCreate(ir->args[0]));
-              DONE(assembly, i);
-
-              i = INST(X86_64_LINUX_IK_REGULAR, strdup("\tlea `d, `u\n"));
-              DEFINES(i, x86_64LinuxRegOperandCreate(X86_64_LINUX_RSI, 8));
-              USES(i, x86_64LinuxOperandCreate(ir->args[1]));
-              DONE(assembly, i);
-
-              i = x86_64LinuxGenerateMemcpy(assembly,
-                                            ir->args[0]->data.temp.size);
-              DEFINES(i, x86_64LinuxOperandCreate(ir->args[0]));
-              USES(i, x86_64LinuxOperandCreate(ir->args[1]));
-              MOVES(i, 3, 3);
-              DONE(assembly, i);
-            }
-          } else {
-            // constant to memory
-            if (ir->args[0]->data.temp.size == 8 ||
-                ir->args[0]->data.temp.size == 4 ||
-                ir->args[0]->data.temp.size == 2 ||
-                ir->args[0]->data.temp.size == 1) {
-              // regular constant to memory
-              if (irOperandIsLocal(ir->args[1]))
-                i = INST(
-                    X86_64_LINUX_IK_REGULAR,
-                    format("\tmov `d, L%lu\n", localOperandName(ir->args[1])));
-              else if (irOperandIsGlobal(ir->args[1]))
-                i = INST(
-                    X86_64_LINUX_IK_REGULAR,
-                    format("\tmov `d, %s\n", globalOperandName(ir->args[1])));
-              else
-                i = INST(X86_64_LINUX_IK_REGULAR,
-                         format("\tmov `d, %lu\n",
-                                x86_64LinuxConstantToNumber(ir->args[1])));
-              DEFINES(i, x86_64LinuxOperandCreate(ir->args[0]));
-              DONE(assembly, i);
-            } else {
-              // memcpy constant to memory
-              size_t constantName = fresh(file);
-              vectorInsert(&asmFile->frags, x86_64LinuxConstantToFrag(
-                                                ir->args[1], constantName));
-
-              i = INST(X86_64_LINUX_IK_REGULAR, strdup("\tlea `d, `u\n"));
-              DEFINES(i, x86_64LinuxRegOperandCreate(X86_64_LINUX_RDI, 8));
-              USES(i, x86_64LinuxOperandCreate(ir->args[0]));
-              DONE(assembly, i);
-
-              i = INST(X86_64_LINUX_IK_REGULAR,
-                       format("\tlea `d, L%lu\n", constantName));
-              DEFINES(i, x86_64LinuxRegOperandCreate(X86_64_LINUX_RSI, 8));
-              USES(i, x86_64LinuxOperandCreate(ir->args[1]));
-              DONE(assembly, i);
-
-              i = x86_64LinuxGenerateMemcpy(assembly,
-                                            ir->args[0]->data.temp.size);
-              DEFINES(i, x86_64LinuxOperandCreate(ir->args[0]));
-              USES(i, x86_64LinuxOperandCreate(ir->args[1]));
-              MOVES(i, 3, 3);
-              DONE(assembly, i);
-            }
-          }
-        }
-        break;
-      }
-      case IO_MEM_STORE: {
-        // arg 0: reg, gp temp, mem temp, const
-        // arg 1: reg, non-mem temp, mem temp, const
-        // arg 2: reg, gp temp, mem temp, const
-        // TODO
-        break;
-      }
-      case IO_MEM_LOAD: {
-        // arg 0: reg, non-mem temp, mem temp
-        // arg 1: reg, gp temp, mem temp, const
-        // arg 2: reg, gp temp, mem temp, const
-        // TODO
-        break;
-      }
-      case IO_STK_STORE: {
-        // arg 0: reg, gp temp, mem temp, const
-        // arg 1: reg, non-mem temp, mem temp, const
-        // TODO
-        break;
-      }
-      case IO_STK_LOAD: {
-        // arg 0: reg, non-mem temp, mem temp
-        // arg 1: reg, gp temp, mem temp, const
-        // TODO
-        break;
-      }
-      case IO_OFFSET_STORE: {
-        // arg 0: mem temp
-        // arg 1: reg, non-mem temp, mem temp, const
-        // arg 2: reg, gp temp, mem temp, const
-        // TODO
-        break;
-      }
-      case IO_OFFSET_LOAD: {
-        // arg 0: reg, non-mem temp, mem temp
-        // arg 1: mem temp
-        // arg 2: reg, gp temp, mem temp, const
-        // TODO
-        break;
-      }
-      case IO_ADD: {
-        // arg 0: reg, gp temp, mem temp
-        // arg 1: reg, gp temp, mem temp, const
-        // arg 2: reg, gp temp, mem temp, const
-
-        if (ir->args[0]->kind == OK_REG || isGpTemp(ir->args[0])) {
-          if (ir->args[1]->kind == OK_REG || ir->args[1]->kind == OK_TEMP) {
-            if (ir->args[2]->kind == OK_REG || ir->args[2]->kind == OK_TEMP) {
-              // register-ish = register-ish/memory + register-ish/memory
-              i = INST(X86_64_LINUX_IK_REGULAR, strdup("\tmov `d, `u\n"));
-              DEFINES(i, x86_64LinuxOperandCreate(ir->args[0]));
-              USES(i, x86_64LinuxOperandCreate(ir->args[1]));
-              MOVES(i, 0, 0);
-              DONE(assembly, i);
-
-              i = INST(X86_64_LINUX_IK_REGULAR, strdup("\tadd `d, `u\n"));
-              DEFINES(i, x86_64LinuxOperandCreate(ir->args[0]));
-              USES(i, x86_64LinuxOperandCreate(ir->args[2]));
-              USES(i, x86_64LinuxOperandCreate(ir->args[0]));
-              DONE(assembly, i);
-            } else {
-              // register-ish = register-ish/memory + constant
-              i = INST(X86_64_LINUX_IK_REGULAR, strdup("\tmov `d, `u\n"));
-              DEFINES(i, x86_64LinuxOperandCreate(ir->args[0]));
-              USES(i, x86_64LinuxOperandCreate(ir->args[1]));
-              MOVES(i, 0, 0);
-              DONE(assembly, i);
-
-              if (irOperandIsLocal(ir->args[2]))
-                i = INST(
-                    X86_64_LINUX_IK_REGULAR,
-                    format("\tadd `d, L%lu\n", localOperandName(ir->args[2])));
-              else if (irOperandIsGlobal(ir->args[2]))
-                i = INST(
-                    X86_64_LINUX_IK_REGULAR,
-                    format("\tmov `d, %s\n", globalOperandName(ir->args[2])));
-              else
-                i = INST(X86_64_LINUX_IK_REGULAR,
-                         format("\tmov `d, %lu\n",
-                                x86_64LinuxConstantToNumber(ir->args[2])));
-              DEFINES(i, x86_64LinuxOperandCreate(ir->args[0]));
-              USES(i, x86_64LinuxOperandCreate(ir->args[0]));
-              DONE(assembly, i);
-            }
-          } else {
-            if (ir->args[2]->kind == OK_REG || ir->args[2]->kind == OK_TEMP) {
-              // register-ish = constant + register-ish/memory
-              if (irOperandIsLocal(ir->args[1]))
-                i = INST(
-                    X86_64_LINUX_IK_REGULAR,
-                    format("\tmov `d, L%lu\n", localOperandName(ir->args[1])));
-              else if (irOperandIsGlobal(ir->args[1]))
-                i = INST(
-                    X86_64_LINUX_IK_REGULAR,
-                    format("\tmov `d, %s\n", globalOperandName(ir->args[1])));
-              else
-                i = INST(X86_64_LINUX_IK_REGULAR,
-                         format("\tmov `d, %lu\n",
-                                x86_64LinuxConstantToNumber(ir->args[1])));
-              DEFINES(i, x86_64LinuxOperandCreate(ir->args[0]));
-              DONE(assembly, i);
-
-              i = INST(X86_64_LINUX_IK_REGULAR, strdup("\tadd `d, `u\n"));
-              DEFINES(i, x86_64LinuxOperandCreate(ir->args[0]));
-              USES(i, x86_64LinuxOperandCreate(ir->args[2]));
-              USES(i, x86_64LinuxOperandCreate(ir->args[0]));
-              DONE(assembly, i);
-            } else {
-              // register-ish = constant + constant
-              if (!irOperandIsLabel(ir->args[1]) &&
-                  !irOperandIsLabel(ir->args[2])) {
-                i = INST(X86_64_LINUX_IK_REGULAR,
-                         format("\tmov `d, %lu\n",
-                                x86_64LinuxConstantToNumber(ir->args[1]) +
-                                    x86_64LinuxConstantToNumber(ir->args[2])));
-                DEFINES(i, x86_64LinuxOperandCreate(ir->args[0]));
-                DONE(assembly, i);
-              } else {
-                if (irOperandIsLocal(ir->args[1]))
-                  i = INST(X86_64_LINUX_IK_REGULAR,
-                           format("\tmov `d, L%lu\n",
-                                  localOperandName(ir->args[1])));
-                else if (irOperandIsGlobal(ir->args[1]))
-                  i = INST(
-                      X86_64_LINUX_IK_REGULAR,
-                      format("\tmov `d, %s\n", globalOperandName(ir->args[1])));
-                else
-                  i = INST(X86_64_LINUX_IK_REGULAR,
-                           format("\tmov `d, %lu\n",
-                                  x86_64LinuxConstantToNumber(ir->args[1])));
-                DEFINES(i, x86_64LinuxOperandCreate(ir->args[0]));
-                DONE(assembly, i);
-
-                if (irOperandIsLocal(ir->args[2]))
-                  i = INST(X86_64_LINUX_IK_REGULAR,
-                           format("\tadd `d, L%lu\n",
-                                  localOperandName(ir->args[2])));
-                else if (irOperandIsGlobal(ir->args[2]))
-                  i = INST(
-                      X86_64_LINUX_IK_REGULAR,
-                      format("\tmov `d, %s\n", globalOperandName(ir->args[2])));
-                else
-                  i = INST(X86_64_LINUX_IK_REGULAR,
-                           format("\tmov `d, %lu\n",
-                                  x86_64LinuxConstantToNumber(ir->args[2])));
-                DEFINES(i, x86_64LinuxOperandCreate(ir->args[0]));
-                USES(i, x86_64LinuxOperandCreate(ir->args[0]));
-                DONE(assembly, i);
-              }
-            }
-          }
-        } else {
-          if (ir->args[1]->kind == OK_REG || isGpTemp(ir->args[1])) {
-            if (ir->args[2]->kind == OK_REG || isGpTemp(ir->args[2])) {
-              // memory = register-ish + register-ish
-              i = INST(X86_64_LINUX_IK_REGULAR, strdup("\tmov `d, `u\n"));
-              DEFINES(i, x86_64LinuxOperandCreate(ir->args[0]));
-              USES(i, x86_64LinuxOperandCreate(ir->args[1]));
-              MOVES(i, 0, 0);
-              DONE(assembly, i);
-
-              i = INST(X86_64_LINUX_IK_REGULAR, strdup("\tadd `d, `u\n"));
-              DEFINES(i, x86_64LinuxOperandCreate(ir->args[0]));
-              USES(i, x86_64LinuxOperandCreate(ir->args[2]));
-              USES(i, x86_64LinuxOperandCreate(ir->args[0]));
-              DONE(assembly, i);
-            } else if (isMemTemp(ir->args[2])) {
-              // memory = register-ish + memory
-              size_t patchTemp = fresh(file);
-              i = INST(X86_64_LINUX_IK_REGULAR, strdup("\tmov `d, `u\n"));
-              DEFINES(i, x86_64LinuxTempOperandCreatePatch(ir->args[0],
-                                                           patchTemp, AH_GP));
-              USES(i, x86_64LinuxOperandCreate(ir->args[1]));
-              MOVES(i, 0, 0);
-              DONE(assembly, i);
-
-              i = INST(X86_64_LINUX_IK_REGULAR, strdup("\tadd `d, `u\n"));
-              DEFINES(i, x86_64LinuxTempOperandCreatePatch(ir->args[0],
-                                                           patchTemp, AH_GP));
-              USES(i, x86_64LinuxOperandCreate(ir->args[2]));
-              USES(i, x86_64LinuxTempOperandCreatePatch(ir->args[0], patchTemp,
-                                                        AH_GP));
-              DONE(assembly, i);
-
-              i = INST(X86_64_LINUX_IK_REGULAR, strdup("\tmov `d, `u\n"));
-              DEFINES(i, x86_64LinuxOperandCreate(ir->args[0]));
-              USES(i, x86_64LinuxTempOperandCreatePatch(ir->args[0], patchTemp,
-                                                        AH_GP));
-              MOVES(i, 0, 0);
-              DONE(assembly, i);
-            } else {
-              // memory = register-ish + constant
-              i = INST(X86_64_LINUX_IK_REGULAR, strdup("\tmov `d, `u\n"));
-              DEFINES(i, x86_64LinuxOperandCreate(ir->args[0]));
-              USES(i, x86_64LinuxOperandCreate(ir->args[1]));
-              MOVES(i, 0, 0);
-              DONE(assembly, i);
-
-              if (irOperandIsLocal(ir->args[2]))
-                i = INST(
-                    X86_64_LINUX_IK_REGULAR,
-                    format("\tadd `d, L%lu\n", localOperandName(ir->args[2])));
-              else if (irOperandIsGlobal(ir->args[2]))
-                i = INST(
-                    X86_64_LINUX_IK_REGULAR,
-                    format("\tmov `d, %s\n", globalOperandName(ir->args[2])));
-              else
-                i = INST(X86_64_LINUX_IK_REGULAR,
-                         format("\tmov `d, %lu\n",
-                                x86_64LinuxConstantToNumber(ir->args[2])));
-              DEFINES(i, x86_64LinuxOperandCreate(ir->args[0]));
-              USES(i, x86_64LinuxOperandCreate(ir->args[0]));
-              DONE(assembly, i);
-            }
-          } else if (isMemTemp(ir->args[1])) {
-            if (ir->args[2]->kind == OK_REG || ir->args[2]->kind == OK_TEMP) {
-              // memory = memory + register-ish/memory
-              size_t patchTemp = fresh(file);
-              i = INST(X86_64_LINUX_IK_REGULAR, strdup("\tmov `d, `u\n"));
-              DEFINES(i, x86_64LinuxTempOperandCreatePatch(ir->args[0],
-                                                           patchTemp, AH_GP));
-              USES(i, x86_64LinuxOperandCreate(ir->args[1]));
-              MOVES(i, 0, 0);
-              DONE(assembly, i);
-
-              i = INST(X86_64_LINUX_IK_REGULAR, strdup("\tadd `d, `u\n"));
-              DEFINES(i, x86_64LinuxTempOperandCreatePatch(ir->args[0],
-                                                           patchTemp, AH_GP));
-              USES(i, x86_64LinuxOperandCreate(ir->args[2]));
-              USES(i, x86_64LinuxTempOperandCreatePatch(ir->args[0], patchTemp,
-                                                        AH_GP));
-              DONE(assembly, i);
-
-              i = INST(X86_64_LINUX_IK_REGULAR, strdup("\tmov `d, `u\n"));
-              DEFINES(i, x86_64LinuxOperandCreate(ir->args[0]));
-              USES(i, x86_64LinuxTempOperandCreatePatch(ir->args[0], patchTemp,
-                                                        AH_GP));
-              MOVES(i, 0, 0);
-              DONE(assembly, i);
-            } else {
-              // memory = memory + constant
+          if (ir->args[1]->kind == OK_REG || isNonMemTemp(ir->args[1])) {
+            // register-ish to memory
+            i = INST(X86_64_LINUX_IK_REGULAR, strdup("\tmov `d, `u\n"));
+            DEFINES(i, x86_64LinuxOperandCreate(ir->args[0]));
+            USES(i, x86_64LinuxOperandCreate(ir->args[1]));
+            DONE(assembly, i);
+          } else if (isMemTemp(ir->args[1])) {
+            // memory to memory
+            if (ir->args[0]->data.temp.size == 8 ||
+                ir->args[0]->data.temp.size == 4 ||
+                ir->args[0]->data.temp.size == 2 ||
+                ir->args[0]->data.temp.size == 1) {
+              // patchable memory to memory
               size_t patchTemp = fresh(file);
               i = INST(X86_64_LINUX_IK_REGULAR, strdup("\tmov `d, `u\n"));
               DEFINES(i, x86_64LinuxTempOperandCreatePatch(ir->args[0],
@@ -922,35 +2485,29 @@ static X86_64LinuxFrag *x86_64LinuxGenerateTextAsm(IRFrag *frag,
               MOVES(i, 0, 0);
               DONE(assembly, i);
 
-              if (irOperandIsLocal(ir->args[2]))
-                i = INST(
-                    X86_64_LINUX_IK_REGULAR,
-                    format("\tadd `d, L%lu\n", localOperandName(ir->args[2])));
-              else if (irOperandIsGlobal(ir->args[2]))
-                i = INST(
-                    X86_64_LINUX_IK_REGULAR,
-                    format("\tadd `d, %s\n", globalOperandName(ir->args[2])));
-              else
-                i = INST(X86_64_LINUX_IK_REGULAR,
-                         format("\tadd `d, %lu\n",
-                                x86_64LinuxConstantToNumber(ir->args[2])));
-              DEFINES(i, x86_64LinuxTempOperandCreatePatch(ir->args[0],
-                                                           patchTemp, AH_GP));
-              USES(i, x86_64LinuxTempOperandCreatePatch(ir->args[0], patchTemp,
-                                                        AH_GP));
-              DONE(assembly, i);
-
               i = INST(X86_64_LINUX_IK_REGULAR, strdup("\tmov `d, `u\n"));
               DEFINES(i, x86_64LinuxOperandCreate(ir->args[0]));
               USES(i, x86_64LinuxTempOperandCreatePatch(ir->args[0], patchTemp,
                                                         AH_GP));
               MOVES(i, 0, 0);
               DONE(assembly, i);
+            } else {
+              // memcpy memory to memory
+              size_t toAddress =
+                  x86_64LinuxGenerateTempAddress(assembly, file, ir->args[0]);
+              size_t fromAddress =
+                  x86_64LinuxGenerateTempAddress(assembly, file, ir->args[1]);
+              x86_64LinuxGenerateMemcpy(assembly, file,
+                                        ir->args[0]->data.temp.size, toAddress,
+                                        fromAddress, ir->args[0], ir->args[1]);
             }
           } else {
-            if (ir->args[2]->kind == OK_REG || ir->args[2]->kind == OK_TEMP) {
-              // memory = constant + register-ish/memory
-              size_t patchTemp = fresh(file);
+            // constant to memory
+            if (ir->args[0]->data.temp.size == 8 ||
+                ir->args[0]->data.temp.size == 4 ||
+                ir->args[0]->data.temp.size == 2 ||
+                ir->args[0]->data.temp.size == 1) {
+              // regular constant to memory
               if (irOperandIsLocal(ir->args[1]))
                 i = INST(
                     X86_64_LINUX_IK_REGULAR,
@@ -963,568 +2520,377 @@ static X86_64LinuxFrag *x86_64LinuxGenerateTextAsm(IRFrag *frag,
                 i = INST(X86_64_LINUX_IK_REGULAR,
                          format("\tmov `d, %lu\n",
                                 x86_64LinuxConstantToNumber(ir->args[1])));
-              DEFINES(i, x86_64LinuxTempOperandCreatePatch(ir->args[0],
-                                                           patchTemp, AH_GP));
-              DONE(assembly, i);
-
-              i = INST(X86_64_LINUX_IK_REGULAR, strdup("\tadd `d, `u\n"));
-              DEFINES(i, x86_64LinuxTempOperandCreatePatch(ir->args[0],
-                                                           patchTemp, AH_GP));
-              USES(i, x86_64LinuxOperandCreate(ir->args[2]));
-              USES(i, x86_64LinuxTempOperandCreatePatch(ir->args[0], patchTemp,
-                                                        AH_GP));
-              DONE(assembly, i);
-
-              i = INST(X86_64_LINUX_IK_REGULAR, strdup("\tmov `d, `u\n"));
               DEFINES(i, x86_64LinuxOperandCreate(ir->args[0]));
-              USES(i, x86_64LinuxTempOperandCreatePatch(ir->args[0], patchTemp,
-                                                        AH_GP));
-              MOVES(i, 0, 0);
               DONE(assembly, i);
+            } else if (x86_64LinuxConstantFill(ir->args[1]) != NULL) {
+              // memset constant to memory
+              x86_64LinuxGenerateMemset(assembly, file, ir->args[0],
+                                        x86_64LinuxConstantFill(ir->args[1]));
             } else {
-              // memory = constant + constant
-              if (!irOperandIsLabel(ir->args[1]) &&
-                  !irOperandIsLabel(ir->args[2])) {
-                i = INST(X86_64_LINUX_IK_REGULAR,
-                         format("\tmov `d, %lu\n",
-                                x86_64LinuxConstantToNumber(ir->args[1]) +
-                                    x86_64LinuxConstantToNumber(ir->args[2])));
-                DEFINES(i, x86_64LinuxOperandCreate(ir->args[0]));
-                DONE(assembly, i);
-              } else {
-                if (irOperandIsLocal(ir->args[1]))
-                  i = INST(X86_64_LINUX_IK_REGULAR,
-                           format("\tmov `d, L%lu\n",
-                                  localOperandName(ir->args[1])));
-                else if (irOperandIsGlobal(ir->args[1]))
-                  i = INST(
-                      X86_64_LINUX_IK_REGULAR,
-                      format("\tmov `d, %s\n", globalOperandName(ir->args[1])));
-                else
-                  i = INST(X86_64_LINUX_IK_REGULAR,
-                           format("\tmov `d, %lu\n",
-                                  x86_64LinuxConstantToNumber(ir->args[1])));
-                DEFINES(i, x86_64LinuxOperandCreate(ir->args[0]));
-                DONE(assembly, i);
-
-                if (irOperandIsLocal(ir->args[2]))
-                  i = INST(X86_64_LINUX_IK_REGULAR,
-                           format("\tadd `d, L%lu\n",
-                                  localOperandName(ir->args[2])));
-                else if (irOperandIsGlobal(ir->args[2]))
-                  i = INST(
-                      X86_64_LINUX_IK_REGULAR,
-                      format("\tmov `d, %s\n", globalOperandName(ir->args[2])));
-                else
-                  i = INST(X86_64_LINUX_IK_REGULAR,
-                           format("\tmov `d, %lu\n",
-                                  x86_64LinuxConstantToNumber(ir->args[2])));
-                DEFINES(i, x86_64LinuxOperandCreate(ir->args[0]));
-                USES(i, x86_64LinuxOperandCreate(ir->args[0]));
-                DONE(assembly, i);
-              }
+              // memcpy constant to memory
+              size_t constantName = x86_64LinuxPoolConstant(
+                  file, ir->args[1]->data.constant.alignment,
+                  &ir->args[1]->data.constant.data);
+              size_t toAddress =
+                  x86_64LinuxGenerateTempAddress(assembly, file, ir->args[0]);
+              size_t fromAddress = x86_64LinuxGenerateLabelAddress(
+                  assembly, file, constantName);
+              x86_64LinuxGenerateMemcpy(assembly, file,
+                                        ir->args[0]->data.temp.size, toAddress,
+                                        fromAddress, ir->args[0], NULL);
             }
           }
         }
         break;
       }
-      case IO_SUB: {
-        // arg 0: reg, gp temp, mem temp
-        // arg 1: reg, gp temp, mem temp, const
+      case IO_MEM_STORE: {
+        // arg 0: reg, gp temp, mem temp, const
+        // arg 1: reg, non-mem temp, mem temp, const
         // arg 2: reg, gp temp, mem temp, const
-        // TODO
+        MemoryLocation m;
+        memoryLocationInit(&m, assembly, file, ir->args[0], NULL, ir->args[2],
+                           &folding.offsets[position],
+                           irOperandSizeof(ir->args[1]));
+        x86_64LinuxGenerateStore(assembly, file, &m, ir->args[1]);
+        memoryLocationUninit(&m);
         break;
       }
-      case IO_SMUL: {
-        // arg 0: reg, gp temp, mem temp
+      case IO_MEM_LOAD: {
+        // arg 0: reg, non-mem temp, mem temp
         // arg 1: reg, gp temp, mem temp, const
         // arg 2: reg, gp temp, mem temp, const
-        // TODO
+        MemoryLocation m;
+        memoryLocationInit(&m, assembly, file, ir->args[1], NULL, ir->args[2],
+                           &folding.offsets[position],
+                           irOperandSizeof(ir->args[0]));
+        x86_64LinuxGenerateLoad(assembly, file, ir->args[0], &m);
+        memoryLocationUninit(&m);
         break;
       }
-      case IO_UMUL: {
-        // arg 0: reg, gp temp, mem temp
+      case IO_STK_STORE: {
+        // arg 0: reg, gp temp, mem temp, const
+        // arg 1: reg, non-mem temp, mem temp, const
+        MemoryLocation m;
+        stackLocationInit(&m, ir->args[0], false);
+        x86_64LinuxGenerateStore(assembly, file, &m, ir->args[1]);
+        memoryLocationUninit(&m);
+        break;
+      }
+      case IO_STK_LOAD: {
+        // arg 0: reg, non-mem temp, mem temp
         // arg 1: reg, gp temp, mem temp, const
+        MemoryLocation m;
+        stackLocationInit(&m, ir->args[1], true);
+        x86_64LinuxGenerateLoad(assembly, file, ir->args[0], &m);
+        memoryLocationUninit(&m);
+        break;
+      }
+      case IO_OFFSET_STORE: {
+        // arg 0: mem temp
+        // arg 1: reg, non-mem temp, mem temp, const
+        // arg 2: reg, gp temp, mem temp, const
+        MemoryLocation m;
+        memoryLocationInit(&m, assembly, file, NULL, ir->args[0], ir->args[2],
+                           &folding.offsets[position],
+                           irOperandSizeof(ir->args[1]));
+        x86_64LinuxGenerateStore(assembly, file, &m, ir->args[1]);
+        memoryLocationUninit(&m);
+        break;
+      }
+      case IO_OFFSET_LOAD: {
+        // arg 0: reg, non-mem temp, mem temp
+        // arg 1: mem temp
         // arg 2: reg, gp temp, mem temp, const
-        // TODO
+        MemoryLocation m;
+        memoryLocationInit(&m, assembly, file, NULL, ir->args[1], ir->args[2],
+                           &folding.offsets[position],
+                           irOperandSizeof(ir->args[0]));
+        x86_64LinuxGenerateLoad(assembly, file, ir->args[0], &m);
+        memoryLocationUninit(&m);
         break;
       }
-      case IO_SDIV: {
+      case IO_ADD: {
         // arg 0: reg, gp temp, mem temp
         // arg 1: reg, gp temp, mem temp, const
         // arg 2: reg, gp temp, mem temp, const
-        // TODO
+        x86_64LinuxGenerateBinop(assembly, file, ir, "add", true);
         break;
       }
-      case IO_UDIV: {
+      case IO_SUB: {
         // arg 0: reg, gp temp, mem temp
         // arg 1: reg, gp temp, mem temp, const
         // arg 2: reg, gp temp, mem temp, const
-        // TODO
+        x86_64LinuxGenerateBinop(assembly, file, ir, "sub", true);
         break;
       }
-      case IO_SMOD: {
+      case IO_SMUL:
+      case IO_UMUL: {
         // arg 0: reg, gp temp, mem temp
         // arg 1: reg, gp temp, mem temp, const
         // arg 2: reg, gp temp, mem temp, const
-        // TODO
+        // the low half of the product doesn't depend on signedness
+        x86_64LinuxGenerateMultiplication(assembly, file, ir);
         break;
       }
+      case IO_SDIV:
+      case IO_UDIV:
+      case IO_SMOD:
       case IO_UMOD: {
         // arg 0: reg, gp temp, mem temp
         // arg 1: reg, gp temp, mem temp, const
         // arg 2: reg, gp temp, mem temp, const
-        // TODO
-        break;
-      }
-      case IO_FADD: {
-        // arg 0: reg, fp temp, mem temp
-        // arg 1: reg, fp temp, mem temp, const
-        // arg 2: reg, fp temp, mem temp, const
-        // TODO
-        break;
-      }
-      case IO_FSUB: {
-        // arg 0: reg, fp temp, mem temp
-        // arg 1: reg, fp temp, mem temp, const
-        // arg 2: reg, fp temp, mem temp, const
-        // TODO
-        break;
-      }
-      case IO_FMUL: {
-        // arg 0: reg, fp temp, mem temp
-        // arg 1: reg, fp temp, mem temp, const
-        // arg 2: reg, fp temp, mem temp, const
-        // TODO
-        break;
-      }
-      case IO_FDIV: {
-        // arg 0: reg, fp temp, mem temp
-        // arg 1: reg, fp temp, mem temp, const
-        // arg 2: reg, fp temp, mem temp, const
-        // TODO
-        break;
-      }
-      case IO_FMOD: {
-        // arg 0: reg, fp temp, mem temp
-        // arg 1: reg, fp temp, mem temp, const
-        // arg 2: reg, fp temp, mem temp, const
-        // TODO
+        x86_64LinuxGenerateDivision(assembly, file, ir,
+                                    ir->op == IO_SDIV || ir->op == IO_SMOD,
+                                    ir->op == IO_SMOD || ir->op == IO_UMOD);
         break;
       }
       case IO_NEG: {
         // arg 0: reg, gp temp, mem temp
         // arg 1: reg, gp temp, mem temp, const
-        // TODO
-        break;
-      }
-      case IO_FNEG: {
-        // arg 0: reg, fp temp, mem temp
-        // arg 1: reg, fp temp, mem temp, const
-        // TODO
+        x86_64LinuxGenerateUnop(assembly, file, ir, "neg");
         break;
       }
       case IO_SLL: {
         // arg 0: reg, gp temp, mem temp
         // arg 1: reg, gp temp, mem temp, const
         // arg 2: reg, gp temp, mem temp, const
-        // TODO
+        x86_64LinuxGenerateShift(assembly, file, ir, "shl");
         break;
       }
       case IO_SLR: {
         // arg 0: reg, gp temp, mem temp
         // arg 1: reg, gp temp, mem temp, const
         // arg 2: reg, gp temp, mem temp, const
-        // TODO
+        x86_64LinuxGenerateShift(assembly, file, ir, "shr");
         break;
       }
       case IO_SAR: {
         // arg 0: reg, gp temp, mem temp
         // arg 1: reg, gp temp, mem temp, const
         // arg 2: reg, gp temp, mem temp, const
-        // TODO
+        x86_64LinuxGenerateShift(assembly, file, ir, "sar");
         break;
       }
       case IO_AND: {
         // arg 0: reg, gp temp, mem temp
         // arg 1: reg, gp temp, mem temp, const
         // arg 2: reg, gp temp, mem temp, const
-        // TODO
+        x86_64LinuxGenerateBinop(assembly, file, ir, "and", true);
         break;
       }
       case IO_XOR: {
         // arg 0: reg, gp temp, mem temp
         // arg 1: reg, gp temp, mem temp, const
         // arg 2: reg, gp temp, mem temp, const
-        // TODO
+        x86_64LinuxGenerateBinop(assembly, file, ir, "xor", true);
         break;
       }
       case IO_OR: {
         // arg 0: reg, gp temp, mem temp
         // arg 1: reg, gp temp, mem temp, const
         // arg 2: reg, gp temp, mem temp, const
-        // TODO
+        x86_64LinuxGenerateBinop(assembly, file, ir, "or", true);
         break;
       }
       case IO_NOT: {
         // arg 0: reg, gp temp, mem temp
         // arg 1: reg, gp temp, mem temp, const
-        // TODO
-        break;
-      }
-      case IO_L: {
-        // arg 0: reg, gp temp, mem temp
-        // arg 1: reg, gp temp, mem temp, const
-        // arg 2: reg, gp temp, mem temp, const
-        // TODO
-        break;
-      }
-      case IO_LE: {
-        // arg 0: reg, gp temp, mem temp
-        // arg 1: reg, gp temp, mem temp, const
-        // arg 2: reg, gp temp, mem temp, const
-        // TODO
-        break;
-      }
-      case IO_E: {
-        // arg 0: reg, gp temp, mem temp
-        // arg 1: reg, gp temp, mem temp, const
-        // arg 2: reg, gp temp, mem temp, const
-        // TODO
-        break;
-      }
-      case IO_NE: {
-        // arg 0: reg, gp temp, mem temp
-        // arg 1: reg, gp temp, mem temp, const
-        // arg 2: reg, gp temp, mem temp, const
-        // TODO
-        break;
-      }
-      case IO_G: {
-        // arg 0: reg, gp temp, mem temp
-        // arg 1: reg, gp temp, mem temp, const
-        // arg 2: reg, gp temp, mem temp, const
-        // TODO
-        break;
-      }
-      case IO_GE: {
-        // arg 0: reg, gp temp, mem temp
-        // arg 1: reg, gp temp, mem temp, const
-        // arg 2: reg, gp temp, mem temp, const
-        // TODO
-        break;
-      }
-      case IO_A: {
-        // arg 0: reg, gp temp, mem temp
-        // arg 1: reg, gp temp, mem temp, const
-        // arg 2: reg, gp temp, mem temp, const
-        // TODO
-        break;
-      }
-      case IO_AE: {
-        // arg 0: reg, gp temp, mem temp
-        // arg 1: reg, gp temp, mem temp, const
-        // arg 2: reg, gp temp, mem temp, const
-        // TODO
-        break;
-      }
-      case IO_B: {
-        // arg 0: reg, gp temp, mem temp
-        // arg 1: reg, gp temp, mem temp, const
-        // arg 2: reg, gp temp, mem temp, const
-        // TODO
-        break;
-      }
+        x86_64LinuxGenerateUnop(assembly, file, ir, "not");
+        break;
+      }
+      case IO_L:
+      case IO_LE:
+      case IO_E:
+      case IO_NE:
+      case IO_G:
+      case IO_GE:
+      case IO_A:
+      case IO_AE:
+      case IO_B:
       case IO_BE: {
         // arg 0: reg, gp temp, mem temp
         // arg 1: reg, gp temp, mem temp, const
         // arg 2: reg, gp temp, mem temp, const
-        // TODO
-        break;
-      }
-      case IO_FL: {
-        // arg 0: reg, gp temp, mem temp
-        // arg 1: reg, fp temp, mem temp, const
-        // arg 2: reg, fp temp, mem temp, const
-        // TODO
-        break;
-      }
-      case IO_FLE: {
-        // arg 0: reg, gp temp, mem temp
-        // arg 1: reg, fp temp, mem temp, const
-        // arg 2: reg, fp temp, mem temp, const
-        // TODO
-        break;
-      }
-      case IO_FE: {
-        // arg 0: reg, gp temp, mem temp
-        // arg 1: reg, fp temp, mem temp, const
-        // arg 2: reg, fp temp, mem temp, const
-        // TODO
-        break;
-      }
-      case IO_FNE: {
-        // arg 0: reg, gp temp, mem temp
-        // arg 1: reg, fp temp, mem temp, const
-        // arg 2: reg, fp temp, mem temp, const
-        // TODO
-        break;
-      }
-      case IO_FG: {
-        // arg 0: reg, gp temp, mem temp
-        // arg 1: reg, fp temp, mem temp, const
-        // arg 2: reg, fp temp, mem temp, const
-        // TODO
-        break;
-      }
-      case IO_FGE: {
-        // arg 0: reg, gp temp, mem temp
-        // arg 1: reg, fp temp, mem temp, const
-        // arg 2: reg, fp temp, mem temp, const
-        // TODO
+        x86_64LinuxGenerateCompare(assembly, file, ir->args[1], ir->args[2],
+                                   knownZero(&folding, ir->args[2], position));
+        x86_64LinuxGenerateSet(assembly, ir->args[0],
+                               COMPARISON_CONDITIONS[ir->op - IO_L]);
         break;
       }
-      case IO_Z: {
+      case IO_Z:
+      case IO_LNOT: {
         // arg 0: reg, gp temp, mem temp
         // arg 1: reg, non-mem temp, mem temp, const
-        // TODO
+        x86_64LinuxGenerateZeroTest(assembly, file, ir->args[1]);
+        x86_64LinuxGenerateSet(assembly, ir->args[0], "z");
         break;
       }
       case IO_NZ: {
         // arg 0: reg, gp temp, mem temp
         // arg 1: reg, non-mem temp, mem temp, const
-        // TODO
+        x86_64LinuxGenerateZeroTest(assembly, file, ir->args[1]);
+        x86_64LinuxGenerateSet(assembly, ir->args[0], "nz");
         break;
       }
-      case IO_LNOT: {
+      case IO_SELECT: {
         // arg 0: reg, gp temp, mem temp
         // arg 1: reg, gp temp, mem temp, const
-        // TODO
+        // arg 2: reg, gp temp, mem temp, const
+        // arg 3: reg, gp temp, mem temp, const
+        IRInstruction const *cmp =
+            position != 0 && fusedIntoSelect(&folding, position - 1)
+                ? folding.instructions[position - 1]
+                : NULL;
+        x86_64LinuxGenerateSelect(
+            assembly, file, ir, cmp,
+            cmp != NULL && knownZero(&folding, cmp->args[2], position - 1));
         break;
       }
       case IO_SX: {
         // arg 0: reg, gp temp, mem temp
         // arg 1: reg, gp temp, mem temp, const
-        // TODO
+        x86_64LinuxGenerateExtension(assembly, file, ir, true);
         break;
       }
       case IO_ZX: {
         // arg 0: reg, gp temp, mem temp
         // arg 1: reg, gp temp, mem temp, const
-        // TODO
+        x86_64LinuxGenerateExtension(assembly, file, ir, false);
         break;
       }
       case IO_TRUNC: {
         // arg 0: reg, gp temp, mem temp
         // arg 1: reg, gp temp, mem temp, const
-        // TODO
-        break;
-      }
-      case IO_U2F: {
-        // arg 0: reg, fp temp, mem temp
-        // arg 1: reg, gp temp, mem temp, const
-        // TODO
-        break;
-      }
-      case IO_S2F: {
-        // arg 0: reg, fp temp, mem temp
-        // arg 1: reg, gp temp, mem temp, const
-        // TODO
-        break;
-      }
-      case IO_FRESIZE: {
-        // arg 0: reg, fp temp, mem temp
-        // arg 1: reg, fp temp, mem temp, const
-        // TODO
-        break;
-      }
-      case IO_F2I: {
-        // arg 0: reg, gp temp, mem temp
-        // arg 1: reg, fp temp, mem temp, const
-        // TODO
-        break;
+        x86_64LinuxGenerateTruncation(assembly, file, ir);
+        break;
+      }
+      case IO_FADD:
+      case IO_FSUB:
+      case IO_FMUL:
+      case IO_FDIV:
+      case IO_FMOD:
+      case IO_FNEG:
+      case IO_FL:
+      case IO_FLE:
+      case IO_FE:
+      case IO_FNE:
+      case IO_FG:
+      case IO_FGE:
+      case IO_U2F:
+      case IO_S2F:
+      case IO_FRESIZE:
+      case IO_F2I:
+      case IO_J1FL:
+      case IO_J1FLE:
+      case IO_J1FE:
+      case IO_J1FNE:
+      case IO_J1FG:
+      case IO_J1FGE: {
+        // better to stop than to run code with the operation missing
+        error(__FILE__, __LINE__,
+              "floating point operations are not yet supported");
       }
       case IO_JUMP: {
         // arg 0: local
-        // TODO
+        size_t name = localOperandName(ir->args[0]);
+        i = INST(X86_64_LINUX_IK_JUMP, format("\tjmp L%zu\n", name));
+        sizeVectorInsert(&i->data.jumpTargets, name);
+        DONE(assembly, i);
         break;
       }
       case IO_JUMPTABLE: {
         // arg 0: gp temp, mem temp
         // arg 1: local
-        // TODO
-        break;
-      }
-      case IO_J1L: {
-        // arg 0: local
-        // arg 1: reg, gp temp, mem temp, const
-        // arg 2: reg, gp temp, mem temp, const
-        // TODO
-        break;
-      }
-      case IO_J1LE: {
-        // arg 0: local
-        // arg 1: reg, gp temp, mem temp, const
-        // arg 2: reg, gp temp, mem temp, const
-        // TODO
-        break;
-      }
-      case IO_J1E: {
-        // arg 0: local
-        // arg 1: reg, gp temp, mem temp, const
-        // arg 2: reg, gp temp, mem temp, const
-        // TODO
-        break;
-      }
-      case IO_J1NE: {
-        // arg 0: local
-        // arg 1: reg, gp temp, mem temp, const
-        // arg 2: reg, gp temp, mem temp, const
-        // TODO
-        break;
-      }
-      case IO_J1G: {
-        // arg 0: local
-        // arg 1: reg, gp temp, mem temp, const
-        // arg 2: reg, gp temp, mem temp, const
-        // TODO
-        break;
-      }
-      case IO_J1GE: {
-        // arg 0: local
-        // arg 1: reg, gp temp, mem temp, const
-        // arg 2: reg, gp temp, mem temp, const
-        // TODO
-        break;
-      }
-      case IO_J1A: {
-        // arg 0: local
-        // arg 1: reg, gp temp, mem temp, const
-        // arg 2: reg, gp temp, mem temp, const
-        // TODO
-        break;
-      }
-      case IO_J1AE: {
-        // arg 0: local
-        // arg 1: reg, gp temp, mem temp, const
-        // arg 2: reg, gp temp, mem temp, const
-        // TODO
-        break;
-      }
-      case IO_J1B: {
-        // arg 0: local
-        // arg 1: reg, gp temp, mem temp, const
-        // arg 2: reg, gp temp, mem temp, const
-        // TODO
-        break;
-      }
+        x86_64LinuxGenerateJumpTable(assembly, file, ir);
+        break;
+      }
+      case IO_J1L:
+      case IO_J1LE:
+      case IO_J1E:
+      case IO_J1NE:
+      case IO_J1G:
+      case IO_J1GE:
+      case IO_J1A:
+      case IO_J1AE:
+      case IO_J1B:
       case IO_J1BE: {
         // arg 0: local
         // arg 1: reg, gp temp, mem temp, const
         // arg 2: reg, gp temp, mem temp, const
-        // TODO
-        break;
-      }
-      case IO_J1FL: {
-        // arg 0: local
-        // arg 1: reg, fp temp, mem temp, const
-        // arg 2: reg, fp temp, mem temp, const
-        // TODO
-        break;
-      }
-      case IO_J1FLE: {
-        // arg 0: local
-        // arg 1: reg, fp temp, mem temp, const
-        // arg 2: reg, fp temp, mem temp, const
-        // TODO
-        break;
-      }
-      case IO_J1FE: {
-        // arg 0: local
-        // arg 1: reg, fp temp, mem temp, const
-        // arg 2: reg, fp temp, mem temp, const
-        // TODO
-        break;
-      }
-      case IO_J1FNE: {
-        // arg 0: local
-        // arg 1: reg, fp temp, mem temp, const
-        // arg 2: reg, fp temp, mem temp, const
-        // TODO
-        break;
-      }
-      case IO_J1FG: {
-        // arg 0: local
-        // arg 1: reg, fp temp, mem temp, const
-        // arg 2: reg, fp temp, mem temp, const
-        // TODO
-        break;
-      }
-      case IO_J1FGE: {
-        // arg 0: local
-        // arg 1: reg, fp temp, mem temp, const
-        // arg 2: reg, fp temp, mem temp, const
-        // TODO
+        x86_64LinuxGenerateCompare(assembly, file, ir->args[1], ir->args[2],
+                                   knownZero(&folding, ir->args[2], position));
+        x86_64LinuxGenerateConditionalJump(
+            assembly, ir->args[0], COMPARISON_CONDITIONS[ir->op - IO_J1L]);
         break;
       }
       case IO_J1Z: {
         // arg 0: local
         // arg 1: reg, non-mem temp, mem temp, const
-        // TODO
+        x86_64LinuxGenerateZeroTest(assembly, file, ir->args[1]);
+        x86_64LinuxGenerateConditionalJump(assembly, ir->args[0], "z");
         break;
       }
       case IO_J1NZ: {
         // arg 0: local
         // arg 1: reg, non-mem temp, mem temp, const
-        // TODO
+        x86_64LinuxGenerateZeroTest(assembly, file, ir->args[1]);
+        x86_64LinuxGenerateConditionalJump(assembly, ir->args[0], "nz");
         break;
       }
       case IO_CALL: {
         // arg 0: reg, gp temp, mem temp, global, local
         if (ir->args[0]->kind == OK_REG || ir->args[0]->kind == OK_TEMP) {
           // register-ish
-          i = INST(X86_64_LINUX_IK_REGULAR, strdup("\tcall `u\n"));
+          i = INST(X86_64_LINUX_IK_CALL, strdup("\tcall `u\n"));
           USES(i, x86_64LinuxOperandCreate(ir->args[0]));
+        } else if (irOperandIsGlobal(ir->args[0])) {
+          i = INST(X86_64_LINUX_IK_CALL,
+                   format("\tcall %s\n", globalOperandName(ir->args[0])));
         } else {
-          // constant
-          if (irOperandIsGlobal(ir->args[0]))
-            i = INST(X86_64_LINUX_IK_REGULAR,
-                     format("\tcall %s\n", globalOperandName(ir->args[0])));
-          else
-            i = INST(X86_64_LINUX_IK_REGULAR,
-                     format("\tcall L%zu\n", localOperandName(ir->args[0])));
-          DEFINES(i, x86_64LinuxRegOperandCreate(X86_64_LINUX_RAX, 8));
-          DEFINES(i, x86_64LinuxRegOperandCreate(X86_64_LINUX_RDI, 8));
-          DEFINES(i, x86_64LinuxRegOperandCreate(X86_64_LINUX_RSI, 8));
-          DEFINES(i, x86_64LinuxRegOperandCreate(X86_64_LINUX_RDX, 8));
-          DEFINES(i, x86_64LinuxRegOperandCreate(X86_64_LINUX_RCX, 8));
-          DEFINES(i, x86_64LinuxRegOperandCreate(X86_64_LINUX_R8, 8));
-          DEFINES(i, x86_64LinuxRegOperandCreate(X86_64_LINUX_R9, 8));
-          DEFINES(i, x86_64LinuxRegOperandCreate(X86_64_LINUX_R10, 8));
-          DEFINES(i, x86_64LinuxRegOperandCreate(X86_64_LINUX_R11, 8));
-          DEFINES(i, x86_64LinuxRegOperandCreate(X86_64_LINUX_XMM0, 8));
-          DEFINES(i, x86_64LinuxRegOperandCreate(X86_64_LINUX_XMM1, 8));
-          DEFINES(i, x86_64LinuxRegOperandCreate(X86_64_LINUX_XMM2, 8));
-          DEFINES(i, x86_64LinuxRegOperandCreate(X86_64_LINUX_XMM3, 8));
-          DEFINES(i, x86_64LinuxRegOperandCreate(X86_64_LINUX_XMM4, 8));
-          DEFINES(i, x86_64LinuxRegOperandCreate(X86_64_LINUX_XMM5, 8));
-          DEFINES(i, x86_64LinuxRegOperandCreate(X86_64_LINUX_XMM6, 8));
-          DEFINES(i, x86_64LinuxRegOperandCreate(X86_64_LINUX_XMM7, 8));
-          DEFINES(i, x86_64LinuxRegOperandCreate(X86_64_LINUX_XMM8, 8));
-          DEFINES(i, x86_64LinuxRegOperandCreate(X86_64_LINUX_XMM9, 8));
-          DEFINES(i, x86_64LinuxRegOperandCreate(X86_64_LINUX_XMM10, 8));
-          DEFINES(i, x86_64LinuxRegOperandCreate(X86_64_LINUX_XMM11, 8));
-          DEFINES(i, x86_64LinuxRegOperandCreate(X86_64_LINUX_XMM12, 8));
-          DEFINES(i, x86_64LinuxRegOperandCreate(X86_64_LINUX_XMM13, 8));
-          DEFINES(i, x86_64LinuxRegOperandCreate(X86_64_LINUX_XMM14, 8));
-          DEFINES(i, x86_64LinuxRegOperandCreate(X86_64_LINUX_XMM15, 8));
-          DONE(assembly, i);
-          break;
+          i = INST(X86_64_LINUX_IK_CALL,
+                   format("\tcall L%zu\n", localOperandName(ir->args[0])));
+        }
+        for (size_t idx = 0; idx < NUM_ARGUMENT_REGISTERS; ++idx)
+          USES(i, x86_64LinuxRegOperandCreate(ARGUMENT_REGISTERS[idx], 8));
+        for (size_t idx = 0; idx < NUM_CALLER_SAVE_REGISTERS; ++idx)
+          DEFINES(i,
+                  x86_64LinuxRegOperandCreate(CALLER_SAVE_REGISTERS[idx], 8));
+        DONE(assembly, i);
+        break;
+      }
+      case IO_TAIL_CALL: {
+        // arg 0: reg, gp temp, mem temp, global, local
+        // frame teardown happens before any leaving instruction, so this is
+        // just a jump
+        if (ir->args[0]->kind == OK_REG || ir->args[0]->kind == OK_TEMP) {
+          // register-ish
+          i = INST(X86_64_LINUX_IK_TAIL_CALL, strdup("\tjmp `u\n"));
+          USES(i, x86_64LinuxOperandCreate(ir->args[0]));
+        } else if (irOperandIsGlobal(ir->args[0])) {
+          i = INST(X86_64_LINUX_IK_TAIL_CALL,
+                   format("\tjmp %s\n", globalOperandName(ir->args[0])));
+        } else {
+          i = INST(X86_64_LINUX_IK_TAIL_CALL,
+                   format("\tjmp L%zu\n", localOperandName(ir->args[0])));
         }
+        for (size_t idx = 0; idx < NUM_ARGUMENT_REGISTERS; ++idx)
+          USES(i, x86_64LinuxRegOperandCreate(ARGUMENT_REGISTERS[idx], 8));
+        for (size_t idx = 0; idx < X86_64_LINUX_NUM_CALLEE_SAVE_REGISTERS;
+             ++idx)
+          USES(i, x86_64LinuxRegOperandCreate(
+                      X86_64_LINUX_CALLEE_SAVE_REGISTERS[idx], 8));
+        DONE(assembly, i);
+        break;
       }
       case IO_RETURN: {
         // no args
         i = INST(X86_64_LINUX_IK_LEAVE, strdup("\tret\n"));
+        for (size_t idx = 0; idx < NUM_RETURN_REGISTERS; ++idx)
+          USES(i, x86_64LinuxRegOperandCreate(RETURN_REGISTERS[idx], 8));
+        for (size_t idx = 0; idx < X86_64_LINUX_NUM_CALLEE_SAVE_REGISTERS;
+             ++idx)
+          USES(i, x86_64LinuxRegOperandCreate(
+                      X86_64_LINUX_CALLEE_SAVE_REGISTERS[idx], 8));
         DONE(assembly, i);
         break;
       }
@@ -1533,6 +2899,8 @@ static X86_64LinuxFrag *x86_64LinuxGenerateTextAsm(IRFrag *frag,
       }
     }
   }
+  free(loopHeaders);
+  addressFoldingUninit(&folding);
   return assembly;
 }
 void x86_64LinuxGenerateAsm(void) {
@@ -30,6 +30,7 @@
 
 #include "ast/ast.h"
 #include "ir/ir.h"
+#include "util/container/hashMap.h"
 #include "util/container/linkedList.h"
 
 extern size_t const X86_64_LINUX_REGISTER_WIDTH;
@@ -72,10 +73,16 @@ typedef enum {
 
 char const *x86_64LinuxPrettyPrintRegister(size_t reg);
 
+/** allocatable registers a function must preserve */
+extern X86_64LinuxRegister const X86_64_LINUX_CALLEE_SAVE_REGISTERS[];
+extern size_t const X86_64_LINUX_NUM_CALLEE_SAVE_REGISTERS;
+
 typedef enum {
   X86_64_LINUX_OK_REG,
   X86_64_LINUX_OK_TEMP,
   X86_64_LINUX_OK_OFFSET,
+  X86_64_LINUX_OK_STACK,
+  X86_64_LINUX_OK_PART,
 } X86_64LinuxOperandKind;
 typedef struct {
   X86_64LinuxOperandKind kind;
@@ -98,14 +105,37 @@ typedef struct {
       size_t who;
       int64_t offset;
     } addrof;
+    struct {
+      X86_64LinuxRegister base; /**< rbp, or rsp if there's no frame */
+      int64_t offset;           /**< offset from base */
+      size_t size;
+    } stack;
+    struct {
+      size_t name;      /**< memory temp this is a part of */
+      size_t alignment; /**< alignment of the whole temp */
+      size_t size;      /**< size of the whole temp */
+      int64_t offset;   /**< offset of the part within the temp */
+      size_t partSize;
+      bool offsetOnly; /**< is only the part's frame offset wanted */
+    } part;
   } data;
 } X86_64LinuxOperand;
+/**
+ * create a register operand, rounding size up to an addressable width
+ */
+X86_64LinuxOperand *x86_64LinuxRegOperandCreate(X86_64LinuxRegister reg,
+                                                size_t size);
+void x86_64LinuxOperandFree(X86_64LinuxOperand *o);
 
 typedef enum {
   /**
    * regular instruction
    */
   X86_64_LINUX_IK_REGULAR,
+  /**
+   * calls a function, then continues with the next instruction
+   */
+  X86_64_LINUX_IK_CALL,
   /**
    * always jumps to given labelName
    */
@@ -122,6 +152,10 @@ typedef enum {
    * leaves the function entirely (e.g. ret)
    */
   X86_64_LINUX_IK_LEAVE,
+  /**
+   * leaves the function entirely by jumping to another function
+   */
+  X86_64_LINUX_IK_TAIL_CALL,
   /**
    * label of the given labelName
    */
@@ -149,6 +183,17 @@ typedef struct {
     } move;
   } data;
 } X86_64LinuxInstruction;
+/**
+ * create a register-to-register style move, taking ownership of the operands
+ */
+X86_64LinuxInstruction *x86_64LinuxMoveInstructionCreate(
+    X86_64LinuxOperand *to, X86_64LinuxOperand *from);
+/**
+ * create an instruction with no operands yet, taking ownership of the skeleton
+ */
+X86_64LinuxInstruction *x86_64LinuxInstructionCreate(
+    X86_64LinuxInstructionKind kind, char *skeleton);
+void x86_64LinuxInstructionFree(X86_64LinuxInstruction *i);
 
 typedef enum {
   X86_64_LINUX_FK_TEXT,
@@ -164,14 +209,22 @@ typedef struct {
       char *header;
       char *footer;
       LinkedList instructions;
+      size_t coldLabel; /**< first label of the cold code, or zero if none */
     } text;
   } data;
 } X86_64LinuxFrag;
+/**
+ * create a text fragment with no instructions, taking ownership of the header
+ * and footer
+ */
+X86_64LinuxFrag *x86_64LinuxTextFragCreate(char *header, char *footer);
+void x86_64LinuxFragFree(X86_64LinuxFrag *frag);
 
 typedef struct {
   char *header;
   char *footer;
   Vector frags;
+  HashMap constants; /**< rodata constant label, keyed on alignment and data */
 } X86_64LinuxFile;
 void x86_64LinuxFileFree(X86_64LinuxFile *file);
 
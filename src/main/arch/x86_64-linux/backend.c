@@ -20,10 +20,18 @@
 #include "arch/x86_64-linux/backend.h"
 
 #include "arch/x86_64-linux/asm.h"
+#include "arch/x86_64-linux/frame.h"
+#include "arch/x86_64-linux/hotColdSplit.h"
+#include "arch/x86_64-linux/jit.h"
+#include "arch/x86_64-linux/objectWriter.h"
+#include "arch/x86_64-linux/peephole.h"
+#include "arch/x86_64-linux/registerAllocation.h"
+#include "arch/x86_64-linux/writer.h"
 #include "fileList.h"
 #include "ir/ir.h"
+#include "options.h"
 
-void x86_64LinuxBackend(void) {
+int x86_64LinuxBackend(int *exitCode) {
   // assembly generation
   x86_64LinuxGenerateAsm();
 
@@ -32,18 +40,32 @@ void x86_64LinuxBackend(void) {
     vectorUninit(&fileList.entries[idx].irFrags, (void (*)(void *))irFragFree);
 
   // assembly optimization 1
-  // TODO
+  x86_64LinuxPeepholeOptimize(false);
 
   // register allocation
-  // TODO
+  x86_64LinuxAllocateRegisters();
 
   // assembly optimization 2
-  // TODO
+  x86_64LinuxPeepholeOptimize(true);
 
-  // write out
-  // TODO
+  // frame layout
+  x86_64LinuxLayoutFrames();
+
+  // hot/cold splitting
+  x86_64LinuxSplitColdCode();
+
+  // write out or run
+  int retval;
+  if (options.run != NULL)
+    retval = x86_64LinuxRunJit(options.run, exitCode);
+  else if (options.emit == OPTION_EMIT_OBJ)
+    retval = x86_64LinuxWriteObject();
+  else
+    retval = x86_64LinuxWriteAsm();
 
   // cleanup
   for (size_t idx = 0; idx < fileList.size; ++idx)
     x86_64LinuxFileFree(fileList.entries[idx].asmFile);
+
+  return retval;
 }
\ No newline at end of file
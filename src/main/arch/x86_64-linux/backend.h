@@ -25,6 +25,14 @@
 #ifndef TLC_ARCH_X86_64_LINUX_BACKEND_H_
 #define TLC_ARCH_X86_64_LINUX_BACKEND_H_
 
-void x86_64LinuxBackend(void);
+/**
+ * generate, optimize, and write out assembly for each code file, or run it
+ * in-process
+ *
+ * @param exitCode output parameter for the program's exit code, set only if
+ *                 the program is run in-process
+ * @returns -1 on failure, 0 on success
+ */
+int x86_64LinuxBackend(int *exitCode);
 
 #endif  // TLC_ARCH_X86_64_LINUX_BACKEND_H_
\ No newline at end of file
@@ -0,0 +1,1115 @@
+// Copyright 2021 Justin Hu
+//
+// This file is part of the T Language Compiler.
+//
+// The T Language Compiler is free software: you can redistribute it and/or
+// modify it under the terms of the GNU General Public License as published by
+// the Free Software Foundation, either version 3 of the License, or (at your
+// option) any later version.
+//
+// The T Language Compiler is distributed in the hope that it will be useful,
+// but WITHOUT ANY WARRANTY; without even the implied warranty of
+// MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the GNU General
+// Public License for more details.
+//
+// You should have received a copy of the GNU General Public License along with
+// the T Language Compiler. If not see <https://www.gnu.org/licenses/>.
+//
+// SPDX-License-Identifier: GPL-3.0-or-later
+
+#include "arch/x86_64-linux/encoder.h"
+
+#include <stdbool.h>
+#include <stdlib.h>
+#include <string.h>
+
+#include "util/format.h"
+#include "util/internalError.h"
+
+/** hardware register numbers, indexed by X86_64LinuxRegister */
+static uint8_t const REGISTER_NUMBERS[] = {
+    0, 3, 1,  2,  6,  7,  4,  5,  8, 9, 10, 11, 12, 13, 14, 15,
+    0, 1, 2,  3,  4,  5,  6,  7,  8, 9, 10, 11, 12, 13, 14, 15,
+};
+/** hardware register number of rsp */
+static uint8_t const RSP_NUMBER = 4;
+/** hardware register number of rbp */
+static uint8_t const RBP_NUMBER = 5;
+/** hardware register number of rcx */
+static uint8_t const RCX_NUMBER = 1;
+
+void x86_64LinuxReferenceFree(X86_64LinuxReference *r) {
+  free(r->symbol);
+  free(r);
+}
+
+/** the kinds of operand an instruction can have */
+typedef enum {
+  EO_REG,
+  EO_IMM,
+  EO_MEM,
+  EO_SYMBOL,
+} EncodedOperandKind;
+/** an operand, as the encoder sees it */
+typedef struct {
+  EncodedOperandKind kind;
+  size_t size;   /**< in bytes, or zero if not known */
+  uint8_t reg;   /**< register number, or base register of a memory operand */
+  bool xmm;      /**< is reg an xmm register */
+  bool hasBase;  /**< does the memory operand have a base register */
+  bool hasIndex; /**< does the memory operand have an index register */
+  uint8_t index; /**< index register of a memory operand */
+  uint8_t scale; /**< scale of the index register - 1, 2, 4, or 8 */
+  int64_t disp;  /**< displacement of a memory operand */
+  uint64_t imm;  /**< value of an immediate */
+  char const *symbol; /**< symbol name - not null terminated */
+  size_t symbolLength;
+} EncodedOperand;
+/** an instruction, parsed out of its skeleton */
+typedef struct {
+  bool rep;
+  size_t numOperands;
+  EncodedOperand operands[3];
+} ParsedInstruction;
+
+static bool isIdStart(char c) {
+  return (c >= 'a' && c <= 'z') || (c >= 'A' && c <= 'Z') || c == '_' ||
+         c == '.';
+}
+static bool isIdChar(char c) { return isIdStart(c) || (c >= '0' && c <= '9'); }
+static bool isDigit(char c) { return c >= '0' && c <= '9'; }
+static void skipSpaces(char const **s) {
+  while (**s == ' ' || **s == '\t') ++*s;
+}
+static size_t identifierLength(char const *s) {
+  size_t length = 0;
+  if (!isIdStart(s[length])) return 0;
+  while (isIdChar(s[length])) ++length;
+  return length;
+}
+static uint64_t readNumber(char const **s) {
+  uint64_t n = 0;
+  for (; isDigit(**s); ++*s) n = n * 10 + (uint64_t)(**s - '0');
+  return n;
+}
+static bool wordIs(char const *word, size_t length, char const *expected) {
+  return strlen(expected) == length && strncmp(word, expected, length) == 0;
+}
+
+/**
+ * find the register with the given name
+ *
+ * @returns whether the name was a register
+ */
+static bool registerNamed(char const *name, size_t length,
+                          EncodedOperand *out) {
+  for (size_t reg = X86_64_LINUX_RAX; reg <= X86_64_LINUX_XMM15; ++reg) {
+    if (wordIs(name, length, x86_64LinuxPrettyPrintRegister(reg))) {
+      out->kind = EO_REG;
+      out->reg = REGISTER_NUMBERS[reg];
+      out->xmm = reg >= X86_64_LINUX_XMM0;
+      out->size = out->xmm ? 16 : 8;
+      return true;
+    }
+  }
+  return false;
+}
+
+/**
+ * convert an instruction's operand
+ *
+ * @returns status code (0 = OK)
+ */
+static int convertOperand(X86_64LinuxOperand const *o, EncodedOperand *out) {
+  switch (o->kind) {
+    case X86_64_LINUX_OK_REG: {
+      out->kind = EO_REG;
+      out->reg = REGISTER_NUMBERS[o->data.reg.reg];
+      out->xmm = o->data.reg.reg >= X86_64_LINUX_XMM0;
+      out->size = o->data.reg.size;
+      return 0;
+    }
+    case X86_64_LINUX_OK_OFFSET: {
+      out->kind = EO_IMM;
+      out->imm = (uint64_t)o->data.offset.offset;
+      return 0;
+    }
+    case X86_64_LINUX_OK_STACK: {
+      out->kind = EO_MEM;
+      out->hasBase = true;
+      out->reg = REGISTER_NUMBERS[o->data.stack.base];
+      out->disp = o->data.stack.offset;
+      out->size = o->data.stack.size;
+      return 0;
+    }
+    default: {
+      return -1;  // unallocated temps can't be encoded
+    }
+  }
+}
+
+/**
+ * convert the operand referred to by a skeleton placeholder
+ *
+ * @param i instruction being parsed
+ * @param which placeholder character
+ * @param counts number of defines, uses, and others already consumed
+ * @returns status code (0 = OK)
+ */
+static int placeholderOperand(X86_64LinuxInstruction const *i, char which,
+                              size_t counts[3], EncodedOperand *out) {
+  Vector const *operands;
+  size_t *count;
+  switch (which) {
+    case 'd': {
+      operands = &i->defines;
+      count = &counts[0];
+      break;
+    }
+    case 'u': {
+      operands = &i->uses;
+      count = &counts[1];
+      break;
+    }
+    case 'o': {
+      operands = &i->other;
+      count = &counts[2];
+      break;
+    }
+    default: {
+      return -1;
+    }
+  }
+  if (*count >= operands->size) return -1;
+  return convertOperand(operands->elements[(*count)++], out);
+}
+
+/** sizes named by memory size keywords */
+static struct {
+  char const *keyword;
+  size_t size;
+} const SIZE_KEYWORDS[] = {
+    {"byte", 1}, {"word", 2}, {"dword", 4}, {"qword", 8}, {"oword", 16},
+};
+static size_t const NUM_SIZE_KEYWORDS =
+    sizeof(SIZE_KEYWORDS) / sizeof(SIZE_KEYWORDS[0]);
+
+/**
+ * parse the inside of a memory operand, after the '['
+ *
+ * @returns status code (0 = OK)
+ */
+static int parseMemory(char const **s, X86_64LinuxInstruction const *i,
+                       size_t counts[3], EncodedOperand *out) {
+  out->kind = EO_MEM;
+  while (true) {
+    skipSpaces(s);
+    if (**s == ']') break;
+
+    int64_t sign = 1;
+    if (**s == '+' || **s == '-') {
+      if (**s == '-') sign = -1;
+      ++*s;
+      skipSpaces(s);
+    }
+
+    EncodedOperand term;
+    memset(&term, 0, sizeof(EncodedOperand));
+    if (**s == '`') {
+      if (placeholderOperand(i, (*s)[1], counts, &term) != 0) return -1;
+      *s += 2;
+    } else if (isDigit(**s)) {
+      term.kind = EO_IMM;
+      term.imm = readNumber(s);
+    } else {
+      size_t length = identifierLength(*s);
+      if (length == 0) return -1;
+      if (!registerNamed(*s, length, &term)) {
+        term.kind = EO_SYMBOL;
+        term.symbol = *s;
+        term.symbolLength = length;
+      }
+      *s += length;
+    }
+
+    uint64_t scale = 0;
+    skipSpaces(s);
+    if (**s == '*') {
+      ++*s;
+      skipSpaces(s);
+      if (!isDigit(**s)) return -1;
+      scale = readNumber(s);
+    }
+
+    switch (term.kind) {
+      case EO_REG: {
+        // addresses are always built from 64 bit registers, so a 32 bit
+        // address size (and the 0x67 prefix) never comes up
+        if (!term.xmm && term.size == 4)
+          error(__FILE__, __LINE__, "32 bit register used in an address");
+        if (term.xmm || term.size != 8 || sign < 0) return -1;
+        if (scale == 0 && !out->hasBase) {
+          out->hasBase = true;
+          out->reg = term.reg;
+        } else {
+          if (scale == 0) scale = 1;
+          if (out->hasIndex || term.reg == RSP_NUMBER ||
+              (scale != 1 && scale != 2 && scale != 4 && scale != 8))
+            return -1;
+          out->hasIndex = true;
+          out->index = term.reg;
+          out->scale = (uint8_t)scale;
+        }
+        break;
+      }
+      case EO_IMM: {
+        out->disp += sign * (int64_t)(scale == 0 ? term.imm : term.imm * scale);
+        break;
+      }
+      case EO_SYMBOL: {
+        if (out->symbol != NULL || sign < 0 || scale != 0) return -1;
+        out->symbol = term.symbol;
+        out->symbolLength = term.symbolLength;
+        break;
+      }
+      default: {
+        return -1;
+      }
+    }
+  }
+  ++*s;
+  return 0;
+}
+
+/**
+ * parse one operand of a skeleton
+ *
+ * @returns status code (0 = OK)
+ */
+static int parseOperand(char const **s, X86_64LinuxInstruction const *i,
+                        size_t counts[3], EncodedOperand *out) {
+  memset(out, 0, sizeof(EncodedOperand));
+  skipSpaces(s);
+
+  size_t keywordSize = 0;
+  size_t length = identifierLength(*s);
+  for (size_t idx = 0; idx < NUM_SIZE_KEYWORDS; ++idx) {
+    if (wordIs(*s, length, SIZE_KEYWORDS[idx].keyword)) {
+      keywordSize = SIZE_KEYWORDS[idx].size;
+      *s += length;
+      skipSpaces(s);
+      length = identifierLength(*s);
+      break;
+    }
+  }
+
+  if (**s == '[') {
+    ++*s;
+    if (parseMemory(s, i, counts, out) != 0) return -1;
+  } else if (**s == '`') {
+    if (placeholderOperand(i, (*s)[1], counts, out) != 0) return -1;
+    *s += 2;
+  } else if (isDigit(**s)) {
+    out->kind = EO_IMM;
+    out->imm = readNumber(s);
+  } else if (**s == '-' && isDigit((*s)[1])) {
+    ++*s;
+    out->kind = EO_IMM;
+    out->imm = -readNumber(s);
+  } else if (length != 0) {
+    if (!registerNamed(*s, length, out)) {
+      out->kind = EO_SYMBOL;
+      out->symbol = *s;
+      out->symbolLength = length;
+    }
+    *s += length;
+  } else {
+    return -1;
+  }
+
+  if (keywordSize != 0) {
+    if (out->kind != EO_MEM) return -1;
+    out->size = keywordSize;
+  }
+  skipSpaces(s);
+  return 0;
+}
+
+/**
+ * split an instruction's skeleton into a mnemonic and operands
+ *
+ * @param mnemonic output parameter for the mnemonic, not null terminated
+ * @param mnemonicLength output parameter for the mnemonic's length
+ * @returns status code (0 = OK)
+ */
+static int parseInstruction(X86_64LinuxInstruction const *i,
+                            char const **mnemonic, size_t *mnemonicLength,
+                            ParsedInstruction *out) {
+  char const *s = i->skeleton;
+  skipSpaces(&s);
+  out->rep = false;
+  *mnemonic = s;
+  *mnemonicLength = identifierLength(s);
+  if (wordIs(*mnemonic, *mnemonicLength, "rep")) {
+    out->rep = true;
+    s += *mnemonicLength;
+    skipSpaces(&s);
+    *mnemonic = s;
+    *mnemonicLength = identifierLength(s);
+  }
+  if (*mnemonicLength == 0) return -1;
+  s += *mnemonicLength;
+  skipSpaces(&s);
+
+  size_t counts[3] = {0, 0, 0};
+  out->numOperands = 0;
+  while (*s != '\n' && *s != '\0') {
+    if (out->numOperands == 3) return -1;
+    if (parseOperand(&s, i, counts, &out->operands[out->numOperands++]) != 0)
+      return -1;
+    if (*s == ',') ++s;
+  }
+  return 0;
+}
+
+static void emitByte(TStringBuilder *out, uint8_t b) {
+  tstringBuilderPush(out, b);
+}
+/**
+ * emit a little-endian value
+ */
+static void emitValue(TStringBuilder *out, uint64_t value, size_t width) {
+  for (size_t idx = 0; idx < width; ++idx)
+    emitByte(out, (uint8_t)(value >> (8 * idx)));
+}
+/**
+ * emit a zeroed field that refers to the symbol in o
+ */
+static void emitReference(TStringBuilder *out, Vector *references,
+                          X86_64LinuxReferenceKind kind,
+                          EncodedOperand const *o, int64_t addend,
+                          size_t width) {
+  X86_64LinuxReference *r = malloc(sizeof(X86_64LinuxReference));
+  r->kind = kind;
+  r->offset = out->size;
+  r->symbol = format("%.*s", (int)o->symbolLength, o->symbol);
+  r->addend = addend;
+  vectorInsert(references, r);
+  emitValue(out, 0, width);
+}
+
+static bool fitsInt8(int64_t n) { return n >= INT8_MIN && n <= INT8_MAX; }
+static bool fitsInt32(int64_t n) { return n >= INT32_MIN && n <= INT32_MAX; }
+/**
+ * can a value be written as an immediate of the given width - either as an
+ * unsigned number or as a sign-extended negative number
+ */
+static bool immediateFits(uint64_t value, size_t width) {
+  if (width == 8) return true;
+  uint64_t max = (UINT64_C(1) << (8 * width)) - 1;
+  int64_t min = -(INT64_C(1) << (8 * width - 1));
+  return value <= max || (int64_t)value >= min;
+}
+/**
+ * is the low size bytes of a value the sign extension of its low byte
+ */
+static bool fitsSignExtendedByte(uint64_t value, size_t size) {
+  uint64_t mask = size == 8 ? UINT64_MAX : (UINT64_C(1) << (8 * size)) - 1;
+  return ((uint64_t)(int64_t)(int8_t)value & mask) == (value & mask);
+}
+
+/**
+ * does an operand name one of spl, bpl, sil, or dil, which need a REX prefix
+ */
+static bool needsByteRex(EncodedOperand const *o) {
+  return o->kind == EO_REG && o->size == 1 && o->reg >= 4 && o->reg <= 7;
+}
+/**
+ * is an operand usable as the r/m operand of a general purpose instruction
+ */
+static bool isGpRm(EncodedOperand const *o) {
+  return (o->kind == EO_REG && !o->xmm) ||
+         (o->kind == EO_MEM && o->symbol == NULL);
+}
+/**
+ * is an operand usable as the r/m operand of a 16 byte sse instruction
+ */
+static bool isSseRm(EncodedOperand const *o) {
+  return (o->kind == EO_REG && o->xmm) ||
+         (o->kind == EO_MEM && (o->size == 0 || o->size == 16));
+}
+static bool isGpReg(EncodedOperand const *o) {
+  return o->kind == EO_REG && !o->xmm;
+}
+static bool isGpSize(size_t size) {
+  return size == 1 || size == 2 || size == 4 || size == 8;
+}
+
+/**
+ * emit prefixes, opcode, modrm byte, and displacement for an instruction
+ *
+ * @param size operand size - sets the operand size prefix or REX.W
+ * @param opcode opcode bytes
+ * @param opcodeLength number of opcode bytes
+ * @param reg register number or opcode extension for the modrm reg field
+ * @param forceRex whether a REX prefix is needed even if it is empty
+ * @param rm register or memory operand
+ * @param immediateWidth size of the immediate after the displacement
+ * @returns status code (0 = OK)
+ */
+static int emitModRM(TStringBuilder *out, Vector *references, size_t size,
+                     uint8_t const *opcode, size_t opcodeLength, uint8_t reg,
+                     bool forceRex, EncodedOperand const *rm,
+                     size_t immediateWidth) {
+  if (size == 2) emitByte(out, 0x66);
+  uint8_t rex = 0x40;
+  if (size == 8) rex |= 0x08;
+  if (reg >= 8) rex |= 0x04;
+  if (rm->hasIndex && rm->index >= 8) rex |= 0x02;
+  if ((rm->kind == EO_REG || rm->hasBase) && rm->reg >= 8) rex |= 0x01;
+  if (rex != 0x40 || forceRex) emitByte(out, rex);
+  for (size_t idx = 0; idx < opcodeLength; ++idx) emitByte(out, opcode[idx]);
+
+  uint8_t regField = (uint8_t)((reg & 7) << 3);
+  if (rm->kind == EO_REG) {
+    emitByte(out, (uint8_t)(0xc0 | regField | (rm->reg & 7)));
+    return 0;
+  }
+
+  uint8_t sib = 0;
+  if (rm->hasIndex) {
+    uint8_t scaleBits = rm->scale == 8   ? 3
+                        : rm->scale == 4 ? 2
+                        : rm->scale == 2 ? 1
+                                         : 0;
+    sib = (uint8_t)(scaleBits << 6 | (rm->index & 7) << 3);
+  }
+
+  if (!rm->hasBase && rm->hasIndex) {
+    // index without a base, through a sib byte with a disp32 and no base
+    if (rm->symbol != NULL || !fitsInt32(rm->disp)) return -1;
+    emitByte(out, (uint8_t)(0x04 | regField));
+    emitByte(out, (uint8_t)(sib | 0x05));
+    emitValue(out, (uint64_t)rm->disp, 4);
+    return 0;
+  } else if (!rm->hasBase) {
+    if (rm->symbol != NULL) {
+      // rip-relative
+      emitByte(out, (uint8_t)(0x05 | regField));
+      emitReference(out, references, X86_64_LINUX_RK_PC32, rm,
+                    rm->disp - 4 - (int64_t)immediateWidth, 4);
+    } else {
+      // absolute, through a sib byte with no base or index
+      if (!fitsInt32(rm->disp)) return -1;
+      emitByte(out, (uint8_t)(0x04 | regField));
+      emitByte(out, 0x25);
+      emitValue(out, (uint64_t)rm->disp, 4);
+    }
+    return 0;
+  }
+
+  if (rm->symbol != NULL) return -1;
+  uint8_t base = rm->reg & 7;
+  uint8_t mod;
+  if (rm->disp == 0 && base != RBP_NUMBER)
+    mod = 0x00;
+  else if (fitsInt8(rm->disp))
+    mod = 0x40;
+  else if (fitsInt32(rm->disp))
+    mod = 0x80;
+  else
+    return -1;
+  if (rm->hasIndex) {
+    emitByte(out, (uint8_t)(mod | regField | 0x04));
+    emitByte(out, (uint8_t)(sib | base));
+  } else {
+    emitByte(out, (uint8_t)(mod | regField | base));
+    if (base == 4) emitByte(out, 0x24);  // rsp and r12 need a sib byte
+  }
+  if (mod == 0x40)
+    emitValue(out, (uint64_t)rm->disp, 1);
+  else if (mod == 0x80)
+    emitValue(out, (uint64_t)rm->disp, 4);
+  return 0;
+}
+
+/**
+ * get the operand size of a two-operand instruction
+ *
+ * @returns size, or zero if the operand sizes are unknown or disagree
+ */
+static size_t operandSize(EncodedOperand const *a, EncodedOperand const *b) {
+  if (a->size != 0 && b->size != 0 && a->size != b->size) return 0;
+  size_t size = a->size != 0 ? a->size : b->size;
+  return isGpSize(size) ? size : 0;
+}
+
+/** an instruction encoder - param comes from the mnemonic table */
+typedef int (*Encoder)(ParsedInstruction const *p, uint8_t param,
+                       TStringBuilder *out, Vector *references);
+
+static int encodeNullary(ParsedInstruction const *p, uint8_t param,
+                         TStringBuilder *out, Vector *references) {
+  (void)references;
+  if (p->numOperands != 0) return -1;
+  emitByte(out, param);
+  return 0;
+}
+static int encodeWideNullary(ParsedInstruction const *p, uint8_t param,
+                             TStringBuilder *out, Vector *references) {
+  (void)references;
+  if (p->numOperands != 0) return -1;
+  emitByte(out, 0x48);
+  emitByte(out, param);
+  return 0;
+}
+
+/**
+ * encode a string move, where param is the element size
+ */
+static int encodeStringMove(ParsedInstruction const *p, uint8_t param,
+                            TStringBuilder *out, Vector *references) {
+  (void)references;
+  if (p->numOperands != 0) return -1;
+  if (p->rep) emitByte(out, 0xf3);
+  if (param == 2) emitByte(out, 0x66);
+  if (param == 8) emitByte(out, 0x48);
+  emitByte(out, param == 1 ? 0xa4 : 0xa5);
+  return 0;
+}
+
+/**
+ * encode a string store, where param is the element size
+ */
+static int encodeStringStore(ParsedInstruction const *p, uint8_t param,
+                             TStringBuilder *out, Vector *references) {
+  (void)references;
+  if (p->numOperands != 0) return -1;
+  if (p->rep) emitByte(out, 0xf3);
+  if (param == 2) emitByte(out, 0x66);
+  if (param == 8) emitByte(out, 0x48);
+  emitByte(out, param == 1 ? 0xaa : 0xab);
+  return 0;
+}
+
+static int encodeMov(ParsedInstruction const *p, uint8_t param,
+                     TStringBuilder *out, Vector *references) {
+  (void)param;
+  if (p->numOperands != 2) return -1;
+  EncodedOperand const *to = &p->operands[0];
+  EncodedOperand const *from = &p->operands[1];
+  bool forceRex = needsByteRex(to) || needsByteRex(from);
+
+  if (isGpRm(to) && isGpReg(from)) {
+    size_t size = operandSize(to, from);
+    if (size == 0) return -1;
+    uint8_t opcode = size == 1 ? 0x88 : 0x89;
+    return emitModRM(out, references, size, &opcode, 1, from->reg, forceRex,
+                     to, 0);
+  } else if (isGpReg(to) && isGpRm(from)) {
+    size_t size = operandSize(to, from);
+    if (size == 0) return -1;
+    uint8_t opcode = size == 1 ? 0x8a : 0x8b;
+    return emitModRM(out, references, size, &opcode, 1, to->reg, forceRex,
+                     from, 0);
+  } else if (isGpReg(to) && from->kind == EO_IMM) {
+    uint8_t rex = to->reg >= 8 ? 0x41 : 0x40;
+    uint8_t low = to->reg & 7;
+    switch (to->size) {
+      case 1: {
+        if (!immediateFits(from->imm, 1)) return -1;
+        if (rex != 0x40 || forceRex) emitByte(out, rex);
+        emitByte(out, (uint8_t)(0xb0 + low));
+        emitValue(out, from->imm, 1);
+        return 0;
+      }
+      case 2:
+      case 4: {
+        if (!immediateFits(from->imm, to->size)) return -1;
+        if (to->size == 2) emitByte(out, 0x66);
+        if (rex != 0x40) emitByte(out, rex);
+        emitByte(out, (uint8_t)(0xb8 + low));
+        emitValue(out, from->imm, to->size);
+        return 0;
+      }
+      case 8: {
+        if (from->imm <= UINT32_MAX) {
+          // writing the low half zeroes the high half
+          if (rex != 0x40) emitByte(out, rex);
+          emitByte(out, (uint8_t)(0xb8 + low));
+          emitValue(out, from->imm, 4);
+        } else if (fitsInt32((int64_t)from->imm)) {
+          uint8_t opcode = 0xc7;
+          emitModRM(out, references, 8, &opcode, 1, 0, false, to, 4);
+          emitValue(out, from->imm, 4);
+        } else {
+          emitByte(out, (uint8_t)(rex | 0x08));
+          emitByte(out, (uint8_t)(0xb8 + low));
+          emitValue(out, from->imm, 8);
+        }
+        return 0;
+      }
+      default: {
+        return -1;
+      }
+    }
+  } else if (to->kind == EO_MEM && from->kind == EO_IMM) {
+    size_t size = to->size;
+    if (!isGpSize(size)) return -1;
+    size_t width = size == 8 ? 4 : size;
+    if (size == 8 ? !fitsInt32((int64_t)from->imm)
+                  : !immediateFits(from->imm, size))
+      return -1;
+    uint8_t opcode = size == 1 ? 0xc6 : 0xc7;
+    if (emitModRM(out, references, size, &opcode, 1, 0, false, to, width) !=
+        0)
+      return -1;
+    emitValue(out, from->imm, width);
+    return 0;
+  } else if (isGpReg(to) && from->kind == EO_SYMBOL) {
+    // address of a symbol
+    if (to->size != 8 && to->size != 4) return -1;
+    uint8_t rex = to->reg >= 8 ? 0x41 : 0x40;
+    if (to->size == 8) rex |= 0x08;
+    if (rex != 0x40) emitByte(out, rex);
+    emitByte(out, (uint8_t)(0xb8 + (to->reg & 7)));
+    emitReference(out, references,
+                  to->size == 8 ? X86_64_LINUX_RK_ABS64 : X86_64_LINUX_RK_ABS32,
+                  from, 0, to->size);
+    return 0;
+  } else {
+    return -1;
+  }
+}
+
+/**
+ * encode one of the eight classic arithmetic instructions, where param is the
+ * opcode extension (add, or, adc, sbb, and, sub, xor, cmp)
+ */
+/**
+ * encode an unaligned 16 byte move to or from an xmm register
+ */
+static int encodeMovdqu(ParsedInstruction const *p, uint8_t param,
+                        TStringBuilder *out, Vector *references) {
+  (void)param;
+  if (p->numOperands != 2) return -1;
+  EncodedOperand const *to = &p->operands[0];
+  EncodedOperand const *from = &p->operands[1];
+  if (to->kind == EO_REG && to->xmm && isSseRm(from)) {
+    uint8_t opcode[] = {0x0f, 0x6f};
+    emitByte(out, 0xf3);
+    return emitModRM(out, references, 16, opcode, 2, to->reg, false, from,
+                     0);
+  } else if (to->kind == EO_MEM && (to->size == 0 || to->size == 16) &&
+             from->kind == EO_REG && from->xmm) {
+    uint8_t opcode[] = {0x0f, 0x7f};
+    emitByte(out, 0xf3);
+    return emitModRM(out, references, 16, opcode, 2, from->reg, false, to,
+                     0);
+  } else {
+    return -1;
+  }
+}
+
+/**
+ * encode a 66 0f-prefixed sse instruction from an xmm register or memory to
+ * an xmm register, where param is the second opcode byte
+ */
+static int encodeSse(ParsedInstruction const *p, uint8_t param,
+                     TStringBuilder *out, Vector *references) {
+  if (p->numOperands != 2) return -1;
+  EncodedOperand const *to = &p->operands[0];
+  EncodedOperand const *from = &p->operands[1];
+  if (to->kind != EO_REG || !to->xmm || !isSseRm(from)) return -1;
+  uint8_t opcode[] = {0x0f, param};
+  emitByte(out, 0x66);
+  return emitModRM(out, references, 16, opcode, 2, to->reg, false, from, 0);
+}
+
+/**
+ * encode a doubleword or quadword move between a general purpose register or
+ * memory and an xmm register, where param is the width moved
+ */
+static int encodeMovq(ParsedInstruction const *p, uint8_t param,
+                      TStringBuilder *out, Vector *references) {
+  if (p->numOperands != 2) return -1;
+  EncodedOperand const *to = &p->operands[0];
+  EncodedOperand const *from = &p->operands[1];
+  if (to->kind == EO_REG && to->xmm && isGpRm(from) &&
+      (from->size == param || (from->kind == EO_MEM && from->size == 0))) {
+    uint8_t opcode[] = {0x0f, 0x6e};
+    emitByte(out, 0x66);
+    return emitModRM(out, references, param, opcode, 2, to->reg, false, from,
+                     0);
+  } else if (from->kind == EO_REG && from->xmm && isGpRm(to) &&
+             (to->size == param || (to->kind == EO_MEM && to->size == 0))) {
+    uint8_t opcode[] = {0x0f, 0x7e};
+    emitByte(out, 0x66);
+    return emitModRM(out, references, param, opcode, 2, from->reg, false, to,
+                     0);
+  } else {
+    return -1;
+  }
+}
+
+static int encodeArith(ParsedInstruction const *p, uint8_t param,
+                       TStringBuilder *out, Vector *references) {
+  if (p->numOperands != 2) return -1;
+  EncodedOperand const *to = &p->operands[0];
+  EncodedOperand const *from = &p->operands[1];
+  bool forceRex = needsByteRex(to) || needsByteRex(from);
+  uint8_t base = (uint8_t)(param * 8);
+
+  if (isGpRm(to) && isGpReg(from)) {
+    size_t size = operandSize(to, from);
+    if (size == 0) return -1;
+    uint8_t opcode = (uint8_t)(base + (size == 1 ? 0 : 1));
+    return emitModRM(out, references, size, &opcode, 1, from->reg, forceRex,
+                     to, 0);
+  } else if (isGpReg(to) && isGpRm(from)) {
+    size_t size = operandSize(to, from);
+    if (size == 0) return -1;
+    uint8_t opcode = (uint8_t)(base + (size == 1 ? 2 : 3));
+    return emitModRM(out, references, size, &opcode, 1, to->reg, forceRex,
+                     from, 0);
+  } else if (isGpRm(to) && from->kind == EO_IMM) {
+    size_t size = to->size;
+    if (!isGpSize(size)) return -1;
+    uint8_t opcode;
+    size_t width;
+    if (size == 1) {
+      if (!immediateFits(from->imm, 1)) return -1;
+      opcode = 0x80;
+      width = 1;
+    } else if (immediateFits(from->imm, size) &&
+               fitsSignExtendedByte(from->imm, size)) {
+      opcode = 0x83;
+      width = 1;
+    } else {
+      if (size == 8 ? !fitsInt32((int64_t)from->imm)
+                    : !immediateFits(from->imm, size))
+        return -1;
+      opcode = 0x81;
+      width = size == 8 ? 4 : size;
+    }
+    if (emitModRM(out, references, size, &opcode, 1, param, forceRex, to,
+                  width) != 0)
+      return -1;
+    emitValue(out, from->imm, width);
+    return 0;
+  } else if (isGpRm(to) && from->kind == EO_SYMBOL) {
+    size_t size = to->size;
+    if (size != 8 && size != 4) return -1;
+    uint8_t opcode = 0x81;
+    if (emitModRM(out, references, size, &opcode, 1, param, false, to, 4) !=
+        0)
+      return -1;
+    emitReference(
+        out, references,
+        size == 8 ? X86_64_LINUX_RK_ABS32S : X86_64_LINUX_RK_ABS32, from, 0,
+        4);
+    return 0;
+  } else {
+    return -1;
+  }
+}
+
+static int encodeTest(ParsedInstruction const *p, uint8_t param,
+                      TStringBuilder *out, Vector *references) {
+  (void)param;
+  if (p->numOperands != 2) return -1;
+  EncodedOperand const *a = &p->operands[0];
+  EncodedOperand const *b = &p->operands[1];
+  bool forceRex = needsByteRex(a) || needsByteRex(b);
+  if (isGpRm(a) && isGpReg(b)) {
+    size_t size = operandSize(a, b);
+    if (size == 0) return -1;
+    uint8_t opcode = size == 1 ? 0x84 : 0x85;
+    return emitModRM(out, references, size, &opcode, 1, b->reg, forceRex, a,
+                     0);
+  } else if (isGpRm(a) && b->kind == EO_IMM) {
+    size_t size = a->size;
+    if (!isGpSize(size)) return -1;
+    size_t width = size == 8 ? 4 : size;
+    if (size == 8 ? !fitsInt32((int64_t)b->imm) : !immediateFits(b->imm, size))
+      return -1;
+    uint8_t opcode = size == 1 ? 0xf6 : 0xf7;
+    if (emitModRM(out, references, size, &opcode, 1, 0, forceRex, a, width) !=
+        0)
+      return -1;
+    emitValue(out, b->imm, width);
+    return 0;
+  } else {
+    return -1;
+  }
+}
+
+static int encodeLea(ParsedInstruction const *p, uint8_t param,
+                     TStringBuilder *out, Vector *references) {
+  (void)param;
+  if (p->numOperands != 2) return -1;
+  EncodedOperand const *to = &p->operands[0];
+  EncodedOperand from = p->operands[1];
+  if (!isGpReg(to) || to->size == 1) return -1;
+  if (from.kind == EO_SYMBOL)
+    from.kind = EO_MEM;  // a bare symbol is its own address
+  else if (from.kind != EO_MEM)
+    return -1;
+  uint8_t opcode = 0x8d;
+  return emitModRM(out, references, to->size, &opcode, 1, to->reg, false,
+                   &from, 0);
+}
+
+/**
+ * encode a one-operand instruction in the f6/f7 group, where param is the
+ * opcode extension (not, neg, mul, imul, div, idiv)
+ */
+static int encodeUnary(ParsedInstruction const *p, uint8_t param,
+                       TStringBuilder *out, Vector *references) {
+  if (p->numOperands != 1) return -1;
+  EncodedOperand const *o = &p->operands[0];
+  if (!isGpRm(o) || !isGpSize(o->size)) return -1;
+  uint8_t opcode = o->size == 1 ? 0xf6 : 0xf7;
+  return emitModRM(out, references, o->size, &opcode, 1, param,
+                   needsByteRex(o), o, 0);
+}
+
+static int encodeImul(ParsedInstruction const *p, uint8_t param,
+                      TStringBuilder *out, Vector *references) {
+  (void)param;
+  if (p->numOperands == 1) return encodeUnary(p, 5, out, references);
+  if (p->numOperands != 2) return -1;
+  EncodedOperand const *to = &p->operands[0];
+  EncodedOperand const *from = &p->operands[1];
+  if (!isGpReg(to) || !isGpRm(from)) return -1;
+  size_t size = operandSize(to, from);
+  if (size == 0 || size == 1) return -1;
+  uint8_t const opcode[] = {0x0f, 0xaf};
+  return emitModRM(out, references, size, opcode, 2, to->reg, false, from, 0);
+}
+
+/**
+ * encode a shift, where param is the opcode extension (shl, shr, sar)
+ */
+static int encodeShift(ParsedInstruction const *p, uint8_t param,
+                       TStringBuilder *out, Vector *references) {
+  if (p->numOperands != 2) return -1;
+  EncodedOperand const *to = &p->operands[0];
+  EncodedOperand const *amount = &p->operands[1];
+  if (!isGpRm(to) || !isGpSize(to->size)) return -1;
+  bool byte = to->size == 1;
+  if (isGpReg(amount) && amount->reg == RCX_NUMBER && amount->size == 1) {
+    uint8_t opcode = byte ? 0xd2 : 0xd3;
+    return emitModRM(out, references, to->size, &opcode, 1, param,
+                     needsByteRex(to), to, 0);
+  } else if (amount->kind == EO_IMM && amount->imm < 64) {
+    uint8_t opcode = byte ? 0xc0 : 0xc1;
+    if (emitModRM(out, references, to->size, &opcode, 1, param,
+                  needsByteRex(to), to, 1) != 0)
+      return -1;
+    emitValue(out, amount->imm, 1);
+    return 0;
+  } else {
+    return -1;
+  }
+}
+
+/**
+ * encode a zero or sign extending move, where param is the byte source opcode
+ */
+static int encodeExtend(ParsedInstruction const *p, uint8_t param,
+                        TStringBuilder *out, Vector *references) {
+  if (p->numOperands != 2) return -1;
+  EncodedOperand const *to = &p->operands[0];
+  EncodedOperand const *from = &p->operands[1];
+  if (!isGpReg(to) || !isGpRm(from) || to->size <= from->size) return -1;
+  bool forceRex = needsByteRex(from);
+  if (from->size == 4) {
+    // movsxd
+    if (param != 0xbe || to->size != 8) return -1;
+    uint8_t opcode = 0x63;
+    return emitModRM(out, references, 8, &opcode, 1, to->reg, false, from, 0);
+  } else if (from->size == 1 || from->size == 2) {
+    uint8_t const opcode[] = {0x0f, (uint8_t)(param + (from->size - 1))};
+    return emitModRM(out, references, to->size, opcode, 2, to->reg, forceRex,
+                     from, 0);
+  } else {
+    return -1;
+  }
+}
+
+/**
+ * encode a push or pop, where param is the register opcode base
+ */
+static int encodeStack(ParsedInstruction const *p, uint8_t param,
+                       TStringBuilder *out, Vector *references) {
+  (void)references;
+  if (p->numOperands != 1) return -1;
+  EncodedOperand const *o = &p->operands[0];
+  if (!isGpReg(o) || o->size != 8) return -1;
+  if (o->reg >= 8) emitByte(out, 0x41);
+  emitByte(out, (uint8_t)(param + (o->reg & 7)));
+  return 0;
+}
+
+/**
+ * encode a call or a jump, where param is the indirect opcode extension
+ */
+static int encodeBranch(ParsedInstruction const *p, uint8_t param,
+                        TStringBuilder *out, Vector *references) {
+  if (p->numOperands != 1) return -1;
+  EncodedOperand const *target = &p->operands[0];
+  if (target->kind == EO_SYMBOL) {
+    emitByte(out, param == 2 ? 0xe8 : 0xe9);
+    emitReference(out, references, X86_64_LINUX_RK_PLT32, target, -4, 4);
+    return 0;
+  } else if (isGpRm(target) && (target->size == 8 || target->size == 0)) {
+    // near branches are always 64 bits - no REX.W needed
+    uint8_t opcode = 0xff;
+    return emitModRM(out, references, 4, &opcode, 1, param, false, target, 0);
+  } else {
+    return -1;
+  }
+}
+
+/** encode a conditional jump, where param is the condition code */
+static int encodeJcc(ParsedInstruction const *p, uint8_t param,
+                     TStringBuilder *out, Vector *references) {
+  if (p->numOperands != 1 || p->operands[0].kind != EO_SYMBOL) return -1;
+  emitByte(out, 0x0f);
+  emitByte(out, (uint8_t)(0x80 + param));
+  emitReference(out, references, X86_64_LINUX_RK_PC32, &p->operands[0], -4, 4);
+  return 0;
+}
+
+/** encode a setcc, where param is the condition code */
+static int encodeSetcc(ParsedInstruction const *p, uint8_t param,
+                       TStringBuilder *out, Vector *references) {
+  if (p->numOperands != 1) return -1;
+  EncodedOperand const *o = &p->operands[0];
+  if (!isGpRm(o) || o->size != 1) return -1;
+  uint8_t const opcode[] = {0x0f, (uint8_t)(0x90 + param)};
+  return emitModRM(out, references, 4, opcode, 2, 0, needsByteRex(o), o, 0);
+}
+
+/** encode a cmovcc, where param is the condition code */
+static int encodeCmovcc(ParsedInstruction const *p, uint8_t param,
+                        TStringBuilder *out, Vector *references) {
+  if (p->numOperands != 2) return -1;
+  EncodedOperand const *to = &p->operands[0];
+  EncodedOperand const *from = &p->operands[1];
+  if (!isGpReg(to) || !isGpRm(from)) return -1;
+  size_t size = operandSize(to, from);
+  if (size == 0 || size == 1) return -1;
+  uint8_t const opcode[] = {0x0f, (uint8_t)(0x40 + param)};
+  return emitModRM(out, references, size, opcode, 2, to->reg, false, from, 0);
+}
+
+/** the instructions the encoder knows */
+static struct {
+  char const *mnemonic;
+  Encoder encode;
+  uint8_t param;
+} const MNEMONICS[] = {
+    {"mov", encodeMov, 0},         {"add", encodeArith, 0},
+    {"or", encodeArith, 1},        {"adc", encodeArith, 2},
+    {"sbb", encodeArith, 3},       {"and", encodeArith, 4},
+    {"sub", encodeArith, 5},       {"xor", encodeArith, 6},
+    {"cmp", encodeArith, 7},       {"test", encodeTest, 0},
+    {"lea", encodeLea, 0},         {"not", encodeUnary, 2},
+    {"neg", encodeUnary, 3},       {"mul", encodeUnary, 4},
+    {"div", encodeUnary, 6},       {"idiv", encodeUnary, 7},
+    {"imul", encodeImul, 0},       {"shl", encodeShift, 4},
+    {"sal", encodeShift, 4},       {"shr", encodeShift, 5},
+    {"sar", encodeShift, 7},       {"movzx", encodeExtend, 0xb6},
+    {"movsx", encodeExtend, 0xbe}, {"movsxd", encodeExtend, 0xbe},
+    {"push", encodeStack, 0x50},   {"pop", encodeStack, 0x58},
+    {"call", encodeBranch, 2},     {"jmp", encodeBranch, 4},
+    {"leave", encodeNullary, 0xc9}, {"ret", encodeNullary, 0xc3},
+    {"cdq", encodeNullary, 0x99},  {"cqo", encodeWideNullary, 0x99},
+    {"movsb", encodeStringMove, 1},
+    {"movsw", encodeStringMove, 2}, {"movsd", encodeStringMove, 4},
+    {"movsq", encodeStringMove, 8}, {"stosb", encodeStringStore, 1},
+    {"stosw", encodeStringStore, 2}, {"stosd", encodeStringStore, 4},
+    {"stosq", encodeStringStore, 8}, {"movdqu", encodeMovdqu, 0},
+    {"movq", encodeMovq, 8},       {"movd", encodeMovq, 4},
+    {"pxor", encodeSse, 0xef},
+    {"punpcklqdq", encodeSse, 0x6c},
+};
+static size_t const NUM_MNEMONICS = sizeof(MNEMONICS) / sizeof(MNEMONICS[0]);
+
+/** condition code suffixes for jcc, setcc, and cmovcc */
+static struct {
+  char const *suffix;
+  uint8_t code;
+} const CONDITIONS[] = {
+    {"o", 0},    {"no", 1},  {"b", 2},   {"c", 2},   {"nae", 2}, {"ae", 3},
+    {"nb", 3},   {"nc", 3},  {"e", 4},   {"z", 4},   {"ne", 5},  {"nz", 5},
+    {"be", 6},   {"na", 6},  {"a", 7},   {"nbe", 7}, {"s", 8},   {"ns", 9},
+    {"p", 10},   {"pe", 10}, {"np", 11}, {"po", 11}, {"l", 12},  {"nge", 12},
+    {"ge", 13},  {"nl", 13}, {"le", 14}, {"ng", 14}, {"g", 15},  {"nle", 15},
+};
+static size_t const NUM_CONDITIONS = sizeof(CONDITIONS) / sizeof(CONDITIONS[0]);
+
+/**
+ * find the condition code named by the end of a mnemonic
+ *
+ * @returns whether the mnemonic was prefix followed by a condition
+ */
+static bool conditionMnemonic(char const *mnemonic, size_t length,
+                              char const *prefix, uint8_t *code) {
+  size_t prefixLength = strlen(prefix);
+  if (length <= prefixLength || strncmp(mnemonic, prefix, prefixLength) != 0)
+    return false;
+  for (size_t idx = 0; idx < NUM_CONDITIONS; ++idx) {
+    if (wordIs(mnemonic + prefixLength, length - prefixLength,
+               CONDITIONS[idx].suffix)) {
+      *code = CONDITIONS[idx].code;
+      return true;
+    }
+  }
+  return false;
+}
+
+int x86_64LinuxEncodeInstruction(X86_64LinuxInstruction const *i,
+                                 TStringBuilder *out, Vector *references) {
+  char const *mnemonic;
+  size_t length;
+  ParsedInstruction p;
+  if (i->skeleton[0] == '\0') return 0;  // empty instruction
+  if (parseInstruction(i, &mnemonic, &length, &p) != 0) return -1;
+
+  Encoder encode = NULL;
+  uint8_t param = 0;
+  for (size_t idx = 0; idx < NUM_MNEMONICS; ++idx) {
+    if (wordIs(mnemonic, length, MNEMONICS[idx].mnemonic)) {
+      encode = MNEMONICS[idx].encode;
+      param = MNEMONICS[idx].param;
+      break;
+    }
+  }
+  if (encode == NULL) {
+    if (conditionMnemonic(mnemonic, length, "j", &param))
+      encode = encodeJcc;
+    else if (conditionMnemonic(mnemonic, length, "set", &param))
+      encode = encodeSetcc;
+    else if (conditionMnemonic(mnemonic, length, "cmov", &param))
+      encode = encodeCmovcc;
+    else
+      return -1;
+  }
+  if (p.rep && encode != encodeStringMove && encode != encodeStringStore)
+    return -1;
+
+  // undo any partial encoding if the instruction turns out to be invalid
+  size_t oldSize = out->size;
+  size_t oldReferences = references->size;
+  if (encode(&p, param, out, references) != 0) {
+    out->size = oldSize;
+    for (size_t idx = oldReferences; idx < references->size; ++idx)
+      x86_64LinuxReferenceFree(references->elements[idx]);
+    references->size = oldReferences;
+    return -1;
+  }
+  return 0;
+}
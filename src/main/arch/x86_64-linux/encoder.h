@@ -0,0 +1,71 @@
+// Copyright 2021 Justin Hu
+//
+// This file is part of the T Language Compiler.
+//
+// The T Language Compiler is free software: you can redistribute it and/or
+// modify it under the terms of the GNU General Public License as published by
+// the Free Software Foundation, either version 3 of the License, or (at your
+// option) any later version.
+//
+// The T Language Compiler is distributed in the hope that it will be useful,
+// but WITHOUT ANY WARRANTY; without even the implied warranty of
+// MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the GNU General
+// Public License for more details.
+//
+// You should have received a copy of the GNU General Public License along with
+// the T Language Compiler. If not see <https://www.gnu.org/licenses/>.
+//
+// SPDX-License-Identifier: GPL-3.0-or-later
+
+/**
+ * @file
+ * Machine code encoding for x86_64 linux
+ */
+
+#ifndef TLC_ARCH_X86_64_LINUX_ENCODER_H_
+#define TLC_ARCH_X86_64_LINUX_ENCODER_H_
+
+#include <stdint.h>
+
+#include "arch/x86_64-linux/asm.h"
+#include "util/container/stringBuilder.h"
+#include "util/container/vector.h"
+
+/** the kinds of fields that refer to a symbol */
+typedef enum {
+  X86_64_LINUX_RK_ABS64,  /**< 64 bit absolute address */
+  X86_64_LINUX_RK_ABS32,  /**< 32 bit zero-extended absolute address */
+  X86_64_LINUX_RK_ABS32S, /**< 32 bit sign-extended absolute address */
+  X86_64_LINUX_RK_PC32,   /**< 32 bit pc-relative address */
+  X86_64_LINUX_RK_PLT32,  /**< 32 bit pc-relative call or jump target */
+} X86_64LinuxReferenceKind;
+/** a field in encoded bytes that holds the address of a symbol */
+typedef struct {
+  X86_64LinuxReferenceKind kind;
+  size_t offset; /**< where the field is in the output */
+  char *symbol;
+  int64_t addend;
+} X86_64LinuxReference;
+/** dtor */
+void x86_64LinuxReferenceFree(X86_64LinuxReference *r);
+
+/**
+ * encode an instruction as machine code
+ *
+ * The instruction is parsed from its skeleton, with the placeholders filled
+ * in from its operands, so the object file gets exactly what the assembly
+ * output would say. Jumps and calls always use 32 bit displacements, so an
+ * instruction's size doesn't depend on where its target ends up. Empty
+ * instructions encode to nothing.
+ *
+ * @param i instruction to encode - must not be a label, and must have all of
+ *          its temps allocated
+ * @param out builder to append the encoded bytes to
+ * @param references vector of X86_64LinuxReference to add symbol references
+ *                   to, with offsets into out
+ * @returns status code (0 = OK, -1 = instruction can't be encoded)
+ */
+int x86_64LinuxEncodeInstruction(X86_64LinuxInstruction const *i,
+                                 TStringBuilder *out, Vector *references);
+
+#endif  // TLC_ARCH_X86_64_LINUX_ENCODER_H_
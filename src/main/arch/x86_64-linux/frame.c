@@ -0,0 +1,376 @@
+// Copyright 2021 Justin Hu
+//
+// This file is part of the T Language Compiler.
+//
+// The T Language Compiler is free software: you can redistribute it and/or
+// modify it under the terms of the GNU General Public License as published by
+// the Free Software Foundation, either version 3 of the License, or (at your
+// option) any later version.
+//
+// The T Language Compiler is distributed in the hope that it will be useful,
+// but WITHOUT ANY WARRANTY; without even the implied warranty of
+// MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the GNU General
+// Public License for more details.
+//
+// You should have received a copy of the GNU General Public License along with
+// the T Language Compiler. If not see <https://www.gnu.org/licenses/>.
+//
+// SPDX-License-Identifier: GPL-3.0-or-later
+
+#include "arch/x86_64-linux/frame.h"
+
+#include <stdlib.h>
+#include <string.h>
+
+#include "arch/x86_64-linux/asm.h"
+#include "fileList.h"
+#include "util/format.h"
+#include "util/numericSizing.h"
+
+/**
+ * bytes below the stack pointer that a function may use without moving it,
+ * as long as it calls nothing
+ */
+static size_t const RED_ZONE_SIZE = 128;
+
+static bool isMemTemp(X86_64LinuxOperand const *o) {
+  return o->kind == X86_64_LINUX_OK_TEMP && o->data.temp.kind == AH_MEM;
+}
+
+/**
+ * get the mem temp whose slot an operand refers to
+ *
+ * @returns whether the operand refers to a slot
+ */
+static bool slotReference(X86_64LinuxOperand const *o, size_t *name,
+                          size_t *size, size_t *alignment) {
+  if (isMemTemp(o)) {
+    *name = o->data.temp.name;
+    *size = o->data.temp.size;
+    *alignment = o->data.temp.alignment;
+    return true;
+  } else if (o->kind == X86_64_LINUX_OK_PART) {
+    *name = o->data.part.name;
+    *size = o->data.part.size;
+    *alignment = o->data.part.alignment;
+    return true;
+  } else {
+    return false;
+  }
+}
+
+/**
+ * a mem temp's lifetime, in instruction indices
+ */
+typedef struct {
+  size_t name;
+  size_t size;
+  size_t alignment;
+  size_t start;
+  size_t end;
+} SlotInterval;
+
+static int slotIntervalCompare(void const *a, void const *b) {
+  SlotInterval const *lhs = a;
+  SlotInterval const *rhs = b;
+  if (lhs->start != rhs->start) return lhs->start < rhs->start ? -1 : 1;
+  if (lhs->name != rhs->name) return lhs->name < rhs->name ? -1 : 1;
+  return 0;
+}
+
+/** the instructions a loop, or several overlapping loops, span */
+typedef struct {
+  size_t start;
+  size_t end;
+} LoopRegion;
+
+static int loopRegionCompare(void const *a, void const *b) {
+  LoopRegion const *lhs = a;
+  LoopRegion const *rhs = b;
+  if (lhs->start != rhs->start) return lhs->start < rhs->start ? -1 : 1;
+  return 0;
+}
+
+/**
+ * find the disjoint regions covered by the loops of a fragment, merging loops
+ * that overlap
+ *
+ * @returns regions, sorted by start
+ */
+static LoopRegion *findLoopRegions(ListNode **nodes, size_t n,
+                                   size_t const *labelIndices,
+                                   size_t *numRegions) {
+  LoopRegion *regions = NULL;
+  size_t count = 0;
+  for (size_t idx = 0; idx < n; ++idx) {
+    X86_64LinuxInstruction *i = nodes[idx]->data;
+    if (i->kind != X86_64_LINUX_IK_JUMP &&
+        i->kind != X86_64_LINUX_IK_JUMPTABLE &&
+        i->kind != X86_64_LINUX_IK_CJUMP)
+      continue;
+    for (size_t targetIdx = 0; targetIdx < i->data.jumpTargets.size;
+         ++targetIdx) {
+      size_t head = labelIndices[i->data.jumpTargets.elements[targetIdx]];
+      if (head == SIZE_MAX || head > idx) continue;
+      regions = realloc(regions, ++count * sizeof(LoopRegion));
+      regions[count - 1] = (LoopRegion){head, idx};
+    }
+  }
+  if (count == 0) {
+    *numRegions = 0;
+    return regions;
+  }
+
+  qsort(regions, count, sizeof(LoopRegion), loopRegionCompare);
+  size_t merged = 0;
+  for (size_t idx = 1; idx < count; ++idx) {
+    if (regions[idx].start <= regions[merged].end) {
+      if (regions[idx].end > regions[merged].end)
+        regions[merged].end = regions[idx].end;
+    } else {
+      regions[++merged] = regions[idx];
+    }
+  }
+  *numRegions = merged + 1;
+  return regions;
+}
+
+/**
+ * build the lifetimes of the mem temps of a fragment
+ *
+ * lifetimes run from the first to the last reference, and are stretched to
+ * cover any loop they overlap; a temp whose address is taken may be accessed
+ * through a pointer anywhere, so it lives for the whole function
+ *
+ * @returns intervals, sorted by start
+ */
+static SlotInterval *buildSlotIntervals(ListNode **nodes, size_t n,
+                                        size_t *numIntervals,
+                                        FileListEntry *file) {
+  size_t *intervalIndices = malloc(file->nextId * sizeof(size_t));
+  size_t *labelIndices = malloc(file->nextId * sizeof(size_t));
+  for (size_t idx = 0; idx < file->nextId; ++idx)
+    intervalIndices[idx] = labelIndices[idx] = SIZE_MAX;
+
+  SlotInterval *intervals = NULL;
+  size_t count = 0;
+  bool *escapes = NULL;
+  for (size_t idx = 0; idx < n; ++idx) {
+    X86_64LinuxInstruction *i = nodes[idx]->data;
+    if (i->kind == X86_64_LINUX_IK_LABEL) labelIndices[i->data.labelName] = idx;
+    Vector *operands[] = {&i->defines, &i->uses, &i->other};
+    for (size_t vecIdx = 0; vecIdx < 3; ++vecIdx) {
+      for (size_t opIdx = 0; opIdx < operands[vecIdx]->size; ++opIdx) {
+        X86_64LinuxOperand *o = operands[vecIdx]->elements[opIdx];
+        size_t name;
+        size_t size;
+        size_t alignment;
+        if (!slotReference(o, &name, &size, &alignment)) continue;
+        if (intervalIndices[name] == SIZE_MAX) {
+          intervalIndices[name] = count++;
+          intervals = realloc(intervals, count * sizeof(SlotInterval));
+          escapes = realloc(escapes, count * sizeof(bool));
+          intervals[count - 1] =
+              (SlotInterval){name, size, alignment, idx, idx};
+          escapes[count - 1] = false;
+        }
+        SlotInterval *interval = &intervals[intervalIndices[name]];
+        if (size > interval->size) interval->size = size;
+        if (alignment > interval->alignment) interval->alignment = alignment;
+        interval->end = idx;
+        if (isMemTemp(o) && o->data.temp.escapes)
+          escapes[intervalIndices[name]] = true;
+      }
+    }
+  }
+
+  // stretch intervals over the loop regions they overlap; regions are
+  // disjoint, so one pass is enough
+  size_t numRegions;
+  LoopRegion *regions = findLoopRegions(nodes, n, labelIndices, &numRegions);
+  for (size_t intervalIdx = 0; intervalIdx < count; ++intervalIdx) {
+    SlotInterval *interval = &intervals[intervalIdx];
+    // find the first region ending at or after the interval's start
+    size_t low = 0;
+    size_t high = numRegions;
+    while (low < high) {
+      size_t mid = low + (high - low) / 2;
+      if (regions[mid].end < interval->start)
+        low = mid + 1;
+      else
+        high = mid;
+    }
+    for (; low < numRegions && regions[low].start <= interval->end; ++low) {
+      if (interval->start > regions[low].start)
+        interval->start = regions[low].start;
+      if (interval->end < regions[low].end) interval->end = regions[low].end;
+    }
+  }
+  free(regions);
+
+  for (size_t idx = 0; idx < count; ++idx) {
+    if (escapes[idx]) {
+      intervals[idx].start = 0;
+      intervals[idx].end = n;
+    }
+  }
+
+  free(intervalIndices);
+  free(labelIndices);
+  free(escapes);
+  if (count != 0)
+    qsort(intervals, count, sizeof(SlotInterval), slotIntervalCompare);
+  *numIntervals = count;
+  return intervals;
+}
+
+/**
+ * a stack slot, possibly shared by several mem temps in turn
+ */
+typedef struct {
+  int64_t offset;
+  size_t size;
+  size_t end; /**< last instruction the current occupant is live at */
+} Slot;
+
+/**
+ * lay out the frame of a text fragment
+ *
+ * mem temps - both those from the program and spilled temps - share slots
+ * when their lifetimes don't overlap; each temp takes the smallest free slot
+ * it fits in, or a new slot below the others if none is free
+ *
+ * a leaf function whose slots fit in the red zone gets no frame at all, and
+ * addresses its slots relative to rsp; they are at the same addresses they
+ * would have been at with a frame, so alignment is unchanged. A tail call only
+ * allows this if there are no slots at all, since the callee may use the red
+ * zone too
+ */
+static void layoutFrame(X86_64LinuxFrag *frag, FileListEntry *file) {
+  LinkedList *instructions = &frag->data.text.instructions;
+
+  size_t n = 0;
+  bool calls = false;
+  bool tailCalls = false;
+  for (ListNode *curr = instructions->head->next; curr != instructions->tail;
+       curr = curr->next) {
+    X86_64LinuxInstruction const *i = curr->data;
+    if (i->kind == X86_64_LINUX_IK_CALL) calls = true;
+    if (i->kind == X86_64_LINUX_IK_TAIL_CALL) tailCalls = true;
+    ++n;
+  }
+  ListNode **nodes = malloc(n * sizeof(ListNode *));
+  n = 0;
+  for (ListNode *curr = instructions->head->next; curr != instructions->tail;
+       curr = curr->next)
+    nodes[n++] = curr;
+
+  size_t numIntervals;
+  SlotInterval *intervals = buildSlotIntervals(nodes, n, &numIntervals, file);
+  free(nodes);
+
+  int64_t *offsets = malloc(file->nextId * sizeof(int64_t));
+  Slot *slots = malloc(numIntervals * sizeof(Slot));
+  size_t numSlots = 0;
+  size_t frameSize = 0;
+  for (size_t intervalIdx = 0; intervalIdx < numIntervals; ++intervalIdx) {
+    SlotInterval const *interval = &intervals[intervalIdx];
+    Slot *best = NULL;
+    for (size_t slotIdx = 0; slotIdx < numSlots; ++slotIdx) {
+      Slot *slot = &slots[slotIdx];
+      if (slot->end < interval->start && slot->size >= interval->size &&
+          (uint64_t)-slot->offset % interval->alignment == 0 &&
+          (best == NULL || slot->size < best->size))
+        best = slot;
+    }
+    if (best == NULL) {
+      frameSize = incrementToMultiple(frameSize + interval->size,
+                                      interval->alignment);
+      best = &slots[numSlots++];
+      best->offset = -(int64_t)frameSize;
+      best->size = interval->size;
+    }
+    best->end = interval->end;
+    offsets[interval->name] = best->offset;
+  }
+  free(slots);
+  free(intervals);
+
+  // without a frame, rsp is still where the return address was pushed, just
+  // above where rbp would have been saved
+  bool fitsRedZone = frameSize <= RED_ZONE_SIZE - X86_64_LINUX_REGISTER_WIDTH;
+  bool frameless = !calls && (frameSize == 0 || (!tailCalls && fitsRedZone));
+  X86_64LinuxRegister base = frameless ? X86_64_LINUX_RSP : X86_64_LINUX_RBP;
+  int64_t bias = frameless ? -(int64_t)X86_64_LINUX_REGISTER_WIDTH : 0;
+  for (ListNode *curr = instructions->head->next; curr != instructions->tail;
+       curr = curr->next) {
+    X86_64LinuxInstruction *i = curr->data;
+    Vector *operands[] = {&i->defines, &i->uses, &i->other};
+    for (size_t vecIdx = 0; vecIdx < 3; ++vecIdx) {
+      for (size_t opIdx = 0; opIdx < operands[vecIdx]->size; ++opIdx) {
+        X86_64LinuxOperand *o = operands[vecIdx]->elements[opIdx];
+        if (isMemTemp(o)) {
+          size_t size = o->data.temp.size;
+          int64_t offset = offsets[o->data.temp.name] + bias;
+          o->kind = X86_64_LINUX_OK_STACK;
+          o->data.stack.base = base;
+          o->data.stack.offset = offset;
+          o->data.stack.size = size;
+        } else if (o->kind == X86_64_LINUX_OK_PART) {
+          int64_t offset =
+              offsets[o->data.part.name] + o->data.part.offset + bias;
+          size_t size = o->data.part.partSize;
+          if (o->data.part.offsetOnly) {
+            o->kind = X86_64_LINUX_OK_OFFSET;
+            o->data.offset.offset = offset;
+          } else {
+            o->kind = X86_64_LINUX_OK_STACK;
+            o->data.stack.base = base;
+            o->data.stack.offset = offset;
+            o->data.stack.size = size;
+          }
+        } else if (o->kind == X86_64_LINUX_OK_OFFSET) {
+          // offset of an incoming stack argument from the frame base
+          o->data.offset.offset += bias;
+        } else if (o->kind == X86_64_LINUX_OK_REG && vecIdx == 2 &&
+                   o->data.reg.reg == X86_64_LINUX_RBP) {
+          // frame base of an indexed frame address
+          o->data.reg.reg = base;
+        }
+      }
+    }
+  }
+  free(offsets);
+  if (frameless) return;
+  frameSize = incrementToMultiple(frameSize, X86_64_LINUX_STACK_ALIGNMENT);
+
+  // prologue and epilogue
+  ListNode *first = instructions->head->next;
+  insertNodeBefore(first, x86_64LinuxInstructionCreate(
+                              X86_64_LINUX_IK_REGULAR, strdup("\tpush rbp\n")));
+  insertNodeBefore(first,
+                   x86_64LinuxInstructionCreate(X86_64_LINUX_IK_REGULAR,
+                                                strdup("\tmov rbp, rsp\n")));
+  if (frameSize != 0)
+    insertNodeBefore(first, x86_64LinuxInstructionCreate(
+                                X86_64_LINUX_IK_REGULAR,
+                                format("\tsub rsp, %zu\n", frameSize)));
+  for (ListNode *curr = first; curr != instructions->tail; curr = curr->next) {
+    X86_64LinuxInstruction *i = curr->data;
+    if (i->kind == X86_64_LINUX_IK_LEAVE ||
+        i->kind == X86_64_LINUX_IK_TAIL_CALL)
+      insertNodeBefore(curr, x86_64LinuxInstructionCreate(
+                                 X86_64_LINUX_IK_REGULAR, strdup("\tleave\n")));
+  }
+}
+
+void x86_64LinuxLayoutFrames(void) {
+  for (size_t fileIdx = 0; fileIdx < fileList.size; ++fileIdx) {
+    FileListEntry *file = &fileList.entries[fileIdx];
+    X86_64LinuxFile *asmFile = file->asmFile;
+    for (size_t fragIdx = 0; fragIdx < asmFile->frags.size; ++fragIdx) {
+      X86_64LinuxFrag *frag = asmFile->frags.elements[fragIdx];
+      if (frag->kind == X86_64_LINUX_FK_TEXT) layoutFrame(frag, file);
+    }
+  }
+}
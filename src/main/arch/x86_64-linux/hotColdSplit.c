@@ -0,0 +1,89 @@
+// Copyright 2021 Justin Hu
+//
+// This file is part of the T Language Compiler.
+//
+// The T Language Compiler is free software: you can redistribute it and/or
+// modify it under the terms of the GNU General Public License as published by
+// the Free Software Foundation, either version 3 of the License, or (at your
+// option) any later version.
+//
+// The T Language Compiler is distributed in the hope that it will be useful,
+// but WITHOUT ANY WARRANTY; without even the implied warranty of
+// MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the GNU General
+// Public License for more details.
+//
+// You should have received a copy of the GNU General Public License along with
+// the T Language Compiler. If not see <https://www.gnu.org/licenses/>.
+//
+// SPDX-License-Identifier: GPL-3.0-or-later
+
+#include "arch/x86_64-linux/hotColdSplit.h"
+
+#include <string.h>
+
+#include "arch/x86_64-linux/asm.h"
+#include "fileList.h"
+#include "util/format.h"
+#include "util/functional.h"
+
+/**
+ * move a function's code from its cold label on into a new fragment
+ *
+ * @returns fragment with the cold code, or NULL if there isn't any
+ */
+static X86_64LinuxFrag *splitFrag(X86_64LinuxFrag *frag) {
+  LinkedList *instructions = &frag->data.text.instructions;
+  size_t coldLabel = frag->data.text.coldLabel;
+  if (coldLabel == 0) return NULL;
+
+  ListNode *start = instructions->head->next;
+  for (; start != instructions->tail; start = start->next) {
+    X86_64LinuxInstruction const *i = start->data;
+    if (i->kind == X86_64_LINUX_IK_LABEL && i->data.labelName == coldLabel)
+      break;
+  }
+  if (start == instructions->tail) return NULL;
+
+  // the hot code might have fallen through into the cold code
+  X86_64LinuxInstruction const *last = start->prev->data;
+  if (start->prev == instructions->head ||
+      (last->kind != X86_64_LINUX_IK_JUMP &&
+       last->kind != X86_64_LINUX_IK_JUMPTABLE &&
+       last->kind != X86_64_LINUX_IK_LEAVE &&
+       last->kind != X86_64_LINUX_IK_TAIL_CALL)) {
+    X86_64LinuxInstruction *jump = x86_64LinuxInstructionCreate(
+        X86_64_LINUX_IK_JUMP, format("\tjmp L%zu\n", coldLabel));
+    sizeVectorInsert(&jump->data.jumpTargets, coldLabel);
+    insertNodeBefore(start, jump);
+  }
+
+  X86_64LinuxFrag *cold = x86_64LinuxTextFragCreate(
+      strdup("section .text.unlikely progbits alloc exec nowrite align=16\n"),
+      strdup(""));
+  while (start != instructions->tail) {
+    ListNode *next = start->next;
+    insertNodeEnd(&cold->data.text.instructions, removeNode(start));
+    start = next;
+  }
+  frag->data.text.coldLabel = 0;
+  return cold;
+}
+
+void x86_64LinuxSplitColdCode(void) {
+  for (size_t fileIdx = 0; fileIdx < fileList.size; ++fileIdx) {
+    X86_64LinuxFile *asmFile = fileList.entries[fileIdx].asmFile;
+    Vector coldFrags;
+    vectorInit(&coldFrags);
+    for (size_t fragIdx = 0; fragIdx < asmFile->frags.size; ++fragIdx) {
+      X86_64LinuxFrag *frag = asmFile->frags.elements[fragIdx];
+      if (frag->kind != X86_64_LINUX_FK_TEXT) continue;
+      X86_64LinuxFrag *cold = splitFrag(frag);
+      if (cold != NULL) vectorInsert(&coldFrags, cold);
+    }
+
+    // keep the cold code together, after everything else
+    for (size_t idx = 0; idx < coldFrags.size; ++idx)
+      vectorInsert(&asmFile->frags, coldFrags.elements[idx]);
+    vectorUninit(&coldFrags, nullDtor);
+  }
+}
@@ -0,0 +1,312 @@
+// Copyright 2021 Justin Hu
+//
+// This file is part of the T Language Compiler.
+//
+// The T Language Compiler is free software: you can redistribute it and/or
+// modify it under the terms of the GNU General Public License as published by
+// the Free Software Foundation, either version 3 of the License, or (at your
+// option) any later version.
+//
+// The T Language Compiler is distributed in the hope that it will be useful,
+// but WITHOUT ANY WARRANTY; without even the implied warranty of
+// MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the GNU General
+// Public License for more details.
+//
+// You should have received a copy of the GNU General Public License along with
+// the T Language Compiler. If not see <https://www.gnu.org/licenses/>.
+//
+// SPDX-License-Identifier: GPL-3.0-or-later
+
+#include "arch/x86_64-linux/jit.h"
+
+#include <fcntl.h>
+#include <stdint.h>
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include <sys/mman.h>
+#include <unistd.h>
+
+#include "arch/x86_64-linux/encoder.h"
+#include "arch/x86_64-linux/objectWriter.h"
+#include "fileList.h"
+#include "util/container/hashMap.h"
+#include "util/format.h"
+#include "util/internalError.h"
+
+/**
+ * order sections are laid out in - code, read-only data, and writable data
+ * each get their own pages
+ */
+static X86_64LinuxSectionName const LAYOUT_ORDER[] = {
+    X86_64_LINUX_SECTION_TEXT,
+    X86_64_LINUX_SECTION_TEXT_UNLIKELY,
+    X86_64_LINUX_SECTION_RODATA,
+    X86_64_LINUX_SECTION_DATA,
+    X86_64_LINUX_SECTION_BSS,
+};
+
+/** a program loaded into memory */
+typedef struct {
+  X86_64LinuxObjectFile *objects;
+  FileListEntry **files; /**< file each object was assembled from */
+  size_t numObjects;
+  /** offset of each object's sections from the start of the image */
+  size_t (*offsets)[X86_64_LINUX_NUM_SECTIONS];
+  HashMap globals; /**< map from name to address of defined global symbols */
+  uint8_t *image;
+  size_t imageSize;
+  size_t codeSize;   /**< size of the executable pages */
+  size_t rodataSize; /**< size of the read-only pages after the code */
+} Program;
+
+static void programInit(Program *p) {
+  p->numObjects = 0;
+  for (size_t idx = 0; idx < fileList.size; ++idx)
+    if (fileList.entries[idx].isCode) ++p->numObjects;
+  p->objects = malloc(p->numObjects * sizeof(X86_64LinuxObjectFile));
+  p->files = malloc(p->numObjects * sizeof(FileListEntry *));
+  p->offsets = malloc(p->numObjects * sizeof(*p->offsets));
+  hashMapInit(&p->globals);
+  p->image = NULL;
+  p->imageSize = 0;
+  p->codeSize = 0;
+  p->rodataSize = 0;
+
+  size_t objectIdx = 0;
+  for (size_t idx = 0; idx < fileList.size; ++idx) {
+    if (!fileList.entries[idx].isCode) continue;
+    p->files[objectIdx] = &fileList.entries[idx];
+    x86_64LinuxObjectFileInit(&p->objects[objectIdx++]);
+  }
+}
+static void programUninit(Program *p) {
+  if (p->image != NULL) munmap(p->image, p->imageSize);
+  hashMapUninit(&p->globals, free);
+  for (size_t idx = 0; idx < p->numObjects; ++idx)
+    x86_64LinuxObjectFileUninit(&p->objects[idx]);
+  free(p->offsets);
+  free(p->files);
+  free(p->objects);
+}
+
+static size_t alignUp(size_t n, size_t alignment) {
+  return (n + alignment - 1) / alignment * alignment;
+}
+static size_t sectionSize(X86_64LinuxObjectFile const *o,
+                          X86_64LinuxSectionName name) {
+  return name == X86_64_LINUX_SECTION_BSS ? o->sections[name].bssSize
+                                          : o->sections[name].contents.size;
+}
+
+/**
+ * decide where each section goes, and map enough zeroed memory for them
+ *
+ * @returns status code (0 = OK)
+ */
+static int layOut(Program *p) {
+  size_t pageSize = (size_t)sysconf(_SC_PAGESIZE);
+  size_t numSections = sizeof(LAYOUT_ORDER) / sizeof(LAYOUT_ORDER[0]);
+  size_t size = 0;
+  for (size_t orderIdx = 0; orderIdx < numSections; ++orderIdx) {
+    X86_64LinuxSectionName section = LAYOUT_ORDER[orderIdx];
+    if (section == X86_64_LINUX_SECTION_RODATA) {
+      size = alignUp(size, pageSize);
+      p->codeSize = size;
+    } else if (section == X86_64_LINUX_SECTION_DATA) {
+      size = alignUp(size, pageSize);
+      p->rodataSize = size - p->codeSize;
+    }
+
+    for (size_t idx = 0; idx < p->numObjects; ++idx) {
+      X86_64LinuxObjectFile const *o = &p->objects[idx];
+      size = alignUp(size, o->sections[section].alignment);
+      p->offsets[idx][section] = size;
+      size += sectionSize(o, section);
+    }
+  }
+  p->imageSize = size == 0 ? pageSize : alignUp(size, pageSize);
+
+  // /dev/zero gives zeroed memory using only POSIX mmap flags
+  int fd = open("/dev/zero", O_RDWR);
+  if (fd == -1) return -1;
+  void *image =
+      mmap(NULL, p->imageSize, PROT_READ | PROT_WRITE, MAP_PRIVATE, fd, 0);
+  close(fd);
+  if (image == MAP_FAILED) return -1;
+  p->image = image;
+  return 0;
+}
+
+/**
+ * copy section contents into the image and record every global's address
+ */
+static void load(Program *p) {
+  for (size_t idx = 0; idx < p->numObjects; ++idx) {
+    X86_64LinuxObjectFile const *o = &p->objects[idx];
+    for (size_t section = 0; section < X86_64_LINUX_SECTION_BSS; ++section)
+      memcpy(p->image + p->offsets[idx][section],
+             o->sections[section].contents.string,
+             o->sections[section].contents.size);
+
+    for (size_t symbolIdx = 0; symbolIdx < o->symbolOrder.size;
+         ++symbolIdx) {
+      X86_64LinuxSymbol const *s = o->symbolOrder.elements[symbolIdx];
+      if (!s->defined || !s->global) continue;
+      uint64_t *address = malloc(sizeof(uint64_t));
+      *address = (uint64_t)(uintptr_t)(p->image + p->offsets[idx][s->section] +
+                                       s->offset);
+      if (hashMapPut(&p->globals, s->name, address) != 0) free(address);
+    }
+  }
+}
+
+/**
+ * find the address of a symbol referenced from an object
+ *
+ * @returns status code (0 = OK)
+ */
+static int symbolAddress(Program const *p, size_t objectIdx,
+                         char const *name, uint64_t *out) {
+  X86_64LinuxSymbol const *s =
+      hashMapGet(&p->objects[objectIdx].symbols, name);
+  if (s != NULL && s->defined) {
+    *out = (uint64_t)(uintptr_t)(p->image +
+                                 p->offsets[objectIdx][s->section] +
+                                 s->offset);
+    return 0;
+  }
+
+  uint64_t const *address = hashMapGet(&p->globals, name);
+  if (address == NULL) return -1;
+  *out = *address;
+  return 0;
+}
+
+/**
+ * patch every remaining reference now that all addresses are known
+ *
+ * @returns status code (0 = OK)
+ */
+static int relocate(Program *p) {
+  for (size_t idx = 0; idx < p->numObjects; ++idx) {
+    char const *filename = p->files[idx]->inputFilename;
+    for (size_t section = 0; section < X86_64_LINUX_SECTION_BSS; ++section) {
+      Vector const *references = &p->objects[idx].sections[section].references;
+      for (size_t refIdx = 0; refIdx < references->size; ++refIdx) {
+        X86_64LinuxReference const *r = references->elements[refIdx];
+        uint8_t *field = p->image + p->offsets[idx][section] + r->offset;
+
+        uint64_t target;
+        if (symbolAddress(p, idx, r->symbol, &target) != 0) {
+          fprintf(stderr, "%s: error: undefined reference to '%s'\n",
+                  filename, r->symbol);
+          return -1;
+        }
+        uint64_t value = target + (uint64_t)r->addend;
+        size_t width = 4;
+        bool fits;
+        switch (r->kind) {
+          case X86_64_LINUX_RK_ABS64: {
+            width = 8;
+            fits = true;
+            break;
+          }
+          case X86_64_LINUX_RK_ABS32: {
+            fits = value <= UINT32_MAX;
+            break;
+          }
+          case X86_64_LINUX_RK_ABS32S: {
+            fits = (int64_t)value >= INT32_MIN && (int64_t)value <= INT32_MAX;
+            break;
+          }
+          case X86_64_LINUX_RK_PC32:
+          case X86_64_LINUX_RK_PLT32: {
+            value -= (uint64_t)(uintptr_t)field;
+            fits = (int64_t)value >= INT32_MIN && (int64_t)value <= INT32_MAX;
+            break;
+          }
+          default: {
+            error(__FILE__, __LINE__, "invalid X86_64LinuxReferenceKind");
+          }
+        }
+        if (!fits) {
+          fprintf(stderr, "%s: error: reference to '%s' is out of range\n",
+                  filename, r->symbol);
+          return -1;
+        }
+
+        for (size_t byte = 0; byte < width; ++byte)
+          field[byte] = (uint8_t)(value >> (8 * byte));
+      }
+    }
+  }
+  return 0;
+}
+
+/**
+ * get the mangled name of a qualified function name
+ */
+static char *mangle(char const *qualified) {
+  char *mangled = strdup("_T");
+  while (true) {
+    char const *end = strstr(qualified, "::");
+    size_t length = end == NULL ? strlen(qualified) : (size_t)(end - qualified);
+    char *old = mangled;
+    mangled = format("%s%zu%.*s", old, length, (int)length, qualified);
+    free(old);
+    if (end == NULL) return mangled;
+    qualified = end + 2;
+  }
+}
+
+int x86_64LinuxRunJit(char const *entry, int *exitCode) {
+  Program p;
+  programInit(&p);
+
+  int retval = 0;
+  for (size_t idx = 0; idx < p.numObjects && retval == 0; ++idx)
+    retval = x86_64LinuxAssembleFile(&p.objects[idx], p.files[idx]);
+  if (retval != 0) {
+    programUninit(&p);
+    return -1;
+  }
+
+  if (layOut(&p) != 0) {
+    fprintf(stderr, "tlc: error: cannot allocate memory to run program\n");
+    programUninit(&p);
+    return -1;
+  }
+  load(&p);
+  if (relocate(&p) != 0) {
+    programUninit(&p);
+    return -1;
+  }
+  if (mprotect(p.image, p.codeSize, PROT_READ | PROT_EXEC) != 0 ||
+      (p.rodataSize != 0 &&
+       mprotect(p.image + p.codeSize, p.rodataSize, PROT_READ) != 0)) {
+    fprintf(stderr, "tlc: error: cannot protect memory to run program\n");
+    programUninit(&p);
+    return -1;
+  }
+
+  char *mangled = mangle(entry);
+  uint64_t const *address = hashMapGet(&p.globals, mangled);
+  free(mangled);
+  if (address == NULL || *address < (uint64_t)(uintptr_t)p.image ||
+      *address >= (uint64_t)(uintptr_t)(p.image + p.codeSize)) {
+    fprintf(stderr, "tlc: error: no function named '%s' to run\n", entry);
+    programUninit(&p);
+    return -1;
+  }
+
+  // ISO C has no conversion from object to function pointers
+  int (*function)(void);
+  void *functionAddress = (void *)(uintptr_t)*address;
+  memcpy(&function, &functionAddress, sizeof(function));
+  *exitCode = function();
+  fflush(stdout);
+
+  programUninit(&p);
+  return 0;
+}
@@ -0,0 +1,40 @@
+// Copyright 2021 Justin Hu
+//
+// This file is part of the T Language Compiler.
+//
+// The T Language Compiler is free software: you can redistribute it and/or
+// modify it under the terms of the GNU General Public License as published by
+// the Free Software Foundation, either version 3 of the License, or (at your
+// option) any later version.
+//
+// The T Language Compiler is distributed in the hope that it will be useful,
+// but WITHOUT ANY WARRANTY; without even the implied warranty of
+// MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the GNU General
+// Public License for more details.
+//
+// You should have received a copy of the GNU General Public License along with
+// the T Language Compiler. If not see <https://www.gnu.org/licenses/>.
+//
+// SPDX-License-Identifier: GPL-3.0-or-later
+
+/**
+ * @file
+ * In-process execution for x86_64 linux
+ */
+
+#ifndef TLC_ARCH_X86_64_LINUX_JIT_H_
+#define TLC_ARCH_X86_64_LINUX_JIT_H_
+
+/**
+ * encode each code file's assembly into executable memory, link the files
+ * together, and call the entry function, freeing fragments as they are
+ * encoded
+ *
+ * @param entry qualified name of the function to call (e.g. "foo::main") -
+ *              must take no arguments and return an integer
+ * @param exitCode output parameter for the entry function's return value
+ * @returns status code (0 = OK)
+ */
+int x86_64LinuxRunJit(char const *entry, int *exitCode);
+
+#endif  // TLC_ARCH_X86_64_LINUX_JIT_H_
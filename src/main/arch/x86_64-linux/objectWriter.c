@@ -0,0 +1,858 @@
+// Copyright 2021 Justin Hu
+//
+// This file is part of the T Language Compiler.
+//
+// The T Language Compiler is free software: you can redistribute it and/or
+// modify it under the terms of the GNU General Public License as published by
+// the Free Software Foundation, either version 3 of the License, or (at your
+// option) any later version.
+//
+// The T Language Compiler is distributed in the hope that it will be useful,
+// but WITHOUT ANY WARRANTY; without even the implied warranty of
+// MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the GNU General
+// Public License for more details.
+//
+// You should have received a copy of the GNU General Public License along with
+// the T Language Compiler. If not see <https://www.gnu.org/licenses/>.
+//
+// SPDX-License-Identifier: GPL-3.0-or-later
+
+#include "arch/x86_64-linux/objectWriter.h"
+
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+
+#include "arch/x86_64-linux/asm.h"
+#include "arch/x86_64-linux/encoder.h"
+#include "fileList.h"
+#include "util/container/hashMap.h"
+#include "util/container/stringBuilder.h"
+#include "util/container/vector.h"
+#include "util/fileWriter.h"
+#include "util/format.h"
+#include "util/functional.h"
+#include "util/internalError.h"
+
+/** names of the sections, by X86_64LinuxSectionName */
+static char const *const SECTION_NAMES[] = {
+    ".text",
+    ".text.unlikely",
+    ".data",
+    ".rodata",
+    ".bss",
+};
+
+/** ELF constants */
+static uint32_t const SHT_PROGBITS = 1;
+static uint32_t const SHT_SYMTAB = 2;
+static uint32_t const SHT_STRTAB = 3;
+static uint32_t const SHT_RELA = 4;
+static uint32_t const SHT_NOBITS = 8;
+static uint64_t const SHF_WRITE = 0x1;
+static uint64_t const SHF_ALLOC = 0x2;
+static uint64_t const SHF_EXECINSTR = 0x4;
+static uint64_t const SHF_INFO_LINK = 0x40;
+static uint8_t const STB_LOCAL = 0;
+static uint8_t const STB_GLOBAL = 1;
+static uint8_t const STT_NOTYPE = 0;
+static uint8_t const STT_OBJECT = 1;
+static uint8_t const STT_FUNC = 2;
+static uint8_t const STT_SECTION = 3;
+static uint32_t const R_X86_64_64 = 1;
+static uint32_t const R_X86_64_PC32 = 2;
+static uint32_t const R_X86_64_PLT32 = 4;
+static uint32_t const R_X86_64_32 = 10;
+static uint32_t const R_X86_64_32S = 11;
+static size_t const ELF_HEADER_SIZE = 64;
+static size_t const SECTION_HEADER_SIZE = 64;
+static size_t const SYMBOL_SIZE = 24;
+static size_t const RELA_SIZE = 24;
+
+/** section header table indices */
+typedef enum {
+  SH_NULL,
+  SH_TEXT,
+  SH_TEXT_UNLIKELY,
+  SH_DATA,
+  SH_RODATA,
+  SH_BSS,
+  SH_RELA_TEXT,
+  SH_RELA_TEXT_UNLIKELY,
+  SH_RELA_DATA,
+  SH_RELA_RODATA,
+  SH_SYMTAB,
+  SH_STRTAB,
+  SH_SHSTRTAB,
+  SH_NOTE_GNU_STACK,
+  NUM_SECTION_HEADERS,
+} SectionHeaderIndex;
+
+static bool isCode(X86_64LinuxSectionName section) {
+  return section == X86_64_LINUX_SECTION_TEXT ||
+         section == X86_64_LINUX_SECTION_TEXT_UNLIKELY;
+}
+
+void x86_64LinuxObjectFileInit(X86_64LinuxObjectFile *o) {
+  for (size_t idx = 0; idx < X86_64_LINUX_NUM_SECTIONS; ++idx) {
+    X86_64LinuxSection *s = &o->sections[idx];
+    tstringBuilderInit(&s->contents);
+    s->bssSize = 0;
+    s->alignment = isCode((X86_64LinuxSectionName)idx) ? 16 : 1;
+    vectorInit(&s->references);
+  }
+  o->current = X86_64_LINUX_SECTION_TEXT;
+  hashMapInit(&o->symbols);
+  vectorInit(&o->symbolOrder);
+  o->lastLabel = NULL;
+}
+static void symbolFree(X86_64LinuxSymbol *s) {
+  free(s->name);
+  free(s);
+}
+void x86_64LinuxObjectFileUninit(X86_64LinuxObjectFile *o) {
+  for (size_t idx = 0; idx < X86_64_LINUX_NUM_SECTIONS; ++idx) {
+    tstringBuilderUninit(&o->sections[idx].contents);
+    vectorUninit(&o->sections[idx].references,
+                 (void (*)(void *))x86_64LinuxReferenceFree);
+  }
+  hashMapUninit(&o->symbols, nullDtor);
+  vectorUninit(&o->symbolOrder, (void (*)(void *))symbolFree);
+}
+
+static size_t sectionSize(X86_64LinuxObjectFile const *o,
+                          X86_64LinuxSectionName name) {
+  return name == X86_64_LINUX_SECTION_BSS ? o->sections[name].bssSize
+                                          : o->sections[name].contents.size;
+}
+
+/**
+ * find a symbol, creating it as undefined if it hasn't been mentioned yet
+ *
+ * @param name name of the symbol - local labels (starting with '.') are
+ *             qualified by the last non-local label
+ * @param length length of the name
+ */
+static X86_64LinuxSymbol *getSymbol(X86_64LinuxObjectFile *o,
+                                    char const *name, size_t length) {
+  char *key = name[0] == '.' && o->lastLabel != NULL
+                  ? format("%s%.*s", o->lastLabel, (int)length, name)
+                  : format("%.*s", (int)length, name);
+  X86_64LinuxSymbol *s = hashMapGet(&o->symbols, key);
+  if (s != NULL) {
+    free(key);
+    return s;
+  }
+
+  s = malloc(sizeof(X86_64LinuxSymbol));
+  s->name = key;
+  s->defined = false;
+  s->section = X86_64_LINUX_SECTION_TEXT;
+  s->offset = 0;
+  s->global = false;
+  s->type = STT_NOTYPE;
+  s->sizeEnd = NULL;
+  s->index = 0;
+  hashMapPut(&o->symbols, s->name, s);
+  vectorInsert(&o->symbolOrder, s);
+  return s;
+}
+
+static bool isIdStart(char c) {
+  return (c >= 'a' && c <= 'z') || (c >= 'A' && c <= 'Z') || c == '_' ||
+         c == '.';
+}
+static bool isDigit(char c) { return c >= '0' && c <= '9'; }
+static size_t identifierLength(char const *s) {
+  size_t length = 0;
+  if (!isIdStart(s[length])) return 0;
+  while (isIdStart(s[length]) || isDigit(s[length])) ++length;
+  return length;
+}
+static void skipSpaces(char const **s) {
+  while (**s == ' ' || **s == '\t') ++*s;
+}
+static bool wordIs(char const *word, size_t length, char const *expected) {
+  return strlen(expected) == length && strncmp(word, expected, length) == 0;
+}
+/**
+ * read a word, moving past it and any spaces after it
+ *
+ * @returns length of the word (zero if there isn't one)
+ */
+static size_t readWord(char const **s, char const **word) {
+  *word = *s;
+  size_t length = identifierLength(*s);
+  *s += length;
+  skipSpaces(s);
+  return length;
+}
+/**
+ * read a decimal number, moving past it and any spaces after it
+ *
+ * @returns status code (0 = OK)
+ */
+static int readNumber(char const **s, uint64_t *out) {
+  bool negative = **s == '-';
+  if (negative) ++*s;
+  if (!isDigit(**s)) return -1;
+  uint64_t n = 0;
+  for (; isDigit(**s); ++*s) n = n * 10 + (uint64_t)(**s - '0');
+  *out = negative ? -n : n;
+  skipSpaces(s);
+  return 0;
+}
+
+static void appendValue(TStringBuilder *sb, uint64_t value, size_t width) {
+  for (size_t idx = 0; idx < width; ++idx)
+    tstringBuilderPush(sb, (uint8_t)(value >> (8 * idx)));
+}
+static void appendBytes(TStringBuilder *sb, uint8_t const *bytes,
+                        size_t length) {
+  for (size_t idx = 0; idx < length; ++idx) tstringBuilderPush(sb, bytes[idx]);
+}
+static void appendZeros(TStringBuilder *sb, size_t count) {
+  for (size_t idx = 0; idx < count; ++idx) tstringBuilderPush(sb, 0);
+}
+static void padTo(TStringBuilder *sb, size_t alignment, uint8_t filler) {
+  while (sb->size % alignment != 0) tstringBuilderPush(sb, filler);
+}
+
+/**
+ * define a label at the current position
+ *
+ * @returns status code (0 = OK)
+ */
+static int defineLabel(X86_64LinuxObjectFile *o, char const *name,
+                       size_t length) {
+  X86_64LinuxSymbol *s = getSymbol(o, name, length);
+  if (s->defined) return -1;
+  s->defined = true;
+  s->section = o->current;
+  s->offset = sectionSize(o, o->current);
+  if (name[0] != '.') o->lastLabel = s->name;
+  return 0;
+}
+
+/**
+ * pad the current section to a multiple of alignment, with nops if it's code
+ */
+static void alignSection(X86_64LinuxObjectFile *o, size_t alignment) {
+  X86_64LinuxSection *s = &o->sections[o->current];
+  if (alignment > s->alignment) s->alignment = alignment;
+  if (o->current == X86_64_LINUX_SECTION_BSS)
+    s->bssSize = (s->bssSize + alignment - 1) / alignment * alignment;
+  else
+    padTo(&s->contents, alignment, isCode(o->current) ? 0x90 : 0);
+}
+/**
+ * switch sections, aligning the new section's end
+ *
+ * @returns status code (0 = OK)
+ */
+static int switchSection(X86_64LinuxObjectFile *o, char const *name,
+                         size_t length, size_t alignment) {
+  bool found = false;
+  for (size_t idx = 0; idx < X86_64_LINUX_NUM_SECTIONS; ++idx) {
+    if (wordIs(name, length, SECTION_NAMES[idx])) {
+      o->current = (X86_64LinuxSectionName)idx;
+      found = true;
+      break;
+    }
+  }
+  if (!found || alignment == 0 || (alignment & (alignment - 1)) != 0)
+    return -1;
+
+  alignSection(o, alignment);
+  return 0;
+}
+
+/**
+ * assemble a data directive's operands
+ *
+ * @param width size of each value
+ * @returns status code (0 = OK)
+ */
+static int assembleData(X86_64LinuxObjectFile *o, char const *s, size_t width) {
+  if (o->current == X86_64_LINUX_SECTION_BSS) return -1;
+  X86_64LinuxSection *section = &o->sections[o->current];
+  while (true) {
+    if (*s == '"' && width == 1) {
+      char const *end = strchr(s + 1, '"');
+      if (end == NULL) return -1;
+      appendBytes(&section->contents, (uint8_t const *)s + 1,
+                  (size_t)(end - s - 1));
+      s = end + 1;
+      skipSpaces(&s);
+    } else if (isIdStart(*s)) {
+      if (width != 8) return -1;
+      char const *name;
+      size_t length = readWord(&s, &name);
+      X86_64LinuxReference *r = malloc(sizeof(X86_64LinuxReference));
+      r->kind = X86_64_LINUX_RK_ABS64;
+      r->offset = section->contents.size;
+      r->symbol = strdup(getSymbol(o, name, length)->name);
+      r->addend = 0;
+      vectorInsert(&section->references, r);
+      appendValue(&section->contents, 0, width);
+    } else {
+      uint64_t value;
+      if (readNumber(&s, &value) != 0) return -1;
+      appendValue(&section->contents, value, width);
+    }
+
+    if (*s == '\0') return 0;
+    if (*s != ',') return -1;
+    ++s;
+    skipSpaces(&s);
+  }
+}
+
+/**
+ * assemble one line of directives or labels
+ *
+ * @returns status code (0 = OK)
+ */
+static int assembleLine(X86_64LinuxObjectFile *o, char const *s) {
+  skipSpaces(&s);
+  if (*s == '\0') return 0;
+
+  char const *word;
+  size_t length = readWord(&s, &word);
+  if (length == 0) return -1;
+
+  if (wordIs(word, length, "section")) {
+    char const *name;
+    size_t nameLength = readWord(&s, &name);
+    uint64_t alignment = 1;
+    while (*s != '\0') {
+      char const *attribute;
+      if (strncmp(s, "align=", 6) == 0) {
+        s += 6;
+        if (readNumber(&s, &alignment) != 0) return -1;
+      } else if (readWord(&s, &attribute) == 0) {
+        return -1;
+      }
+      // other attributes are implied by the section's name
+    }
+    return switchSection(o, name, nameLength, alignment);
+  } else if (wordIs(word, length, "global")) {
+    char const *name;
+    size_t nameLength = readWord(&s, &name);
+    if (nameLength == 0) return -1;
+    X86_64LinuxSymbol *symbol = getSymbol(o, name, nameLength);
+    symbol->global = true;
+    if (*s == ':') {
+      ++s;
+      char const *type;
+      size_t typeLength = readWord(&s, &type);
+      if (wordIs(type, typeLength, "function"))
+        symbol->type = STT_FUNC;
+      else if (wordIs(type, typeLength, "data"))
+        symbol->type = STT_OBJECT;
+      else
+        return -1;
+    }
+    if (*s == '(') {
+      // size, as (end - start)
+      ++s;
+      skipSpaces(&s);
+      char const *end;
+      size_t endLength = readWord(&s, &end);
+      if (endLength == 0 || *s != '-') return -1;
+      symbol->sizeEnd = getSymbol(o, end, endLength)->name;
+      s = strchr(s, ')');
+      if (s == NULL) return -1;
+      ++s;
+      skipSpaces(&s);
+    }
+    return *s == '\0' ? 0 : -1;
+  } else if (wordIs(word, length, "extern") ||
+             wordIs(word, length, "lprefix")) {
+    return 0;  // undefined symbols are always external
+  } else if (wordIs(word, length, "db")) {
+    return assembleData(o, s, 1);
+  } else if (wordIs(word, length, "dw")) {
+    return assembleData(o, s, 2);
+  } else if (wordIs(word, length, "dd")) {
+    return assembleData(o, s, 4);
+  } else if (wordIs(word, length, "dq")) {
+    return assembleData(o, s, 8);
+  } else if (wordIs(word, length, "resb")) {
+    uint64_t count;
+    if (readNumber(&s, &count) != 0 || *s != '\0') return -1;
+    if (o->current == X86_64_LINUX_SECTION_BSS) {
+      o->sections[o->current].bssSize += count;
+    } else {
+      appendZeros(&o->sections[o->current].contents, count);
+    }
+    return 0;
+  } else if (wordIs(word, length, "align")) {
+    uint64_t alignment;
+    if (readNumber(&s, &alignment) != 0 || *s != '\0' || alignment == 0 ||
+        (alignment & (alignment - 1)) != 0)
+      return -1;
+    alignSection(o, alignment);
+    return 0;
+  } else if (wordIs(word, length, "times")) {
+    uint64_t count;
+    if (readNumber(&s, &count) != 0) return -1;
+    for (size_t idx = 0; idx < count; ++idx)
+      if (assembleLine(o, s) != 0) return -1;
+    return 0;
+  } else {
+    // label, with or without a colon
+    if (*s == ':') {
+      ++s;
+      skipSpaces(&s);
+    }
+    if (*s != '\0') return -1;
+    return defineLabel(o, word, length);
+  }
+}
+
+/**
+ * assemble some lines of directives and labels
+ *
+ * @returns status code (0 = OK)
+ */
+static int assembleText(X86_64LinuxObjectFile *o, char const *text,
+                        char const *filename) {
+  while (*text != '\0') {
+    char const *end = strchr(text, '\n');
+    if (end == NULL) end = text + strlen(text);
+    char *line = format("%.*s", (int)(end - text), text);
+    int retval = assembleLine(o, line);
+    if (retval != 0)
+      fprintf(stderr, "%s: error: cannot assemble '%s'\n", filename, line);
+    free(line);
+    if (retval != 0) return -1;
+    text = *end == '\0' ? end : end + 1;
+  }
+  return 0;
+}
+
+/**
+ * assemble a fragment
+ *
+ * @returns status code (0 = OK)
+ */
+static int assembleFrag(X86_64LinuxObjectFile *o,
+                        X86_64LinuxFrag const *frag, char const *filename) {
+  switch (frag->kind) {
+    case X86_64_LINUX_FK_TEXT: {
+      if (assembleText(o, frag->data.text.header, filename) != 0) return -1;
+      LinkedList const *instructions = &frag->data.text.instructions;
+      for (ListNode *curr = instructions->head->next;
+           curr != instructions->tail; curr = curr->next) {
+        X86_64LinuxInstruction const *i = curr->data;
+        if (i->kind == X86_64_LINUX_IK_LABEL) {
+          if (assembleText(o, i->skeleton, filename) != 0) return -1;
+          continue;
+        }
+
+        X86_64LinuxSection *section = &o->sections[o->current];
+        if (o->current == X86_64_LINUX_SECTION_BSS ||
+            x86_64LinuxEncodeInstruction(i, &section->contents,
+                                         &section->references) != 0) {
+          char const *skeleton = i->skeleton;
+          skipSpaces(&skeleton);
+          fprintf(stderr, "%s: error: cannot encode '%.*s'\n", filename,
+                  (int)strcspn(skeleton, "\n"), skeleton);
+          return -1;
+        }
+      }
+      return assembleText(o, frag->data.text.footer, filename);
+    }
+    case X86_64_LINUX_FK_DATA: {
+      return assembleText(o, frag->data.data.data, filename);
+    }
+    default: {
+      error(__FILE__, __LINE__, "invalid X86_64LinuxFrag");
+    }
+  }
+}
+
+/**
+ * patch pc-relative references to symbols in the same section, and make
+ * sure every other referenced symbol exists
+ *
+ * @returns status code (0 = OK)
+ */
+static int resolveReferences(X86_64LinuxObjectFile *o) {
+  o->lastLabel = NULL;
+  for (size_t sectionIdx = 0; sectionIdx < X86_64_LINUX_NUM_SECTIONS;
+       ++sectionIdx) {
+    X86_64LinuxSection *section = &o->sections[sectionIdx];
+    size_t kept = 0;
+    for (size_t idx = 0; idx < section->references.size; ++idx) {
+      X86_64LinuxReference *r = section->references.elements[idx];
+      X86_64LinuxSymbol const *s = getSymbol(o, r->symbol, strlen(r->symbol));
+      if ((r->kind == X86_64_LINUX_RK_PC32 ||
+           r->kind == X86_64_LINUX_RK_PLT32) &&
+          s->defined && s->section == sectionIdx) {
+        int64_t value = (int64_t)s->offset + r->addend - (int64_t)r->offset;
+        if (value < INT32_MIN || value > INT32_MAX) return -1;
+        for (size_t byte = 0; byte < 4; ++byte)
+          section->contents.string[r->offset + byte] =
+              (uint8_t)((uint64_t)value >> (8 * byte));
+        x86_64LinuxReferenceFree(r);
+      } else {
+        section->references.elements[kept++] = r;
+      }
+    }
+    section->references.size = kept;
+  }
+  return 0;
+}
+
+int x86_64LinuxAssembleFile(X86_64LinuxObjectFile *o, FileListEntry *file) {
+  X86_64LinuxFile *asmFile = file->asmFile;
+  int status = assembleText(o, asmFile->header, file->inputFilename);
+  for (size_t fragIdx = 0; fragIdx < asmFile->frags.size; ++fragIdx) {
+    if (status == 0)
+      status = assembleFrag(o, asmFile->frags.elements[fragIdx],
+                            file->inputFilename);
+    x86_64LinuxFragFree(asmFile->frags.elements[fragIdx]);
+  }
+  asmFile->frags.size = 0;  // already freed
+  if (status == 0)
+    status = assembleText(o, asmFile->footer, file->inputFilename);
+  if (status == 0 && resolveReferences(o) != 0) {
+    fprintf(stderr, "%s: error: jump target out of range\n",
+            file->inputFilename);
+    status = -1;
+  }
+  return status;
+}
+
+/**
+ * append a symbol table entry
+ */
+static void appendSymbol(TStringBuilder *symtab, uint32_t name, uint8_t bind,
+                         uint8_t type, uint16_t section, uint64_t value,
+                         uint64_t size) {
+  appendValue(symtab, name, 4);
+  appendValue(symtab, (uint64_t)((bind << 4) | type), 1);
+  appendValue(symtab, 0, 1);
+  appendValue(symtab, section, 2);
+  appendValue(symtab, value, 8);
+  appendValue(symtab, size, 8);
+}
+/**
+ * add a name to a string table
+ *
+ * @returns offset of the name
+ */
+static uint32_t appendName(TStringBuilder *strtab, char const *name) {
+  uint32_t offset = (uint32_t)strtab->size;
+  appendBytes(strtab, (uint8_t const *)name, strlen(name) + 1);
+  return offset;
+}
+static uint16_t sectionHeaderOf(X86_64LinuxSectionName section) {
+  return (uint16_t)(SH_TEXT + section);
+}
+
+/**
+ * build the symbol and string tables
+ *
+ * @returns number of local symbols
+ */
+static uint32_t buildSymbolTable(X86_64LinuxObjectFile *o,
+                                 TStringBuilder *symtab,
+                                 TStringBuilder *strtab) {
+  appendName(strtab, "");
+  appendSymbol(symtab, 0, STB_LOCAL, STT_NOTYPE, 0, 0, 0);
+  size_t index = 1;
+  for (size_t idx = 0; idx < X86_64_LINUX_NUM_SECTIONS; ++idx, ++index)
+    appendSymbol(symtab, 0, STB_LOCAL, STT_SECTION,
+                 sectionHeaderOf((X86_64LinuxSectionName)idx), 0, 0);
+
+  // all locals come before all globals
+  uint32_t numLocals = 0;
+  for (size_t pass = 0; pass < 2; ++pass) {
+    bool globalPass = pass == 1;
+    for (size_t idx = 0; idx < o->symbolOrder.size; ++idx) {
+      X86_64LinuxSymbol *s = o->symbolOrder.elements[idx];
+      bool global = s->global || !s->defined;
+      if (global != globalPass) continue;
+
+      uint64_t size = 0;
+      if (s->sizeEnd != NULL) {
+        X86_64LinuxSymbol const *end = hashMapGet(&o->symbols, s->sizeEnd);
+        if (end->defined && s->defined && end->section == s->section)
+          size = end->offset - s->offset;
+      }
+      s->index = index++;
+      appendSymbol(symtab, appendName(strtab, s->name),
+                   global ? STB_GLOBAL : STB_LOCAL, s->type,
+                   s->defined ? sectionHeaderOf(s->section) : 0, s->offset,
+                   size);
+    }
+    if (!globalPass) numLocals = (uint32_t)index;
+  }
+  return numLocals;
+}
+
+static uint32_t relocationType(X86_64LinuxReferenceKind kind) {
+  switch (kind) {
+    case X86_64_LINUX_RK_ABS64: {
+      return R_X86_64_64;
+    }
+    case X86_64_LINUX_RK_ABS32: {
+      return R_X86_64_32;
+    }
+    case X86_64_LINUX_RK_ABS32S: {
+      return R_X86_64_32S;
+    }
+    case X86_64_LINUX_RK_PC32: {
+      return R_X86_64_PC32;
+    }
+    case X86_64_LINUX_RK_PLT32: {
+      return R_X86_64_PLT32;
+    }
+    default: {
+      error(__FILE__, __LINE__, "invalid X86_64LinuxReferenceKind");
+    }
+  }
+}
+
+/**
+ * build the relocation table for a section's unresolved references
+ */
+static void buildRelocations(X86_64LinuxObjectFile const *o,
+                             X86_64LinuxSectionName section,
+                             TStringBuilder *rela) {
+  Vector const *references = &o->sections[section].references;
+  for (size_t idx = 0; idx < references->size; ++idx) {
+    X86_64LinuxReference const *r = references->elements[idx];
+    X86_64LinuxSymbol const *s = hashMapGet(&o->symbols, r->symbol);
+    appendValue(rela, r->offset, 8);
+    appendValue(rela, ((uint64_t)s->index << 32) | relocationType(r->kind), 8);
+    appendValue(rela, (uint64_t)r->addend, 8);
+  }
+}
+
+static void appendSectionHeader(TStringBuilder *out, uint32_t name,
+                                uint32_t type, uint64_t flags, size_t offset,
+                                size_t size, uint32_t link, uint32_t info,
+                                size_t alignment, size_t entrySize) {
+  appendValue(out, name, 4);
+  appendValue(out, type, 4);
+  appendValue(out, flags, 8);
+  appendValue(out, 0, 8);  // address
+  appendValue(out, offset, 8);
+  appendValue(out, size, 8);
+  appendValue(out, link, 4);
+  appendValue(out, info, 4);
+  appendValue(out, alignment, 8);
+  appendValue(out, entrySize, 8);
+}
+
+static void appendElfHeader(TStringBuilder *out, size_t sectionHeaderOffset) {
+  uint8_t const ident[] = {0x7f, 'E', 'L', 'F', 2, 1, 1, 0,
+                           0,    0,   0,   0,   0, 0, 0, 0};
+  appendBytes(out, ident, sizeof(ident));
+  appendValue(out, 1, 2);   // relocatable
+  appendValue(out, 62, 2);  // x86_64
+  appendValue(out, 1, 4);   // version
+  appendValue(out, 0, 8);   // entry
+  appendValue(out, 0, 8);   // program headers
+  appendValue(out, sectionHeaderOffset, 8);
+  appendValue(out, 0, 4);  // flags
+  appendValue(out, ELF_HEADER_SIZE, 2);
+  appendValue(out, 0, 2);  // program header size
+  appendValue(out, 0, 2);  // program header count
+  appendValue(out, SECTION_HEADER_SIZE, 2);
+  appendValue(out, NUM_SECTION_HEADERS, 2);
+  appendValue(out, SH_SHSTRTAB, 2);
+}
+
+/**
+ * lay out an assembled object file and write it out
+ *
+ * @returns status code (0 = OK)
+ */
+static int writeObjectFile(X86_64LinuxObjectFile *o, char const *filename) {
+  TStringBuilder symtab;
+  TStringBuilder strtab;
+  TStringBuilder shstrtab;
+  TStringBuilder rela[X86_64_LINUX_SECTION_BSS];
+  tstringBuilderInit(&symtab);
+  tstringBuilderInit(&strtab);
+  tstringBuilderInit(&shstrtab);
+  uint32_t numLocals = buildSymbolTable(o, &symtab, &strtab);
+  for (size_t idx = 0; idx < X86_64_LINUX_SECTION_BSS; ++idx) {
+    tstringBuilderInit(&rela[idx]);
+    buildRelocations(o, (X86_64LinuxSectionName)idx, &rela[idx]);
+  }
+
+  char const *const names[] = {
+      "",
+      ".text",
+      ".text.unlikely",
+      ".data",
+      ".rodata",
+      ".bss",
+      ".rela.text",
+      ".rela.text.unlikely",
+      ".rela.data",
+      ".rela.rodata",
+      ".symtab",
+      ".strtab",
+      ".shstrtab",
+      ".note.GNU-stack",
+  };
+  uint32_t nameOffsets[NUM_SECTION_HEADERS];
+  for (size_t idx = 0; idx < NUM_SECTION_HEADERS; ++idx)
+    nameOffsets[idx] = appendName(&shstrtab, names[idx]);
+  TStringBuilder const *contents[] = {
+      NULL,
+      &o->sections[X86_64_LINUX_SECTION_TEXT].contents,
+      &o->sections[X86_64_LINUX_SECTION_TEXT_UNLIKELY].contents,
+      &o->sections[X86_64_LINUX_SECTION_DATA].contents,
+      &o->sections[X86_64_LINUX_SECTION_RODATA].contents,
+      NULL,
+      &rela[X86_64_LINUX_SECTION_TEXT],
+      &rela[X86_64_LINUX_SECTION_TEXT_UNLIKELY],
+      &rela[X86_64_LINUX_SECTION_DATA],
+      &rela[X86_64_LINUX_SECTION_RODATA],
+      &symtab,
+      &strtab,
+      &shstrtab,
+      NULL,
+  };
+  size_t const alignments[] = {
+      0,
+      o->sections[X86_64_LINUX_SECTION_TEXT].alignment,
+      o->sections[X86_64_LINUX_SECTION_TEXT_UNLIKELY].alignment,
+      o->sections[X86_64_LINUX_SECTION_DATA].alignment,
+      o->sections[X86_64_LINUX_SECTION_RODATA].alignment,
+      o->sections[X86_64_LINUX_SECTION_BSS].alignment,
+      8,
+      8,
+      8,
+      8,
+      8,
+      1,
+      1,
+      1,
+  };
+
+  // section contents go right after the ELF header
+  TStringBuilder file;
+  tstringBuilderInit(&file);
+  appendZeros(&file, ELF_HEADER_SIZE);
+  size_t offsets[NUM_SECTION_HEADERS];
+  size_t sizes[NUM_SECTION_HEADERS];
+  for (size_t idx = 0; idx < NUM_SECTION_HEADERS; ++idx) {
+    if (contents[idx] != NULL) {
+      padTo(&file, alignments[idx], 0);
+      offsets[idx] = file.size;
+      sizes[idx] = contents[idx]->size;
+      appendBytes(&file, contents[idx]->string, contents[idx]->size);
+    } else {
+      offsets[idx] = idx == SH_NULL ? 0 : file.size;
+      sizes[idx] =
+          idx == SH_BSS ? o->sections[X86_64_LINUX_SECTION_BSS].bssSize : 0;
+    }
+  }
+
+  padTo(&file, 8, 0);
+  size_t sectionHeaderOffset = file.size;
+  appendZeros(&file, SECTION_HEADER_SIZE);
+  uint32_t const types[] = {
+      0,          SHT_PROGBITS, SHT_PROGBITS, SHT_PROGBITS, SHT_PROGBITS,
+      SHT_NOBITS, SHT_RELA,     SHT_RELA,     SHT_RELA,     SHT_RELA,
+      SHT_SYMTAB, SHT_STRTAB,   SHT_STRTAB,   SHT_PROGBITS,
+  };
+  uint64_t const flags[] = {
+      0,
+      SHF_ALLOC | SHF_EXECINSTR,
+      SHF_ALLOC | SHF_EXECINSTR,
+      SHF_WRITE | SHF_ALLOC,
+      SHF_ALLOC,
+      SHF_WRITE | SHF_ALLOC,
+      SHF_INFO_LINK,
+      SHF_INFO_LINK,
+      SHF_INFO_LINK,
+      SHF_INFO_LINK,
+      0,
+      0,
+      0,
+      0,
+  };
+  for (size_t idx = SH_TEXT; idx < NUM_SECTION_HEADERS; ++idx) {
+    uint32_t link = 0;
+    uint32_t info = 0;
+    size_t entrySize = 0;
+    if (types[idx] == SHT_RELA) {
+      link = SH_SYMTAB;
+      info = (uint32_t)(idx - SH_RELA_TEXT + SH_TEXT);
+      entrySize = RELA_SIZE;
+    } else if (types[idx] == SHT_SYMTAB) {
+      link = SH_STRTAB;
+      info = numLocals;
+      entrySize = SYMBOL_SIZE;
+    }
+    appendSectionHeader(&file, nameOffsets[idx], types[idx], flags[idx],
+                        offsets[idx], sizes[idx], link, info, alignments[idx],
+                        entrySize);
+  }
+
+  TStringBuilder header;
+  tstringBuilderInit(&header);
+  appendElfHeader(&header, sectionHeaderOffset);
+  memcpy(file.string, header.string, ELF_HEADER_SIZE);
+  tstringBuilderUninit(&header);
+
+  int retval = 0;
+  FileWriter w;
+  if (fileWriterInit(&w, filename) != 0) {
+    fprintf(stderr, "%s: error: cannot open file\n", filename);
+    retval = -1;
+  } else {
+    fileWriterWrite(&w, (char const *)file.string, file.size);
+    if (fileWriterUninit(&w) != 0) {
+      fprintf(stderr, "%s: error: cannot write file\n", filename);
+      retval = -1;
+    }
+  }
+
+  tstringBuilderUninit(&file);
+  for (size_t idx = 0; idx < X86_64_LINUX_SECTION_BSS; ++idx)
+    tstringBuilderUninit(&rela[idx]);
+  tstringBuilderUninit(&shstrtab);
+  tstringBuilderUninit(&strtab);
+  tstringBuilderUninit(&symtab);
+  return retval;
+}
+
+/**
+ * get the name of the object file for a code file
+ */
+static char *outputFilename(char const *inputFilename) {
+  // code files always end in ".tc"
+  size_t length = strlen(inputFilename) - 3;
+  return format("%.*s.o", (int)length, inputFilename);
+}
+
+int x86_64LinuxWriteObject(void) {
+  int retval = 0;
+  for (size_t fileIdx = 0; fileIdx < fileList.size; ++fileIdx) {
+    FileListEntry *file = &fileList.entries[fileIdx];
+    if (!file->isCode) continue;
+
+    X86_64LinuxObjectFile o;
+    x86_64LinuxObjectFileInit(&o);
+    int status = x86_64LinuxAssembleFile(&o, file);
+    if (status == 0) {
+      char *filename = outputFilename(file->inputFilename);
+      status = writeObjectFile(&o, filename);
+      free(filename);
+    }
+    x86_64LinuxObjectFileUninit(&o);
+    if (status != 0) retval = -1;
+  }
+  return retval;
+}
@@ -0,0 +1,102 @@
+// Copyright 2021 Justin Hu
+//
+// This file is part of the T Language Compiler.
+//
+// The T Language Compiler is free software: you can redistribute it and/or
+// modify it under the terms of the GNU General Public License as published by
+// the Free Software Foundation, either version 3 of the License, or (at your
+// option) any later version.
+//
+// The T Language Compiler is distributed in the hope that it will be useful,
+// but WITHOUT ANY WARRANTY; without even the implied warranty of
+// MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the GNU General
+// Public License for more details.
+//
+// You should have received a copy of the GNU General Public License along with
+// the T Language Compiler. If not see <https://www.gnu.org/licenses/>.
+//
+// SPDX-License-Identifier: GPL-3.0-or-later
+
+/**
+ * @file
+ * Object file output for x86_64 linux
+ */
+
+#ifndef TLC_ARCH_X86_64_LINUX_OBJECTWRITER_H_
+#define TLC_ARCH_X86_64_LINUX_OBJECTWRITER_H_
+
+#include <stdbool.h>
+#include <stdint.h>
+
+#include "fileList.h"
+#include "util/container/hashMap.h"
+#include "util/container/stringBuilder.h"
+#include "util/container/vector.h"
+
+/** the sections code and data go in */
+typedef enum {
+  X86_64_LINUX_SECTION_TEXT,
+  X86_64_LINUX_SECTION_TEXT_UNLIKELY,
+  X86_64_LINUX_SECTION_DATA,
+  X86_64_LINUX_SECTION_RODATA,
+  X86_64_LINUX_SECTION_BSS, /**< must be last - it has no contents */
+  X86_64_LINUX_NUM_SECTIONS,
+} X86_64LinuxSectionName;
+
+/** the contents of a section being assembled */
+typedef struct {
+  TStringBuilder contents; /**< unused for .bss */
+  size_t bssSize;
+  size_t alignment;
+  Vector references; /**< vector of X86_64LinuxReference */
+} X86_64LinuxSection;
+
+/** a symbol being assembled */
+typedef struct {
+  char *name;
+  bool defined;
+  X86_64LinuxSectionName section;
+  size_t offset;
+  bool global;
+  uint8_t type;        /**< ELF symbol type */
+  char const *sizeEnd; /**< name of the label at the end of the symbol */
+  size_t index;        /**< index in the ELF symbol table */
+} X86_64LinuxSymbol;
+
+/** an object file being assembled */
+typedef struct {
+  X86_64LinuxSection sections[X86_64_LINUX_NUM_SECTIONS];
+  X86_64LinuxSectionName current;
+  HashMap symbols;       /**< map from name to X86_64LinuxSymbol */
+  Vector symbolOrder;    /**< vector of X86_64LinuxSymbol, by first mention */
+  char const *lastLabel; /**< last non-local label, to qualify .labels */
+} X86_64LinuxObjectFile;
+
+
+/** ctor */
+void x86_64LinuxObjectFileInit(X86_64LinuxObjectFile *o);
+/** dtor */
+void x86_64LinuxObjectFileUninit(X86_64LinuxObjectFile *o);
+
+/**
+ * encode a code file's assembly into an object file, freeing fragments as
+ * they are encoded
+ *
+ * Pc-relative references to symbols in the same section are resolved; all
+ * other references are left in their sections.
+ *
+ * @param o object file to assemble into - must be freshly initialized
+ * @param file file to assemble
+ * @returns status code (0 = OK)
+ */
+int x86_64LinuxAssembleFile(X86_64LinuxObjectFile *o, FileListEntry *file);
+
+/**
+ * encode each code file's assembly and write it to an ELF64 relocatable .o
+ * file next to it, freeing fragments as they are encoded
+ *
+ * @returns status code (0 = OK)
+ */
+int x86_64LinuxWriteObject(void);
+
+#endif  // TLC_ARCH_X86_64_LINUX_OBJECTWRITER_H_
@@ -0,0 +1,452 @@
+// Copyright 2021 Justin Hu
+//
+// This file is part of the T Language Compiler.
+//
+// The T Language Compiler is free software: you can redistribute it and/or
+// modify it under the terms of the GNU General Public License as published by
+// the Free Software Foundation, either version 3 of the License, or (at your
+// option) any later version.
+//
+// The T Language Compiler is distributed in the hope that it will be useful,
+// but WITHOUT ANY WARRANTY; without even the implied warranty of
+// MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the GNU General
+// Public License for more details.
+//
+// You should have received a copy of the GNU General Public License along with
+// the T Language Compiler. If not see <https://www.gnu.org/licenses/>.
+//
+// SPDX-License-Identifier: GPL-3.0-or-later
+
+#include "arch/x86_64-linux/peephole.h"
+
+#include <inttypes.h>
+#include <stdlib.h>
+#include <string.h>
+
+#include "arch/x86_64-linux/asm.h"
+#include "fileList.h"
+#include "util/format.h"
+
+/** mnemonics of instructions that overwrite all of the arithmetic flags */
+static char const *const FLAG_WRITERS[] = {
+    "add",    "sub",    "and",     "or",      "xor",  "cmp",
+    "test",   "neg",    "mul",     "imul",    "div",  "idiv",
+    "comiss", "comisd", "ucomiss", "ucomisd", "call",
+};
+static size_t const NUM_FLAG_WRITERS =
+    sizeof(FLAG_WRITERS) / sizeof(char const *);
+/** mnemonic prefixes of instructions that read the arithmetic flags */
+static char const *const FLAG_READERS[] = {
+    "j", "set", "cmov", "adc", "sbb",
+};
+static size_t const NUM_FLAG_READERS =
+    sizeof(FLAG_READERS) / sizeof(char const *);
+/** condition codes that only look at the zero and sign flags */
+static char const *const ZERO_SIGN_CONDITIONS[] = {
+    "e", "ne", "z", "nz", "s", "ns",
+};
+static size_t const NUM_ZERO_SIGN_CONDITIONS =
+    sizeof(ZERO_SIGN_CONDITIONS) / sizeof(char const *);
+/** mnemonics of instructions that never touch the arithmetic flags */
+static char const *const FLAG_PRESERVERS[] = {
+    "mov", "movzx", "movsx", "movsxd", "lea",
+};
+static size_t const NUM_FLAG_PRESERVERS =
+    sizeof(FLAG_PRESERVERS) / sizeof(char const *);
+
+/**
+ * get the length of an instruction's mnemonic
+ *
+ * @returns length, or zero if the instruction isn't an ordinary instruction
+ */
+static size_t mnemonicLength(X86_64LinuxInstruction const *i) {
+  if (i->skeleton[0] != '\t') return 0;
+  return strcspn(i->skeleton + 1, " \n");
+}
+static bool mnemonicIs(X86_64LinuxInstruction const *i,
+                       char const *mnemonic) {
+  size_t length = mnemonicLength(i);
+  return length == strlen(mnemonic) &&
+         strncmp(i->skeleton + 1, mnemonic, length) == 0;
+}
+static bool mnemonicStartsWith(X86_64LinuxInstruction const *i,
+                               char const *prefix) {
+  size_t length = strlen(prefix);
+  return mnemonicLength(i) >= length &&
+         strncmp(i->skeleton + 1, prefix, length) == 0;
+}
+
+static bool readsFlags(X86_64LinuxInstruction const *i) {
+  if (i->kind == X86_64_LINUX_IK_CJUMP) return true;
+  if (mnemonicIs(i, "jmp")) return false;
+  for (size_t idx = 0; idx < NUM_FLAG_READERS; ++idx) {
+    if (mnemonicStartsWith(i, FLAG_READERS[idx])) return true;
+  }
+  return false;
+}
+static bool writesFlags(X86_64LinuxInstruction const *i) {
+  for (size_t idx = 0; idx < NUM_FLAG_WRITERS; ++idx) {
+    if (mnemonicIs(i, FLAG_WRITERS[idx])) return true;
+  }
+  return false;
+}
+static bool preservesFlags(X86_64LinuxInstruction const *i) {
+  if (i->kind != X86_64_LINUX_IK_REGULAR) return false;
+  for (size_t idx = 0; idx < NUM_FLAG_PRESERVERS; ++idx) {
+    if (mnemonicIs(i, FLAG_PRESERVERS[idx])) return true;
+  }
+  return false;
+}
+/**
+ * does this flag reader only look at the zero and sign flags
+ */
+static bool readsZeroSign(X86_64LinuxInstruction const *i) {
+  size_t length = mnemonicLength(i);
+  char const *prefixes[] = {"j", "set", "cmov"};
+  for (size_t prefixIdx = 0; prefixIdx < 3; ++prefixIdx) {
+    if (!mnemonicStartsWith(i, prefixes[prefixIdx])) continue;
+    size_t prefixLength = strlen(prefixes[prefixIdx]);
+    for (size_t idx = 0; idx < NUM_ZERO_SIGN_CONDITIONS; ++idx) {
+      char const *condition = ZERO_SIGN_CONDITIONS[idx];
+      if (length - prefixLength == strlen(condition) &&
+          strncmp(i->skeleton + 1 + prefixLength, condition,
+                  strlen(condition)) == 0)
+        return true;
+    }
+  }
+  return false;
+}
+
+/** how many jumps to follow when looking for flag reads */
+#define MAX_FLAG_JUMPS 4
+
+static ListNode *findLabel(LinkedList *instructions, size_t name) {
+  for (ListNode *curr = instructions->head->next; curr != instructions->tail;
+       curr = curr->next) {
+    X86_64LinuxInstruction const *i = curr->data;
+    if (i->kind == X86_64_LINUX_IK_LABEL && i->data.labelName == name)
+      return curr;
+  }
+  return NULL;
+}
+
+/**
+ * find which flags might be read starting at start, before they are
+ * overwritten
+ *
+ * @param instructions list start is in
+ * @param start first instruction to look at
+ * @param jumps how many more jumps to follow before assuming the worst
+ * @param anyRead set if any flag might be read
+ * @param otherRead set if a flag other than the zero and sign flags might be
+ * read
+ */
+static void flagsReadFrom(LinkedList *instructions, ListNode *start,
+                          size_t jumps, bool *anyRead, bool *otherRead) {
+  for (ListNode *curr = start; curr != instructions->tail; curr = curr->next) {
+    X86_64LinuxInstruction const *i = curr->data;
+    if (readsFlags(i)) {
+      *anyRead = true;
+      if (!readsZeroSign(i)) {
+        *otherRead = true;
+        return;
+      }
+    }
+    if (writesFlags(i) || i->kind == X86_64_LINUX_IK_LEAVE ||
+        i->kind == X86_64_LINUX_IK_TAIL_CALL)
+      return;
+
+    if (i->kind == X86_64_LINUX_IK_JUMPTABLE ||
+        ((i->kind == X86_64_LINUX_IK_JUMP ||
+          i->kind == X86_64_LINUX_IK_CJUMP) &&
+         jumps == 0)) {
+      *anyRead = true;
+      *otherRead = true;
+      return;
+    } else if (i->kind == X86_64_LINUX_IK_JUMP ||
+               i->kind == X86_64_LINUX_IK_CJUMP) {
+      for (size_t idx = 0; idx < i->data.jumpTargets.size; ++idx) {
+        ListNode *target =
+            findLabel(instructions, i->data.jumpTargets.elements[idx]);
+        if (target == NULL) {
+          *anyRead = true;
+          *otherRead = true;
+        } else {
+          flagsReadFrom(instructions, target, jumps - 1, anyRead, otherRead);
+        }
+        if (*otherRead) return;
+      }
+      if (i->kind == X86_64_LINUX_IK_JUMP) return;
+    }
+  }
+}
+/**
+ * find which flags might be read after node
+ *
+ * @param instructions list node is in
+ * @param node instruction to look after
+ * @param anyRead set to whether any flag might be read
+ * @param otherRead set to whether a flag other than the zero and sign flags
+ * might be read
+ */
+static void flagsReadAfter(LinkedList *instructions, ListNode *node,
+                           bool *anyRead, bool *otherRead) {
+  *anyRead = false;
+  *otherRead = false;
+  flagsReadFrom(instructions, node->next, MAX_FLAG_JUMPS, anyRead, otherRead);
+}
+static bool flagsLiveAfter(LinkedList *instructions, ListNode *node) {
+  bool anyRead;
+  bool otherRead;
+  flagsReadAfter(instructions, node, &anyRead, &otherRead);
+  return anyRead;
+}
+
+static bool isReg(X86_64LinuxOperand const *o) {
+  return o->kind == X86_64_LINUX_OK_REG;
+}
+static bool isGpReg(X86_64LinuxOperand const *o) {
+  return isReg(o) && o->data.reg.reg <= X86_64_LINUX_R15;
+}
+static bool sameReg(X86_64LinuxOperand const *a, X86_64LinuxOperand const *b) {
+  return isReg(a) && isReg(b) && a->data.reg.reg == b->data.reg.reg &&
+         a->data.reg.size == b->data.reg.size;
+}
+/** does the instruction write any part of the register o */
+static bool definesReg(X86_64LinuxInstruction const *i,
+                       X86_64LinuxOperand const *o) {
+  for (size_t idx = 0; idx < i->defines.size; ++idx) {
+    X86_64LinuxOperand const *defined = i->defines.elements[idx];
+    if (isReg(defined) && defined->data.reg.reg == o->data.reg.reg)
+      return true;
+  }
+  return false;
+}
+static bool isMove(X86_64LinuxInstruction const *i) {
+  return i->kind == X86_64_LINUX_IK_REGULAR && i->data.move.from != NULL &&
+         i->defines.size == 1 && i->uses.size == 1;
+}
+
+/**
+ * parse the immediate out of an instruction of the form "\t<op> `d, <n>\n"
+ *
+ * @returns whether the instruction had that form
+ */
+static bool immediateOperand(X86_64LinuxInstruction const *i, char const *op,
+                             uint64_t *value) {
+  if (!mnemonicIs(i, op)) return false;
+  char const *rest = i->skeleton + 1 + strlen(op);
+  if (strncmp(rest, " `d, ", 5) != 0) return false;
+  rest += 5;
+  if (*rest < '0' || *rest > '9') return false;
+
+  char *end;
+  *value = strtoull(rest, &end, 10);
+  return strcmp(end, "\n") == 0;
+}
+
+/**
+ * jmp L; L: -> L:
+ */
+static bool removeJumpToNext(LinkedList *instructions, ListNode *node) {
+  X86_64LinuxInstruction *i = node->data;
+  if (i->kind != X86_64_LINUX_IK_JUMP || i->data.jumpTargets.size != 1)
+    return false;
+  for (ListNode *curr = node->next; curr != instructions->tail;
+       curr = curr->next) {
+    X86_64LinuxInstruction const *label = curr->data;
+    if (label->kind != X86_64_LINUX_IK_LABEL) return false;
+    if (label->data.labelName == i->data.jumpTargets.elements[0]) {
+      x86_64LinuxInstructionFree(removeNode(node));
+      return true;
+    }
+  }
+  return false;
+}
+
+/**
+ * mov r, r ->
+ *
+ * doesn't depend on the surrounding instructions, so it's checked directly
+ * instead of being a rule
+ */
+static bool isSelfMove(X86_64LinuxInstruction const *i) {
+  return isMove(i) && sameReg(i->data.move.to, i->data.move.from);
+}
+
+/**
+ * mov r, 0 -> xor r, r
+ *
+ * a 32 bit xor clears the whole register and has a shorter encoding
+ */
+static bool zeroWithXor(LinkedList *instructions, ListNode *node) {
+  X86_64LinuxInstruction *i = node->data;
+  uint64_t value;
+  if (!immediateOperand(i, "mov", &value) || value != 0 ||
+      i->defines.size != 1 || !isGpReg(i->defines.elements[0]) ||
+      flagsLiveAfter(instructions, node))
+    return false;
+
+  X86_64LinuxOperand *reg = i->defines.elements[0];
+  if (reg->data.reg.size == 8) reg->data.reg.size = 4;
+  vectorInsert(&i->uses, x86_64LinuxRegOperandCreate(reg->data.reg.reg,
+                                                     reg->data.reg.size));
+  free(i->skeleton);
+  i->skeleton = strdup("\txor `d, `u\n");
+  return true;
+}
+
+/**
+ * mov d, s; add d, n -> lea d, [s + n]
+ * mov d, s; sub d, n -> lea d, [s - n]
+ */
+static bool moveAddToLea(LinkedList *instructions, ListNode *node) {
+  X86_64LinuxInstruction *move = node->data;
+  if (node->next == instructions->tail || !isMove(move)) return false;
+  X86_64LinuxOperand const *to = move->data.move.to;
+  X86_64LinuxOperand const *from = move->data.move.from;
+  if (!isGpReg(to) || !isGpReg(from) ||
+      (to->data.reg.size != 4 && to->data.reg.size != 8) ||
+      to->data.reg.size != from->data.reg.size)
+    return false;
+
+  ListNode *addNode = node->next;
+  X86_64LinuxInstruction *add = addNode->data;
+  uint64_t value;
+  bool negate;
+  if (immediateOperand(add, "add", &value))
+    negate = false;
+  else if (immediateOperand(add, "sub", &value))
+    negate = true;
+  else
+    return false;
+  if (add->defines.size != 1 || add->uses.size != 1 ||
+      !sameReg(add->defines.elements[0], to) ||
+      !sameReg(add->uses.elements[0], to) ||
+      flagsLiveAfter(instructions, addNode))
+    return false;
+
+  // lea only takes a sign-extended 32 bit displacement
+  int64_t displacement;
+  if (to->data.reg.size == 4)
+    displacement = (int32_t)(uint32_t)value;
+  else if (value <= INT32_MAX || value >= (uint64_t)INT32_MIN)
+    displacement = (int64_t)value;
+  else
+    return false;
+  if (negate) {
+    if (displacement == INT32_MIN) return false;
+    displacement = -displacement;
+  }
+
+  // the address is always built from the 64 bit register, even for a 32 bit
+  // add, since the low 32 bits of the sum are the same either way
+  X86_64LinuxOperand *base = add->uses.elements[0];
+  *base = *from;
+  base->data.reg.size = 8;
+  free(add->skeleton);
+  add->skeleton = displacement < 0
+                      ? format("\tlea `d, [`u - %" PRId64 "]\n", -displacement)
+                      : format("\tlea `d, [`u + %" PRId64 "]\n", displacement);
+  x86_64LinuxInstructionFree(removeNode(node));
+  return true;
+}
+
+/**
+ * and r, x; test r, r -> and r, x (likewise for or and xor)
+ * add r, x; test r, r -> add r, x, if only the zero and sign flags are read
+ * (likewise for sub and neg)
+ *
+ * moves that leave r alone may come between the arithmetic and the test
+ *
+ * test is matched at the test, since the arithmetic stays
+ */
+static bool removeRedundantTest(LinkedList *instructions, ListNode *node) {
+  X86_64LinuxInstruction *test = node->data;
+  if (!mnemonicIs(test, "test") || test->uses.size != 2 ||
+      !isGpReg(test->uses.elements[0]) ||
+      !sameReg(test->uses.elements[0], test->uses.elements[1]))
+    return false;
+  X86_64LinuxOperand const *reg = test->uses.elements[0];
+
+  ListNode *prevNode = node->prev;
+  while (prevNode != instructions->head && preservesFlags(prevNode->data) &&
+         !definesReg(prevNode->data, reg))
+    prevNode = prevNode->prev;
+  if (prevNode == instructions->head) return false;
+
+  X86_64LinuxInstruction const *prev = prevNode->data;
+  if (prev->kind != X86_64_LINUX_IK_REGULAR || prev->defines.size != 1 ||
+      !sameReg(prev->defines.elements[0], reg))
+    return false;
+  if (!mnemonicIs(prev, "and") && !mnemonicIs(prev, "or") &&
+      !mnemonicIs(prev, "xor")) {
+    if (!mnemonicIs(prev, "add") && !mnemonicIs(prev, "sub") &&
+        !mnemonicIs(prev, "neg"))
+      return false;
+
+    // these set the carry and overflow flags differently from test
+    bool anyRead;
+    bool otherRead;
+    flagsReadAfter(instructions, node, &anyRead, &otherRead);
+    if (otherRead) return false;
+  }
+
+  x86_64LinuxInstructionFree(removeNode(node));
+  return true;
+}
+
+/** a peephole rewrite, tried at each instruction */
+typedef struct {
+  /** only valid once temps have been replaced by registers */
+  bool needsRegisters;
+  /**
+   * try to rewrite the sequence starting (or ending) at node; may free node
+   *
+   * @returns whether anything changed
+   */
+  bool (*apply)(LinkedList *instructions, ListNode *node);
+} PeepholeRule;
+
+static PeepholeRule const RULES[] = {
+    {false, removeJumpToNext},
+    {true, zeroWithXor},
+    {true, moveAddToLea},
+    {true, removeRedundantTest},
+};
+static size_t const NUM_RULES = sizeof(RULES) / sizeof(PeepholeRule);
+
+static void peepholeOptimizeFrag(X86_64LinuxFrag *frag, bool allocated) {
+  LinkedList *instructions = &frag->data.text.instructions;
+  bool changed;
+  do {
+    changed = false;
+    for (ListNode *curr = instructions->head->next, *next;
+         curr != instructions->tail; curr = next) {
+      next = curr->next;
+      if (allocated && isSelfMove(curr->data)) {
+        x86_64LinuxInstructionFree(removeNode(curr));
+        changed = true;
+        continue;
+      }
+      for (size_t idx = 0; idx < NUM_RULES; ++idx) {
+        if (RULES[idx].needsRegisters && !allocated) continue;
+        if (RULES[idx].apply(instructions, curr)) {
+          changed = true;
+          break;
+        }
+      }
+    }
+  } while (changed);
+}
+
+void x86_64LinuxPeepholeOptimize(bool allocated) {
+  for (size_t fileIdx = 0; fileIdx < fileList.size; ++fileIdx) {
+    X86_64LinuxFile *asmFile = fileList.entries[fileIdx].asmFile;
+    for (size_t fragIdx = 0; fragIdx < asmFile->frags.size; ++fragIdx) {
+      X86_64LinuxFrag *frag = asmFile->frags.elements[fragIdx];
+      if (frag->kind == X86_64_LINUX_FK_TEXT)
+        peepholeOptimizeFrag(frag, allocated);
+    }
+  }
+}
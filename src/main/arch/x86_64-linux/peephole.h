@@ -0,0 +1,39 @@
+// Copyright 2021 Justin Hu
+//
+// This file is part of the T Language Compiler.
+//
+// The T Language Compiler is free software: you can redistribute it and/or
+// modify it under the terms of the GNU General Public License as published by
+// the Free Software Foundation, either version 3 of the License, or (at your
+// option) any later version.
+//
+// The T Language Compiler is distributed in the hope that it will be useful,
+// but WITHOUT ANY WARRANTY; without even the implied warranty of
+// MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the GNU General
+// Public License for more details.
+//
+// You should have received a copy of the GNU General Public License along with
+// the T Language Compiler. If not see <https://www.gnu.org/licenses/>.
+//
+// SPDX-License-Identifier: GPL-3.0-or-later
+
+/**
+ * @file
+ * Peephole optimization for x86_64 linux
+ */
+
+#ifndef TLC_ARCH_X86_64_LINUX_PEEPHOLE_H_
+#define TLC_ARCH_X86_64_LINUX_PEEPHOLE_H_
+
+#include <stdbool.h>
+
+/**
+ * rewrite short instruction sequences in the generated assembly into cheaper
+ * equivalents
+ *
+ * @param allocated have registers been allocated yet - most rewrites only apply
+ * to registers
+ */
+void x86_64LinuxPeepholeOptimize(bool allocated);
+
+#endif  // TLC_ARCH_X86_64_LINUX_PEEPHOLE_H_
@@ -0,0 +1,1299 @@
+// Copyright 2021 Justin Hu
+//
+// This file is part of the T Language Compiler.
+//
+// The T Language Compiler is free software: you can redistribute it and/or
+// modify it under the terms of the GNU General Public License as published by
+// the Free Software Foundation, either version 3 of the License, or (at your
+// option) any later version.
+//
+// The T Language Compiler is distributed in the hope that it will be useful,
+// but WITHOUT ANY WARRANTY; without even the implied warranty of
+// MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the GNU General
+// Public License for more details.
+//
+// You should have received a copy of the GNU General Public License along with
+// the T Language Compiler. If not see <https://www.gnu.org/licenses/>.
+//
+// SPDX-License-Identifier: GPL-3.0-or-later
+
+#include "arch/x86_64-linux/registerAllocation.h"
+
+#include <stdlib.h>
+#include <string.h>
+
+#include "arch/x86_64-linux/asm.h"
+#include "fileList.h"
+#include "options.h"
+#include "translation/translation.h"
+#include "util/internalError.h"
+
+/** registers are nodes zero through NUM_REGISTERS - 1; temps come after */
+#define NUM_REGISTERS ((size_t)X86_64_LINUX_XMM15 + 1)
+
+/**
+ * gp registers, in the order they are handed out
+ *
+ * caller-save registers come first so leaf functions rarely need to save
+ * anything; rsp and rbp are never handed out
+ */
+static X86_64LinuxRegister const GP_COLORS[] = {
+    X86_64_LINUX_RAX, X86_64_LINUX_RCX, X86_64_LINUX_RDX, X86_64_LINUX_RSI,
+    X86_64_LINUX_RDI, X86_64_LINUX_R8,  X86_64_LINUX_R9,  X86_64_LINUX_R10,
+    X86_64_LINUX_R11, X86_64_LINUX_RBX, X86_64_LINUX_R12, X86_64_LINUX_R13,
+    X86_64_LINUX_R14, X86_64_LINUX_R15,
+};
+static size_t const NUM_GP_COLORS =
+    sizeof(GP_COLORS) / sizeof(X86_64LinuxRegister);
+/** fp registers, in the order they are handed out */
+static X86_64LinuxRegister const FP_COLORS[] = {
+    X86_64_LINUX_XMM0,  X86_64_LINUX_XMM1,  X86_64_LINUX_XMM2,
+    X86_64_LINUX_XMM3,  X86_64_LINUX_XMM4,  X86_64_LINUX_XMM5,
+    X86_64_LINUX_XMM6,  X86_64_LINUX_XMM7,  X86_64_LINUX_XMM8,
+    X86_64_LINUX_XMM9,  X86_64_LINUX_XMM10, X86_64_LINUX_XMM11,
+    X86_64_LINUX_XMM12, X86_64_LINUX_XMM13, X86_64_LINUX_XMM14,
+    X86_64_LINUX_XMM15,
+};
+static size_t const NUM_FP_COLORS =
+    sizeof(FP_COLORS) / sizeof(X86_64LinuxRegister);
+
+/**
+ * get the callee-save register a temp holds
+ *
+ * @param saves name of the temp each callee-save register is copied into
+ * @param name temp name
+ * @returns register, or SIZE_MAX if the temp doesn't hold one
+ */
+static size_t savedRegister(size_t const *saves, size_t name) {
+  for (size_t idx = 0; idx < X86_64_LINUX_NUM_CALLEE_SAVE_REGISTERS; ++idx) {
+    if (saves[idx] == name) return X86_64_LINUX_CALLEE_SAVE_REGISTERS[idx];
+  }
+  return SIZE_MAX;
+}
+static bool isCalleeSave(size_t reg) {
+  for (size_t idx = 0; idx < X86_64_LINUX_NUM_CALLEE_SAVE_REGISTERS; ++idx) {
+    if (X86_64_LINUX_CALLEE_SAVE_REGISTERS[idx] == reg) return true;
+  }
+  return false;
+}
+
+static size_t bitsetWords(size_t bits) { return (bits + 63) / 64; }
+static bool bitsetGet(uint64_t const *set, size_t idx) {
+  return (set[idx / 64] >> (idx % 64) & 1) != 0;
+}
+static void bitsetSet(uint64_t *set, size_t idx) {
+  set[idx / 64] |= (uint64_t)1 << (idx % 64);
+}
+static void bitsetClear(uint64_t *set, size_t idx) {
+  set[idx / 64] &= ~((uint64_t)1 << (idx % 64));
+}
+
+/**
+ * interference graph over the registers and gp/fp temps of one fragment
+ */
+typedef struct {
+  size_t numNodes;
+  size_t words;         /**< number of words in a bitset over the nodes */
+  size_t *tempNodes;    /**< map from temp name to node, or SIZE_MAX */
+  AllocHint *kinds;     /**< register class of each node */
+  size_t *sizes;        /**< largest size each temp node is used at */
+  size_t *alignments;   /**< largest alignment each temp node is used at */
+  bool *unspillable;    /**< was this temp introduced by spilling */
+  size_t *saved;        /**< callee-save register held, or SIZE_MAX */
+  size_t *costs;        /**< number of references to each node */
+  size_t *aliases;      /**< node this node was coalesced into, or itself */
+  uint64_t *adjacency;  /**< one bitset over nodes per node */
+  size_t *degrees;      /**< number of neighbors of each node */
+  SizeVector moves;     /**< pairs of (to, from) nodes joined by moves */
+} InterferenceGraph;
+
+static bool isPrecolored(size_t node) { return node < NUM_REGISTERS; }
+static size_t numColors(InterferenceGraph const *g, size_t node) {
+  return g->kinds[node] == AH_GP ? NUM_GP_COLORS : NUM_FP_COLORS;
+}
+static uint64_t *neighbors(InterferenceGraph const *g, size_t node) {
+  return g->adjacency + node * g->words;
+}
+static bool interferes(InterferenceGraph const *g, size_t a, size_t b) {
+  return bitsetGet(neighbors(g, a), b);
+}
+/**
+ * is node's degree high enough that it might not be colorable
+ */
+static bool significant(InterferenceGraph const *g, size_t node) {
+  return isPrecolored(node) || g->degrees[node] >= numColors(g, node);
+}
+static size_t findAlias(InterferenceGraph const *g, size_t node) {
+  while (g->aliases[node] != node) node = g->aliases[node];
+  return node;
+}
+
+/**
+ * get the node for an operand
+ *
+ * @returns node, or SIZE_MAX if the operand isn't allocated
+ */
+static size_t operandNode(InterferenceGraph const *g,
+                          X86_64LinuxOperand const *o) {
+  switch (o->kind) {
+    case X86_64_LINUX_OK_REG: {
+      return o->data.reg.reg;
+    }
+    case X86_64_LINUX_OK_TEMP: {
+      return o->data.temp.kind == AH_MEM ? SIZE_MAX
+                                         : g->tempNodes[o->data.temp.name];
+    }
+    default: {
+      return SIZE_MAX;
+    }
+  }
+}
+static bool isAllocatableTemp(X86_64LinuxOperand const *o) {
+  return o->kind == X86_64_LINUX_OK_TEMP && o->data.temp.kind != AH_MEM;
+}
+/**
+ * is this a plain copy between two registers-ish operands
+ */
+static bool isMove(X86_64LinuxInstruction const *i) {
+  return i->kind == X86_64_LINUX_IK_REGULAR && i->data.move.from != NULL &&
+         i->defines.size == 1 && i->uses.size == 1;
+}
+
+static void addEdge(InterferenceGraph *g, size_t a, size_t b) {
+  if (a == b || g->kinds[a] != g->kinds[b] ||
+      (isPrecolored(a) && isPrecolored(b)) || interferes(g, a, b))
+    return;
+  bitsetSet(neighbors(g, a), b);
+  bitsetSet(neighbors(g, b), a);
+  ++g->degrees[a];
+  ++g->degrees[b];
+}
+
+/**
+ * number the registers and temps of a fragment
+ *
+ * @param g graph to initialize
+ * @param nodes instructions of the fragment
+ * @param n number of instructions
+ * @param noSpill which temp names were introduced by spilling
+ * @param saves name of the temp each callee-save register is copied into
+ * @param file file the fragment is in
+ */
+static void graphInit(InterferenceGraph *g, ListNode **nodes, size_t n,
+                      bool const *noSpill, size_t const *saves,
+                      FileListEntry *file) {
+  g->tempNodes = malloc(file->nextId * sizeof(size_t));
+  for (size_t idx = 0; idx < file->nextId; ++idx) g->tempNodes[idx] = SIZE_MAX;
+
+  g->numNodes = NUM_REGISTERS;
+  for (size_t idx = 0; idx < n; ++idx) {
+    X86_64LinuxInstruction *i = nodes[idx]->data;
+    Vector *operands[] = {&i->defines, &i->uses};
+    for (size_t vecIdx = 0; vecIdx < 2; ++vecIdx) {
+      for (size_t opIdx = 0; opIdx < operands[vecIdx]->size; ++opIdx) {
+        X86_64LinuxOperand *o = operands[vecIdx]->elements[opIdx];
+        if (isAllocatableTemp(o) && g->tempNodes[o->data.temp.name] == SIZE_MAX)
+          g->tempNodes[o->data.temp.name] = g->numNodes++;
+      }
+    }
+  }
+
+  g->words = bitsetWords(g->numNodes);
+  g->kinds = calloc(g->numNodes, sizeof(AllocHint));
+  g->sizes = calloc(g->numNodes, sizeof(size_t));
+  g->alignments = calloc(g->numNodes, sizeof(size_t));
+  g->unspillable = calloc(g->numNodes, sizeof(bool));
+  g->saved = malloc(g->numNodes * sizeof(size_t));
+  g->costs = calloc(g->numNodes, sizeof(size_t));
+  g->aliases = malloc(g->numNodes * sizeof(size_t));
+  g->adjacency = calloc(g->numNodes * g->words, sizeof(uint64_t));
+  g->degrees = calloc(g->numNodes, sizeof(size_t));
+  sizeVectorInit(&g->moves);
+
+  for (size_t node = 0; node < g->numNodes; ++node) {
+    g->aliases[node] = node;
+    g->saved[node] = SIZE_MAX;
+  }
+  for (size_t reg = 0; reg < NUM_REGISTERS; ++reg)
+    g->kinds[reg] = reg <= X86_64_LINUX_R15 ? AH_GP : AH_FP;
+
+  for (size_t idx = 0; idx < n; ++idx) {
+    X86_64LinuxInstruction *i = nodes[idx]->data;
+    Vector *operands[] = {&i->defines, &i->uses};
+    for (size_t vecIdx = 0; vecIdx < 2; ++vecIdx) {
+      for (size_t opIdx = 0; opIdx < operands[vecIdx]->size; ++opIdx) {
+        X86_64LinuxOperand *o = operands[vecIdx]->elements[opIdx];
+        size_t node = operandNode(g, o);
+        if (node == SIZE_MAX) continue;
+        ++g->costs[node];
+        if (isPrecolored(node)) continue;
+        g->kinds[node] = o->data.temp.kind;
+        g->unspillable[node] = noSpill[o->data.temp.name];
+        g->saved[node] = savedRegister(saves, o->data.temp.name);
+        if (o->data.temp.size > g->sizes[node])
+          g->sizes[node] = o->data.temp.size;
+        if (o->data.temp.alignment > g->alignments[node])
+          g->alignments[node] = o->data.temp.alignment;
+      }
+    }
+  }
+}
+static void graphUninit(InterferenceGraph *g) {
+  free(g->tempNodes);
+  free(g->kinds);
+  free(g->sizes);
+  free(g->alignments);
+  free(g->unspillable);
+  free(g->saved);
+  free(g->costs);
+  free(g->aliases);
+  free(g->adjacency);
+  free(g->degrees);
+  sizeVectorUninit(&g->moves);
+}
+
+/**
+ * find the control flow successors of each instruction
+ *
+ * @param nodes instructions of the fragment
+ * @param n number of instructions
+ * @param successors array of n uninitialized vectors to fill in
+ * @param file file the fragment is in
+ */
+static void findSuccessors(ListNode **nodes, size_t n, SizeVector *successors,
+                           FileListEntry *file) {
+  size_t *labelIndices = malloc(file->nextId * sizeof(size_t));
+  for (size_t idx = 0; idx < file->nextId; ++idx) labelIndices[idx] = SIZE_MAX;
+  for (size_t idx = 0; idx < n; ++idx) {
+    X86_64LinuxInstruction *i = nodes[idx]->data;
+    if (i->kind == X86_64_LINUX_IK_LABEL) labelIndices[i->data.labelName] = idx;
+  }
+
+  for (size_t idx = 0; idx < n; ++idx) {
+    X86_64LinuxInstruction *i = nodes[idx]->data;
+    sizeVectorInit(&successors[idx]);
+    switch (i->kind) {
+      case X86_64_LINUX_IK_JUMP:
+      case X86_64_LINUX_IK_JUMPTABLE:
+      case X86_64_LINUX_IK_CJUMP: {
+        for (size_t targetIdx = 0; targetIdx < i->data.jumpTargets.size;
+             ++targetIdx) {
+          size_t target = labelIndices[i->data.jumpTargets.elements[targetIdx]];
+          if (target != SIZE_MAX) sizeVectorInsert(&successors[idx], target);
+        }
+        if (i->kind == X86_64_LINUX_IK_CJUMP && idx + 1 < n)
+          sizeVectorInsert(&successors[idx], idx + 1);
+        break;
+      }
+      case X86_64_LINUX_IK_LEAVE:
+      case X86_64_LINUX_IK_TAIL_CALL: {
+        break;
+      }
+      default: {
+        if (idx + 1 < n) sizeVectorInsert(&successors[idx], idx + 1);
+        break;
+      }
+    }
+  }
+
+  free(labelIndices);
+}
+
+/**
+ * compute the set of nodes live out of each instruction
+ *
+ * @param g graph with numbered nodes
+ * @param nodes instructions of the fragment
+ * @param n number of instructions
+ * @param file file the fragment is in
+ * @returns n bitsets of g->words words each
+ */
+static uint64_t *computeLiveness(InterferenceGraph const *g, ListNode **nodes,
+                                 size_t n, FileListEntry *file) {
+  SizeVector *successors = malloc(n * sizeof(SizeVector));
+  findSuccessors(nodes, n, successors, file);
+
+  uint64_t *liveIn = calloc(n * g->words, sizeof(uint64_t));
+  uint64_t *liveOut = calloc(n * g->words, sizeof(uint64_t));
+  uint64_t *scratch = malloc(g->words * sizeof(uint64_t));
+  bool changed;
+  do {
+    changed = false;
+    for (size_t idx = n; idx-- > 0;) {
+      X86_64LinuxInstruction *i = nodes[idx]->data;
+      uint64_t *in = liveIn + idx * g->words;
+      uint64_t *out = liveOut + idx * g->words;
+
+      // out = union of successors' in
+      for (size_t succIdx = 0; succIdx < successors[idx].size; ++succIdx) {
+        uint64_t const *succIn =
+            liveIn + successors[idx].elements[succIdx] * g->words;
+        for (size_t word = 0; word < g->words; ++word)
+          out[word] |= succIn[word];
+      }
+
+      // in = uses + (out - defines)
+      memcpy(scratch, out, g->words * sizeof(uint64_t));
+      for (size_t opIdx = 0; opIdx < i->defines.size; ++opIdx) {
+        size_t node = operandNode(g, i->defines.elements[opIdx]);
+        if (node != SIZE_MAX) bitsetClear(scratch, node);
+      }
+      for (size_t opIdx = 0; opIdx < i->uses.size; ++opIdx) {
+        size_t node = operandNode(g, i->uses.elements[opIdx]);
+        if (node != SIZE_MAX) bitsetSet(scratch, node);
+      }
+      if (memcmp(scratch, in, g->words * sizeof(uint64_t)) != 0) {
+        memcpy(in, scratch, g->words * sizeof(uint64_t));
+        changed = true;
+      }
+    }
+  } while (changed);
+
+  for (size_t idx = 0; idx < n; ++idx) sizeVectorUninit(&successors[idx]);
+  free(successors);
+  free(liveIn);
+  free(scratch);
+  return liveOut;
+}
+
+/**
+ * add interference edges between each definition and everything live after
+ * it, and record moves as coalescing candidates
+ *
+ * the source of a move doesn't interfere with its destination, since they hold
+ * the same value
+ */
+static void buildInterference(InterferenceGraph *g, ListNode **nodes, size_t n,
+                              uint64_t const *liveOut) {
+  uint64_t *live = malloc(g->words * sizeof(uint64_t));
+  for (size_t idx = 0; idx < n; ++idx) {
+    X86_64LinuxInstruction *i = nodes[idx]->data;
+    memcpy(live, liveOut + idx * g->words, g->words * sizeof(uint64_t));
+
+    if (isMove(i)) {
+      size_t to = operandNode(g, i->data.move.to);
+      size_t from = operandNode(g, i->data.move.from);
+      if (to != SIZE_MAX && from != SIZE_MAX) {
+        bitsetClear(live, from);
+        sizeVectorInsert(&g->moves, to);
+        sizeVectorInsert(&g->moves, from);
+      }
+    }
+
+    for (size_t defIdx = 0; defIdx < i->defines.size; ++defIdx) {
+      size_t def = operandNode(g, i->defines.elements[defIdx]);
+      if (def == SIZE_MAX) continue;
+      for (size_t word = 0; word < g->words; ++word) {
+        if (live[word] == 0) continue;
+        for (size_t bit = 0; bit < 64; ++bit) {
+          if ((live[word] >> bit & 1) != 0) addEdge(g, def, word * 64 + bit);
+        }
+      }
+      for (size_t otherIdx = 0; otherIdx < i->defines.size; ++otherIdx) {
+        size_t other = operandNode(g, i->defines.elements[otherIdx]);
+        if (other != SIZE_MAX) addEdge(g, def, other);
+      }
+    }
+  }
+  free(live);
+}
+
+/**
+ * Briggs' test - coalescing a and b is safe if the merged node has fewer than
+ * K significant neighbors
+ */
+static bool briggsSafe(InterferenceGraph const *g, size_t a, size_t b) {
+  uint64_t const *aNeighbors = neighbors(g, a);
+  uint64_t const *bNeighbors = neighbors(g, b);
+  size_t count = 0;
+  for (size_t node = 0; node < g->numNodes; ++node) {
+    if ((bitsetGet(aNeighbors, node) || bitsetGet(bNeighbors, node)) &&
+        significant(g, node))
+      ++count;
+  }
+  return count < numColors(g, a);
+}
+/**
+ * George's test - coalescing temp into reg is safe if every significant
+ * neighbor of temp already interferes with reg
+ */
+static bool georgeSafe(InterferenceGraph const *g, size_t reg, size_t temp) {
+  uint64_t const *tempNeighbors = neighbors(g, temp);
+  for (size_t node = 0; node < g->numNodes; ++node) {
+    if (bitsetGet(tempNeighbors, node) && !isPrecolored(node) &&
+        significant(g, node) && !interferes(g, node, reg))
+      return false;
+  }
+  return true;
+}
+/**
+ * merge node from into node into
+ */
+static void merge(InterferenceGraph *g, size_t into, size_t from) {
+  g->aliases[from] = into;
+  g->costs[into] += g->costs[from];
+  g->unspillable[into] = g->unspillable[into] && g->unspillable[from];
+  uint64_t *fromNeighbors = neighbors(g, from);
+  for (size_t node = 0; node < g->numNodes; ++node) {
+    if (!bitsetGet(fromNeighbors, node)) continue;
+    bitsetClear(fromNeighbors, node);
+    bitsetClear(neighbors(g, node), from);
+    --g->degrees[node];
+    addEdge(g, into, node);
+  }
+  g->degrees[from] = 0;
+}
+static bool isColor(size_t reg) {
+  return reg != X86_64_LINUX_RSP && reg != X86_64_LINUX_RBP;
+}
+/**
+ * conservatively coalesce move-related nodes until nothing changes
+ */
+static void coalesce(InterferenceGraph *g) {
+  bool changed;
+  do {
+    changed = false;
+    for (size_t idx = 0; idx < g->moves.size; idx += 2) {
+      size_t a = findAlias(g, g->moves.elements[idx]);
+      size_t b = findAlias(g, g->moves.elements[idx + 1]);
+      if (a == b || g->kinds[a] != g->kinds[b] || interferes(g, a, b) ||
+          (isPrecolored(a) && isPrecolored(b)))
+        continue;
+
+      if (isPrecolored(b)) {
+        size_t swap = a;
+        a = b;
+        b = swap;
+      }
+      if (isPrecolored(a) ? isColor(a) && georgeSafe(g, a, b)
+                           : briggsSafe(g, a, b)) {
+        merge(g, a, b);
+        changed = true;
+      }
+    }
+  } while (changed);
+}
+
+/**
+ * take a node out of the graph and push it onto the coloring stack
+ */
+static void simplifyNode(InterferenceGraph *g, bool *removed,
+                         SizeVector *stack, size_t node) {
+  removed[node] = true;
+  sizeVectorInsert(stack, node);
+  uint64_t const *nodeNeighbors = neighbors(g, node);
+  for (size_t other = NUM_REGISTERS; other < g->numNodes; ++other) {
+    if (!removed[other] && bitsetGet(nodeNeighbors, other))
+      --g->degrees[other];
+  }
+}
+
+/**
+ * color the graph, simplifying optimistically
+ *
+ * @param g graph to color
+ * @param colors filled in with the register for each node, or SIZE_MAX if it
+ * must be spilled
+ * @returns whether anything must be spilled
+ */
+static bool color(InterferenceGraph *g, size_t *colors) {
+  bool *removed = calloc(g->numNodes, sizeof(bool));
+  SizeVector stack;
+  sizeVectorInit(&stack);
+
+  size_t remaining = 0;
+  for (size_t node = NUM_REGISTERS; node < g->numNodes; ++node) {
+    if (g->aliases[node] == node)
+      ++remaining;
+    else
+      removed[node] = true;
+  }
+
+  // callee-save temps are colored last, so they only keep their registers if
+  // nothing else wants them
+  for (size_t node = NUM_REGISTERS; node < g->numNodes; ++node) {
+    if (!removed[node] && g->saved[node] != SIZE_MAX) {
+      simplifyNode(g, removed, &stack, node);
+      --remaining;
+    }
+  }
+
+  for (; remaining > 0; --remaining) {
+    // prefer a trivially colorable node
+    size_t pick = SIZE_MAX;
+    for (size_t node = NUM_REGISTERS; node < g->numNodes; ++node) {
+      if (!removed[node] && !significant(g, node)) {
+        pick = node;
+        break;
+      }
+    }
+
+    // otherwise, optimistically push the cheapest spill candidate
+    if (pick == SIZE_MAX) {
+      for (size_t node = NUM_REGISTERS; node < g->numNodes; ++node) {
+        if (removed[node]) continue;
+        if (pick == SIZE_MAX ||
+            (g->unspillable[pick] && !g->unspillable[node]) ||
+            (g->unspillable[pick] == g->unspillable[node] &&
+             g->costs[node] * g->degrees[pick] <
+                 g->costs[pick] * g->degrees[node]))
+          pick = node;
+      }
+    }
+
+    simplifyNode(g, removed, &stack, pick);
+  }
+
+  for (size_t node = 0; node < g->numNodes; ++node)
+    colors[node] = isPrecolored(node) ? node : SIZE_MAX;
+
+  bool spilled = false;
+  while (stack.size > 0) {
+    size_t node = stack.elements[--stack.size];
+    bool used[NUM_REGISTERS];
+    memset(used, 0, sizeof(used));
+    uint64_t const *nodeNeighbors = neighbors(g, node);
+    for (size_t other = 0; other < g->numNodes; ++other) {
+      if (bitsetGet(nodeNeighbors, other) && colors[other] != SIZE_MAX)
+        used[colors[other]] = true;
+    }
+
+    X86_64LinuxRegister const *candidates =
+        g->kinds[node] == AH_GP ? GP_COLORS : FP_COLORS;
+    if (g->saved[node] != SIZE_MAX) {
+      // a callee-save temp stays in its register, or else moves to a
+      // caller-save register or the stack - moving it into another
+      // callee-save register would just mean saving that one too
+      if (!used[g->saved[node]]) {
+        colors[node] = g->saved[node];
+      } else {
+        for (size_t idx = 0; idx < numColors(g, node); ++idx) {
+          if (!used[candidates[idx]] && !isCalleeSave(candidates[idx])) {
+            colors[node] = candidates[idx];
+            break;
+          }
+        }
+      }
+      if (colors[node] == SIZE_MAX) spilled = true;
+      continue;
+    }
+    for (size_t idx = 0; idx < numColors(g, node); ++idx) {
+      if (!used[candidates[idx]]) {
+        colors[node] = candidates[idx];
+        break;
+      }
+    }
+
+    // prefer the register of something the node is copied to or from, so the
+    // copy goes away
+    for (size_t idx = 0; idx < g->moves.size && colors[node] != SIZE_MAX;
+         idx += 2) {
+      size_t a = findAlias(g, g->moves.elements[idx]);
+      size_t b = findAlias(g, g->moves.elements[idx + 1]);
+      size_t partner = a == node ? b : b == node ? a : SIZE_MAX;
+      if (partner == SIZE_MAX || colors[partner] == SIZE_MAX ||
+          used[colors[partner]])
+        continue;
+      bool candidate = false;
+      for (size_t colorIdx = 0; colorIdx < numColors(g, node); ++colorIdx)
+        candidate = candidate || candidates[colorIdx] == colors[partner];
+      if (candidate) {
+        colors[node] = colors[partner];
+        break;
+      }
+    }
+    if (colors[node] == SIZE_MAX) spilled = true;
+  }
+
+  for (size_t node = NUM_REGISTERS; node < g->numNodes; ++node)
+    colors[node] = colors[findAlias(g, node)];
+
+  sizeVectorUninit(&stack);
+  free(removed);
+  return spilled;
+}
+
+/**
+ * run one round of graph coloring allocation
+ *
+ * @param nodes instructions of the fragment
+ * @param n number of instructions
+ * @param noSpill which temp names were introduced by spilling
+ * @param saves name of the temp each callee-save register is copied into
+ * @param assignments filled in with the register for each temp name
+ * @param spillSlots filled in with the mem temp to spill each temp name to
+ * @param file file the fragment is in
+ * @returns whether anything was spilled
+ */
+static bool graphColor(ListNode **nodes, size_t n, bool const *noSpill,
+                       size_t const *saves, size_t *assignments,
+                       size_t *spillSlots, FileListEntry *file) {
+  size_t numNames = file->nextId;
+  InterferenceGraph g;
+  graphInit(&g, nodes, n, noSpill, saves, file);
+  uint64_t *liveOut = computeLiveness(&g, nodes, n, file);
+  buildInterference(&g, nodes, n, liveOut);
+  free(liveOut);
+
+  coalesce(&g);
+  size_t *colors = malloc(g.numNodes * sizeof(size_t));
+  bool spilled = color(&g, colors);
+
+  // every node coalesced into a spilled node shares its slot
+  size_t *slots = malloc(g.numNodes * sizeof(size_t));
+  for (size_t node = 0; node < g.numNodes; ++node)
+    slots[node] = colors[node] == SIZE_MAX && findAlias(&g, node) == node
+                      ? fresh(file)
+                      : SIZE_MAX;
+  for (size_t name = 0; name < numNames; ++name) {
+    size_t node = g.tempNodes[name];
+    if (node == SIZE_MAX) continue;
+    assignments[name] = colors[node];
+    spillSlots[name] = slots[findAlias(&g, node)];
+  }
+
+  free(slots);
+  free(colors);
+  graphUninit(&g);
+  return spilled;
+}
+
+/**
+ * a temp's live range in linear scan allocation
+ *
+ * positions are twice the instruction index for uses, and one more than that
+ * for definitions, so a move's source and destination don't overlap
+ */
+typedef struct {
+  size_t name;
+  AllocHint kind;
+  size_t start;
+  size_t end;
+  bool unspillable;
+  size_t hint;  /**< instruction the temp might be copied from, or SIZE_MAX */
+  size_t saved; /**< callee-save register the temp holds, or SIZE_MAX */
+} LiveInterval;
+
+static int intervalCompare(void const *a, void const *b) {
+  LiveInterval const *lhs = a;
+  LiveInterval const *rhs = b;
+  if (lhs->start != rhs->start) return lhs->start < rhs->start ? -1 : 1;
+  if (lhs->name != rhs->name) return lhs->name < rhs->name ? -1 : 1;
+  return 0;
+}
+
+/** the positions a loop, or several overlapping loops, span */
+typedef struct {
+  size_t start;
+  size_t end;
+} LoopRegion;
+
+static int loopRegionCompare(void const *a, void const *b) {
+  LoopRegion const *lhs = a;
+  LoopRegion const *rhs = b;
+  if (lhs->start != rhs->start) return lhs->start < rhs->start ? -1 : 1;
+  return 0;
+}
+
+/**
+ * find the disjoint regions covered by the loops of a fragment
+ *
+ * overlapping loops are merged, since a lifetime stretched over one of them
+ * overlaps the others, and must be stretched over those too
+ *
+ * @returns regions, sorted by start
+ */
+static LoopRegion *findLoopRegions(size_t n, SizeVector const *successors,
+                                   size_t *numRegions) {
+  LoopRegion *regions = NULL;
+  size_t count = 0;
+  for (size_t idx = 0; idx < n; ++idx) {
+    for (size_t succIdx = 0; succIdx < successors[idx].size; ++succIdx) {
+      size_t head = successors[idx].elements[succIdx];
+      if (head > idx) continue;
+      regions = realloc(regions, ++count * sizeof(LoopRegion));
+      regions[count - 1] = (LoopRegion){2 * head, 2 * idx + 1};
+    }
+  }
+  if (count == 0) {
+    *numRegions = 0;
+    return regions;
+  }
+
+  qsort(regions, count, sizeof(LoopRegion), loopRegionCompare);
+  size_t merged = 0;
+  for (size_t idx = 1; idx < count; ++idx) {
+    if (regions[idx].start <= regions[merged].end) {
+      if (regions[idx].end > regions[merged].end)
+        regions[merged].end = regions[idx].end;
+    } else {
+      regions[++merged] = regions[idx];
+    }
+  }
+  *numRegions = merged + 1;
+  return regions;
+}
+
+static uint64_t registerMask(Vector const *operands) {
+  uint64_t mask = 0;
+  for (size_t idx = 0; idx < operands->size; ++idx) {
+    X86_64LinuxOperand const *o = operands->elements[idx];
+    if (o->kind == X86_64_LINUX_OK_REG) mask |= (uint64_t)1 << o->data.reg.reg;
+  }
+  return mask;
+}
+
+/**
+ * find the positions at which each register holds a live value
+ *
+ * register liveness is cheap to compute exactly, since there are only a few
+ * registers
+ *
+ * @param nodes instructions of the fragment
+ * @param n number of instructions
+ * @param successors successors of each instruction
+ * @param ranges array of NUM_REGISTERS vectors to fill with sorted, disjoint
+ * (start, end) pairs
+ */
+static void findRegisterRanges(ListNode **nodes, size_t n,
+                               SizeVector const *successors,
+                               SizeVector *ranges) {
+  uint64_t *liveIn = calloc(n, sizeof(uint64_t));
+  uint64_t *liveOut = calloc(n, sizeof(uint64_t));
+  bool changed;
+  do {
+    changed = false;
+    for (size_t idx = n; idx-- > 0;) {
+      X86_64LinuxInstruction *i = nodes[idx]->data;
+      for (size_t succIdx = 0; succIdx < successors[idx].size; ++succIdx)
+        liveOut[idx] |= liveIn[successors[idx].elements[succIdx]];
+      uint64_t in = registerMask(&i->uses) |
+                    (liveOut[idx] & ~registerMask(&i->defines));
+      if (in != liveIn[idx]) {
+        liveIn[idx] = in;
+        changed = true;
+      }
+    }
+  } while (changed);
+
+  for (size_t reg = 0; reg < NUM_REGISTERS; ++reg) {
+    sizeVectorInit(&ranges[reg]);
+    bool open = false;
+    for (size_t pos = 0; pos < 2 * n; ++pos) {
+      size_t idx = pos / 2;
+      uint64_t occupied =
+          pos % 2 == 0 ? liveIn[idx]
+                       : liveOut[idx] |
+                             registerMask(
+                                 &((X86_64LinuxInstruction *)nodes[idx]->data)
+                                      ->defines);
+      if ((occupied >> reg & 1) == 0) {
+        open = false;
+      } else if (open) {
+        ranges[reg].elements[ranges[reg].size - 1] = pos;
+      } else {
+        sizeVectorInsert(&ranges[reg], pos);
+        sizeVectorInsert(&ranges[reg], pos);
+        open = true;
+      }
+    }
+  }
+
+  free(liveIn);
+  free(liveOut);
+}
+
+/**
+ * does the register hold a live value anywhere in [start, end]
+ */
+static bool registerOccupied(SizeVector const *ranges, size_t start,
+                             size_t end) {
+  // find the first range ending at or after start
+  size_t low = 0;
+  size_t high = ranges->size / 2;
+  while (low < high) {
+    size_t mid = low + (high - low) / 2;
+    if (ranges->elements[2 * mid + 1] < start)
+      low = mid + 1;
+    else
+      high = mid;
+  }
+  return low < ranges->size / 2 && ranges->elements[2 * low] <= end;
+}
+
+/**
+ * build the live intervals of the temps of a fragment
+ *
+ * intervals run from the first to the last reference, and are stretched to
+ * cover any loop they overlap, since a value may be live around the back edge;
+ * temps introduced by spilling are never stretched
+ *
+ * @returns intervals, sorted by start
+ */
+static LiveInterval *buildIntervals(ListNode **nodes, size_t n,
+                                    SizeVector const *successors,
+                                    bool const *noSpill, size_t const *saves,
+                                    size_t *numIntervals, FileListEntry *file) {
+  size_t *intervalIndices = malloc(file->nextId * sizeof(size_t));
+  for (size_t idx = 0; idx < file->nextId; ++idx)
+    intervalIndices[idx] = SIZE_MAX;
+
+  size_t count = 0;
+  for (size_t idx = 0; idx < n; ++idx) {
+    X86_64LinuxInstruction *i = nodes[idx]->data;
+    Vector *operands[] = {&i->defines, &i->uses};
+    for (size_t vecIdx = 0; vecIdx < 2; ++vecIdx) {
+      for (size_t opIdx = 0; opIdx < operands[vecIdx]->size; ++opIdx) {
+        X86_64LinuxOperand *o = operands[vecIdx]->elements[opIdx];
+        if (isAllocatableTemp(o) &&
+            intervalIndices[o->data.temp.name] == SIZE_MAX)
+          intervalIndices[o->data.temp.name] = count++;
+      }
+    }
+  }
+
+  LiveInterval *intervals = malloc(count * sizeof(LiveInterval));
+  for (size_t idx = 0; idx < count; ++idx) {
+    intervals[idx].start = SIZE_MAX;
+    intervals[idx].end = 0;
+    intervals[idx].hint = SIZE_MAX;
+  }
+  for (size_t idx = 0; idx < n; ++idx) {
+    X86_64LinuxInstruction *i = nodes[idx]->data;
+    Vector *operands[] = {&i->uses, &i->defines};
+    for (size_t vecIdx = 0; vecIdx < 2; ++vecIdx) {
+      size_t pos = 2 * idx + vecIdx;
+      for (size_t opIdx = 0; opIdx < operands[vecIdx]->size; ++opIdx) {
+        X86_64LinuxOperand *o = operands[vecIdx]->elements[opIdx];
+        if (!isAllocatableTemp(o)) continue;
+        LiveInterval *interval = &intervals[intervalIndices[o->data.temp.name]];
+        if (interval->start == SIZE_MAX) {
+          interval->name = o->data.temp.name;
+          interval->kind = o->data.temp.kind;
+          interval->start = pos;
+          interval->unspillable = noSpill[o->data.temp.name];
+          interval->saved = savedRegister(saves, o->data.temp.name);
+          if (isMove(i) && i->data.move.to == o) interval->hint = idx;
+        }
+        interval->end = pos;
+      }
+    }
+  }
+
+  // stretch intervals over the loop regions they overlap; regions are
+  // disjoint, so one pass is enough
+  size_t numRegions;
+  LoopRegion *regions = findLoopRegions(n, successors, &numRegions);
+  for (size_t intervalIdx = 0; intervalIdx < count; ++intervalIdx) {
+    LiveInterval *interval = &intervals[intervalIdx];
+    // temps introduced by spilling only live between neighbouring
+    // instructions, never around a back edge
+    if (interval->unspillable) continue;
+    // find the first region ending at or after the interval's start
+    size_t low = 0;
+    size_t high = numRegions;
+    while (low < high) {
+      size_t mid = low + (high - low) / 2;
+      if (regions[mid].end < interval->start)
+        low = mid + 1;
+      else
+        high = mid;
+    }
+    for (; low < numRegions && regions[low].start <= interval->end; ++low) {
+      if (interval->start > regions[low].start)
+        interval->start = regions[low].start;
+      if (interval->end < regions[low].end) interval->end = regions[low].end;
+    }
+  }
+  free(regions);
+
+  free(intervalIndices);
+  qsort(intervals, count, sizeof(LiveInterval), intervalCompare);
+  *numIntervals = count;
+  return intervals;
+}
+
+/**
+ * run one round of linear scan allocation
+ *
+ * much cheaper than graph coloring, since it never builds an interference
+ * graph, at the cost of worse register choices
+ *
+ * @param nodes instructions of the fragment, in layout order
+ * @param n number of instructions
+ * @param noSpill which temp names were introduced by spilling
+ * @param saves name of the temp each callee-save register is copied into
+ * @param assignments filled in with the register for each temp name
+ * @param spillSlots filled in with the mem temp to spill each temp name to
+ * @param file file the fragment is in
+ * @returns whether anything was spilled
+ */
+static bool linearScan(ListNode **nodes, size_t n, bool const *noSpill,
+                       size_t const *saves, size_t *assignments,
+                       size_t *spillSlots, FileListEntry *file) {
+  SizeVector *successors = malloc(n * sizeof(SizeVector));
+  findSuccessors(nodes, n, successors, file);
+  SizeVector ranges[NUM_REGISTERS];
+  findRegisterRanges(nodes, n, successors, ranges);
+  size_t numIntervals;
+  LiveInterval *intervals =
+      buildIntervals(nodes, n, successors, noSpill, saves, &numIntervals,
+                     file);
+  for (size_t idx = 0; idx < n; ++idx) sizeVectorUninit(&successors[idx]);
+  free(successors);
+
+  size_t owners[NUM_REGISTERS]; /**< interval holding each register */
+  for (size_t reg = 0; reg < NUM_REGISTERS; ++reg) owners[reg] = SIZE_MAX;
+  bool spilled = false;
+  for (size_t idx = 0; idx < numIntervals; ++idx) {
+    LiveInterval *curr = &intervals[idx];
+
+    // expire intervals that ended before this one starts
+    for (size_t reg = 0; reg < NUM_REGISTERS; ++reg) {
+      if (owners[reg] != SIZE_MAX && intervals[owners[reg]].end < curr->start)
+        owners[reg] = SIZE_MAX;
+    }
+
+    X86_64LinuxRegister const *candidates =
+        curr->kind == AH_GP ? GP_COLORS : FP_COLORS;
+    size_t numCandidates = curr->kind == AH_GP ? NUM_GP_COLORS : NUM_FP_COLORS;
+
+    // prefer the register this temp is copied from
+    size_t reg = SIZE_MAX;
+    if (curr->hint != SIZE_MAX) {
+      X86_64LinuxInstruction *i = nodes[curr->hint]->data;
+      X86_64LinuxOperand const *from = i->data.move.from;
+      size_t hint = SIZE_MAX;
+      if (from->kind == X86_64_LINUX_OK_REG)
+        hint = from->data.reg.reg;
+      else if (isAllocatableTemp(from))
+        hint = assignments[from->data.temp.name];
+      for (size_t candIdx = 0; hint != SIZE_MAX && candIdx < numCandidates;
+           ++candIdx) {
+        if (candidates[candIdx] == hint && owners[hint] == SIZE_MAX &&
+            !registerOccupied(&ranges[hint], curr->start, curr->end))
+          reg = hint;
+      }
+    }
+    // callee-save temps never move into another callee-save register, since
+    // that one would then need saving too
+    for (size_t candIdx = 0; reg == SIZE_MAX && candIdx < numCandidates;
+         ++candIdx) {
+      size_t candidate = candidates[candIdx];
+      if (curr->saved != SIZE_MAX && isCalleeSave(candidate)) continue;
+      if (owners[candidate] == SIZE_MAX &&
+          !registerOccupied(&ranges[candidate], curr->start, curr->end))
+        reg = candidate;
+    }
+
+    if (reg == SIZE_MAX) {
+      // spill whichever usable interval ends last
+      size_t victimReg = SIZE_MAX;
+      for (size_t candIdx = 0; candIdx < numCandidates; ++candIdx) {
+        size_t candidate = candidates[candIdx];
+        if (owners[candidate] == SIZE_MAX ||
+            intervals[owners[candidate]].unspillable ||
+            registerOccupied(&ranges[candidate], curr->start, curr->end))
+          continue;
+        if (victimReg == SIZE_MAX ||
+            intervals[owners[candidate]].end > intervals[owners[victimReg]].end)
+          victimReg = candidate;
+      }
+
+      if (victimReg != SIZE_MAX && curr->saved == SIZE_MAX &&
+          (curr->unspillable ||
+           intervals[owners[victimReg]].end > curr->end)) {
+        size_t victim = intervals[owners[victimReg]].name;
+        assignments[victim] = SIZE_MAX;
+        spillSlots[victim] = fresh(file);
+        reg = victimReg;
+      } else if (!curr->unspillable) {
+        spillSlots[curr->name] = fresh(file);
+      } else {
+        error(__FILE__, __LINE__, "no register available for a spill temp");
+      }
+      spilled = true;
+    }
+
+    if (reg != SIZE_MAX) {
+      owners[reg] = idx;
+      assignments[curr->name] = reg;
+    }
+  }
+
+  for (size_t reg = 0; reg < NUM_REGISTERS; ++reg)
+    sizeVectorUninit(&ranges[reg]);
+  free(intervals);
+  return spilled;
+}
+
+static X86_64LinuxOperand *tempCreate(size_t name, size_t size,
+                                      size_t alignment, AllocHint kind) {
+  X86_64LinuxOperand *retval = malloc(sizeof(X86_64LinuxOperand));
+  retval->kind = X86_64_LINUX_OK_TEMP;
+  retval->data.temp.name = name;
+  retval->data.temp.size = size;
+  retval->data.temp.alignment = alignment;
+  retval->data.temp.kind = kind;
+  retval->data.temp.escapes = false;
+  return retval;
+}
+
+/**
+ * grow the set of temps introduced by spilling to cover all current names
+ */
+static void growNoSpill(bool **noSpill, size_t *size, FileListEntry *file) {
+  *noSpill = realloc(*noSpill, file->nextId * sizeof(bool));
+  memset(*noSpill + *size, 0, (file->nextId - *size) * sizeof(bool));
+  *size = file->nextId;
+}
+
+/**
+ * get the slot a temp operand is spilled to
+ *
+ * @returns slot name, or SIZE_MAX if the operand isn't spilled
+ */
+static size_t spillSlot(X86_64LinuxOperand const *o, size_t const *spillSlots,
+                        size_t numNames) {
+  return isAllocatableTemp(o) && o->data.temp.name < numNames
+             ? spillSlots[o->data.temp.name]
+             : SIZE_MAX;
+}
+
+/**
+ * rewrite spilled temps so each reference goes through a fresh, short-lived
+ * temp loaded from and stored to the spilled temp's stack slot
+ *
+ * @param instructions instructions to rewrite
+ * @param spillSlots mem temp each temp name is spilled to, or SIZE_MAX
+ * @param numNames number of entries in spillSlots
+ * @param noSpill which temp names were introduced by spilling - grown and
+ * updated
+ * @param noSpillSize number of entries in noSpill
+ * @param file file the fragment is in
+ */
+static void rewriteSpills(LinkedList *instructions, size_t const *spillSlots,
+                          size_t numNames, bool **noSpill, size_t *noSpillSize,
+                          FileListEntry *file) {
+  // slots are shaped to fit the largest temp spilled into them
+  size_t numSlots = file->nextId;
+  size_t *slotSizes = calloc(numSlots, sizeof(size_t));
+  size_t *slotAlignments = calloc(numSlots, sizeof(size_t));
+  for (ListNode *curr = instructions->head->next; curr != instructions->tail;
+       curr = curr->next) {
+    X86_64LinuxInstruction *i = curr->data;
+    Vector *operands[] = {&i->uses, &i->defines};
+    for (size_t vecIdx = 0; vecIdx < 2; ++vecIdx) {
+      for (size_t opIdx = 0; opIdx < operands[vecIdx]->size; ++opIdx) {
+        X86_64LinuxOperand *o = operands[vecIdx]->elements[opIdx];
+        size_t slot = spillSlot(o, spillSlots, numNames);
+        if (slot == SIZE_MAX) continue;
+        if (o->data.temp.size > slotSizes[slot])
+          slotSizes[slot] = o->data.temp.size;
+        if (o->data.temp.alignment > slotAlignments[slot])
+          slotAlignments[slot] = o->data.temp.alignment;
+      }
+    }
+  }
+
+  SizeVector replacedSlots;
+  SizeVector replacements;
+  sizeVectorInit(&replacedSlots);
+  sizeVectorInit(&replacements);
+  for (ListNode *curr = instructions->head->next, *next;
+       curr != instructions->tail; curr = next) {
+    next = curr->next;
+    X86_64LinuxInstruction *i = curr->data;
+    replacedSlots.size = 0;
+    replacements.size = 0;
+
+    Vector *operands[] = {&i->uses, &i->defines};
+    for (size_t vecIdx = 0; vecIdx < 2; ++vecIdx) {
+      for (size_t opIdx = 0; opIdx < operands[vecIdx]->size; ++opIdx) {
+        X86_64LinuxOperand *o = operands[vecIdx]->elements[opIdx];
+        size_t slot = spillSlot(o, spillSlots, numNames);
+        if (slot == SIZE_MAX) continue;
+
+        size_t replacement = SIZE_MAX;
+        for (size_t idx = 0; idx < replacedSlots.size; ++idx) {
+          if (replacedSlots.elements[idx] == slot)
+            replacement = replacements.elements[idx];
+        }
+        if (replacement == SIZE_MAX) {
+          replacement = fresh(file);
+          sizeVectorInsert(&replacedSlots, slot);
+          sizeVectorInsert(&replacements, replacement);
+          growNoSpill(noSpill, noSpillSize, file);
+          (*noSpill)[replacement] = true;
+        }
+
+        // the whole slot is moved, since a temp may be written as a dword
+        // and read as a qword
+        X86_64LinuxOperand *slotOperand = tempCreate(
+            slot, slotSizes[slot], slotAlignments[slot], AH_MEM);
+        X86_64LinuxOperand *temp =
+            tempCreate(replacement, slotSizes[slot], slotAlignments[slot],
+                       o->data.temp.kind);
+        if (operands[vecIdx] == &i->uses)
+          insertNodeBefore(curr,
+                           x86_64LinuxMoveInstructionCreate(temp, slotOperand));
+        else
+          insertNodeAfter(curr,
+                          x86_64LinuxMoveInstructionCreate(slotOperand, temp));
+        o->data.temp.name = replacement;
+      }
+    }
+  }
+  sizeVectorUninit(&replacedSlots);
+  sizeVectorUninit(&replacements);
+
+  free(slotSizes);
+  free(slotAlignments);
+}
+
+/**
+ * replace temps with their registers, and drop moves made redundant by
+ * coalescing
+ *
+ * @param instructions instructions to rewrite
+ * @param assignments register for each temp name
+ * @param numNames number of entries in assignments
+ */
+static void applyAssignments(LinkedList *instructions,
+                             size_t const *assignments, size_t numNames) {
+  for (ListNode *curr = instructions->head->next, *next;
+       curr != instructions->tail; curr = next) {
+    next = curr->next;
+    X86_64LinuxInstruction *i = curr->data;
+    Vector *operands[] = {&i->defines, &i->uses};
+    for (size_t vecIdx = 0; vecIdx < 2; ++vecIdx) {
+      for (size_t opIdx = 0; opIdx < operands[vecIdx]->size; ++opIdx) {
+        X86_64LinuxOperand *o = operands[vecIdx]->elements[opIdx];
+        if (!isAllocatableTemp(o)) continue;
+        if (o->data.temp.name >= numNames ||
+            assignments[o->data.temp.name] == SIZE_MAX)
+          error(__FILE__, __LINE__, "temp was not assigned a register");
+        X86_64LinuxOperand *reg = x86_64LinuxRegOperandCreate(
+            (X86_64LinuxRegister)assignments[o->data.temp.name],
+            o->data.temp.size);
+        *o = *reg;
+        x86_64LinuxOperandFree(reg);
+      }
+    }
+
+    if (isMove(i)) {
+      X86_64LinuxOperand const *to = i->data.move.to;
+      X86_64LinuxOperand const *from = i->data.move.from;
+      if (to->kind == X86_64_LINUX_OK_REG &&
+          from->kind == X86_64_LINUX_OK_REG &&
+          to->data.reg.reg == from->data.reg.reg &&
+          to->data.reg.size == from->data.reg.size)
+        x86_64LinuxInstructionFree(removeNode(curr));
+    }
+  }
+}
+
+/**
+ * copy each callee-save register into a temp on entry and back before each
+ * exit, so the allocator can either keep the register or spill it if it
+ * needs more registers
+ *
+ * @param saves filled in with the name of the temp each callee-save register
+ * is copied into
+ */
+static void addCalleeSaves(LinkedList *instructions, size_t *saves,
+                           FileListEntry *file) {
+  for (size_t idx = 0; idx < X86_64_LINUX_NUM_CALLEE_SAVE_REGISTERS; ++idx) {
+    saves[idx] = fresh(file);
+    insertNodeBefore(
+        instructions->head->next,
+        x86_64LinuxMoveInstructionCreate(
+            tempCreate(saves[idx], X86_64_LINUX_REGISTER_WIDTH,
+                       X86_64_LINUX_REGISTER_WIDTH, AH_GP),
+            x86_64LinuxRegOperandCreate(X86_64_LINUX_CALLEE_SAVE_REGISTERS[idx],
+                                        X86_64_LINUX_REGISTER_WIDTH)));
+  }
+
+  for (ListNode *curr = instructions->head->next; curr != instructions->tail;
+       curr = curr->next) {
+    X86_64LinuxInstruction *i = curr->data;
+    if (i->kind != X86_64_LINUX_IK_LEAVE &&
+        i->kind != X86_64_LINUX_IK_TAIL_CALL)
+      continue;
+    for (size_t idx = 0; idx < X86_64_LINUX_NUM_CALLEE_SAVE_REGISTERS; ++idx)
+      insertNodeBefore(
+          curr,
+          x86_64LinuxMoveInstructionCreate(
+              x86_64LinuxRegOperandCreate(
+                  X86_64_LINUX_CALLEE_SAVE_REGISTERS[idx],
+                  X86_64_LINUX_REGISTER_WIDTH),
+              tempCreate(saves[idx], X86_64_LINUX_REGISTER_WIDTH,
+                         X86_64_LINUX_REGISTER_WIDTH, AH_GP)));
+  }
+}
+
+/**
+ * allocate registers for a text fragment
+ *
+ * allocates, then rewrites spilled temps and starts over, until everything
+ * gets a register
+ */
+static void allocateFragRegisters(X86_64LinuxFrag *frag, FileListEntry *file) {
+  LinkedList *instructions = &frag->data.text.instructions;
+  size_t saves[NUM_REGISTERS];
+  addCalleeSaves(instructions, saves, file);
+
+  bool linear =
+      options.registerAllocator == OPTION_RA_LINEAR_SCAN ||
+      (options.registerAllocator == OPTION_RA_AUTO &&
+       linkedListLength(instructions) > options.linearScanThreshold);
+
+  bool *noSpill = NULL;
+  size_t noSpillSize = 0;
+  while (true) {
+    growNoSpill(&noSpill, &noSpillSize, file);
+
+    size_t n = linkedListLength(instructions);
+    ListNode **nodes = malloc(n * sizeof(ListNode *));
+    size_t idx = 0;
+    for (ListNode *curr = instructions->head->next; curr != instructions->tail;
+         curr = curr->next)
+      nodes[idx++] = curr;
+
+    size_t numNames = file->nextId;
+    size_t *assignments = malloc(numNames * sizeof(size_t));
+    size_t *spillSlots = malloc(numNames * sizeof(size_t));
+    for (size_t name = 0; name < numNames; ++name)
+      assignments[name] = spillSlots[name] = SIZE_MAX;
+
+    bool spilled =
+        linear
+            ? linearScan(nodes, n, noSpill, saves, assignments, spillSlots,
+                         file)
+            : graphColor(nodes, n, noSpill, saves, assignments, spillSlots,
+                         file);
+    free(nodes);
+    if (spilled)
+      rewriteSpills(instructions, spillSlots, numNames, &noSpill, &noSpillSize,
+                    file);
+    else
+      applyAssignments(instructions, assignments, numNames);
+    free(assignments);
+    free(spillSlots);
+
+    if (!spilled) break;
+  }
+  free(noSpill);
+}
+
+void x86_64LinuxAllocateRegisters(void) {
+  for (size_t fileIdx = 0; fileIdx < fileList.size; ++fileIdx) {
+    FileListEntry *file = &fileList.entries[fileIdx];
+    X86_64LinuxFile *asmFile = file->asmFile;
+    for (size_t fragIdx = 0; fragIdx < asmFile->frags.size; ++fragIdx) {
+      X86_64LinuxFrag *frag = asmFile->frags.elements[fragIdx];
+      if (frag->kind == X86_64_LINUX_FK_TEXT)
+        allocateFragRegisters(frag, file);
+    }
+  }
+}
@@ -0,0 +1,34 @@
+// Copyright 2021 Justin Hu
+//
+// This file is part of the T Language Compiler.
+//
+// The T Language Compiler is free software: you can redistribute it and/or
+// modify it under the terms of the GNU General Public License as published by
+// the Free Software Foundation, either version 3 of the License, or (at your
+// option) any later version.
+//
+// The T Language Compiler is distributed in the hope that it will be useful,
+// but WITHOUT ANY WARRANTY; without even the implied warranty of
+// MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the GNU General
+// Public License for more details.
+//
+// You should have received a copy of the GNU General Public License along with
+// the T Language Compiler. If not see <https://www.gnu.org/licenses/>.
+//
+// SPDX-License-Identifier: GPL-3.0-or-later
+
+/**
+ * @file
+ * Register allocation for x86_64 linux
+ */
+
+#ifndef TLC_ARCH_X86_64_LINUX_REGISTERALLOCATION_H_
+#define TLC_ARCH_X86_64_LINUX_REGISTERALLOCATION_H_
+
+/**
+ * replace every gp and fp temp in the generated assembly with a register,
+ * spilling temps into mem temps where there are not enough registers
+ */
+void x86_64LinuxAllocateRegisters(void);
+
+#endif  // TLC_ARCH_X86_64_LINUX_REGISTERALLOCATION_H_
@@ -0,0 +1,226 @@
+// Copyright 2021 Justin Hu
+//
+// This file is part of the T Language Compiler.
+//
+// The T Language Compiler is free software: you can redistribute it and/or
+// modify it under the terms of the GNU General Public License as published by
+// the Free Software Foundation, either version 3 of the License, or (at your
+// option) any later version.
+//
+// The T Language Compiler is distributed in the hope that it will be useful,
+// but WITHOUT ANY WARRANTY; without even the implied warranty of
+// MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the GNU General
+// Public License for more details.
+//
+// You should have received a copy of the GNU General Public License along with
+// the T Language Compiler. If not see <https://www.gnu.org/licenses/>.
+//
+// SPDX-License-Identifier: GPL-3.0-or-later
+
+#include "arch/x86_64-linux/writer.h"
+
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+
+#include "arch/x86_64-linux/asm.h"
+#include "fileList.h"
+#include "util/fileWriter.h"
+#include "util/format.h"
+#include "util/internalError.h"
+
+/** names of the low 32, 16, and 8 bits of the gp registers */
+static char const *const DWORD_REGISTER_NAMES[] = {
+    "eax", "ebx", "ecx",  "edx",  "esi",  "edi",  "esp",  "ebp",
+    "r8d", "r9d", "r10d", "r11d", "r12d", "r13d", "r14d", "r15d",
+};
+static char const *const WORD_REGISTER_NAMES[] = {
+    "ax",  "bx",  "cx",   "dx",   "si",   "di",   "sp",   "bp",
+    "r8w", "r9w", "r10w", "r11w", "r12w", "r13w", "r14w", "r15w",
+};
+static char const *const BYTE_REGISTER_NAMES[] = {
+    "al",  "bl",  "cl",   "dl",   "sil",  "dil",  "spl",  "bpl",
+    "r8b", "r9b", "r10b", "r11b", "r12b", "r13b", "r14b", "r15b",
+};
+
+static char const *registerName(X86_64LinuxRegister reg, size_t size) {
+  if (reg > X86_64_LINUX_R15) return x86_64LinuxPrettyPrintRegister(reg);
+  switch (size) {
+    case 1: {
+      return BYTE_REGISTER_NAMES[reg];
+    }
+    case 2: {
+      return WORD_REGISTER_NAMES[reg];
+    }
+    case 4: {
+      return DWORD_REGISTER_NAMES[reg];
+    }
+    default: {
+      return x86_64LinuxPrettyPrintRegister(reg);
+    }
+  }
+}
+
+/**
+ * get the size keyword for a memory operand, or NULL if there isn't one
+ */
+static char const *sizeKeyword(size_t size) {
+  switch (size) {
+    case 1: {
+      return "byte";
+    }
+    case 2: {
+      return "word";
+    }
+    case 4: {
+      return "dword";
+    }
+    case 8: {
+      return "qword";
+    }
+    case 16: {
+      return "oword";
+    }
+    default: {
+      return NULL;
+    }
+  }
+}
+
+static void writeOperand(FileWriter *w, X86_64LinuxOperand const *o) {
+  switch (o->kind) {
+    case X86_64_LINUX_OK_REG: {
+      fileWriterWriteString(w, registerName(o->data.reg.reg, o->data.reg.size));
+      break;
+    }
+    case X86_64_LINUX_OK_OFFSET: {
+      fileWriterWriteSigned(w, o->data.offset.offset);
+      break;
+    }
+    case X86_64_LINUX_OK_STACK: {
+      char const *keyword = sizeKeyword(o->data.stack.size);
+      if (keyword != NULL) {
+        fileWriterWriteString(w, keyword);
+        fileWriterWriteChar(w, ' ');
+      }
+      fileWriterWriteChar(w, '[');
+      fileWriterWriteString(w, registerName(o->data.stack.base, 8));
+      if (o->data.stack.offset < 0) {
+        fileWriterWriteString(w, " - ");
+        fileWriterWriteUnsigned(w, -(uint64_t)o->data.stack.offset);
+      } else if (o->data.stack.offset > 0) {
+        fileWriterWriteString(w, " + ");
+        fileWriterWriteUnsigned(w, (uint64_t)o->data.stack.offset);
+      }
+      fileWriterWriteChar(w, ']');
+      break;
+    }
+    default: {
+      error(__FILE__, __LINE__, "unallocated operand at write out");
+    }
+  }
+}
+
+/**
+ * render an instruction's skeleton, substituting its operands
+ */
+static void writeInstruction(FileWriter *w, X86_64LinuxInstruction const *i) {
+  size_t define = 0;
+  size_t use = 0;
+  size_t other = 0;
+  char const *run = i->skeleton;
+  for (char const *curr = run; *curr != '\0'; ++curr) {
+    if (*curr != '`') continue;
+
+    fileWriterWrite(w, run, (size_t)(curr - run));
+    ++curr;
+    switch (*curr) {
+      case 'd': {
+        writeOperand(w, i->defines.elements[define++]);
+        break;
+      }
+      case 'u': {
+        writeOperand(w, i->uses.elements[use++]);
+        break;
+      }
+      case 'o': {
+        writeOperand(w, i->other.elements[other++]);
+        break;
+      }
+      case '`': {
+        fileWriterWriteChar(w, '`');
+        break;
+      }
+      default: {
+        error(__FILE__, __LINE__, "invalid instruction skeleton");
+      }
+    }
+    run = curr + 1;
+  }
+  fileWriterWriteString(w, run);
+}
+
+static void writeFrag(FileWriter *w, X86_64LinuxFrag *frag) {
+  switch (frag->kind) {
+    case X86_64_LINUX_FK_TEXT: {
+      fileWriterWriteString(w, frag->data.text.header);
+      LinkedList *instructions = &frag->data.text.instructions;
+      for (ListNode *curr = instructions->head->next;
+           curr != instructions->tail; curr = curr->next)
+        writeInstruction(w, curr->data);
+      fileWriterWriteString(w, frag->data.text.footer);
+      break;
+    }
+    case X86_64_LINUX_FK_DATA: {
+      // data is already rendered - hand over the string instead of copying it
+      fileWriterWriteOwnedString(w, frag->data.data.data);
+      frag->data.data.data = NULL;
+      break;
+    }
+    default: {
+      error(__FILE__, __LINE__, "invalid X86_64LinuxFrag");
+    }
+  }
+}
+
+/**
+ * get the name of the assembly file for a code file
+ */
+static char *outputFilename(char const *inputFilename) {
+  // code files always end in ".tc"
+  size_t length = strlen(inputFilename) - 3;
+  return format("%.*s.s", (int)length, inputFilename);
+}
+
+int x86_64LinuxWriteAsm(void) {
+  int retval = 0;
+  for (size_t fileIdx = 0; fileIdx < fileList.size; ++fileIdx) {
+    FileListEntry *file = &fileList.entries[fileIdx];
+    if (!file->isCode) continue;
+    X86_64LinuxFile *asmFile = file->asmFile;
+
+    char *filename = outputFilename(file->inputFilename);
+    FileWriter w;
+    if (fileWriterInit(&w, filename) != 0) {
+      fprintf(stderr, "%s: error: cannot open file\n", filename);
+      free(filename);
+      retval = -1;
+      continue;
+    }
+
+    fileWriterWriteString(&w, asmFile->header);
+    for (size_t fragIdx = 0; fragIdx < asmFile->frags.size; ++fragIdx) {
+      writeFrag(&w, asmFile->frags.elements[fragIdx]);
+      x86_64LinuxFragFree(asmFile->frags.elements[fragIdx]);
+    }
+    asmFile->frags.size = 0;  // already freed
+    fileWriterWriteString(&w, asmFile->footer);
+
+    if (fileWriterUninit(&w) != 0) {
+      fprintf(stderr, "%s: error: cannot write file\n", filename);
+      retval = -1;
+    }
+    free(filename);
+  }
+  return retval;
+}
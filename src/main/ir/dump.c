@@ -71,6 +71,19 @@ static void datumDump(FILE *where, IRDatum *datum) {
       fprintf(where, "GLOBAL(%s)", datum->data.globalLabel);
       break;
     }
+    case DT_BLOB: {
+      fprintf(where, "BLOB(");
+      for (size_t idx = 0; idx < datum->data.blob.length; ++idx) {
+        fprintf(where, "%02hhX", datum->data.blob.bytes[idx]);
+      }
+      fprintf(where, ")");
+      break;
+    }
+    case DT_FILL: {
+      fprintf(where, "FILL(%zu, %zu, %lu)", datum->data.fill.width,
+              datum->data.fill.count, datum->data.fill.value);
+      break;
+    }
   }
 }
 
@@ -228,6 +241,8 @@ static void fragDump(FILE *where, IRFrag *frag) {
     case FT_TEXT: {
       fprintf(where, "TEXT(");
       fragNameDump(where, frag);
+      if (frag->data.text.coldLabel != 0)
+        fprintf(where, ", COLD(LOCAL(%zu))", frag->data.text.coldLabel);
       fprintf(where, ",\n");
       for (ListNode *curr = frag->data.text.blocks.head->next;
            curr != frag->data.text.blocks.tail; curr = curr->next) {
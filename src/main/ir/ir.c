@@ -20,6 +20,7 @@
 #include "ir/ir.h"
 
 #include <stdlib.h>
+#include <string.h>
 
 #include "arch/interface.h"
 #include "fileList.h"
@@ -51,6 +52,7 @@ IRFrag *textFragCreate(char *name) {
   IRFrag *df = fragCreate(FT_TEXT, FNT_GLOBAL);
   df->name.global = name;
   linkedListInit(&df->data.text.blocks);
+  df->data.text.coldLabel = 0;
   return df;
 }
 IRFrag *findFrag(Vector *frags, size_t label) {
@@ -141,6 +143,37 @@ IRDatum *globalLabelDatumCreate(char *label) {
   d->data.globalLabel = label;
   return d;
 }
+IRDatum *blobDatumCreate(uint8_t *bytes, size_t length) {
+  IRDatum *d = datumCreate(DT_BLOB);
+  d->data.blob.bytes = bytes;
+  d->data.blob.length = length;
+  return d;
+}
+IRDatum *fillDatumCreate(uint64_t value, size_t width, size_t count) {
+  IRDatum *d = datumCreate(DT_FILL);
+  d->data.fill.value = value;
+  d->data.fill.width = width;
+  d->data.fill.count = count;
+  return d;
+}
+/**
+ * capacity of a blob's buffer - the blob grows by doubling, so this is the
+ * smallest power of two that holds length bytes
+ */
+static size_t blobCapacity(size_t length) {
+  size_t capacity = 8;
+  while (capacity < length) capacity *= 2;
+  return capacity;
+}
+void blobDatumAppend(IRDatum *blob, uint64_t value, size_t width) {
+  size_t length = blob->data.blob.length;
+  if (length == 0 || blobCapacity(length) < length + width)
+    blob->data.blob.bytes =
+        realloc(blob->data.blob.bytes, blobCapacity(length + width));
+  for (size_t idx = 0; idx < width; ++idx)
+    blob->data.blob.bytes[length + idx] = (uint8_t)(value >> (8 * idx));
+  blob->data.blob.length += width;
+}
 void irDatumFree(IRDatum *d) {
   switch (d->type) {
     case DT_STRING: {
@@ -155,6 +188,10 @@ void irDatumFree(IRDatum *d) {
       free(d->data.globalLabel);
       break;
     }
+    case DT_BLOB: {
+      free(d->data.blob.bytes);
+      break;
+    }
     default: {
       break;
     }
@@ -190,6 +227,15 @@ IRDatum *irDatumCopy(IRDatum const *d) {
     case DT_GLOBAL: {
       return globalLabelDatumCreate(strdup(d->data.globalLabel));
     }
+    case DT_BLOB: {
+      uint8_t *bytes = malloc(blobCapacity(d->data.blob.length));
+      memcpy(bytes, d->data.blob.bytes, d->data.blob.length);
+      return blobDatumCreate(bytes, d->data.blob.length);
+    }
+    case DT_FILL: {
+      return fillDatumCreate(d->data.fill.value, d->data.fill.width,
+                             d->data.fill.count);
+    }
     default: {
       error(__FILE__, __LINE__, "invalid DatumType");
     }
@@ -222,6 +268,12 @@ static size_t irDatumSizeof(IRDatum const *d) {
     case DT_GLOBAL: {
       return POINTER_WIDTH;
     }
+    case DT_BLOB: {
+      return d->data.blob.length;
+    }
+    case DT_FILL: {
+      return d->data.fill.width * d->data.fill.count;
+    }
     default: {
       error(__FILE__, __LINE__, "invalid DatumType");
     }
@@ -352,7 +404,8 @@ size_t irOperatorArity(IROperator op) {
     case IO_VOLATILE:
     case IO_UNINITIALIZED:
     case IO_JUMP:
-    case IO_CALL: {
+    case IO_CALL:
+    case IO_TAIL_CALL: {
       return 1;
     }
     case IO_MOVE:
@@ -450,6 +503,7 @@ size_t irOperatorArity(IROperator op) {
     case IO_J2FLE:
     case IO_J2FE:
     case IO_J2FNE:
+    case IO_SELECT:
     case IO_J2FG:
     case IO_J2FGE: {
       return 4;
@@ -569,6 +623,7 @@ char const *const IROPERATOR_NAMES[] = {
     "Z",
     "NZ",
     "LNOT",
+    "SELECT",
     "SX",
     "ZX",
     "TRUNC",
@@ -615,6 +670,7 @@ char const *const IROPERATOR_NAMES[] = {
     "J1Z",
     "J1NZ",
     "CALL",
+    "TAIL_CALL",
     "RETURN",
 };
 char const *const IROPERAND_NAMES[] = {
@@ -1050,6 +1106,7 @@ static int validateIr(char const *phase, bool blocked) {
               case IO_J1FGE:
               case IO_J1Z:
               case IO_J1NZ:
+              case IO_TAIL_CALL:
               case IO_RETURN: {
                 break;
               }
@@ -1329,6 +1386,35 @@ static int validateIr(char const *phase, bool blocked) {
                 validateArgByteRead(i, 1, temps, phase, file);
                 break;
               }
+              case IO_SELECT: {
+                validateArgWritable(i, 0, temps, phase, file);
+                if (i->args[0]->kind == OK_TEMP) {
+                  validateTempGP(i, 0, phase, file);
+                  validateTempWrite(temps, i->args[0], phase, file);
+                }
+
+                validateArgByteRead(i, 1, temps, phase, file);
+
+                validateArgRead(i, 2, temps, localLabels, phase, file);
+                if (i->args[2]->kind == OK_TEMP)
+                  validateTempGP(i, 2, phase, file);
+
+                validateArgRead(i, 3, temps, localLabels, phase, file);
+                if (i->args[3]->kind == OK_TEMP)
+                  validateTempGP(i, 3, phase, file);
+
+                validateArgsSameSize(i, 0, 2, phase, file);
+                validateArgsSameSize(i, 0, 3, phase, file);
+                if (irOperandSizeof(i->args[0]) == BYTE_WIDTH) {
+                  fprintf(stderr,
+                          "%s: internal compiler error: IR validation after "
+                          "%s failed - SELECT instruction's values can't be "
+                          "bytes\n",
+                          file->inputFilename, phase);
+                  file->errored = true;
+                }
+                break;
+              }
               case IO_SX:
               case IO_ZX: {
                 validateArgWritable(i, 0, temps, phase, file);
@@ -1645,6 +1731,19 @@ static int validateIr(char const *phase, bool blocked) {
                 validateArgJumpTarget(i, 0, temps, localLabels, phase, file);
                 break;
               }
+              case IO_TAIL_CALL: {
+                validateArgJumpTarget(i, 0, temps, localLabels, phase, file);
+                if (blocked && currInst->next != block->instructions.tail) {
+                  fprintf(stderr,
+                          "%s: internal compiler error: IR validation after %s "
+                          "failed - non-terminal tail call encountered in %s "
+                          "IR\n",
+                          file->inputFilename, phase,
+                          blocked ? "basic block" : "scheduled");
+                  file->errored = true;
+                }
+                break;
+              }
               case IO_RETURN: {
                 if (blocked && currInst->next != block->instructions.tail) {
                   fprintf(stderr,
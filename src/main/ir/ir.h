@@ -59,6 +59,7 @@ typedef struct {
     } data;
     struct {
       LinkedList blocks; /**< list of IRBlock - first one is the entry block */
+      size_t coldLabel;  /**< first label of the cold code, or zero if none */
     } text;
   } data;
 } IRFrag;
@@ -86,6 +87,8 @@ typedef enum {
   DT_WSTRING,
   DT_LOCAL,
   DT_GLOBAL,
+  DT_BLOB,
+  DT_FILL,
 } DatumType;
 /** a data element - handles endianness */
 typedef struct {
@@ -100,6 +103,15 @@ typedef struct {
     uint32_t *wstring;
     size_t localLabel;
     char *globalLabel;
+    struct {
+      uint8_t *bytes; /**< little-endian contents */
+      size_t length;
+    } blob;
+    struct {
+      uint64_t value; /**< zero-extended value to repeat */
+      size_t width;   /**< size of one copy of value */
+      size_t count;
+    } fill;
   } data;
 } IRDatum;
 
@@ -113,6 +125,12 @@ IRDatum *stringDatumCreate(uint8_t *string);
 IRDatum *wstringDatumCreate(uint32_t *wstring);
 IRDatum *localLabelDatumCreate(size_t label);
 IRDatum *globalLabelDatumCreate(char *label);
+IRDatum *blobDatumCreate(uint8_t *bytes, size_t length);
+IRDatum *fillDatumCreate(uint64_t value, size_t width, size_t count);
+/**
+ * append width little-endian bytes of value to a blob datum
+ */
+void blobDatumAppend(IRDatum *blob, uint64_t value, size_t width);
 /** copy */
 IRDatum *irDatumCopy(IRDatum const *d);
 /** dtor */
@@ -448,6 +466,21 @@ typedef enum IROperator {
    *    BYTE_WIDTH
    */
   IO_LNOT,
+  /**
+   * select one of two values by a condition, without branching
+   *
+   * four operands
+   * 0: REG | TEMP, written, allocation == (GP | MEM)
+   * 1: REG | TEMP, read, allocation == (GP | MEM) | CONST; size ==
+   *    BYTE_WIDTH; the condition
+   * 2: REG | TEMP, read, allocation == (GP | MEM) | CONST; the value if the
+   *    condition is nonzero
+   * 3: REG | TEMP, read, allocation == (GP | MEM) | CONST; the value if the
+   *    condition is zero
+   *
+   * sizeof(0) == sizeof(2) == sizeof(3) > BYTE_WIDTH
+   */
+  IO_SELECT,
 
   // conversion
   /**
@@ -618,6 +651,15 @@ typedef enum IROperator {
    *    POINTER_WIDTH
    */
   IO_CALL,
+  /**
+   * function call in tail position - leaves this function and jumps to the
+   * callee, which returns directly to our caller; ends a basic block
+   *
+   * one operand
+   * 0: REG | TEMP, read, allocation == (GP | MEM) | GLOBAL | LOCAL; size ==
+   *    POINTER_WIDTH
+   */
+  IO_TAIL_CALL,
   /**
    * return from function
    *
@@ -127,6 +127,11 @@ IRInstruction *BINOP(IROperator op, IROperand *dest, IROperand *lhs,
 IRInstruction *UNOP(IROperator op, IROperand *dest, IROperand *src) {
   return twoArgInstructionCreate(op, dest, src);
 }
+IRInstruction *SELECT(IROperand *dest, IROperand *condition,
+                      IROperand *consequent, IROperand *alternative) {
+  return fourArgInstructionCreate(IO_SELECT, dest, condition, consequent,
+                                  alternative);
+}
 IRInstruction *JUMP(size_t dest) {
   return oneArgInstructionCreate(IO_JUMP, LOCAL(dest));
 }
@@ -146,6 +151,9 @@ IRInstruction *BJUMP(IROperator op, size_t trueDest, size_t falseDest,
 IRInstruction *CALL(IROperand *who) {
   return oneArgInstructionCreate(IO_CALL, who);
 }
+IRInstruction *TAIL_CALL(IROperand *who) {
+  return oneArgInstructionCreate(IO_TAIL_CALL, who);
+}
 IRInstruction *RETURN(void) { return irInstructionCreate(IO_RETURN); }
 
 void IR(IRBlock *b, IRInstruction *i) { insertNodeEnd(&b->instructions, i); }
@@ -143,6 +143,15 @@ IRInstruction *BINOP(IROperator op, IROperand *dest, IROperand *lhs,
  * @param src source temp or reg
  */
 IRInstruction *UNOP(IROperator op, IROperand *dest, IROperand *src);
+/**
+ * conditional move
+ * @param dest destination temp
+ * @param condition byte temp to condition on
+ * @param consequent temp or constant to use if condition is not zero
+ * @param alternative temp or constant to use if condition is zero
+ */
+IRInstruction *SELECT(IROperand *dest, IROperand *condition,
+                      IROperand *consequent, IROperand *alternative);
 /**
  * unconditional jump to local label
  * @param dest destination numeric id
@@ -178,6 +187,11 @@ IRInstruction *BJUMP(IROperator op, size_t trueDest, size_t falseDest,
  * @param who label or temp or reg to call
  */
 IRInstruction *CALL(IROperand *who);
+/**
+ * call a function in tail position, leaving the current function
+ * @param who label or temp or reg to call
+ */
+IRInstruction *TAIL_CALL(IROperand *who);
 /**
  * return from a function
  */
@@ -82,8 +82,8 @@ enum {
   CODE_IR_ERROR,
 };
 
-// compile the given declaration and code files into one assembly file per code
-// file, given the flags
+// compile the given declaration and code files into one assembly or object
+// file per code file, or run them in-process, given the flags
 int main(int argc, char **argv) {
   // handle overriding command line arguments
   if (helpRequested((size_t)argc, argv)) {
@@ -95,6 +95,16 @@ int main(int argc, char **argv) {
         "  --help, -h, -?    Display this information, and stop\n"
         "  --version         Display version information, and stop\n"
         "  --arch=...        Set the target architecture\n"
+        "  --emit=...        Set the kind of output file (asm or obj)\n"
+        "  --run=...         Run the given function in-process instead of\n"
+        "                    writing output files\n"
+        "  --inline-threshold=...\n"
+        "                    Set the largest function size to inline\n"
+        "  --register-allocator=...\n"
+        "                    Set the register allocation algorithm\n"
+        "  --linear-scan-threshold=...\n"
+        "                    Set the function size at which to switch to\n"
+        "                    linear scan register allocation\n"
         "  -W...=...         Configure warning options\n"
         "  --debug-dump=...  Configure debug information\n"
         "\n"
@@ -214,7 +224,8 @@ int main(int argc, char **argv) {
     return CODE_IR_ERROR;
 
   // hand off to arch-specific backend
-  backend();
+  int exitCode = CODE_SUCCESS;
+  if (backend(&exitCode) != 0) return CODE_FILE_ERROR;
 
-  return CODE_SUCCESS;
+  return exitCode;
 }
\ No newline at end of file
@@ -19,9 +19,16 @@
 
 #include "optimization/optimization.h"
 
+#include <string.h>
+
 #include "fileList.h"
 #include "ir/ir.h"
+#include "ir/shorthand.h"
+#include "options.h"
+#include "translation/translation.h"
+#include "util/functional.h"
 #include "util/internalError.h"
+#include "util/numericSizing.h"
 
 /**
  * short-circuit unconditional-jump-to-any-jump
@@ -48,6 +55,24 @@
  *   JUMP(_B_) | BJUMP(_B_) | CJUMP(_B_)
  * }
  *
+ * and then conditional-jump-to-unconditional-jump
+ *
+ * 1: {
+ *   ...
+ *   CJUMP(_A_, ...) | BJUMP(_A_, ...)
+ * }
+ *
+ * _A_: {
+ *   JUMP(_B_)
+ * }
+ *
+ * ==>
+ *
+ * 1: {
+ *   ...
+ *   CJUMP(_B_, ...) | BJUMP(_B_, ...)
+ * }
+ *
  * @param blocks blocks to apply optimization to (mutated)
  */
 static void shortCircuitJumps(LinkedList *blocks) {
@@ -76,8 +101,9 @@ static void shortCircuitJumps(LinkedList *blocks) {
   bool changed = true;
   while (changed) {
     changed = false;
+    idx = 0;
     for (ListNode *curr = blocks->head->next; curr != blocks->tail;
-         curr = curr->next) {
+         curr = curr->next, ++idx) {
       // for each block, if it's last jump is an unconditional jump
       IRBlock *b = curr->data;
       IRInstruction *last = b->instructions.tail->prev->data;
@@ -86,9 +112,12 @@ static void shortCircuitJumps(LinkedList *blocks) {
         if (irOperandIsLocal(targetArg)) {
           size_t target = indexOfBlock(blocks, localOperandName(targetArg));
           if (shortCircuits[target] != NULL) {
-            irInstructionFree(last);
-            b->instructions.tail->prev->data =
+            IRInstruction *replacement =
                 irInstructionCopy(shortCircuits[target]);
+            // this block's jump may itself be a short circuit
+            if (shortCircuits[idx] == last) shortCircuits[idx] = replacement;
+            irInstructionFree(last);
+            b->instructions.tail->prev->data = replacement;
             changed = true;
           }
         }
@@ -96,6 +125,23 @@ static void shortCircuitJumps(LinkedList *blocks) {
     }
   }
 
+  // unconditional jump chains are already followed, so one step is enough
+  for (ListNode *curr = blocks->head->next; curr != blocks->tail;
+       curr = curr->next) {
+    IRBlock *b = curr->data;
+    IRInstruction *last = b->instructions.tail->prev->data;
+    if (!(IO_J2L <= last->op && last->op <= IO_J2NZ)) continue;
+    for (size_t idx = 0; idx < 2; ++idx) {
+      IRInstruction *jump = shortCircuits[indexOfBlock(
+          blocks, localOperandName(last->args[idx]))];
+      if (jump != NULL && jump->op == IO_JUMP &&
+          irOperandIsLocal(jump->args[0])) {
+        irOperandFree(last->args[idx]);
+        last->args[idx] = irOperandCopy(jump->args[0]);
+      }
+    }
+  }
+
   free(shortCircuits);
 }
 
@@ -204,6 +250,74 @@ static void markTempUse(bool *seen, IROperand *arg) {
 static bool writesDeadTemp(bool *seen, IROperand *target) {
   return target->kind == OK_TEMP && !seen[target->data.temp.name];
 }
+/**
+ * does this operator write to its first argument
+ */
+static bool writesFirstArg(IROperator op) {
+  switch (op) {
+    case IO_UNINITIALIZED:
+    case IO_ADDROF:
+    case IO_MOVE:
+    case IO_MEM_LOAD:
+    case IO_STK_LOAD:
+    case IO_OFFSET_STORE:
+    case IO_OFFSET_LOAD:
+    case IO_ADD:
+    case IO_SUB:
+    case IO_SMUL:
+    case IO_UMUL:
+    case IO_SDIV:
+    case IO_UDIV:
+    case IO_SMOD:
+    case IO_UMOD:
+    case IO_FADD:
+    case IO_FSUB:
+    case IO_FMUL:
+    case IO_FDIV:
+    case IO_FMOD:
+    case IO_NEG:
+    case IO_FNEG:
+    case IO_SLL:
+    case IO_SLR:
+    case IO_SAR:
+    case IO_AND:
+    case IO_XOR:
+    case IO_OR:
+    case IO_NOT:
+    case IO_L:
+    case IO_LE:
+    case IO_E:
+    case IO_NE:
+    case IO_G:
+    case IO_GE:
+    case IO_A:
+    case IO_AE:
+    case IO_B:
+    case IO_BE:
+    case IO_FL:
+    case IO_FLE:
+    case IO_FE:
+    case IO_FNE:
+    case IO_FG:
+    case IO_FGE:
+    case IO_Z:
+    case IO_NZ:
+    case IO_LNOT:
+    case IO_SELECT:
+    case IO_SX:
+    case IO_ZX:
+    case IO_TRUNC:
+    case IO_U2F:
+    case IO_S2F:
+    case IO_FRESIZE:
+    case IO_F2I: {
+      return true;
+    }
+    default: {
+      return false;
+    }
+  }
+}
 /**
  * dead temp elimination
  */
@@ -226,7 +340,7 @@ static void deadTempElimination(LinkedList *blocks, size_t maxTemps) {
           }
           case IO_ADDROF: {
             // this means the value in the temp *might* be visible elsewhere
-            markTempUse(seen, i->args[0]);
+            markTempUse(seen, i->args[1]);
             break;
           }
           case IO_MOVE: {
@@ -298,6 +412,12 @@ static void deadTempElimination(LinkedList *blocks, size_t maxTemps) {
             markTempUse(seen, i->args[2]);
             break;
           }
+          case IO_SELECT: {
+            markTempUse(seen, i->args[1]);
+            markTempUse(seen, i->args[2]);
+            markTempUse(seen, i->args[3]);
+            break;
+          }
           case IO_NEG:
           case IO_FNEG:
           case IO_NOT:
@@ -314,7 +434,8 @@ static void deadTempElimination(LinkedList *blocks, size_t maxTemps) {
             markTempUse(seen, i->args[1]);
             break;
           }
-          case IO_JUMP: {
+          case IO_JUMP:
+          case IO_JUMPTABLE: {
             markTempUse(seen, i->args[0]);
             break;
           }
@@ -344,7 +465,8 @@ static void deadTempElimination(LinkedList *blocks, size_t maxTemps) {
             markTempUse(seen, i->args[2]);
             break;
           }
-          case IO_CALL: {
+          case IO_CALL:
+          case IO_TAIL_CALL: {
             markTempUse(seen, i->args[0]);
             break;
           }
@@ -362,72 +484,9 @@ static void deadTempElimination(LinkedList *blocks, size_t maxTemps) {
       for (ListNode *currInst = block->instructions.head->next;
            currInst != block->instructions.tail; currInst = currInst->next) {
         IRInstruction *i = currInst->data;
-        switch (i->op) {
-          case IO_UNINITIALIZED:
-          case IO_ADDROF:
-          case IO_MOVE:
-          case IO_MEM_LOAD:
-          case IO_STK_LOAD:
-          case IO_OFFSET_STORE:
-          case IO_OFFSET_LOAD:
-          case IO_ADD:
-          case IO_SUB:
-          case IO_SMUL:
-          case IO_UMUL:
-          case IO_SDIV:
-          case IO_UDIV:
-          case IO_SMOD:
-          case IO_UMOD:
-          case IO_FADD:
-          case IO_FSUB:
-          case IO_FMUL:
-          case IO_FDIV:
-          case IO_FMOD:
-          case IO_NEG:
-          case IO_FNEG:
-          case IO_SLL:
-          case IO_SLR:
-          case IO_SAR:
-          case IO_AND:
-          case IO_XOR:
-          case IO_OR:
-          case IO_NOT:
-          case IO_L:
-          case IO_LE:
-          case IO_E:
-          case IO_NE:
-          case IO_G:
-          case IO_GE:
-          case IO_A:
-          case IO_AE:
-          case IO_B:
-          case IO_BE:
-          case IO_FL:
-          case IO_FLE:
-          case IO_FE:
-          case IO_FNE:
-          case IO_FG:
-          case IO_FGE:
-          case IO_Z:
-          case IO_NZ:
-          case IO_LNOT:
-          case IO_SX:
-          case IO_ZX:
-          case IO_TRUNC:
-          case IO_U2F:
-          case IO_S2F:
-          case IO_FRESIZE:
-          case IO_F2I: {
-            if (writesDeadTemp(seen, i->args[0])) {
-              irInstructionMakeNop(i);
-              changed = true;
-            }
-            break;
-          }
-          default: {
-            // doesn't involve a write
-            break;
-          }
+        if (writesFirstArg(i->op) && writesDeadTemp(seen, i->args[0])) {
+          irInstructionMakeNop(i);
+          changed = true;
         }
       }
     }
@@ -436,118 +495,1854 @@ static void deadTempElimination(LinkedList *blocks, size_t maxTemps) {
   }
 }
 
-void optimizeBlockedIr(void) {
-  for (size_t fileIdx = 0; fileIdx < fileList.size; ++fileIdx) {
-    FileListEntry *file = &fileList.entries[fileIdx];
-    Vector *irFrags = &fileList.entries[fileIdx].irFrags;
-    for (size_t fragIdx = 0; fragIdx < irFrags->size; ++fragIdx) {
-      IRFrag *frag = irFrags->elements[fragIdx];
-      if (frag->type == FT_TEXT) {
-        LinkedList *blocks = &frag->data.text.blocks;
-        // TODO: (difficult) inlining
-        // TODO: (difficult) constant propogation
-        // (if only ever used in context where a constant can be used, may
-        // replace temp with constant)
-        // TODO: (difficult) loop-invariant hoisting
-        // (if some expression doesn't change across loop iterations, compute it
-        // outside of the loop)
-        // TODO: (difficult) loop induction variables
-        // (only keep one iteration count for the loop, or reduce for loops to
-        // start and end pointer loops)
-        // TODO: (difficult) common subexpression elimination
-        // (if two expressions are the same, only compute them once)
-        // TODO: (difficult) copy propagation
-        // (if tempB is moved to tempA and tempB isn't changed afterwards,
-        // replace all instances of tempA afterwards with tempB)
-        // TODO: (difficult) tail call optimization
-        shortCircuitJumps(blocks);
-        deadBlockElimination(blocks, irFrags);
-        // TODO: dead label elimination
-        deadTempElimination(blocks, file->nextId);
+/**
+ * find the temps that are only ever defined once, to a constant
+ *
+ * @param blocks blocks to search
+ * @param maxTemps number of temps in the file
+ * @returns array mapping temp name to its defining MOVE, SX, or ZX, or NULL if
+ * the temp isn't a known constant
+ */
+static IRInstruction **findConstantTemps(LinkedList *blocks, size_t maxTemps) {
+  IRInstruction **definitions = calloc(maxTemps, sizeof(IRInstruction *));
+  size_t *numDefinitions = calloc(maxTemps, sizeof(size_t));
+  for (ListNode *currBlock = blocks->head->next; currBlock != blocks->tail;
+       currBlock = currBlock->next) {
+    IRBlock *block = currBlock->data;
+    for (ListNode *currInst = block->instructions.head->next;
+         currInst != block->instructions.tail; currInst = currInst->next) {
+      IRInstruction *i = currInst->data;
+      if (writesFirstArg(i->op) && i->args[0]->kind == OK_TEMP) {
+        size_t name = i->args[0]->data.temp.name;
+        ++numDefinitions[name];
+        if ((i->op == IO_MOVE || i->op == IO_SX || i->op == IO_ZX) &&
+            i->args[1]->kind == OK_CONSTANT)
+          definitions[name] = i;
       }
     }
   }
-}
 
-static void deadLabelElimination(LinkedList *instructions, Vector *frags,
-                                 size_t maxLabels) {
-  // mark all of the blocks we jump to as seen
-  bool *seen = calloc(maxLabels, sizeof(bool));
+  for (size_t idx = 0; idx < maxTemps; ++idx)
+    if (numDefinitions[idx] != 1) definitions[idx] = NULL;
 
-  // deal with jump tables
-  // TODO: refactor out of per-frag loop
-  for (size_t fragIdx = 0; fragIdx < frags->size; ++fragIdx) {
-    IRFrag *f = frags->elements[fragIdx];
-    switch (f->type) {
-      case FT_RODATA: {
-        Vector *data = &f->data.data.data;
-        for (size_t datumIdx = 0; datumIdx < data->size; ++datumIdx) {
-          IRDatum *datum = data->elements[datumIdx];
-          if (datum->type == DT_LOCAL) seen[datum->data.localLabel] = true;
+  free(numDefinitions);
+  return definitions;
+}
+/**
+ * find the text fragment with the given global name
+ *
+ * @returns the fragment, or NULL if it's not defined in this file
+ */
+static IRFrag *findTextFrag(Vector *frags, char const *name) {
+  for (size_t idx = 0; idx < frags->size; ++idx) {
+    IRFrag *f = frags->elements[idx];
+    if (f->type == FT_TEXT && strcmp(f->name.global, name) == 0) return f;
+  }
+  return NULL;
+}
+/**
+ * estimate the size of a function for inlining
+ *
+ * jumps and moves to and from registers aren't counted - once the function is
+ * inlined, the jumps are mostly scheduled away, and the register moves become
+ * copies between the caller's and callee's temps
+ *
+ * @param callee function to estimate
+ * @returns estimated size, or SIZE_MAX if the function can't be inlined (it
+ * makes calls, reads its arguments off the stack, or uses a jump table)
+ */
+static size_t inliningCost(IRFrag const *callee) {
+  size_t cost = 0;
+  LinkedList const *blocks = &callee->data.text.blocks;
+  for (ListNode *currBlock = blocks->head->next; currBlock != blocks->tail;
+       currBlock = currBlock->next) {
+    IRBlock *block = currBlock->data;
+    for (ListNode *currInst = block->instructions.head->next;
+         currInst != block->instructions.tail; currInst = currInst->next) {
+      IRInstruction *i = currInst->data;
+      switch (i->op) {
+        case IO_CALL:
+        case IO_TAIL_CALL:
+        case IO_STK_LOAD:
+        case IO_JUMPTABLE: {
+          return SIZE_MAX;
+        }
+        case IO_NOP:
+        case IO_JUMP:
+        case IO_RETURN: {
+          break;
+        }
+        case IO_MOVE: {
+          if (i->args[0]->kind != OK_REG && i->args[1]->kind != OK_REG) ++cost;
+          break;
+        }
+        default: {
+          ++cost;
+          break;
         }
-      }
-      default: {
-        break;
       }
     }
   }
+  return cost;
+}
+/**
+ * copy an operand from an inlined function, renaming temps and block labels
+ *
+ * @param o operand to copy
+ * @param renames mapping from callee ids to caller ids, SIZE_MAX if not yet
+ * mapped; block labels must already be mapped
+ * @param file file to get fresh temps from
+ */
+static IROperand *inlinedOperandCopy(IROperand const *o, size_t *renames,
+                                     FileListEntry *file) {
+  IROperand *copy = irOperandCopy(o);
+  if (copy->kind == OK_TEMP) {
+    if (renames[copy->data.temp.name] == SIZE_MAX)
+      renames[copy->data.temp.name] = fresh(file);
+    copy->data.temp.name = renames[copy->data.temp.name];
+  } else if (irOperandIsLocal(copy) &&
+             renames[localOperandName(copy)] != SIZE_MAX) {
+    IRDatum *label = copy->data.constant.data.elements[0];
+    label->data.localLabel = renames[label->data.localLabel];
+  }
+  return copy;
+}
+/**
+ * replace a call with the body of the called function
+ *
+ * 1: {
+ *   ...before...
+ *   CALL(GLOBAL(f))
+ *   ...after...
+ * }
+ *
+ * ==>
+ *
+ * 1: {
+ *   ...before...
+ *   JUMP(f's entry)
+ * }
+ *
+ * ...f's blocks, with RETURN replaced by JUMP(2)...
+ *
+ * 2: {
+ *   ...after...
+ * }
+ *
+ * @param blockNode node holding the block containing the call
+ * @param callNode node holding the call
+ * @param callee function being called
+ * @param file file the blocks are from
+ */
+static void inlineCall(ListNode *blockNode, ListNode *callNode,
+                       IRFrag const *callee, FileListEntry *file) {
+  IRBlock *block = blockNode->data;
+  LinkedList const *calleeBlocks = &callee->data.text.blocks;
 
-  for (ListNode *curr = instructions->head->next; curr != instructions->tail;
-       curr = curr->next) {
-    IRInstruction *i = curr->data;
-    switch (i->op) {
-      case IO_JUMP: {
-        seen[localOperandName(i->args[0])] = true;
-        break;
-      }
-      case IO_JUMPTABLE: {
-        IRFrag *table = findFrag(frags, localOperandName(i->args[1]));
-        for (size_t idx = 0; idx < table->data.data.data.size; ++idx) {
-          IRDatum *datum = table->data.data.data.elements[idx];
-          seen[datum->data.localLabel] = true;
-        }
-        break;
-      }
-      case IO_J1L:
-      case IO_J1LE:
-      case IO_J1E:
-      case IO_J1NE:
-      case IO_J1G:
-      case IO_J1GE:
-      case IO_J1A:
-      case IO_J1AE:
-      case IO_J1B:
-      case IO_J1BE:
-      case IO_J1FL:
-      case IO_J1FLE:
-      case IO_J1FE:
-      case IO_J1FNE:
-      case IO_J1FG:
-      case IO_J1FGE:
-      case IO_J1Z:
-      case IO_J1NZ: {
-        seen[localOperandName(i->args[0])] = true;
-        break;
-      }
-      default: {
-        // not a jump
-        break;
+  size_t maxIds = file->nextId;
+  size_t *renames = malloc(maxIds * sizeof(size_t));
+  for (size_t idx = 0; idx < maxIds; ++idx) renames[idx] = SIZE_MAX;
+  for (ListNode *currBlock = calleeBlocks->head->next;
+       currBlock != calleeBlocks->tail; currBlock = currBlock->next) {
+    IRBlock *calleeBlock = currBlock->data;
+    renames[calleeBlock->label] = fresh(file);
+  }
+
+  // split off everything after the call
+  IRBlock *continuation = irBlockCreate(fresh(file));
+  while (callNode->next != block->instructions.tail)
+    insertNodeEnd(&continuation->instructions, removeNode(callNode->next));
+  irInstructionFree(callNode->data);
+  IRBlock *calleeEntry = calleeBlocks->head->next->data;
+  callNode->data = JUMP(renames[calleeEntry->label]);
+
+  // copy in the callee
+  ListNode *insertAfter = blockNode;
+  for (ListNode *currBlock = calleeBlocks->head->next;
+       currBlock != calleeBlocks->tail; currBlock = currBlock->next) {
+    IRBlock *calleeBlock = currBlock->data;
+    IRBlock *copy = irBlockCreate(renames[calleeBlock->label]);
+    for (ListNode *currInst = calleeBlock->instructions.head->next;
+         currInst != calleeBlock->instructions.tail;
+         currInst = currInst->next) {
+      IRInstruction *i = currInst->data;
+      if (i->op == IO_RETURN) {
+        IR(copy, JUMP(continuation->label));
+      } else {
+        IRInstruction *inlined = irInstructionCreate(i->op);
+        for (size_t idx = 0; idx < irOperatorArity(i->op); ++idx)
+          inlined->args[idx] = inlinedOperandCopy(i->args[idx], renames, file);
+        IR(copy, inlined);
       }
     }
+    insertNodeAfter(insertAfter, copy);
+    insertAfter = insertAfter->next;
   }
+  insertNodeAfter(insertAfter, continuation);
 
-  for (ListNode *curr = instructions->head->next; curr != instructions->tail;) {
-    IRInstruction *i = curr->data;
-    if (i->op == IO_LABEL && !seen[localOperandName(i->args[0])]) {
-      ListNode *toRemove = curr;
-      curr = curr->next;
-      irInstructionFree(removeNode(toRemove));
-    } else {
-      curr = curr->next;
+  free(renames);
+}
+/**
+ * inline calls to small leaf functions defined in the same file
+ *
+ * functions are inlined if their inliningCost is at most the inline
+ * threshold option
+ *
+ * @param frag function to inline calls in (mutated)
+ * @param file file the function is from
+ */
+static void inlineFunctions(IRFrag *frag, FileListEntry *file) {
+  if (options.inlineThreshold == 0) return;
+
+  LinkedList *blocks = &frag->data.text.blocks;
+  size_t maxTemps = file->nextId;
+  IRInstruction **constantTemps = findConstantTemps(blocks, maxTemps);
+  for (ListNode *currBlock = blocks->head->next; currBlock != blocks->tail;
+       currBlock = currBlock->next) {
+    IRBlock *block = currBlock->data;
+    for (ListNode *currInst = block->instructions.head->next;
+         currInst != block->instructions.tail; currInst = currInst->next) {
+      IRInstruction *i = currInst->data;
+      if (i->op != IO_CALL) continue;
+
+      // calls are made through a temp holding the function's address
+      IROperand const *target = i->args[0];
+      if (target->kind == OK_TEMP && target->data.temp.name < maxTemps &&
+          constantTemps[target->data.temp.name] != NULL)
+        target = constantTemps[target->data.temp.name]->args[1];
+      if (!irOperandIsGlobal(target)) continue;
+
+      IRFrag *callee = findTextFrag(&file->irFrags, globalOperandName(target));
+      if (callee == NULL || callee == frag ||
+          inliningCost(callee) > options.inlineThreshold)
+        continue;
+
+      // rest of this block is now in the continuation block, which we'll get
+      // to after the inlined blocks
+      inlineCall(currBlock, currInst, callee, file);
+      break;
     }
   }
 
-  free(seen);
+  free(constantTemps);
+}
+
+/**
+ * get the value of an integral constant
+ *
+ * @param o operand to examine
+ * @param out output parameter for the value, zero-extended
+ * @returns whether o was a single non-label integral datum
+ */
+static bool integralConstantValue(IROperand const *o, uint64_t *out) {
+  if (o->kind != OK_CONSTANT || o->data.constant.data.size != 1) return false;
+
+  IRDatum const *d = o->data.constant.data.elements[0];
+  switch (d->type) {
+    case DT_BYTE: {
+      *out = d->data.byteVal;
+      return true;
+    }
+    case DT_SHORT: {
+      *out = d->data.shortVal;
+      return true;
+    }
+    case DT_INT: {
+      *out = d->data.intVal;
+      return true;
+    }
+    case DT_LONG: {
+      *out = d->data.longVal;
+      return true;
+    }
+    default: {
+      return false;
+    }
+  }
+}
+/**
+ * get the value of an integral constant or a temp known to hold one
+ *
+ * @param o operand to examine
+ * @param constantTemps result of findConstantTemps
+ * @param maxTemps length of constantTemps
+ * @param out output parameter for the value, not truncated to o's size
+ * @returns whether o's value is known
+ */
+static bool knownIntegralValue(IROperand const *o,
+                               IRInstruction *const *constantTemps,
+                               size_t maxTemps, uint64_t *out) {
+  if (integralConstantValue(o, out)) return true;
+  if (o->kind != OK_TEMP || o->data.temp.name >= maxTemps ||
+      constantTemps[o->data.temp.name] == NULL)
+    return false;
+
+  IRInstruction const *definition = constantTemps[o->data.temp.name];
+  if (!integralConstantValue(definition->args[1], out)) return false;
+  size_t fromBits = irOperandSizeof(definition->args[1]) * 8;
+  if (definition->op == IO_SX && fromBits < 64 &&
+      (*out & (UINT64_C(1) << (fromBits - 1))) != 0)
+    *out |= UINT64_MAX << fromBits;
+  return true;
+}
+/**
+ * create an integral constant of the given size
+ */
+static IROperand *integralConstantCreate(size_t size, uint64_t value) {
+  if (size == BYTE_WIDTH)
+    return CONSTANT(BYTE_WIDTH, byteDatumCreate((uint8_t)value));
+  else if (size == SHORT_WIDTH)
+    return CONSTANT(SHORT_WIDTH, shortDatumCreate((uint16_t)value));
+  else if (size == INT_WIDTH)
+    return CONSTANT(INT_WIDTH, intDatumCreate((uint32_t)value));
+  else
+    return CONSTANT(LONG_WIDTH, longDatumCreate(value));
+}
+/**
+ * create a shift amount constant
+ */
+static IROperand *shiftConstantCreate(size_t amount) {
+  return CONSTANT(BYTE_WIDTH, byteDatumCreate((uint8_t)amount));
+}
+/**
+ * number of trailing zero bits in a nonzero value
+ */
+static size_t trailingZeros(uint64_t value) {
+  size_t count = 0;
+  for (; (value & 1) == 0; value >>= 1) ++count;
+  return count;
+}
+/**
+ * multiplication strength reduction
+ *
+ * multiplication is the same modulo 2^n for signed and unsigned operands, so
+ * any SMUL or UMUL by a constant of the form 2^k, (2^j + 1) * 2^k, or
+ * (2^j - 1) * 2^k can be done with shifts and adds (the backend can select
+ * shift-by-1, 2, or 3 followed by an add as a single LEA)
+ *
+ * MUL(dest, x, 0) ==> MOVE(dest, 0)
+ * MUL(dest, x, 1) ==> MOVE(dest, x)
+ * MUL(dest, x, -1) ==> NEG(dest, x)
+ * MUL(dest, x, 2^k) ==> SLL(dest, x, k)
+ *
+ * MUL(dest, x, (2^j +/- 1) * 2^k)
+ *
+ * ==>
+ *
+ * SLL(t1, x, j)
+ * ADD | SUB(t2, t1, x)
+ * SLL(dest, t2, k)
+ *
+ * @param blocks blocks to apply optimization to (mutated)
+ * @param file file the blocks are from, for fresh temps
+ */
+static void strengthReduceMultiplication(LinkedList *blocks,
+                                         FileListEntry *file) {
+  size_t maxTemps = file->nextId;
+  IRInstruction **constantTemps = findConstantTemps(blocks, maxTemps);
+
+  for (ListNode *currBlock = blocks->head->next; currBlock != blocks->tail;
+       currBlock = currBlock->next) {
+    IRBlock *block = currBlock->data;
+    for (ListNode *currInst = block->instructions.head->next;
+         currInst != block->instructions.tail; currInst = currInst->next) {
+      IRInstruction *i = currInst->data;
+      if (i->op != IO_SMUL && i->op != IO_UMUL) continue;
+
+      IROperand *dest = i->args[0];
+      IROperand *x;
+      uint64_t factor;
+      if (i->args[1]->kind != OK_CONSTANT &&
+          knownIntegralValue(i->args[2], constantTemps, maxTemps, &factor))
+        x = i->args[1];
+      else if (i->args[2]->kind != OK_CONSTANT &&
+               knownIntegralValue(i->args[1], constantTemps, maxTemps,
+                                  &factor))
+        x = i->args[2];
+      else
+        continue;
+
+      size_t size = irOperandSizeof(dest);
+      size_t bits = size * 8;
+      uint64_t mask = bits >= 64 ? UINT64_MAX : (UINT64_C(1) << bits) - 1;
+      factor &= mask;
+
+      IRInstruction *replacement;
+      if (factor == 0) {
+        replacement =
+            MOVE(irOperandCopy(dest), integralConstantCreate(size, 0));
+      } else if (factor == 1) {
+        replacement = MOVE(irOperandCopy(dest), irOperandCopy(x));
+      } else if (factor == mask) {
+        replacement = UNOP(IO_NEG, irOperandCopy(dest), irOperandCopy(x));
+      } else if ((factor & (factor - 1)) == 0) {
+        replacement = BINOP(IO_SLL, irOperandCopy(dest), irOperandCopy(x),
+                            shiftConstantCreate(trailingZeros(factor)));
+      } else {
+        size_t shift = trailingZeros(factor);
+        uint64_t odd = factor >> shift;
+
+        IROperator combine;
+        size_t innerShift;
+        if (((odd - 1) & (odd - 2)) == 0) {
+          combine = IO_ADD;
+          innerShift = trailingZeros(odd - 1);
+        } else if (((odd + 1) & odd) == 0) {
+          combine = IO_SUB;
+          innerShift = trailingZeros(odd + 1);
+        } else {
+          continue;
+        }
+
+        IROperand *scaled = TEMP(fresh(file), size, size, AH_GP);
+        insertNodeBefore(
+            currInst,
+            BINOP(IO_SLL, irOperandCopy(scaled), irOperandCopy(x),
+                  shiftConstantCreate(innerShift)));
+        if (shift == 0) {
+          replacement =
+              BINOP(combine, irOperandCopy(dest), scaled, irOperandCopy(x));
+        } else {
+          IROperand *combined = TEMP(fresh(file), size, size, AH_GP);
+          insertNodeBefore(currInst, BINOP(combine, irOperandCopy(combined),
+                                           scaled, irOperandCopy(x)));
+          replacement = BINOP(IO_SLL, irOperandCopy(dest), combined,
+                              shiftConstantCreate(shift));
+        }
+      }
+
+      irInstructionFree(i);
+      currInst->data = replacement;
+    }
+  }
+
+  free(constantTemps);
+}
+
+/**
+ * count how many times each temp is read
+ *
+ * @param blocks blocks to search
+ * @param maxTemps number of temps in the file
+ * @returns array mapping temp name to number of reads
+ */
+static size_t *countTempReads(LinkedList *blocks, size_t maxTemps) {
+  size_t *reads = calloc(maxTemps, sizeof(size_t));
+  for (ListNode *currBlock = blocks->head->next; currBlock != blocks->tail;
+       currBlock = currBlock->next) {
+    IRBlock *block = currBlock->data;
+    for (ListNode *currInst = block->instructions.head->next;
+         currInst != block->instructions.tail; currInst = currInst->next) {
+      IRInstruction *i = currInst->data;
+      for (size_t idx = 0; idx < irOperatorArity(i->op); ++idx) {
+        if (idx == 0 && writesFirstArg(i->op)) continue;
+        if (i->args[idx]->kind == OK_TEMP)
+          ++reads[i->args[idx]->data.temp.name];
+      }
+    }
+  }
+  return reads;
+}
+/**
+ * count how many times each temp is written
+ */
+static size_t *countTempWrites(LinkedList *blocks, size_t maxTemps) {
+  size_t *writes = calloc(maxTemps, sizeof(size_t));
+  for (ListNode *currBlock = blocks->head->next; currBlock != blocks->tail;
+       currBlock = currBlock->next) {
+    IRBlock *block = currBlock->data;
+    for (ListNode *currInst = block->instructions.head->next;
+         currInst != block->instructions.tail; currInst = currInst->next) {
+      IRInstruction *i = currInst->data;
+      if (writesFirstArg(i->op) && i->args[0]->kind == OK_TEMP)
+        ++writes[i->args[0]->data.temp.name];
+    }
+  }
+  return writes;
+}
+/**
+ * count how many jumps (or jump table entries) go to each label
+ */
+static size_t *countLabelReferences(LinkedList *blocks, Vector *frags,
+                                    size_t maxLabels) {
+  size_t *references = calloc(maxLabels, sizeof(size_t));
+  for (size_t fragIdx = 0; fragIdx < frags->size; ++fragIdx) {
+    IRFrag *f = frags->elements[fragIdx];
+    if (f->type != FT_RODATA) continue;
+    Vector *data = &f->data.data.data;
+    for (size_t datumIdx = 0; datumIdx < data->size; ++datumIdx) {
+      IRDatum *datum = data->elements[datumIdx];
+      if (datum->type == DT_LOCAL) ++references[datum->data.localLabel];
+    }
+  }
+  for (ListNode *currBlock = blocks->head->next; currBlock != blocks->tail;
+       currBlock = currBlock->next) {
+    IRBlock *block = currBlock->data;
+    IRInstruction *last = block->instructions.tail->prev->data;
+    if (last->op == IO_JUMP && irOperandIsLocal(last->args[0])) {
+      ++references[localOperandName(last->args[0])];
+    } else if (IO_J2L <= last->op && last->op <= IO_J2NZ) {
+      ++references[localOperandName(last->args[0])];
+      ++references[localOperandName(last->args[1])];
+    }
+  }
+  return references;
+}
+/**
+ * get the two-target jump version of a comparison
+ */
+static IROperator comparisonJump(IROperator op) {
+  switch (op) {
+    case IO_L: {
+      return IO_J2L;
+    }
+    case IO_LE: {
+      return IO_J2LE;
+    }
+    case IO_E: {
+      return IO_J2E;
+    }
+    case IO_NE: {
+      return IO_J2NE;
+    }
+    case IO_G: {
+      return IO_J2G;
+    }
+    case IO_GE: {
+      return IO_J2GE;
+    }
+    case IO_A: {
+      return IO_J2A;
+    }
+    case IO_AE: {
+      return IO_J2AE;
+    }
+    case IO_B: {
+      return IO_J2B;
+    }
+    case IO_BE: {
+      return IO_J2BE;
+    }
+    case IO_FL: {
+      return IO_J2FL;
+    }
+    case IO_FLE: {
+      return IO_J2FLE;
+    }
+    case IO_FE: {
+      return IO_J2FE;
+    }
+    case IO_FNE: {
+      return IO_J2FNE;
+    }
+    case IO_FG: {
+      return IO_J2FG;
+    }
+    case IO_FGE: {
+      return IO_J2FGE;
+    }
+    default: {
+      error(__FILE__, __LINE__, "not a comparison");
+    }
+  }
+}
+static bool sameTemp(IROperand const *a, IROperand const *b) {
+  return a->kind == OK_TEMP && b->kind == OK_TEMP &&
+         a->data.temp.name == b->data.temp.name;
+}
+/**
+ * fuse a comparison into the J2Z or J2NZ that tests its result
+ *
+ * Follows the straight-line path from the comparison (through unconditional
+ * jumps to blocks with no other way in) while the result is only copied around
+ * and the compared temps don't change. If that path ends in a J2Z or J2NZ on a
+ * copy of the result, and the result and its copies are written and read only
+ * along that path, the jump is replaced by
+ * the matching two-target comparison jump (with its targets swapped for J2Z,
+ * which keeps floating point comparisons with NaN correct). The comparison
+ * and the copies are left for dead temp elimination.
+ *
+ * @param blocks blocks in the function
+ * @param blockNode block containing the comparison
+ * @param cmpNode the comparison
+ * @param reads number of reads of each temp
+ * @param writes number of writes to each temp
+ * @param references number of jumps to each label
+ */
+static void fuseComparison(LinkedList *blocks, ListNode *blockNode,
+                           ListNode *cmpNode, size_t const *reads,
+                           size_t const *writes, size_t const *references) {
+  IRInstruction *cmp = cmpNode->data;
+  IROperand *lhs = cmp->args[1];
+  IROperand *rhs = cmp->args[2];
+  if (lhs->kind == OK_REG || rhs->kind == OK_REG) return;
+  if (cmp->args[0]->kind != OK_TEMP ||
+      writes[cmp->args[0]->data.temp.name] != 1)
+    return;
+
+  Vector aliases;  // vector of IROperand, borrowed
+  vectorInit(&aliases);
+  vectorInsert(&aliases, cmp->args[0]);
+
+  IRBlock *block = blockNode->data;
+  ListNode *currInst = cmpNode->next;
+  size_t maxSteps = linkedListLength(blocks);
+  while (true) {
+    // blocks always end in a jump, so this never runs off the end of a block
+    IRInstruction *i = currInst->data;
+    currInst = currInst->next;
+
+    if (i->op == IO_JUMP) {
+      if (maxSteps-- == 0 || !irOperandIsLocal(i->args[0]) ||
+          references[localOperandName(i->args[0])] != 1)
+        break;
+      block = findBlock(blocks, localOperandName(i->args[0]));
+      currInst = block->instructions.head->next;
+      continue;
+    } else if (i->op == IO_J2Z || i->op == IO_J2NZ) {
+      bool tested = false;
+      for (size_t idx = 0; idx < aliases.size; ++idx)
+        tested = tested || sameTemp(aliases.elements[idx], i->args[2]);
+      if (tested && reads[i->args[2]->data.temp.name] == 1) {
+        IROperand *trueDest = i->args[0];
+        IROperand *falseDest = i->args[1];
+        irOperandFree(i->args[2]);
+        i->args = realloc(i->args, 4 * sizeof(IROperand *));
+        if (i->op == IO_J2Z) {
+          i->args[0] = falseDest;
+          i->args[1] = trueDest;
+        }
+        i->args[2] = irOperandCopy(lhs);
+        i->args[3] = irOperandCopy(rhs);
+        i->op = comparisonJump(cmp->op);
+      }
+      break;
+    } else if (!writesFirstArg(i->op)) {
+      // anything else might leave the path or have side effects we don't
+      // track, except for no-ops
+      if (i->op != IO_NOP) break;
+      continue;
+    }
+
+    IROperand *dest = i->args[0];
+    if (sameTemp(dest, lhs) || sameTemp(dest, rhs)) break;
+
+    bool copiesAlias = false;
+    bool overwritesAlias = false;
+    for (size_t idx = 0; idx < aliases.size; ++idx) {
+      IROperand const *alias = aliases.elements[idx];
+      if (i->op == IO_MOVE && sameTemp(alias, i->args[1])) copiesAlias = true;
+      if (sameTemp(alias, dest)) overwritesAlias = true;
+    }
+
+    if (copiesAlias && dest->kind == OK_TEMP && !overwritesAlias) {
+      if (reads[i->args[1]->data.temp.name] != 1 ||
+          writes[dest->data.temp.name] != 1)
+        break;
+      vectorInsert(&aliases, dest);
+    } else if (overwritesAlias) {
+      break;
+    }
+  }
+
+  vectorUninit(&aliases, nullDtor);
+}
+/**
+ * fuse comparisons into the conditional jumps on their results
+ */
+static void compareBranchFusion(LinkedList *blocks, Vector *frags,
+                                size_t maxTemps) {
+  size_t *reads = countTempReads(blocks, maxTemps);
+  size_t *writes = countTempWrites(blocks, maxTemps);
+  size_t *references = countLabelReferences(blocks, frags, maxTemps);
+  for (ListNode *currBlock = blocks->head->next; currBlock != blocks->tail;
+       currBlock = currBlock->next) {
+    IRBlock *block = currBlock->data;
+    for (ListNode *currInst = block->instructions.head->next;
+         currInst != block->instructions.tail; currInst = currInst->next) {
+      IRInstruction *i = currInst->data;
+      if (IO_L <= i->op && i->op <= IO_FGE)
+        fuseComparison(blocks, currBlock, currInst, reads, writes, references);
+    }
+  }
+  free(reads);
+  free(writes);
+  free(references);
+}
+
+/**
+ * most instructions, other than copies, either side of a branch may hoist to
+ * become a select
+ */
+#define MAX_SELECT_ARM 4
+/** most blocks either side of a branch may span to become a select */
+#define MAX_SELECT_ARM_BLOCKS 8
+
+/**
+ * can this instruction run even if its side of a branch isn't taken
+ *
+ * It must be unable to trap, and write a GP temp that nothing else writes.
+ */
+static bool isSpeculatable(IRInstruction const *i, size_t const *writes) {
+  switch (i->op) {
+    case IO_MOVE:
+    case IO_ADD:
+    case IO_SUB:
+    case IO_SMUL:
+    case IO_UMUL:
+    case IO_NEG:
+    case IO_SLL:
+    case IO_SLR:
+    case IO_SAR:
+    case IO_AND:
+    case IO_XOR:
+    case IO_OR:
+    case IO_NOT:
+    case IO_L:
+    case IO_LE:
+    case IO_E:
+    case IO_NE:
+    case IO_G:
+    case IO_GE:
+    case IO_A:
+    case IO_AE:
+    case IO_B:
+    case IO_BE:
+    case IO_Z:
+    case IO_NZ:
+    case IO_LNOT:
+    case IO_SELECT:
+    case IO_SX:
+    case IO_ZX:
+    case IO_TRUNC: {
+      break;
+    }
+    default: {
+      return false;
+    }
+  }
+  for (size_t idx = 0; idx < irOperatorArity(i->op); ++idx) {
+    IROperand const *arg = i->args[idx];
+    if (arg->kind == OK_REG ||
+        (arg->kind == OK_TEMP && arg->data.temp.kind != AH_GP))
+      return false;
+  }
+  return i->args[0]->kind == OK_TEMP &&
+         writes[i->args[0]->data.temp.name] == 1;
+}
+/**
+ * one side of a branch that might become a select
+ */
+typedef struct {
+  IRBlock *blocks[MAX_SELECT_ARM_BLOCKS]; /**< blocks along the side */
+  size_t numBlocks;
+  IRInstruction *result; /**< move of the side's value into the result */
+  size_t join;           /**< label both sides meet at */
+} SelectArm;
+/**
+ * find the straight-line code starting at label and ending in a jump to a
+ * block with other ways in
+ *
+ * @returns if the code is cheap enough to speculate, and ends by moving a value
+ * into a GP temp written exactly twice
+ */
+static bool findSelectArm(SelectArm *arm, LinkedList *blocks, size_t label,
+                          size_t const *references, size_t const *writes) {
+  arm->numBlocks = 0;
+  arm->result = NULL;
+  size_t numInstructions = 0;
+  while (references[label] == 1) {
+    IRBlock *b = findBlock(blocks, label);
+    if (arm->numBlocks == MAX_SELECT_ARM_BLOCKS) return false;
+    arm->blocks[arm->numBlocks++] = b;
+
+    for (ListNode *curr = b->instructions.head->next;
+         curr != b->instructions.tail->prev; curr = curr->next) {
+      IRInstruction *i = curr->data;
+      if (arm->result != NULL ||
+          (i->op != IO_MOVE && numInstructions++ == MAX_SELECT_ARM))
+        return false;
+
+      if (i->op == IO_MOVE && i->args[0]->kind == OK_TEMP &&
+          writes[i->args[0]->data.temp.name] == 2) {
+        IROperand const *dest = i->args[0];
+        IROperand const *value = i->args[1];
+        if (dest->data.temp.kind != AH_GP || dest->data.temp.size == 1 ||
+            value->kind == OK_REG ||
+            (value->kind == OK_TEMP && value->data.temp.kind != AH_GP))
+          return false;
+        arm->result = i;
+      } else if (!isSpeculatable(i, writes)) {
+        return false;
+      }
+    }
+
+    IRInstruction *last = b->instructions.tail->prev->data;
+    if (last->op != IO_JUMP || !irOperandIsLocal(last->args[0])) return false;
+    label = localOperandName(last->args[0]);
+  }
+  arm->join = label;
+  return arm->numBlocks != 0 && arm->result != NULL;
+}
+/**
+ * move an arm's instructions, other than the move of its result, to the end of
+ * the given block, and free the arm's blocks
+ */
+static void hoistSelectArm(SelectArm const *arm, IRBlock *into,
+                           LinkedList *blocks) {
+  for (size_t blockIdx = 0; blockIdx < arm->numBlocks; ++blockIdx) {
+    IRBlock *b = arm->blocks[blockIdx];
+    while (b->instructions.head->next != b->instructions.tail->prev) {
+      IRInstruction *i = removeNode(b->instructions.head->next);
+      if (i == arm->result)
+        irInstructionFree(i);
+      else
+        IR(into, i);
+    }
+    for (ListNode *curr = blocks->head->next; curr != blocks->tail;
+         curr = curr->next) {
+      if (curr->data == b) {
+        irBlockFree(removeNode(curr));
+        break;
+      }
+    }
+  }
+}
+/**
+ * turn branches that only pick between two cheap values into selects
+ *
+ * 1: {
+ *   ...
+ *   J2cc(_T_, _F_, lhs, rhs)
+ * }
+ * _T_: {
+ *   t = ...
+ *   MOVE(out, t)
+ *   JUMP(_J_)
+ * }
+ * _F_: {
+ *   f = ...
+ *   MOVE(out, f)
+ *   JUMP(_J_)
+ * }
+ *
+ * ==>
+ *
+ * 1: {
+ *   ...
+ *   t = ...
+ *   f = ...
+ *   cc(c, lhs, rhs)
+ *   SELECT(out, c, t, f)
+ *   JUMP(_J_)
+ * }
+ *
+ * Both sides must have no other way in, and may only compute GP temps with
+ * instructions that can't trap. Repeats until nothing changes, so nested
+ * ternaries become nested selects.
+ */
+static void selectFormation(LinkedList *blocks, Vector *frags,
+                            FileListEntry *file) {
+  bool changed = true;
+  while (changed) {
+    changed = false;
+    size_t *writes = countTempWrites(blocks, file->nextId);
+    size_t *references = countLabelReferences(blocks, frags, file->nextId);
+    for (ListNode *currBlock = blocks->head->next; currBlock != blocks->tail;
+         currBlock = currBlock->next) {
+      IRBlock *block = currBlock->data;
+      IRInstruction *last = block->instructions.tail->prev->data;
+      if (!(IO_J2L <= last->op && last->op <= IO_J2NZ)) continue;
+
+      SelectArm consequent;
+      SelectArm alternative;
+      if (!findSelectArm(&consequent, blocks, localOperandName(last->args[0]),
+                         references, writes) ||
+          !findSelectArm(&alternative, blocks, localOperandName(last->args[1]),
+                         references, writes) ||
+          consequent.join != alternative.join ||
+          !sameTemp(consequent.result->args[0], alternative.result->args[0]))
+        continue;
+
+      IROperand *dest = irOperandCopy(consequent.result->args[0]);
+      IROperand *consequentValue = irOperandCopy(consequent.result->args[1]);
+      IROperand *alternativeValue = irOperandCopy(alternative.result->args[1]);
+      size_t join = consequent.join;
+
+      removeNode(block->instructions.tail->prev);
+      hoistSelectArm(&consequent, block, blocks);
+      hoistSelectArm(&alternative, block, blocks);
+
+      IROperand *condition;
+      if ((last->op == IO_J2Z || last->op == IO_J2NZ) &&
+          last->args[2]->kind == OK_TEMP &&
+          last->args[2]->data.temp.size == BYTE_WIDTH) {
+        condition = irOperandCopy(last->args[2]);
+        if (last->op == IO_J2Z) {
+          IROperand *temp = consequentValue;
+          consequentValue = alternativeValue;
+          alternativeValue = temp;
+        }
+      } else {
+        // the two-target jumps are in the same order as the comparisons
+        IRInstruction *cmp = irInstructionCreate(IO_L + (last->op - IO_J2L));
+        cmp->args[0] = TEMPBOOL(fresh(file));
+        for (size_t idx = 2; idx < irOperatorArity(last->op); ++idx)
+          cmp->args[idx - 1] = irOperandCopy(last->args[idx]);
+        IR(block, cmp);
+        condition = irOperandCopy(cmp->args[0]);
+      }
+      irInstructionFree(last);
+      IR(block, SELECT(dest, condition, consequentValue, alternativeValue));
+      IR(block, JUMP(join));
+      changed = true;
+      break;
+    }
+    free(writes);
+    free(references);
+  }
+}
+
+/** most scalars an aggregate temp may be split into */
+#define MAX_REPLACED_PIECES 4
+
+/**
+ * a part of an aggregate temp that is always accessed as a single scalar
+ */
+typedef struct {
+  uint64_t offset;
+  size_t size;
+  AllocHint kind; /**< MEM if only constants have been stored to it */
+} Piece;
+/**
+ * the pieces of a group of aggregate temps that are copied to one another
+ */
+typedef struct {
+  bool replaceable;
+  bool wholeAccess; /**< is the group loaded or stored through memory whole */
+  size_t size;
+  size_t numPieces;
+  Piece pieces[MAX_REPLACED_PIECES];
+} PieceLayout;
+
+static bool isMemTemp(IROperand const *o) {
+  return o->kind == OK_TEMP && o->data.temp.kind == AH_MEM;
+}
+/**
+ * find the representative of a temp's group
+ */
+static size_t groupOf(size_t *groups, size_t name) {
+  while (groups[name] != name) {
+    groups[name] = groups[groups[name]];
+    name = groups[name];
+  }
+  return name;
+}
+/**
+ * can an operand be read from or written to a piece - is it a scalar temp or
+ * a constant
+ */
+static bool isPieceValue(IROperand const *o) {
+  return (o->kind == OK_TEMP && o->data.temp.kind != AH_MEM) ||
+         o->kind == OK_CONSTANT;
+}
+/**
+ * can this mention of a mem temp be rewritten in terms of its pieces
+ *
+ * @param i instruction mentioning the temp
+ * @param argIdx which argument the temp is
+ */
+static bool isPieceableUse(IRInstruction const *i, size_t argIdx) {
+  uint64_t offset;
+  switch (i->op) {
+    case IO_UNINITIALIZED: {
+      return true;
+    }
+    case IO_MOVE: {
+      return isMemTemp(i->args[0]) && isMemTemp(i->args[1]);
+    }
+    case IO_OFFSET_STORE: {
+      return argIdx == 0 && isPieceValue(i->args[1]) &&
+             integralConstantValue(i->args[2], &offset);
+    }
+    case IO_OFFSET_LOAD: {
+      return argIdx == 1 && i->args[0]->kind == OK_TEMP &&
+             isPieceValue(i->args[0]) &&
+             integralConstantValue(i->args[2], &offset);
+    }
+    case IO_MEM_STORE: {
+      return argIdx == 1 && integralConstantValue(i->args[2], &offset);
+    }
+    case IO_MEM_LOAD: {
+      return argIdx == 0 && integralConstantValue(i->args[2], &offset);
+    }
+    default: {
+      return false;
+    }
+  }
+}
+/**
+ * get the offset of a pieceable offset or memory access
+ */
+static uint64_t pieceableOffset(IRInstruction const *i) {
+  uint64_t offset;
+  if (!integralConstantValue(i->args[2], &offset))
+    error(__FILE__, __LINE__, "pieceable access has a non-constant offset");
+  return offset;
+}
+/**
+ * note that a scalar is read from or written to part of a group
+ */
+static void addPiece(PieceLayout *layout, uint64_t offset,
+                     IROperand const *value) {
+  size_t size = irOperandSizeof(value);
+  AllocHint kind = value->kind == OK_TEMP ? value->data.temp.kind : AH_MEM;
+  if ((size != 1 && size != 2 && size != 4 && size != 8) ||
+      offset > layout->size || layout->size - offset < size) {
+    layout->replaceable = false;
+    return;
+  }
+
+  for (size_t idx = 0; idx < layout->numPieces; ++idx) {
+    Piece *piece = &layout->pieces[idx];
+    if (piece->offset == offset && piece->size == size) {
+      if (piece->kind == AH_MEM)
+        piece->kind = kind;
+      else if (kind != AH_MEM && kind != piece->kind)
+        layout->replaceable = false;
+      return;
+    } else if (piece->offset < offset + size &&
+               offset < piece->offset + piece->size) {
+      layout->replaceable = false;
+      return;
+    }
+  }
+
+  if (layout->numPieces == MAX_REPLACED_PIECES) {
+    layout->replaceable = false;
+    return;
+  }
+  layout->pieces[layout->numPieces++] = (Piece){offset, size, kind};
+}
+/**
+ * do a layout's pieces cover the whole of the temps
+ */
+static bool piecesCoverTemp(PieceLayout const *layout) {
+  size_t covered = 0;
+  for (size_t idx = 0; idx < layout->numPieces; ++idx)
+    covered += layout->pieces[idx].size;
+  return covered == layout->size;
+}
+/**
+ * find the piece at an offset
+ */
+static size_t pieceAt(PieceLayout const *layout, uint64_t offset) {
+  for (size_t idx = 0; idx < layout->numPieces; ++idx) {
+    if (layout->pieces[idx].offset == offset) return idx;
+  }
+  error(__FILE__, __LINE__, "no piece at offset");
+}
+/**
+ * get the temp holding one piece of a replaced temp, creating it if needed
+ *
+ * @param pieceNames names of the piece temps of each temp, MAX_REPLACED_PIECES
+ * per temp
+ */
+static IROperand *pieceTemp(size_t *pieceNames, PieceLayout const *layout,
+                            size_t name, size_t idx, FileListEntry *file) {
+  size_t *pieceName = &pieceNames[name * MAX_REPLACED_PIECES + idx];
+  if (*pieceName == SIZE_MAX) *pieceName = fresh(file);
+  Piece const *piece = &layout->pieces[idx];
+  return TEMP(*pieceName, piece->size, piece->size,
+              piece->kind == AH_MEM ? AH_GP : piece->kind);
+}
+/**
+ * scalar replacement of aggregates
+ *
+ * Aggregate temps copied to one another form a group. If every mention of a
+ * group's temps is a copy within the group, a constant-offset access of a
+ * scalar, an uninitialized marker, or a whole load or store through memory at
+ * a constant offset, and the accessed scalars don't partly overlap, each temp
+ * is replaced by one scalar temp per accessed part, which can then live in a
+ * register. Groups loaded or stored whole must be entirely covered by their
+ * pieces, so nothing is lost. Temps whose address is taken are never split,
+ * since ADDROF is none of the above.
+ *
+ * OFFSET_STORE(t, x, off) ==> MOVE(t_off, x)
+ * OFFSET_LOAD(x, t, off) ==> MOVE(x, t_off)
+ * MOVE(t, u) ==> MOVE(t_a, u_a), MOVE(t_b, u_b), ...
+ * MEM_LOAD(t, p, off) ==> MEM_LOAD(t_a, p, off + a), ...
+ * MEM_STORE(p, t, off) ==> MEM_STORE(p, t_a, off + a), ...
+ *
+ * @param blocks blocks to apply optimization to (mutated)
+ * @param file file the blocks are from, for fresh temps
+ */
+static void scalarReplaceAggregates(LinkedList *blocks, FileListEntry *file) {
+  size_t maxTemps = file->nextId;
+  size_t *groups = malloc(maxTemps * sizeof(size_t));
+  bool *pieceable = malloc(maxTemps * sizeof(bool));
+  PieceLayout *layouts = malloc(maxTemps * sizeof(PieceLayout));
+  for (size_t idx = 0; idx < maxTemps; ++idx) {
+    groups[idx] = idx;
+    pieceable[idx] = true;
+    layouts[idx] = (PieceLayout){false, false, 0, 0, {{0}}};
+  }
+
+  // group the temps, and rule out any mentioned in other ways
+  for (ListNode *currBlock = blocks->head->next; currBlock != blocks->tail;
+       currBlock = currBlock->next) {
+    IRBlock *block = currBlock->data;
+    for (ListNode *currInst = block->instructions.head->next;
+         currInst != block->instructions.tail; currInst = currInst->next) {
+      IRInstruction *i = currInst->data;
+      size_t arity = irOperatorArity(i->op);
+      for (size_t argIdx = 0; argIdx < arity; ++argIdx) {
+        IROperand *arg = i->args[argIdx];
+        if (!isMemTemp(arg)) continue;
+        if (!isPieceableUse(i, argIdx)) pieceable[arg->data.temp.name] = false;
+        layouts[arg->data.temp.name].replaceable = true;
+        layouts[arg->data.temp.name].size = arg->data.temp.size;
+      }
+      if (i->op == IO_MOVE && isMemTemp(i->args[0]) && isMemTemp(i->args[1]))
+        groups[groupOf(groups, i->args[0]->data.temp.name)] =
+            groupOf(groups, i->args[1]->data.temp.name);
+    }
+  }
+  for (size_t idx = 0; idx < maxTemps; ++idx) {
+    if (!pieceable[idx]) layouts[groupOf(groups, idx)].replaceable = false;
+  }
+
+  // find the pieces of each group
+  for (ListNode *currBlock = blocks->head->next; currBlock != blocks->tail;
+       currBlock = currBlock->next) {
+    IRBlock *block = currBlock->data;
+    for (ListNode *currInst = block->instructions.head->next;
+         currInst != block->instructions.tail; currInst = currInst->next) {
+      IRInstruction *i = currInst->data;
+      uint64_t offset;
+      if (i->op == IO_OFFSET_STORE && isMemTemp(i->args[0]) &&
+          integralConstantValue(i->args[2], &offset)) {
+        PieceLayout *layout =
+            &layouts[groupOf(groups, i->args[0]->data.temp.name)];
+        if (layout->replaceable) addPiece(layout, offset, i->args[1]);
+      } else if (i->op == IO_OFFSET_LOAD && isMemTemp(i->args[1]) &&
+                 integralConstantValue(i->args[2], &offset)) {
+        PieceLayout *layout =
+            &layouts[groupOf(groups, i->args[1]->data.temp.name)];
+        if (layout->replaceable) addPiece(layout, offset, i->args[0]);
+      } else if (i->op == IO_MEM_STORE && isMemTemp(i->args[1])) {
+        layouts[groupOf(groups, i->args[1]->data.temp.name)].wholeAccess = true;
+      } else if (i->op == IO_MEM_LOAD && isMemTemp(i->args[0])) {
+        layouts[groupOf(groups, i->args[0]->data.temp.name)].wholeAccess = true;
+      }
+    }
+  }
+  for (size_t idx = 0; idx < maxTemps; ++idx) {
+    if (layouts[idx].replaceable && layouts[idx].wholeAccess &&
+        !piecesCoverTemp(&layouts[idx]))
+      layouts[idx].replaceable = false;
+  }
+
+  // rewrite mentions of replaced temps in terms of their pieces
+  size_t *pieceNames =
+      malloc(maxTemps * MAX_REPLACED_PIECES * sizeof(size_t));
+  for (size_t idx = 0; idx < maxTemps * MAX_REPLACED_PIECES; ++idx)
+    pieceNames[idx] = SIZE_MAX;
+  for (ListNode *currBlock = blocks->head->next; currBlock != blocks->tail;
+       currBlock = currBlock->next) {
+    IRBlock *block = currBlock->data;
+    for (ListNode *currInst = block->instructions.head->next, *next;
+         currInst != block->instructions.tail; currInst = next) {
+      next = currInst->next;
+      IRInstruction *i = currInst->data;
+
+      // every mem temp in a pieceable use is in a replaceable group, or none
+      // are
+      size_t arity = irOperatorArity(i->op);
+      IROperand *temp = NULL;
+      for (size_t argIdx = 0; argIdx < arity && temp == NULL; ++argIdx) {
+        if (isMemTemp(i->args[argIdx])) temp = i->args[argIdx];
+      }
+      if (temp == NULL) continue;
+      size_t name = temp->data.temp.name;
+      PieceLayout const *layout = &layouts[groupOf(groups, name)];
+      if (!layout->replaceable) continue;
+
+      switch (i->op) {
+        case IO_UNINITIALIZED: {
+          for (size_t idx = 0; idx < layout->numPieces; ++idx)
+            insertNodeBefore(
+                currInst,
+                MARK_TEMP(IO_UNINITIALIZED,
+                          pieceTemp(pieceNames, layout, name, idx, file)));
+          break;
+        }
+        case IO_MOVE: {
+          size_t from = i->args[1]->data.temp.name;
+          for (size_t idx = 0; idx < layout->numPieces; ++idx)
+            insertNodeBefore(
+                currInst,
+                MOVE(pieceTemp(pieceNames, layout, name, idx, file),
+                     pieceTemp(pieceNames, layout, from, idx, file)));
+          break;
+        }
+        case IO_OFFSET_STORE: {
+          uint64_t offset = pieceableOffset(i);
+          insertNodeBefore(
+              currInst, MOVE(pieceTemp(pieceNames, layout, name,
+                                       pieceAt(layout, offset), file),
+                             irOperandCopy(i->args[1])));
+          break;
+        }
+        case IO_OFFSET_LOAD: {
+          uint64_t offset = pieceableOffset(i);
+          insertNodeBefore(
+              currInst,
+              MOVE(irOperandCopy(i->args[0]),
+                   pieceTemp(pieceNames, layout, name, pieceAt(layout, offset),
+                             file)));
+          break;
+        }
+        case IO_MEM_STORE: {
+          uint64_t offset = pieceableOffset(i);
+          for (size_t idx = 0; idx < layout->numPieces; ++idx)
+            insertNodeBefore(
+                currInst,
+                MEM_STORE(irOperandCopy(i->args[0]),
+                          pieceTemp(pieceNames, layout, name, idx, file),
+                          OFFSET((int64_t)(offset +
+                                           layout->pieces[idx].offset))));
+          break;
+        }
+        case IO_MEM_LOAD: {
+          uint64_t offset = pieceableOffset(i);
+          for (size_t idx = 0; idx < layout->numPieces; ++idx)
+            insertNodeBefore(
+                currInst,
+                MEM_LOAD(pieceTemp(pieceNames, layout, name, idx, file),
+                         irOperandCopy(i->args[1]),
+                         OFFSET((int64_t)(offset +
+                                          layout->pieces[idx].offset))));
+          break;
+        }
+        default: {
+          error(__FILE__, __LINE__, "replaced temp used in an unpieceable way");
+        }
+      }
+      irInstructionFree(removeNode(currInst));
+    }
+  }
+
+  free(pieceNames);
+  free(layouts);
+  free(pieceable);
+  free(groups);
+}
+
+void optimizeBlockedIr(void) {
+  for (size_t fileIdx = 0; fileIdx < fileList.size; ++fileIdx) {
+    FileListEntry *file = &fileList.entries[fileIdx];
+    Vector *irFrags = &fileList.entries[fileIdx].irFrags;
+    for (size_t fragIdx = 0; fragIdx < irFrags->size; ++fragIdx) {
+      IRFrag *frag = irFrags->elements[fragIdx];
+      if (frag->type == FT_TEXT) {
+        LinkedList *blocks = &frag->data.text.blocks;
+        inlineFunctions(frag, file);
+        scalarReplaceAggregates(blocks, file);
+        // TODO: (difficult) constant propogation
+        // (if only ever used in context where a constant can be used, may
+        // replace temp with constant)
+        // TODO: (difficult) loop-invariant hoisting
+        // (if some expression doesn't change across loop iterations, compute it
+        // outside of the loop)
+        // TODO: (difficult) loop induction variables
+        // (only keep one iteration count for the loop, or reduce for loops to
+        // start and end pointer loops)
+        // TODO: (difficult) common subexpression elimination
+        // (if two expressions are the same, only compute them once)
+        // TODO: (difficult) copy propagation
+        // (if tempB is moved to tempA and tempB isn't changed afterwards,
+        // replace all instances of tempA afterwards with tempB)
+        strengthReduceMultiplication(blocks, file);
+        compareBranchFusion(blocks, irFrags, file->nextId);
+        shortCircuitJumps(blocks);
+        deadBlockElimination(blocks, irFrags);
+        selectFormation(blocks, irFrags, file);
+        // TODO: dead label elimination
+        deadTempElimination(blocks, file->nextId);
+      }
+    }
+  }
+}
+
+static void deadLabelElimination(LinkedList *instructions, Vector *frags,
+                                 size_t maxLabels) {
+  // mark all of the blocks we jump to as seen
+  bool *seen = calloc(maxLabels, sizeof(bool));
+
+  // deal with jump tables
+  // TODO: refactor out of per-frag loop
+  for (size_t fragIdx = 0; fragIdx < frags->size; ++fragIdx) {
+    IRFrag *f = frags->elements[fragIdx];
+    switch (f->type) {
+      case FT_RODATA: {
+        Vector *data = &f->data.data.data;
+        for (size_t datumIdx = 0; datumIdx < data->size; ++datumIdx) {
+          IRDatum *datum = data->elements[datumIdx];
+          if (datum->type == DT_LOCAL) seen[datum->data.localLabel] = true;
+        }
+      }
+      default: {
+        break;
+      }
+    }
+  }
+
+  for (ListNode *curr = instructions->head->next; curr != instructions->tail;
+       curr = curr->next) {
+    IRInstruction *i = curr->data;
+    switch (i->op) {
+      case IO_JUMP: {
+        seen[localOperandName(i->args[0])] = true;
+        break;
+      }
+      case IO_JUMPTABLE: {
+        IRFrag *table = findFrag(frags, localOperandName(i->args[1]));
+        for (size_t idx = 0; idx < table->data.data.data.size; ++idx) {
+          IRDatum *datum = table->data.data.data.elements[idx];
+          seen[datum->data.localLabel] = true;
+        }
+        break;
+      }
+      case IO_J1L:
+      case IO_J1LE:
+      case IO_J1E:
+      case IO_J1NE:
+      case IO_J1G:
+      case IO_J1GE:
+      case IO_J1A:
+      case IO_J1AE:
+      case IO_J1B:
+      case IO_J1BE:
+      case IO_J1FL:
+      case IO_J1FLE:
+      case IO_J1FE:
+      case IO_J1FNE:
+      case IO_J1FG:
+      case IO_J1FGE:
+      case IO_J1Z:
+      case IO_J1NZ: {
+        seen[localOperandName(i->args[0])] = true;
+        break;
+      }
+      default: {
+        // not a jump
+        break;
+      }
+    }
+  }
+
+  for (ListNode *curr = instructions->head->next; curr != instructions->tail;) {
+    IRInstruction *i = curr->data;
+    if (i->op == IO_LABEL && !seen[localOperandName(i->args[0])]) {
+      ListNode *toRemove = curr;
+      curr = curr->next;
+      irInstructionFree(removeNode(toRemove));
+    } else {
+      curr = curr->next;
+    }
+  }
+
+  free(seen);
+}
+
+/**
+ * find the temps that appear as some argument of some operator
+ *
+ * @param instructions instructions to search
+ * @param maxTemps number of temps in the file
+ * @param op operator to look for
+ * @param argIdx argument of op to look at
+ * @returns array mapping temp name to whether it appears there
+ */
+static bool *findMarkedTemps(LinkedList *instructions, size_t maxTemps,
+                             IROperator op, size_t argIdx) {
+  bool *marked = calloc(maxTemps, sizeof(bool));
+  for (ListNode *currInst = instructions->head->next;
+       currInst != instructions->tail; currInst = currInst->next) {
+    IRInstruction *i = currInst->data;
+    if (i->op == op && i->args[argIdx]->kind == OK_TEMP)
+      marked[i->args[argIdx]->data.temp.name] = true;
+  }
+  return marked;
+}
+/**
+ * does this instruction end a straight-line run of code - might the next
+ * instruction not be the only thing that happens after it
+ */
+static bool endsStraightLine(IROperator op) {
+  return op == IO_JUMP || op == IO_JUMPTABLE || op == IO_RETURN ||
+         op == IO_TAIL_CALL || (IO_J2L <= op && op <= IO_J1NZ);
+}
+
+/**
+ * a temp known to hold a copy of an address
+ */
+typedef struct {
+  IROperand const *temp;
+  IROperand const *source; /**< temp or symbol that was copied */
+} Copy;
+/**
+ * find the base that an address is a copy of
+ */
+static IROperand const *copiedBase(Copy const *copies, size_t numCopies,
+                                   IROperand const *base) {
+  for (size_t idx = numCopies; idx-- > 0;) {
+    if (sameTemp(copies[idx].temp, base)) return copies[idx].source;
+  }
+  return base;
+}
+/**
+ * find the base address each memory access is at, looking through copies
+ *
+ * Within straight-line code, a temp that was moved from a pointer temp or a
+ * symbol and neither has changed since is the same address.
+ *
+ * @param instructions instructions to search
+ * @param numInstructions number of instructions
+ * @returns array mapping instruction index to the base of its memory access,
+ * or NULL if it isn't one; bases are borrowed from the instructions
+ */
+static IROperand const **findMemoryBases(LinkedList *instructions,
+                                         size_t numInstructions) {
+  IROperand const **bases =
+      malloc(numInstructions * sizeof(IROperand const *));
+  Copy *copies = malloc(numInstructions * sizeof(Copy));
+  size_t numCopies = 0;
+  size_t idx = 0;
+  for (ListNode *currInst = instructions->head->next;
+       currInst != instructions->tail; currInst = currInst->next, ++idx) {
+    IRInstruction *i = currInst->data;
+    bases[idx] = NULL;
+    if (i->op == IO_LABEL) {
+      numCopies = 0;
+    } else if (i->op == IO_MEM_LOAD) {
+      bases[idx] = copiedBase(copies, numCopies, i->args[1]);
+    } else if (i->op == IO_MEM_STORE) {
+      bases[idx] = copiedBase(copies, numCopies, i->args[0]);
+    }
+
+    if (writesFirstArg(i->op) && i->args[0]->kind == OK_TEMP) {
+      IROperand const *source =
+          i->op == IO_MOVE ? copiedBase(copies, numCopies, i->args[1]) : NULL;
+      size_t kept = 0;
+      for (size_t copyIdx = 0; copyIdx < numCopies; ++copyIdx) {
+        if (!sameTemp(copies[copyIdx].temp, i->args[0]) &&
+            !sameTemp(copies[copyIdx].source, i->args[0]))
+          copies[kept++] = copies[copyIdx];
+      }
+      numCopies = kept;
+      if (source != NULL && i->args[0]->data.temp.kind == AH_GP &&
+          irOperandSizeof(i->args[0]) == POINTER_WIDTH &&
+          !sameTemp(source, i->args[0]) &&
+          ((source->kind == OK_TEMP && source->data.temp.kind == AH_GP) ||
+           irOperandIsGlobal(source) || irOperandIsLocal(source)))
+        copies[numCopies++] = (Copy){i->args[0], source};
+    }
+  }
+  free(copies);
+  return bases;
+}
+
+/**
+ * a location in memory, or in part of a mem temp
+ */
+typedef struct {
+  IROperand const *base; /**< address, or the mem temp itself */
+  bool inTemp;           /**< is this a part of the mem temp in base */
+  bool knownOffset;      /**< is the offset a constant */
+  uint64_t offset;
+  size_t size;
+} Location;
+/**
+ * a location known to hold the value of a temp or constant
+ */
+typedef struct {
+  Location location;
+  IROperand const *value;
+} KnownValue;
+
+/**
+ * find the location accessed by a memory or offset load or store
+ */
+static void locationOf(Location *location, IROperand const *base,
+                       IROperand const *offset, size_t size, bool inTemp) {
+  location->base = base;
+  location->inTemp = inTemp;
+  location->offset = 0;
+  location->knownOffset = integralConstantValue(offset, &location->offset);
+  location->size = size;
+}
+/**
+ * is this operand the address of a distinct object - a global or local label
+ */
+static bool isSymbol(IROperand const *o) {
+  return irOperandIsGlobal(o) || irOperandIsLocal(o);
+}
+/**
+ * are two bases certainly the same
+ */
+static bool sameBase(IROperand const *a, IROperand const *b) {
+  if (a->kind == OK_TEMP) return sameTemp(a, b);
+  if (irOperandIsGlobal(a))
+    return irOperandIsGlobal(b) &&
+           strcmp(globalOperandName(a), globalOperandName(b)) == 0;
+  if (irOperandIsLocal(a))
+    return irOperandIsLocal(b) && localOperandName(a) == localOperandName(b);
+  return false;
+}
+/**
+ * could two locations overlap
+ *
+ * Parts of mem temps are only ever reached through their temp; temps whose
+ * address is taken are handled by the callers. Accesses from the same base
+ * overlap if their offsets might, and distinct symbols never overlap, but
+ * anything else through an address might.
+ */
+static bool mayAlias(Location const *a, Location const *b) {
+  if (a->inTemp != b->inTemp) return false;
+  if (sameBase(a->base, b->base))
+    return !a->knownOffset || !b->knownOffset ||
+           (a->offset < b->offset + b->size &&
+            b->offset < a->offset + a->size);
+  return !a->inTemp && !(isSymbol(a->base) && isSymbol(b->base));
+}
+/**
+ * is a location certainly entirely within another
+ */
+static bool locationCovers(Location const *outer, Location const *inner) {
+  return outer->inTemp == inner->inTemp && outer->knownOffset &&
+         inner->knownOffset && sameBase(outer->base, inner->base) &&
+         outer->offset <= inner->offset &&
+         inner->offset + inner->size <= outer->offset + outer->size;
+}
+/**
+ * can a location be tracked - is it at a known offset from a temp or symbol
+ */
+static bool isTrackable(Location const *location) {
+  return location->knownOffset &&
+         (location->base->kind == OK_TEMP || isSymbol(location->base));
+}
+/**
+ * is this a volatile memory access - is the address or loaded value marked
+ * with IO_VOLATILE
+ */
+static bool isVolatileAccess(IRInstruction const *i, bool const *volatiles) {
+  IROperand const *addr = i->args[i->op == IO_MEM_STORE ? 0 : 1];
+  IROperand const *value = i->args[i->op == IO_MEM_STORE ? 1 : 0];
+  return (addr->kind == OK_TEMP && volatiles[addr->data.temp.name]) ||
+         (value->kind == OK_TEMP && volatiles[value->data.temp.name]);
+}
+/**
+ * does this instruction read or write a temp whose address is taken
+ *
+ * @param written true to look for writes, false for reads
+ */
+static bool mentionsAddressedTemp(IRInstruction const *i, bool const *addressed,
+                                  bool written) {
+  size_t arity = irOperatorArity(i->op);
+  for (size_t idx = 0; idx < arity; ++idx) {
+    if ((idx == 0 && writesFirstArg(i->op)) == written &&
+        i->args[idx]->kind == OK_TEMP &&
+        addressed[i->args[idx]->data.temp.name])
+      return true;
+  }
+  return false;
+}
+/**
+ * can a temp or constant be remembered as the contents of a location
+ */
+static bool isRememberable(IROperand const *value, bool const *addressed) {
+  return value->kind == OK_CONSTANT ||
+         (value->kind == OK_TEMP && !addressed[value->data.temp.name]);
+}
+
+/**
+ * forget known values that might be changed by a store to a location
+ */
+static void forgetAliases(KnownValue *known, size_t *numKnown,
+                          Location const *location) {
+  size_t kept = 0;
+  for (size_t idx = 0; idx < *numKnown; ++idx) {
+    if (!mayAlias(&known[idx].location, location)) known[kept++] = known[idx];
+  }
+  *numKnown = kept;
+}
+/**
+ * forget known values in memory (but not in mem temps)
+ */
+static void forgetMemory(KnownValue *known, size_t *numKnown) {
+  size_t kept = 0;
+  for (size_t idx = 0; idx < *numKnown; ++idx) {
+    if (known[idx].location.inTemp) known[kept++] = known[idx];
+  }
+  *numKnown = kept;
+}
+/**
+ * forget known values held in a temp
+ */
+static void forgetValue(KnownValue *known, size_t *numKnown,
+                        IROperand const *temp) {
+  size_t kept = 0;
+  for (size_t idx = 0; idx < *numKnown; ++idx) {
+    if (!sameTemp(known[idx].value, temp)) known[kept++] = known[idx];
+  }
+  *numKnown = kept;
+}
+/**
+ * forget known values held in or addressed through a temp
+ */
+static void forgetTemp(KnownValue *known, size_t *numKnown,
+                       IROperand const *temp) {
+  size_t kept = 0;
+  for (size_t idx = 0; idx < *numKnown; ++idx) {
+    if (!sameTemp(known[idx].location.base, temp) &&
+        !sameTemp(known[idx].value, temp))
+      known[kept++] = known[idx];
+  }
+  *numKnown = kept;
+}
+/**
+ * replace a load with a move from a known value, if there is one
+ *
+ * @returns whether the load was replaced
+ */
+static bool reuseKnownValue(IRInstruction *i, KnownValue const *known,
+                            size_t numKnown, Location const *location) {
+  IROperand const *dest = i->args[0];
+  for (size_t idx = numKnown; idx-- > 0;) {
+    Location const *candidate = &known[idx].location;
+    IROperand const *value = known[idx].value;
+    if (candidate->inTemp == location->inTemp &&
+        sameBase(candidate->base, location->base) &&
+        candidate->offset == location->offset &&
+        candidate->size == location->size) {
+      if (dest->kind != OK_TEMP ||
+          (value->kind == OK_TEMP
+               ? value->data.temp.kind != dest->data.temp.kind
+               : dest->data.temp.kind == AH_FP))
+        return false;
+      IROperand *replacement = irOperandCopy(value);
+      irOperandFree(i->args[1]);
+      irOperandFree(i->args[2]);
+      i->op = IO_MOVE;
+      i->args[1] = replacement;
+      return true;
+    }
+  }
+  return false;
+}
+/**
+ * redundant load elimination
+ *
+ * Within straight-line code, remembers which temp or constant each location
+ * was last loaded into or stored from, and replaces later loads of the same
+ * location with moves, until a store that might alias the location, a write
+ * to the address or value temp, a call, or a volatile access. Parts of mem
+ * temps whose address is never taken can only change through that temp.
+ *
+ * MEM_LOAD(x, p, 8), ..., MEM_LOAD(y, p, 8) ==> ..., MOVE(y, x)
+ * MEM_STORE(p, x, 8), ..., MEM_LOAD(y, p, 8) ==> ..., MOVE(y, x)
+ * OFFSET_LOAD(x, t, 8), ..., OFFSET_LOAD(y, t, 8) ==> ..., MOVE(y, x)
+ *
+ * @param instructions instructions to apply optimization to (mutated)
+ * @param maxTemps number of temps in the file
+ */
+static void redundantLoadElimination(LinkedList *instructions,
+                                     size_t maxTemps) {
+  bool *addressed = findMarkedTemps(instructions, maxTemps, IO_ADDROF, 1);
+  bool *volatiles = findMarkedTemps(instructions, maxTemps, IO_VOLATILE, 0);
+  size_t numInstructions = 0;
+  for (ListNode *currInst = instructions->head->next;
+       currInst != instructions->tail; currInst = currInst->next)
+    ++numInstructions;
+  IROperand const **bases = findMemoryBases(instructions, numInstructions);
+  KnownValue *known = malloc(numInstructions * sizeof(KnownValue));
+  size_t numKnown = 0;
+
+  size_t idx = 0;
+  for (ListNode *currInst = instructions->head->next;
+       currInst != instructions->tail; currInst = currInst->next, ++idx) {
+    IRInstruction *i = currInst->data;
+    Location location;
+    bool remember = false;
+    switch (i->op) {
+      case IO_LABEL: {
+        numKnown = 0;
+        break;
+      }
+      case IO_MEM_LOAD: {
+        if (isVolatileAccess(i, volatiles)) {
+          numKnown = 0;
+          break;
+        }
+        locationOf(&location, bases[idx], i->args[2],
+                   irOperandSizeof(i->args[0]), false);
+        if (!isTrackable(&location) ||
+            reuseKnownValue(i, known, numKnown, &location))
+          break;
+        remember = isRememberable(i->args[0], addressed) &&
+                   !sameTemp(i->args[0], bases[idx]);
+        break;
+      }
+      case IO_MEM_STORE: {
+        if (isVolatileAccess(i, volatiles)) {
+          numKnown = 0;
+          break;
+        }
+        locationOf(&location, bases[idx], i->args[2],
+                   irOperandSizeof(i->args[1]), false);
+        forgetAliases(known, &numKnown, &location);
+        remember =
+            isTrackable(&location) && isRememberable(i->args[1], addressed);
+        break;
+      }
+      case IO_OFFSET_LOAD: {
+        if (!isMemTemp(i->args[1]) || addressed[i->args[1]->data.temp.name] ||
+            volatiles[i->args[1]->data.temp.name])
+          break;
+        locationOf(&location, i->args[1], i->args[2],
+                   irOperandSizeof(i->args[0]), true);
+        if (!location.knownOffset ||
+            reuseKnownValue(i, known, numKnown, &location))
+          break;
+        remember = isRememberable(i->args[0], addressed);
+        break;
+      }
+      case IO_OFFSET_STORE: {
+        // only the stored-to part and whole copies of the temp change
+        locationOf(&location, i->args[0], i->args[2],
+                   irOperandSizeof(i->args[1]), true);
+        forgetAliases(known, &numKnown, &location);
+        forgetValue(known, &numKnown, i->args[0]);
+        remember = location.knownOffset &&
+                   !addressed[i->args[0]->data.temp.name] &&
+                   !volatiles[i->args[0]->data.temp.name] &&
+                   isRememberable(i->args[1], addressed);
+        break;
+      }
+      case IO_CALL: {
+        forgetMemory(known, &numKnown);
+        break;
+      }
+      default: {
+        break;
+      }
+    }
+
+    // the written temp no longer holds what it used to
+    if (writesFirstArg(i->op) && i->op != IO_OFFSET_STORE &&
+        i->args[0]->kind == OK_TEMP)
+      forgetTemp(known, &numKnown, i->args[0]);
+    // and memory might have changed through a pointer to it
+    if (mentionsAddressedTemp(i, addressed, true))
+      forgetMemory(known, &numKnown);
+
+    if (remember) {
+      known[numKnown++] = (KnownValue){
+          location, i->op == IO_MEM_STORE || i->op == IO_OFFSET_STORE
+                        ? i->args[1]
+                        : i->args[0]};
+    }
+  }
+
+  free(known);
+  free(bases);
+  free(volatiles);
+  free(addressed);
+}
+/**
+ * dead store elimination
+ *
+ * Within straight-line code, removes stores to memory that are entirely
+ * overwritten by a later store to the same address before anything might read
+ * them - a load that might alias them, a read of a temp whose address is
+ * taken, a call, or a volatile access.
+ *
+ * MEM_STORE(p, x, 8), ..., MEM_STORE(p, y, 8) ==> ..., MEM_STORE(p, y, 8)
+ *
+ * @param instructions instructions to apply optimization to (mutated)
+ * @param maxTemps number of temps in the file
+ */
+static void deadStoreElimination(LinkedList *instructions, size_t maxTemps) {
+  bool *addressed = findMarkedTemps(instructions, maxTemps, IO_ADDROF, 1);
+  bool *volatiles = findMarkedTemps(instructions, maxTemps, IO_VOLATILE, 0);
+  size_t numInstructions = 0;
+  for (ListNode *currInst = instructions->head->next;
+       currInst != instructions->tail; currInst = currInst->next)
+    ++numInstructions;
+  IROperand const **bases = findMemoryBases(instructions, numInstructions);
+  // locations stored to later on, and not read in between
+  Location *overwritten = malloc(numInstructions * sizeof(Location));
+  size_t numOverwritten = 0;
+
+  size_t idx = numInstructions;
+  for (ListNode *currInst = instructions->tail->prev;
+       currInst != instructions->head; currInst = currInst->prev) {
+    IRInstruction *i = currInst->data;
+    --idx;
+    if (endsStraightLine(i->op) || i->op == IO_CALL) {
+      numOverwritten = 0;
+    } else if (i->op == IO_MEM_STORE) {
+      if (isVolatileAccess(i, volatiles)) {
+        numOverwritten = 0;
+        continue;
+      }
+      Location location;
+      locationOf(&location, bases[idx], i->args[2],
+                 irOperandSizeof(i->args[1]), false);
+      if (isTrackable(&location)) {
+        bool dead = false;
+        for (size_t prevIdx = 0; prevIdx < numOverwritten && !dead; ++prevIdx)
+          dead = locationCovers(&overwritten[prevIdx], &location);
+        if (dead) {
+          irInstructionMakeNop(i);
+          continue;
+        }
+        overwritten[numOverwritten++] = location;
+      }
+    } else if (i->op == IO_MEM_LOAD) {
+      if (isVolatileAccess(i, volatiles)) {
+        numOverwritten = 0;
+        continue;
+      }
+      Location location;
+      locationOf(&location, bases[idx], i->args[2],
+                 irOperandSizeof(i->args[0]), false);
+      size_t kept = 0;
+      for (size_t prevIdx = 0; prevIdx < numOverwritten; ++prevIdx) {
+        if (!mayAlias(&overwritten[prevIdx], &location))
+          overwritten[kept++] = overwritten[prevIdx];
+      }
+      numOverwritten = kept;
+    }
+
+    if (mentionsAddressedTemp(i, addressed, false)) numOverwritten = 0;
+    // before this, the written temp held some other address
+    if (writesFirstArg(i->op) && i->args[0]->kind == OK_TEMP) {
+      size_t kept = 0;
+      for (size_t prevIdx = 0; prevIdx < numOverwritten; ++prevIdx) {
+        if (!sameTemp(overwritten[prevIdx].base, i->args[0]))
+          overwritten[kept++] = overwritten[prevIdx];
+      }
+      numOverwritten = kept;
+    }
+  }
+
+  free(overwritten);
+  free(bases);
+  free(volatiles);
+  free(addressed);
 }
 
 void optimizeScheduledIr(void) {
@@ -559,6 +2354,8 @@ void optimizeScheduledIr(void) {
       if (frag->type == FT_TEXT) {
         IRBlock *block = frag->data.text.blocks.head->next->data;
         deadLabelElimination(&block->instructions, irFrags, file->nextId);
+        redundantLoadElimination(&block->instructions, file->nextId);
+        deadStoreElimination(&block->instructions, file->nextId);
       }
     }
   }
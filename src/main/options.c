@@ -20,13 +20,33 @@
 #include "options.h"
 
 #include <stdio.h>
+#include <stdlib.h>
 #include <string.h>
 
 Options options = {
-    OPTION_W_ERROR, OPTION_W_ERROR, OPTION_W_ERROR,
-    OPTION_DD_NONE, false,          OPTION_A_X86_64_LINUX,
+    OPTION_W_ERROR, OPTION_W_ERROR,        OPTION_W_ERROR, OPTION_DD_NONE,
+    false,          OPTION_A_X86_64_LINUX, 16,             OPTION_RA_AUTO,
+    5000,           OPTION_EMIT_ASM,       NULL,
 };
 
+/**
+ * parses the value of a numeric option
+ *
+ * @param value text after the '='
+ * @param out output parameter for the parsed number
+ * @returns status code (0 = OK)
+ */
+static int parseNumericOption(char const *value, size_t *out) {
+  if (*value < '0' || *value > '9') return -1;
+
+  char *end;
+  unsigned long long parsed = strtoull(value, &end, 10);
+  if (*end != '\0') return -1;
+
+  *out = (size_t)parsed;
+  return 0;
+}
+
 int parseArgs(size_t argc, char const *const *argv, size_t *numFilesOut) {
   size_t numFiles = 0;
 
@@ -76,6 +96,36 @@ int parseArgs(size_t argc, char const *const *argv, size_t *numFilesOut) {
       options.debugValidateIr = false;
     } else if (strcmp(argv[idx], "--arch=x86_64-linux") == 0) {
       options.arch = OPTION_A_X86_64_LINUX;
+    } else if (strncmp(argv[idx], "--inline-threshold=", 19) == 0) {
+      if (parseNumericOption(argv[idx] + 19, &options.inlineThreshold) != 0) {
+        fprintf(stderr, "tlc: error: invalid inline threshold in '%s'\n",
+                argv[idx]);
+        return -1;
+      }
+    } else if (strcmp(argv[idx], "--register-allocator=auto") == 0) {
+      options.registerAllocator = OPTION_RA_AUTO;
+    } else if (strcmp(argv[idx], "--register-allocator=graph-coloring") == 0) {
+      options.registerAllocator = OPTION_RA_GRAPH_COLORING;
+    } else if (strcmp(argv[idx], "--register-allocator=linear-scan") == 0) {
+      options.registerAllocator = OPTION_RA_LINEAR_SCAN;
+    } else if (strncmp(argv[idx], "--linear-scan-threshold=", 24) == 0) {
+      if (parseNumericOption(argv[idx] + 24, &options.linearScanThreshold) !=
+          0) {
+        fprintf(stderr, "tlc: error: invalid linear scan threshold in '%s'\n",
+                argv[idx]);
+        return -1;
+      }
+    } else if (strcmp(argv[idx], "--emit=asm") == 0) {
+      options.emit = OPTION_EMIT_ASM;
+    } else if (strcmp(argv[idx], "--emit=obj") == 0) {
+      options.emit = OPTION_EMIT_OBJ;
+    } else if (strncmp(argv[idx], "--run=", 6) == 0) {
+      if (argv[idx][6] == '\0') {
+        fprintf(stderr, "tlc: error: missing function name in '%s'\n",
+                argv[idx]);
+        return -1;
+      }
+      options.run = argv[idx] + 6;
     } else {
       fprintf(stderr, "tlc: error: options '%s' not recognized\n", argv[idx]);
       return -1;
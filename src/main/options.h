@@ -48,6 +48,17 @@ typedef enum {
 typedef enum {
   OPTION_A_X86_64_LINUX,
 } ArchOption;
+/** Register allocation algorithms */
+typedef enum {
+  OPTION_RA_AUTO,
+  OPTION_RA_GRAPH_COLORING,
+  OPTION_RA_LINEAR_SCAN,
+} RegisterAllocatorOption;
+/** Output file kinds */
+typedef enum {
+  OPTION_EMIT_ASM,
+  OPTION_EMIT_OBJ,
+} EmitOption;
 /** Holds options */
 typedef struct {
   WarningOption duplicateFile;
@@ -56,6 +67,11 @@ typedef struct {
   DebugDumpOption dump;
   bool debugValidateIr;
   ArchOption arch;
+  size_t inlineThreshold;
+  RegisterAllocatorOption registerAllocator;
+  size_t linearScanThreshold;
+  EmitOption emit;
+  char const *run; /**< qualified name of the function to run, or NULL */
 } Options;
 
 /**
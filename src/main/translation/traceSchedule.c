@@ -19,6 +19,8 @@
 
 #include "translation/traceSchedule.h"
 
+#include <stdlib.h>
+
 #include "fileList.h"
 #include "ir/ir.h"
 #include "ir/shorthand.h"
@@ -118,8 +120,199 @@ static IRInstruction *oneArgJumpFromTwoArgJump(IRInstruction *i) {
     }
   }
 }
+/**
+ * get the one-arg jump taken exactly when a two-arg jump's condition is false
+ *
+ * @returns inverted jump, or IO_NOP if there isn't one - floating point
+ * comparisons are false both ways for NaNs
+ */
+static IROperator invertedOneArgJump(IROperator op) {
+  switch (op) {
+    case IO_J2L: {
+      return IO_J1GE;
+    }
+    case IO_J2LE: {
+      return IO_J1G;
+    }
+    case IO_J2E: {
+      return IO_J1NE;
+    }
+    case IO_J2NE: {
+      return IO_J1E;
+    }
+    case IO_J2G: {
+      return IO_J1LE;
+    }
+    case IO_J2GE: {
+      return IO_J1L;
+    }
+    case IO_J2A: {
+      return IO_J1BE;
+    }
+    case IO_J2AE: {
+      return IO_J1B;
+    }
+    case IO_J2B: {
+      return IO_J1AE;
+    }
+    case IO_J2BE: {
+      return IO_J1A;
+    }
+    case IO_J2Z: {
+      return IO_J1NZ;
+    }
+    case IO_J2NZ: {
+      return IO_J1Z;
+    }
+    default: {
+      return IO_NOP;
+    }
+  }
+}
+
+/**
+ * does a label start a chain of unconditional jumps ending in a function exit,
+ * without merging with other code before the exit block itself
+ *
+ * @param byLabel map from label to unscheduled block
+ * @param references map from label to number of jumps to it
+ * @param maxSteps number of jumps to follow before giving up (loops forever)
+ */
+static bool leadsToExit(IRBlock **byLabel, size_t const *references,
+                        size_t label, size_t maxSteps) {
+  for (size_t step = 0; step < maxSteps; ++step) {
+    IRBlock *b = byLabel[label];
+    if (b == NULL) return false;
+    IRInstruction *last = b->instructions.tail->prev->data;
+    if (last->op == IO_RETURN || last->op == IO_TAIL_CALL) return true;
+    if (references[label] != 1 || last->op != IO_JUMP ||
+        !irOperandIsLocal(last->args[0]))
+      return false;
+    label = localOperandName(last->args[0]);
+  }
+  return false;
+}
+
+/**
+ * mark a chain of blocks only reachable through the given label as cold
+ *
+ * The chain stops at the first block with other predecessors, usually the
+ * shared exit block.
+ */
+static void markCold(bool *cold, IRBlock **byLabel, size_t const *references,
+                     size_t label) {
+  while (references[label] == 1 && !cold[label]) {
+    cold[label] = true;
+    IRInstruction *last = byLabel[label]->instructions.tail->prev->data;
+    if (last->op != IO_JUMP) return;
+    label = localOperandName(last->args[0]);
+  }
+}
+
+/**
+ * find the blocks that are cold
+ *
+ * With no profile data, a conditional jump is assumed to rarely take a side
+ * that goes straight to a function exit if the other side does more work
+ * first - this is how early error returns look. Only blocks with no other
+ * predecessors are cold, so the shared exit block stays hot. Jumps closing a
+ * loop are left alone, since the loop's exit is taken once per loop.
+ *
+ * @returns array mapping label to whether that block is cold
+ */
+static bool *findColdBlocks(LinkedList *blocks, Vector *frags,
+                            size_t maxLabels) {
+  IRBlock **byLabel = calloc(maxLabels, sizeof(IRBlock *));
+  size_t *positions = calloc(maxLabels, sizeof(size_t));
+  size_t *references = calloc(maxLabels, sizeof(size_t));
+  size_t numBlocks = 0;
+  for (ListNode *curr = blocks->head->next; curr != blocks->tail;
+       curr = curr->next) {
+    IRBlock *b = curr->data;
+    byLabel[b->label] = b;
+    positions[b->label] = numBlocks++;
+  }
+
+  // the entry block is always reachable from outside
+  ++references[((IRBlock *)blocks->head->next->data)->label];
+  for (ListNode *curr = blocks->head->next; curr != blocks->tail;
+       curr = curr->next) {
+    IRBlock *b = curr->data;
+    IRInstruction *last = b->instructions.tail->prev->data;
+    switch (last->op) {
+      case IO_JUMP: {
+        if (irOperandIsLocal(last->args[0]))
+          ++references[localOperandName(last->args[0])];
+        break;
+      }
+      case IO_JUMPTABLE: {
+        IRFrag *table = findFrag(frags, localOperandName(last->args[1]));
+        for (size_t idx = 0; idx < table->data.data.data.size; ++idx) {
+          IRDatum *datum = table->data.data.data.elements[idx];
+          ++references[datum->data.localLabel];
+        }
+        break;
+      }
+      case IO_RETURN:
+      case IO_TAIL_CALL: {
+        break;
+      }
+      default: {
+        // two-arg jump
+        ++references[localOperandName(last->args[0])];
+        ++references[localOperandName(last->args[1])];
+        break;
+      }
+    }
+  }
+
+  bool *cold = calloc(maxLabels, sizeof(bool));
+  for (ListNode *curr = blocks->head->next; curr != blocks->tail;
+       curr = curr->next) {
+    IRBlock *b = curr->data;
+    IRInstruction *last = b->instructions.tail->prev->data;
+    switch (last->op) {
+      case IO_JUMP:
+      case IO_JUMPTABLE:
+      case IO_RETURN:
+      case IO_TAIL_CALL: {
+        break;
+      }
+      default: {
+        size_t trueLabel = localOperandName(last->args[0]);
+        size_t falseLabel = localOperandName(last->args[1]);
+        if (positions[trueLabel] <= positions[b->label] ||
+            positions[falseLabel] <= positions[b->label])
+          break;  // loops back
+        bool trueExits =
+            leadsToExit(byLabel, references, trueLabel, numBlocks);
+        bool falseExits =
+            leadsToExit(byLabel, references, falseLabel, numBlocks);
+        if (trueExits && !falseExits)
+          markCold(cold, byLabel, references, trueLabel);
+        else if (falseExits && !trueExits)
+          markCold(cold, byLabel, references, falseLabel);
+        break;
+      }
+    }
+  }
+
+  free(references);
+  free(positions);
+  free(byLabel);
+  return cold;
+}
+
+/**
+ * schedule a block and the trace following it
+ *
+ * @param cold array mapping label to whether that block is cold, or NULL if
+ * cold blocks may be scheduled inline
+ * @param deferred labels of cold blocks jumped to but not scheduled
+ */
 static void scheduleBlock(IRBlock *b, IRBlock *out, LinkedList *blocks,
-                          Vector *frags) {
+                          Vector *frags, bool const *cold,
+                          SizeVector *deferred) {
   for (ListNode *currBlock = blocks->head->next; currBlock != blocks->tail;
        currBlock = currBlock->next) {
     if (currBlock->data == b) {
@@ -152,14 +345,16 @@ static void scheduleBlock(IRBlock *b, IRBlock *out, LinkedList *blocks,
   IRInstruction *last = b->instructions.tail->prev->data;
   switch (last->op) {
     case IO_JUMP: {
-      // if it's a jump to a local, schedule that block and skip the jump,
-      // otherwise, copy the jump verbatim
-      if (irOperandIsLocal(last->args[0])) {
-        IRBlock *found = findBlock(blocks, localOperandName(last->args[0]));
-        if (found != NULL) scheduleBlock(found, out, blocks, frags);
-      } else {
+      // if it's a jump to an unscheduled local, schedule that block and skip
+      // the jump, otherwise, copy the jump verbatim
+      IRBlock *found =
+          irOperandIsLocal(last->args[0])
+              ? findBlock(blocks, localOperandName(last->args[0]))
+              : NULL;
+      if (found != NULL)
+        scheduleBlock(found, out, blocks, frags, cold, deferred);
+      else
         copyOverLastInstruction(b, out);
-      }
       break;
     }
     case IO_JUMPTABLE: {
@@ -168,7 +363,8 @@ static void scheduleBlock(IRBlock *b, IRBlock *out, LinkedList *blocks,
       for (size_t idx = 0; idx < table->data.data.data.size; ++idx) {
         IRDatum *datum = table->data.data.data.elements[idx];
         IRBlock *found = findBlock(blocks, datum->data.localLabel);
-        if (found != NULL) scheduleBlock(found, out, blocks, frags);
+        if (found != NULL)
+          scheduleBlock(found, out, blocks, frags, cold, deferred);
       }
       break;
     }
@@ -190,18 +386,43 @@ static void scheduleBlock(IRBlock *b, IRBlock *out, LinkedList *blocks,
     case IO_J2FGE:
     case IO_J2Z:
     case IO_J2NZ: {
-      // both must be jumps to locals - assume falsehood is more likely
+      // both must be jumps to locals - assume falsehood is more likely,
+      // unless only the false branch is cold
+      size_t trueLabel = localOperandName(last->args[0]);
+      size_t falseLabel = localOperandName(last->args[1]);
+      bool trueCold = cold != NULL && cold[trueLabel];
+      bool falseCold = cold != NULL && cold[falseLabel];
+      IROperator inverted = invertedOneArgJump(last->op);
+      if (falseCold && !trueCold && inverted != IO_NOP) {
+        IR(out, inverted == IO_J1Z || inverted == IO_J1NZ
+                    ? oneArgBJumpCreate(inverted, last->args[1], last->args[2])
+                    : oneArgCJumpCreate(inverted, last->args[1], last->args[2],
+                                        last->args[3]));
+        sizeVectorInsert(deferred, falseLabel);
+        IRBlock *found = findBlock(blocks, trueLabel);
+        if (found != NULL)
+          scheduleBlock(found, out, blocks, frags, cold, deferred);
+        else
+          IR(out, JUMP(trueLabel));
+        break;
+      }
+
       IR(out, oneArgJumpFromTwoArgJump(last));
-      IRBlock *found = findBlock(blocks, localOperandName(last->args[1]));
-      if (found != NULL) {
-        scheduleBlock(found, out, blocks, frags);
+      IRBlock *found = findBlock(blocks, falseLabel);
+      if (found != NULL && !falseCold) {
+        scheduleBlock(found, out, blocks, frags, cold, deferred);
       } else {
-        IR(out, JUMP(localOperandName(last->args[1])));
+        IR(out, JUMP(falseLabel));
+        if (found != NULL) sizeVectorInsert(deferred, falseLabel);
       }
-      found = findBlock(blocks, localOperandName(last->args[0]));
-      if (found != NULL) scheduleBlock(found, out, blocks, frags);
+      found = findBlock(blocks, trueLabel);
+      if (found != NULL && !trueCold)
+        scheduleBlock(found, out, blocks, frags, cold, deferred);
+      else if (found != NULL)
+        sizeVectorInsert(deferred, trueLabel);
       break;
     }
+    case IO_TAIL_CALL:
     case IO_RETURN: {
       // append it without modification
       copyOverLastInstruction(b, out);
@@ -228,7 +449,23 @@ void traceSchedule(void) {
           blocks.tail = frag->data.text.blocks.tail;
           linkedListInit(&frag->data.text.blocks);
           IRBlock *out = BLOCK(0, &frag->data.text.blocks);
-          scheduleBlock(blocks.head->next->data, out, &blocks, &file->irFrags);
+
+          // hot code first, then the cold blocks it jumps to
+          bool *cold = findColdBlocks(&blocks, &file->irFrags, file->nextId);
+          SizeVector deferred;
+          sizeVectorInit(&deferred);
+          scheduleBlock(blocks.head->next->data, out, &blocks, &file->irFrags,
+                        cold, &deferred);
+          for (size_t idx = 0; idx < deferred.size; ++idx) {
+            IRBlock *found = findBlock(&blocks, deferred.elements[idx]);
+            if (found == NULL) continue;
+            if (frag->data.text.coldLabel == 0)
+              frag->data.text.coldLabel = found->label;
+            scheduleBlock(found, out, &blocks, &file->irFrags, NULL, NULL);
+          }
+          sizeVectorUninit(&deferred);
+          free(cold);
+
           linkedListUninit(&blocks, (void (*)(void *))irBlockFree);
         }
       }
@@ -23,7 +23,9 @@
 #include "fileList.h"
 #include "ir/ir.h"
 #include "ir/shorthand.h"
+#include "util/container/hashMap.h"
 #include "util/conversions.h"
+#include "util/functional.h"
 #include "util/internalError.h"
 #include "util/numericSizing.h"
 #include "util/string.h"
@@ -136,6 +138,199 @@ static IROperand *unsignedJumpTableEntryToConstant(JumpTableEntry const *e,
   }
 }
 
+/**
+ * minimum number of case values to use a jump table for
+ */
+static size_t const JUMP_TABLE_MIN_CASES = 4;
+/**
+ * minimum percentage of a jump table's entries that must be case values (and
+ * not holes filled in with the default label)
+ */
+static size_t const JUMP_TABLE_MIN_DENSITY = 40;
+/**
+ * maximum number of entries in a jump table
+ */
+static uint64_t const JUMP_TABLE_MAX_ENTRIES = 4096;
+
+/**
+ * a switch statement being lowered
+ */
+typedef struct {
+  JumpTableEntry const *entries; /**< case values, sorted */
+  IROperand const *condition;    /**< value being switched on */
+  Type const *switchedType;
+  size_t size; /**< size of switchedType */
+  bool isSigned;
+  size_t defaultLabel;
+} SwitchInfo;
+/**
+ * a run of case values lowered as one jump table, or a single case value
+ */
+typedef struct {
+  size_t start; /**< index of first entry */
+  size_t end;   /**< index of last entry, inclusive */
+  bool table;
+} SwitchCluster;
+
+static IROperand *jumpTableEntryToConstant(JumpTableEntry const *e,
+                                           SwitchInfo const *s) {
+  return s->isSigned ? signedJumpTableEntryToConstant(e, s->size)
+                     : unsignedJumpTableEntryToConstant(e, s->size);
+}
+/**
+ * difference between the last and the first of a run of sorted entries
+ *
+ * works for signed entries too, since the subtraction wraps around
+ */
+static uint64_t jumpTableSpan(JumpTableEntry const *entries, size_t start,
+                              size_t end) {
+  return entries[end].value.unsignedVal - entries[start].value.unsignedVal;
+}
+
+/**
+ * group sorted case values into clusters
+ *
+ * Greedily takes the longest run starting at each entry that is dense enough
+ * to be a jump table, and leaves everything else as single values.
+ *
+ * @param entries sorted case values
+ * @param numEntries number of entries
+ * @param numClusters output number of clusters
+ * @returns array of clusters (owning)
+ */
+static SwitchCluster *clusterSwitchCases(JumpTableEntry const *entries,
+                                         size_t numEntries,
+                                         size_t *numClusters) {
+  SwitchCluster *clusters = malloc(sizeof(SwitchCluster) * numEntries);
+  *numClusters = 0;
+  for (size_t start = 0; start < numEntries;) {
+    size_t end = start;
+    for (size_t candidate = start + 1; candidate < numEntries; ++candidate) {
+      uint64_t span = jumpTableSpan(entries, start, candidate);
+      if (span >= JUMP_TABLE_MAX_ENTRIES) break;
+      if ((candidate - start + 1) * 100 >= (span + 1) * JUMP_TABLE_MIN_DENSITY)
+        end = candidate;
+    }
+
+    SwitchCluster *cluster = &clusters[(*numClusters)++];
+    cluster->start = start;
+    if (end - start + 1 >= JUMP_TABLE_MIN_CASES) {
+      cluster->end = end;
+      cluster->table = true;
+    } else {
+      cluster->end = start;
+      cluster->table = false;
+    }
+    start = cluster->end + 1;
+  }
+  return clusters;
+}
+
+/**
+ * translate a single cluster of a switch
+ *
+ * @param blocks list of blocks to put new blocks in
+ * @param label label of the first block
+ * @param cluster cluster to translate
+ * @param s switch being translated
+ * @param file file the switch is in
+ */
+static void translateSwitchCluster(LinkedList *blocks, size_t label,
+                                   SwitchCluster const *cluster,
+                                   SwitchInfo const *s, FileListEntry *file) {
+  JumpTableEntry const *first = &s->entries[cluster->start];
+  JumpTableEntry const *last = &s->entries[cluster->end];
+
+  if (!cluster->table) {
+    IRBlock *b = BLOCK(label, blocks);
+    IR(b, CJUMP(IO_J2E, first->label, s->defaultLabel,
+                irOperandCopy(s->condition),
+                jumpTableEntryToConstant(first, s)));
+    return;
+  }
+
+  // table, with holes going to the default
+  size_t tableLabel = fresh(file);
+  IRFrag *table = localDataFragCreate(FT_RODATA, tableLabel, POINTER_WIDTH);
+  vectorInsert(&file->irFrags, table);
+  uint64_t span = jumpTableSpan(s->entries, cluster->start, cluster->end);
+  size_t entryIdx = cluster->start;
+  for (uint64_t offset = 0; offset <= span; ++offset) {
+    if (s->entries[entryIdx].value.unsignedVal ==
+        first->value.unsignedVal + offset) {
+      vectorInsert(&table->data.data.data,
+                   localLabelDatumCreate(s->entries[entryIdx++].label));
+    } else {
+      vectorInsert(&table->data.data.data,
+                   localLabelDatumCreate(s->defaultLabel));
+    }
+  }
+
+  size_t gtFallthroughLabel = fresh(file);
+  IRBlock *b = BLOCK(label, blocks);
+  IR(b, CJUMP(s->isSigned ? IO_J2L : IO_J2B, s->defaultLabel,
+              gtFallthroughLabel, irOperandCopy(s->condition),
+              jumpTableEntryToConstant(first, s)));
+
+  size_t tableDerefLabel = fresh(file);
+  b = BLOCK(gtFallthroughLabel, blocks);
+  IR(b, CJUMP(s->isSigned ? IO_J2G : IO_J2A, s->defaultLabel, tableDerefLabel,
+              irOperandCopy(s->condition), jumpTableEntryToConstant(last, s)));
+
+  size_t offset = fresh(file);
+  size_t castOffset;
+  size_t multipliedOffset = fresh(file);
+  size_t target = fresh(file);
+  b = BLOCK(tableDerefLabel, blocks);
+  IR(b, BINOP(IO_SUB, TEMPOF(offset, s->switchedType),
+              irOperandCopy(s->condition), jumpTableEntryToConstant(first, s)));
+  if (s->size != POINTER_WIDTH) {
+    castOffset = fresh(file);
+    IR(b, UNOP(s->isSigned ? IO_SX : IO_ZX, TEMPPTR(castOffset),
+               TEMPOF(offset, s->switchedType)));
+  } else {
+    castOffset = offset;
+  }
+
+  IR(b, BINOP(s->isSigned ? IO_SMUL : IO_UMUL, TEMPPTR(multipliedOffset),
+              TEMPPTR(castOffset),
+              CONSTANT(POINTER_WIDTH, longDatumCreate(POINTER_WIDTH))));
+  IR(b, BINOP(IO_ADD, TEMPPTR(target), TEMPPTR(multipliedOffset),
+              LOCAL(tableLabel)));
+  IR(b, JUMPTABLE(TEMPPTR(target), tableLabel));
+}
+
+/**
+ * translate a balanced binary decision tree over the clusters of a switch
+ *
+ * @param blocks list of blocks to put new blocks in
+ * @param label label of the first block
+ * @param clusters clusters to decide between, sorted
+ * @param numClusters number of clusters (at least one)
+ * @param s switch being translated
+ * @param file file the switch is in
+ */
+static void translateSwitchTree(LinkedList *blocks, size_t label,
+                                SwitchCluster const *clusters,
+                                size_t numClusters, SwitchInfo const *s,
+                                FileListEntry *file) {
+  if (numClusters == 1) {
+    translateSwitchCluster(blocks, label, clusters, s, file);
+    return;
+  }
+
+  size_t mid = numClusters / 2;
+  size_t lowLabel = fresh(file);
+  size_t highLabel = fresh(file);
+  IRBlock *b = BLOCK(label, blocks);
+  IR(b, CJUMP(s->isSigned ? IO_J2L : IO_J2B, lowLabel, highLabel,
+              irOperandCopy(s->condition),
+              jumpTableEntryToConstant(&s->entries[clusters[mid].start], s)));
+  translateSwitchTree(blocks, lowLabel, clusters, mid, s, file);
+  translateSwitchTree(blocks, highLabel, clusters + mid, numClusters - mid, s,
+                      file);
+}
+
 /**
  * get the type of an expression
  */
@@ -252,6 +447,104 @@ static bool initializerAllZero(Node const *initializer) {
   }
 }
 
+/** fewest repeats of a scalar that get split out of a blob into a fill */
+#define FILL_MIN_COUNT 8
+
+/**
+ * create a plain datum for a scalar
+ */
+static IRDatum *scalarDatumCreate(size_t width, uint64_t value) {
+  if (width == BYTE_WIDTH)
+    return byteDatumCreate((uint8_t)value);
+  else if (width == SHORT_WIDTH)
+    return shortDatumCreate((uint16_t)value);
+  else if (width == INT_WIDTH)
+    return intDatumCreate((uint32_t)value);
+  else
+    return longDatumCreate(value);
+}
+/**
+ * get the width and value of a plain scalar datum
+ *
+ * @returns whether the datum was a plain scalar
+ */
+static bool scalarDatumValue(IRDatum const *d, size_t *width,
+                             uint64_t *value) {
+  switch (d->type) {
+    case DT_BYTE: {
+      *width = BYTE_WIDTH;
+      *value = d->data.byteVal;
+      return true;
+    }
+    case DT_SHORT: {
+      *width = SHORT_WIDTH;
+      *value = d->data.shortVal;
+      return true;
+    }
+    case DT_INT: {
+      *width = INT_WIDTH;
+      *value = d->data.intVal;
+      return true;
+    }
+    case DT_LONG: {
+      *width = LONG_WIDTH;
+      *value = d->data.longVal;
+      return true;
+    }
+    default: {
+      return false;
+    }
+  }
+}
+/**
+ * add a scalar to initializer data
+ *
+ * A lone scalar is kept as a plain datum, and a run of scalars is packed into
+ * a blob. Once the end of a blob holds FILL_MIN_COUNT copies of the same
+ * value, those are moved into a fill, which absorbs further copies.
+ *
+ * @param data vector of IRDatums to add to
+ * @param width size of the scalar
+ * @param value zero-extended value of the scalar
+ */
+static void insertScalar(Vector *data, size_t width, uint64_t value) {
+  IRDatum *last = data->size == 0 ? NULL : data->elements[data->size - 1];
+  if (last != NULL && last->type == DT_FILL && last->data.fill.width == width &&
+      last->data.fill.value == value) {
+    ++last->data.fill.count;
+    return;
+  }
+
+  size_t lastWidth;
+  uint64_t lastValue;
+  if (last != NULL && scalarDatumValue(last, &lastWidth, &lastValue)) {
+    irDatumFree(last);
+    last = blobDatumCreate(NULL, 0);
+    blobDatumAppend(last, lastValue, lastWidth);
+    data->elements[data->size - 1] = last;
+  } else if (last == NULL || last->type != DT_BLOB) {
+    vectorInsert(data, scalarDatumCreate(width, value));
+    return;
+  }
+  blobDatumAppend(last, value, width);
+
+  size_t runLength = FILL_MIN_COUNT * width;
+  if (last->data.blob.length < runLength) return;
+  uint8_t const *run =
+      last->data.blob.bytes + last->data.blob.length - runLength;
+  for (size_t idx = 0; idx < runLength - width; ++idx)
+    if (run[idx] != run[idx + width]) return;
+
+  last->data.blob.length -= runLength;
+  IRDatum *fill = fillDatumCreate(value, width, FILL_MIN_COUNT);
+  if (last->data.blob.length == 0) {
+    irDatumFree(last);
+    data->elements[data->size - 1] = fill;
+  } else {
+    vectorInsert(data, fill);
+  }
+}
+
 /**
  * translate an initializer into IRDatums, given a type
  *
@@ -267,31 +560,30 @@ static void translateInitializer(Vector *data, Vector *irFrags,
     case TK_KEYWORD: {
       switch (type->data.keyword.keyword) {
         case TK_UBYTE: {
-          vectorInsert(
-              data, byteDatumCreate(initializer->data.literal.data.ubyteVal));
+          insertScalar(data, BYTE_WIDTH,
+                       initializer->data.literal.data.ubyteVal);
           break;
         }
         case TK_BYTE: {
-          vectorInsert(
-              data,
-              byteDatumCreate(s8ToU8(initializer->data.literal.data.byteVal)));
+          insertScalar(data, BYTE_WIDTH,
+                       s8ToU8(initializer->data.literal.data.byteVal));
           break;
         }
         case TK_CHAR: {
-          vectorInsert(data,
-                       byteDatumCreate(initializer->data.literal.data.charVal));
+          insertScalar(data, BYTE_WIDTH,
+                       initializer->data.literal.data.charVal);
           break;
         }
         case TK_USHORT: {
           switch (initializer->data.literal.literalType) {
             case LT_UBYTE: {
-              vectorInsert(data, shortDatumCreate(
-                                     initializer->data.literal.data.ubyteVal));
+              insertScalar(data, SHORT_WIDTH,
+                           initializer->data.literal.data.ubyteVal);
               break;
             }
             case LT_USHORT: {
-              vectorInsert(data, shortDatumCreate(
-                                     initializer->data.literal.data.ushortVal));
+              insertScalar(data, SHORT_WIDTH,
+                           initializer->data.literal.data.ushortVal);
               break;
             }
             default: {
@@ -303,18 +595,18 @@ static void translateInitializer(Vector *data, Vector *irFrags,
         case TK_SHORT: {
           switch (initializer->data.literal.literalType) {
             case LT_UBYTE: {
-              vectorInsert(data, shortDatumCreate(
-                                     initializer->data.literal.data.ubyteVal));
+              insertScalar(data, SHORT_WIDTH,
+                           initializer->data.literal.data.ubyteVal);
               break;
             }
             case LT_BYTE: {
-              vectorInsert(data, shortDatumCreate(s16ToU16(
-                                     initializer->data.literal.data.byteVal)));
+              insertScalar(data, SHORT_WIDTH,
+                           s16ToU16(initializer->data.literal.data.byteVal));
               break;
             }
             case LT_SHORT: {
-              vectorInsert(data, shortDatumCreate(s16ToU16(
-                                     initializer->data.literal.data.shortVal)));
+              insertScalar(data, SHORT_WIDTH,
+                           s16ToU16(initializer->data.literal.data.shortVal));
               break;
             }
             default: {
@@ -326,18 +618,18 @@ static void translateInitializer(Vector *data, Vector *irFrags,
         case TK_UINT: {
           switch (initializer->data.literal.literalType) {
             case LT_UBYTE: {
-              vectorInsert(data, intDatumCreate(
-                                     initializer->data.literal.data.ubyteVal));
+              insertScalar(data, INT_WIDTH,
+                           initializer->data.literal.data.ubyteVal);
               break;
             }
             case LT_USHORT: {
-              vectorInsert(data, intDatumCreate(
-                                     initializer->data.literal.data.ushortVal));
+              insertScalar(data, INT_WIDTH,
+                           initializer->data.literal.data.ushortVal);
               break;
             }
             case LT_UINT: {
-              vectorInsert(
-                  data, intDatumCreate(initializer->data.literal.data.uintVal));
+              insertScalar(data, INT_WIDTH,
+                           initializer->data.literal.data.uintVal);
               break;
             }
             default: {
@@ -349,28 +641,28 @@ static void translateInitializer(Vector *data, Vector *irFrags,
         case TK_INT: {
           switch (initializer->data.literal.literalType) {
             case LT_UBYTE: {
-              vectorInsert(data, intDatumCreate(
-                                     initializer->data.literal.data.ubyteVal));
+              insertScalar(data, INT_WIDTH,
+                           initializer->data.literal.data.ubyteVal);
               break;
             }
             case LT_BYTE: {
-              vectorInsert(data, intDatumCreate(s32ToU32(
-                                     initializer->data.literal.data.byteVal)));
+              insertScalar(data, INT_WIDTH,
+                           s32ToU32(initializer->data.literal.data.byteVal));
               break;
             }
             case LT_USHORT: {
-              vectorInsert(data, intDatumCreate(
-                                     initializer->data.literal.data.ushortVal));
+              insertScalar(data, INT_WIDTH,
+                           initializer->data.literal.data.ushortVal);
               break;
             }
             case LT_SHORT: {
-              vectorInsert(data, intDatumCreate(s32ToU32(
-                                     initializer->data.literal.data.shortVal)));
+              insertScalar(data, INT_WIDTH,
+                           s32ToU32(initializer->data.literal.data.shortVal));
               break;
             }
             case LT_INT: {
-              vectorInsert(data, intDatumCreate(s32ToU32(
-                                     initializer->data.literal.data.intVal)));
+              insertScalar(data, INT_WIDTH,
+                           s32ToU32(initializer->data.literal.data.intVal));
               break;
             }
             default: {
@@ -382,13 +674,13 @@ static void translateInitializer(Vector *data, Vector *irFrags,
         case TK_WCHAR: {
           switch (initializer->data.literal.literalType) {
             case LT_CHAR: {
-              vectorInsert(
-                  data, intDatumCreate(initializer->data.literal.data.charVal));
+              insertScalar(data, INT_WIDTH,
+                           initializer->data.literal.data.charVal);
               break;
             }
             case LT_WCHAR: {
-              vectorInsert(data, intDatumCreate(
-                                     initializer->data.literal.data.wcharVal));
+              insertScalar(data, INT_WIDTH,
+                           initializer->data.literal.data.wcharVal);
               break;
             }
             default: {
@@ -400,23 +692,23 @@ static void translateInitializer(Vector *data, Vector *irFrags,
         case TK_ULONG: {
           switch (initializer->data.literal.literalType) {
             case LT_UBYTE: {
-              vectorInsert(data, longDatumCreate(
-                                     initializer->data.literal.data.ubyteVal));
+              insertScalar(data, LONG_WIDTH,
+                           initializer->data.literal.data.ubyteVal);
               break;
             }
             case LT_USHORT: {
-              vectorInsert(data, longDatumCreate(
-                                     initializer->data.literal.data.ushortVal));
+              insertScalar(data, LONG_WIDTH,
+                           initializer->data.literal.data.ushortVal);
               break;
             }
             case LT_UINT: {
-              vectorInsert(data, longDatumCreate(
-                                     initializer->data.literal.data.uintVal));
+              insertScalar(data, LONG_WIDTH,
+                           initializer->data.literal.data.uintVal);
               break;
             }
             case LT_ULONG: {
-              vectorInsert(data, longDatumCreate(
-                                     initializer->data.literal.data.ulongVal));
+              insertScalar(data, LONG_WIDTH,
+                           initializer->data.literal.data.ulongVal);
               break;
             }
             default: {
@@ -428,38 +720,38 @@ static void translateInitializer(Vector *data, Vector *irFrags,
         case TK_LONG: {
           switch (initializer->data.literal.literalType) {
             case LT_UBYTE: {
-              vectorInsert(data, longDatumCreate(
-                                     initializer->data.literal.data.ubyteVal));
+              insertScalar(data, LONG_WIDTH,
+                           initializer->data.literal.data.ubyteVal);
               break;
             }
             case LT_BYTE: {
-              vectorInsert(data, longDatumCreate(s64ToU64(
-                                     initializer->data.literal.data.byteVal)));
+              insertScalar(data, LONG_WIDTH,
+                           s64ToU64(initializer->data.literal.data.byteVal));
               break;
             }
             case LT_USHORT: {
-              vectorInsert(data, longDatumCreate(
-                                     initializer->data.literal.data.ushortVal));
+              insertScalar(data, LONG_WIDTH,
+                           initializer->data.literal.data.ushortVal);
               break;
             }
             case LT_SHORT: {
-              vectorInsert(data, longDatumCreate(s64ToU64(
-                                     initializer->data.literal.data.shortVal)));
+              insertScalar(data, LONG_WIDTH,
+                           s64ToU64(initializer->data.literal.data.shortVal));
               break;
             }
             case LT_UINT: {
-              vectorInsert(data, longDatumCreate(
-                                     initializer->data.literal.data.uintVal));
+              insertScalar(data, LONG_WIDTH,
+                           initializer->data.literal.data.uintVal);
               break;
             }
             case LT_INT: {
-              vectorInsert(data, longDatumCreate(s64ToU64(
-                                     initializer->data.literal.data.intVal)));
+              insertScalar(data, LONG_WIDTH,
+                           s64ToU64(initializer->data.literal.data.intVal));
               break;
             }
             case LT_LONG: {
-              vectorInsert(data, longDatumCreate(s64ToU64(
-                                     initializer->data.literal.data.longVal)));
+              insertScalar(data, LONG_WIDTH,
+                           s64ToU64(initializer->data.literal.data.longVal));
               break;
             }
             default: {
@@ -471,49 +763,56 @@ static void translateInitializer(Vector *data, Vector *irFrags,
         case TK_FLOAT: {
           switch (initializer->data.literal.literalType) {
             case LT_UBYTE: {
-              vectorInsert(data, intDatumCreate(uintToFloatBits(
-                                     initializer->data.literal.data.ubyteVal)));
+              insertScalar(data, INT_WIDTH,
+                           uintToFloatBits(
+                               initializer->data.literal.data.ubyteVal));
               break;
             }
             case LT_BYTE: {
-              vectorInsert(data, intDatumCreate(intToFloatBits(
-                                     initializer->data.literal.data.byteVal)));
+              insertScalar(data, INT_WIDTH,
+                           intToFloatBits(
+                               initializer->data.literal.data.byteVal));
               break;
             }
             case LT_USHORT: {
-              vectorInsert(data,
-                           intDatumCreate(uintToFloatBits(
-                               initializer->data.literal.data.ushortVal)));
+              insertScalar(data, INT_WIDTH,
+                           uintToFloatBits(
+                               initializer->data.literal.data.ushortVal));
               break;
             }
             case LT_SHORT: {
-              vectorInsert(data, intDatumCreate(intToFloatBits(
-                                     initializer->data.literal.data.shortVal)));
+              insertScalar(data, INT_WIDTH,
+                           intToFloatBits(
+                               initializer->data.literal.data.shortVal));
               break;
             }
             case LT_UINT: {
-              vectorInsert(data, intDatumCreate(uintToFloatBits(
-                                     initializer->data.literal.data.uintVal)));
+              insertScalar(data, INT_WIDTH,
+                           uintToFloatBits(
+                               initializer->data.literal.data.uintVal));
               break;
             }
             case LT_INT: {
-              vectorInsert(data, intDatumCreate(intToFloatBits(
-                                     initializer->data.literal.data.intVal)));
+              insertScalar(data, INT_WIDTH,
+                           intToFloatBits(
+                               initializer->data.literal.data.intVal));
               break;
             }
             case LT_ULONG: {
-              vectorInsert(data, intDatumCreate(uintToFloatBits(
-                                     initializer->data.literal.data.ulongVal)));
+              insertScalar(data, INT_WIDTH,
+                           uintToFloatBits(
+                               initializer->data.literal.data.ulongVal));
               break;
             }
             case LT_LONG: {
-              vectorInsert(data, intDatumCreate(intToFloatBits(
-                                     initializer->data.literal.data.longVal)));
+              insertScalar(data, INT_WIDTH,
+                           intToFloatBits(
+                               initializer->data.literal.data.longVal));
               break;
             }
             case LT_FLOAT: {
-              vectorInsert(data, intDatumCreate(
-                                     initializer->data.literal.data.floatBits));
+              insertScalar(data, INT_WIDTH,
+                           initializer->data.literal.data.floatBits);
               break;
             }
             default: {
@@ -525,56 +824,62 @@ static void translateInitializer(Vector *data, Vector *irFrags,
         case TK_DOUBLE: {
           switch (initializer->data.literal.literalType) {
             case LT_UBYTE: {
-              vectorInsert(data, longDatumCreate(uintToDoubleBits(
-                                     initializer->data.literal.data.ubyteVal)));
+              insertScalar(data, LONG_WIDTH,
+                           uintToDoubleBits(
+                               initializer->data.literal.data.ubyteVal));
               break;
             }
             case LT_BYTE: {
-              vectorInsert(data, longDatumCreate(intToDoubleBits(
-                                     initializer->data.literal.data.byteVal)));
+              insertScalar(data, LONG_WIDTH,
+                           intToDoubleBits(
+                               initializer->data.literal.data.byteVal));
               break;
             }
             case LT_USHORT: {
-              vectorInsert(data,
-                           longDatumCreate(uintToDoubleBits(
-                               initializer->data.literal.data.ushortVal)));
+              insertScalar(data, LONG_WIDTH,
+                           uintToDoubleBits(
+                               initializer->data.literal.data.ushortVal));
               break;
             }
             case LT_SHORT: {
-              vectorInsert(data, longDatumCreate(intToDoubleBits(
-                                     initializer->data.literal.data.shortVal)));
+              insertScalar(data, LONG_WIDTH,
+                           intToDoubleBits(
+                               initializer->data.literal.data.shortVal));
               break;
             }
             case LT_UINT: {
-              vectorInsert(data, longDatumCreate(uintToDoubleBits(
-                                     initializer->data.literal.data.uintVal)));
+              insertScalar(data, LONG_WIDTH,
+                           uintToDoubleBits(
+                               initializer->data.literal.data.uintVal));
               break;
             }
             case LT_INT: {
-              vectorInsert(data, longDatumCreate(intToDoubleBits(
-                                     initializer->data.literal.data.intVal)));
+              insertScalar(data, LONG_WIDTH,
+                           intToDoubleBits(
+                               initializer->data.literal.data.intVal));
               break;
             }
             case LT_ULONG: {
-              vectorInsert(data, longDatumCreate(uintToDoubleBits(
-                                     initializer->data.literal.data.ulongVal)));
+              insertScalar(data, LONG_WIDTH,
+                           uintToDoubleBits(
+                               initializer->data.literal.data.ulongVal));
               break;
             }
             case LT_LONG: {
-              vectorInsert(data, longDatumCreate(intToDoubleBits(
-                                     initializer->data.literal.data.longVal)));
+              insertScalar(data, LONG_WIDTH,
+                           intToDoubleBits(
+                               initializer->data.literal.data.longVal));
               break;
             }
             case LT_FLOAT: {
-              vectorInsert(data,
-                           longDatumCreate(floatBitsToDoubleBits(
-                               initializer->data.literal.data.floatBits)));
+              insertScalar(data, LONG_WIDTH,
+                           floatBitsToDoubleBits(
+                               initializer->data.literal.data.floatBits));
               break;
             }
             case LT_DOUBLE: {
-              vectorInsert(
-                  data,
-                  longDatumCreate(initializer->data.literal.data.doubleBits));
+              insertScalar(data, LONG_WIDTH,
+                           initializer->data.literal.data.doubleBits);
               break;
             }
             default: {
@@ -585,9 +890,9 @@ static void translateInitializer(Vector *data, Vector *irFrags,
         }
         case TK_BOOL: {
           if (initializer->data.literal.data.boolVal)
-            vectorInsert(data, byteDatumCreate(1));
+            insertScalar(data, BYTE_WIDTH, 1);
           else
-            vectorInsert(data, byteDatumCreate(0));
+            insertScalar(data, BYTE_WIDTH, 0);
           break;
         }
         default: {
@@ -637,59 +942,54 @@ static void translateInitializer(Vector *data, Vector *irFrags,
           switch (constEntry->data.enumConst.parent->data.enumType.backingType
                       ->data.keyword.keyword) {
             case TK_UBYTE: {
-              vectorInsert(
-                  data,
-                  byteDatumCreate(
-                      (uint8_t)constEntry->data.enumConst.data.unsignedValue));
+              insertScalar(
+                  data, BYTE_WIDTH,
+                  (uint8_t)constEntry->data.enumConst.data.unsignedValue);
               break;
             }
             case TK_BYTE: {
-              vectorInsert(
-                  data,
-                  byteDatumCreate(s8ToU8(
-                      (int8_t)constEntry->data.enumConst.data.signedValue)));
+              insertScalar(
+                  data, BYTE_WIDTH,
+                  s8ToU8((int8_t)constEntry->data.enumConst.data.signedValue));
               break;
             }
             case TK_USHORT: {
-              vectorInsert(
-                  data,
-                  shortDatumCreate(
-                      (uint16_t)constEntry->data.enumConst.data.unsignedValue));
+              insertScalar(
+                  data, SHORT_WIDTH,
+                  (uint16_t)constEntry->data.enumConst.data.unsignedValue);
               break;
             }
             case TK_SHORT: {
-              vectorInsert(
-                  data,
-                  shortDatumCreate(s16ToU16(
-                      (int16_t)constEntry->data.enumConst.data.signedValue)));
+              insertScalar(
+                  data, SHORT_WIDTH,
+                  s16ToU16(
+                      (int16_t)constEntry->data.enumConst.data.signedValue));
               break;
             }
             case TK_UINT: {
-              vectorInsert(
-                  data,
-                  intDatumCreate(
-                      (uint32_t)constEntry->data.enumConst.data.unsignedValue));
+              insertScalar(
+                  data, INT_WIDTH,
+                  (uint32_t)constEntry->data.enumConst.data.unsignedValue);
               break;
             }
             case TK_INT: {
-              vectorInsert(
-                  data,
-                  intDatumCreate(s32ToU32(
-                      (int32_t)constEntry->data.enumConst.data.signedValue)));
+              insertScalar(
+                  data, INT_WIDTH,
+                  s32ToU32(
+                      (int32_t)constEntry->data.enumConst.data.signedValue));
               break;
             }
             case TK_ULONG: {
-              vectorInsert(
-                  data,
-                  longDatumCreate(
-                      (uint64_t)constEntry->data.enumConst.data.unsignedValue));
+              insertScalar(
+                  data, LONG_WIDTH,
+                  (uint64_t)constEntry->data.enumConst.data.unsignedValue);
               break;
             }
             case TK_LONG: {
-              vectorInsert(
-                  data,
-                  longDatumCreate(s64ToU64(
-                      (int64_t)constEntry->data.enumConst.data.signedValue)));
+              insertScalar(
+                  data, LONG_WIDTH,
+                  s64ToU64(
+                      (int64_t)constEntry->data.enumConst.data.signedValue));
               break;
             }
             default: {
@@ -735,6 +1035,74 @@ static void translateInitializer(Vector *data, Vector *irFrags,
   }
 }
 
+/**
+ * produce true if given initializer is made of only non-string literals
+ */
+static bool initializerConstant(Node const *initializer) {
+  if (initializer->type != NT_LITERAL) return false;
+  switch (initializer->data.literal.literalType) {
+    case LT_STRING:
+    case LT_WSTRING: {
+      return false;
+    }
+    case LT_AGGREGATEINIT: {
+      Vector *aggregateInitVal =
+          initializer->data.literal.data.aggregateInitVal;
+      for (size_t idx = 0; idx < aggregateInitVal->size; ++idx) {
+        if (!initializerConstant(aggregateInitVal->elements[idx]))
+          return false;
+      }
+      return true;
+    }
+    default: {
+      return true;
+    }
+  }
+}
+
+/**
+ * produce true if given type is an array (of arrays) of keyword types
+ */
+static bool keywordArray(Type const *type) {
+  type = stripCV(type);
+  if (type->kind != TK_ARRAY) return false;
+  while (type->kind == TK_ARRAY) type = stripCV(type->data.array.type);
+  return type->kind == TK_KEYWORD;
+}
+
+/**
+ * translate the initializer of a local aggregate into a single fill, if it
+ * zeroes the aggregate or sets every element of an array to the same value
+ *
+ * @param type type of initialized thing
+ * @param initializer initializer to translate
+ * @returns fill constant, or NULL if the initializer isn't a fill
+ */
+static IROperand *translateFillInitializer(Type const *type,
+                                           Node const *initializer,
+                                           FileListEntry *file) {
+  if (typeAllocation(type) != AH_MEM || !initializerConstant(initializer))
+    return NULL;
+
+  if (initializerAllZero(initializer))
+    return CONSTANT(typeAlignof(type),
+                    fillDatumCreate(0, BYTE_WIDTH, typeSizeof(type)));
+
+  if (!keywordArray(type)) return NULL;
+  Vector data;
+  vectorInit(&data);
+  translateInitializer(&data, &file->irFrags, type, initializer, file);
+  IROperand *retval = NULL;
+  if (data.size == 1 &&
+      ((IRDatum const *)data.elements[0])->type == DT_FILL) {
+    retval = constantOperandCreate(typeAlignof(type));
+    vectorInsert(&retval->data.constant.data, data.elements[0]);
+    data.size = 0;
+  }
+  vectorUninit(&data, (void (*)(void *))irDatumFree);
+  return retval;
+}
+
 /**
  * translate a constant into a fragment
  */
@@ -1652,8 +2020,8 @@ static IROperand *translateBitOr(IRBlock *b, IROperand *lhs,
 static IROperand *translateComparison(IRBlock *b, IROperand *lhs,
                                       Type const *lhsType, IROperand *rhs,
                                       Type const *rhsType, IROperator floatOp,
-                                      IROperator unsignedOp,
                                       IROperator signedOp,
+                                      IROperator unsignedOp,
                                       FileListEntry *file) {
   Type *merged = comparisonTypeMerge(lhsType, rhsType);
   IROperand *castLhs = translateCast(b, lhs, lhsType, merged, file);
@@ -1962,6 +2330,33 @@ static void translateLValueStore(IRBlock *b, LValue const *dest, IROperand *src,
     }
   }
 }
+/**
+ * is this type volatile-qualified
+ */
+static bool typeVolatile(Type const *t) {
+  return t->kind == TK_QUALIFIED && t->data.qualified.volatileQual;
+}
+/**
+ * mark an access through an address as volatile
+ *
+ * The address is put in a temp (if it isn't already in one) which is marked
+ * with IO_VOLATILE; optimizations leave accesses through marked temps alone.
+ *
+ * @param b block to add marker to
+ * @param addr address (owning)
+ * @param file file this block is in
+ * @returns marked address
+ */
+static IROperand *markVolatileAddress(IRBlock *b, IROperand *addr,
+                                      FileListEntry *file) {
+  if (addr->kind != OK_TEMP) {
+    IROperand *temp = TEMPPTR(fresh(file));
+    IR(b, MOVE(irOperandCopy(temp), addr));
+    addr = temp;
+  }
+  IR(b, MARK_TEMP(IO_VOLATILE, irOperandCopy(addr)));
+  return addr;
+}
 static void lvalueFree(LValue *lv) {
   irOperandFree(lv->operand);
   free(lv);
@@ -1971,8 +2366,10 @@ static void translateExpressionVoid(LinkedList *, Node const *, size_t, size_t,
                                     FileListEntry *);
 static IROperand *translateExpressionValue(LinkedList *, Node const *, size_t,
                                            size_t, FileListEntry *);
+static LValue *translateExpressionLValue(LinkedList *, Node const *, size_t,
+                                         size_t, FileListEntry *);
 /**
- * translate an l-value expression
+ * translate an l-value expression, without marking volatile accesses
  *
  * @param block vector to put new blocks in
  * @param e expression to translate
@@ -1981,9 +2378,9 @@ static IROperand *translateExpressionValue(LinkedList *, Node const *, size_t,
  * @param file file the expression is in
  * @returns an l-value
  */
-static LValue *translateExpressionLValue(LinkedList *blocks, Node const *e,
-                                         size_t label, size_t nextLabel,
-                                         FileListEntry *file) {
+static LValue *translateUnmarkedLValue(LinkedList *blocks, Node const *e,
+                                       size_t label, size_t nextLabel,
+                                       FileListEntry *file) {
   switch (e->type) {
     case NT_BINOPEXP: {
       Node const *lhs = e->data.binOpExp.lhs;
@@ -2188,6 +2585,32 @@ static LValue *translateExpressionLValue(LinkedList *blocks, Node const *e,
     }
   }
 }
+/**
+ * translate an l-value expression
+ *
+ * Memory l-values of volatile type have their address marked as volatile.
+ *
+ * @param block vector to put new blocks in
+ * @param e expression to translate
+ * @param label this block's label
+ * @param nextLabel label the next block is at
+ * @param file file the expression is in
+ * @returns an l-value
+ */
+static LValue *translateExpressionLValue(LinkedList *blocks, Node const *e,
+                                         size_t label, size_t nextLabel,
+                                         FileListEntry *file) {
+  if (!typeVolatile(expressionTypeof(e)))
+    return translateUnmarkedLValue(blocks, e, label, nextLabel, file);
+
+  size_t markLabel = fresh(file);
+  LValue *lvalue = translateUnmarkedLValue(blocks, e, label, markLabel, file);
+  IRBlock *b = BLOCK(markLabel, blocks);
+  if (lvalue->kind == LK_MEM)
+    lvalue->operand = markVolatileAddress(b, lvalue->operand, file);
+  IR(b, JUMP(nextLabel));
+  return lvalue;
+}
 
 /**
  * determine the IROperator for a conditional jump
@@ -2224,10 +2647,10 @@ static void translateVariablePredicate(LinkedList *blocks, Node const *e,
                                        size_t label, size_t trueLabel,
                                        size_t falseLabel, FileListEntry *file) {
   size_t comparisonLabel = fresh(file);
+  IROperand *value =
+      translateExpressionValue(blocks, e, label, comparisonLabel, file);
   IRBlock *b = BLOCK(comparisonLabel, blocks);
-  IR(b,
-     BJUMP(IO_J2NZ, trueLabel, falseLabel,
-           translateExpressionValue(blocks, e, label, comparisonLabel, file)));
+  IR(b, BJUMP(IO_J2NZ, trueLabel, falseLabel, value));
 }
 /**
  * translate a conditional jump predicate
@@ -2601,6 +3024,54 @@ static void translateValueLiteral(Node const *e, IRFrag *df,
   }
 }
 
+/**
+ * translate the function and the arguments of a function call
+ *
+ * @param blocks vector to put new blocks in
+ * @param e function call expression to translate
+ * @param label this block's label
+ * @param callBlock output block the call itself must go in
+ * @param args output array of arguments, converted to the parameter types
+ * (owning)
+ * @param file file the expression is in
+ * @returns operand with the function to call
+ */
+static IROperand *translateCallOperands(LinkedList *blocks, Node const *e,
+                                        size_t label, IRBlock **callBlock,
+                                        IROperand ***args,
+                                        FileListEntry *file) {
+  Type const *funType = expressionTypeof(e->data.funCallExp.function);
+  Vector const *argTypes = &funType->data.funPtr.argTypes;
+
+  size_t argsLabel = fresh(file);
+  size_t callLabel = fresh(file);
+  IROperand *fun = translateExpressionValue(
+      blocks, e->data.funCallExp.function, label,
+      argTypes->size == 0 ? callLabel : argsLabel, file);
+
+  *args = malloc(argTypes->size * sizeof(IROperand *));
+  size_t curr = argsLabel;
+  for (size_t idx = 0; idx < e->data.funCallExp.arguments->size; ++idx) {
+    Node const *arg = e->data.funCallExp.arguments->elements[idx];
+    if (idx == e->data.funCallExp.arguments->size - 1) {
+      (*args)[idx] =
+          translateExpressionValue(blocks, arg, curr, callLabel, file);
+    } else {
+      size_t next = fresh(file);
+      (*args)[idx] = translateExpressionValue(blocks, arg, curr, next, file);
+      curr = next;
+    }
+  }
+
+  *callBlock = BLOCK(callLabel, blocks);
+  for (size_t idx = 0; idx < e->data.funCallExp.arguments->size; ++idx)
+    (*args)[idx] = translateCast(
+        *callBlock, (*args)[idx],
+        expressionTypeof(e->data.funCallExp.arguments->elements[idx]),
+        argTypes->elements[idx], file);
+  return fun;
+}
+
 /**
  * translate an expression for its value
  *
@@ -2780,6 +3251,8 @@ static IROperand *translateExpressionValue(LinkedList *blocks, Node const *e,
           IROperand *addr =
               translateExpressionValue(blocks, lhs, label, resultLabel, file);
           IRBlock *b = BLOCK(resultLabel, blocks);
+          if (typeVolatile(expressionTypeof(e)))
+            addr = markVolatileAddress(b, addr, file);
           IROperand *result = TEMPOF(fresh(file), expressionTypeof(e));
           IR(b, MEM_LOAD(irOperandCopy(result), addr,
                          lhsEntry->kind == SK_STRUCT
@@ -2803,6 +3276,8 @@ static IROperand *translateExpressionValue(LinkedList *blocks, Node const *e,
                 b, rawRhs, expressionTypeof(rhs),
                 typeSizeof(stripCV(expressionTypeof(lhs))->data.pointer.base),
                 file);
+            if (typeVolatile(expressionTypeof(e)))
+              lhsVal = markVolatileAddress(b, lhsVal, file);
             IR(b, MEM_LOAD(irOperandCopy(result), lhsVal, scaledRhs));
           } else {
             IROperand *scaledRhs = translatePointerArithmeticScale(
@@ -2834,12 +3309,13 @@ static IROperand *translateExpressionValue(LinkedList *blocks, Node const *e,
       switch (e->data.unOpExp.op) {
         case UO_DEREF: {
           size_t derefLabel = fresh(file);
+          IROperand *addr =
+              translateExpressionValue(blocks, target, label, derefLabel, file);
           IRBlock *b = BLOCK(derefLabel, blocks);
+          if (typeVolatile(expressionTypeof(e)))
+            addr = markVolatileAddress(b, addr, file);
           IROperand *result = TEMPOF(fresh(file), expressionTypeof(e));
-          IR(b, MEM_LOAD(irOperandCopy(result),
-                         translateExpressionValue(blocks, target, label,
-                                                  derefLabel, file),
-                         OFFSET(0)));
+          IR(b, MEM_LOAD(irOperandCopy(result), addr, OFFSET(0)));
           IR(b, JUMP(nextLabel));
           return result;
         }
@@ -2958,29 +3434,10 @@ static IROperand *translateExpressionValue(LinkedList *blocks, Node const *e,
     case NT_FUNCALLEXP: {
       Type const *funType = expressionTypeof(e->data.funCallExp.function);
 
-      size_t argsLabel = fresh(file);
-      size_t callLabel = fresh(file);
-      IROperand *fun = translateExpressionValue(
-          blocks, e->data.funCallExp.function, label,
-          funType->data.funPtr.argTypes.size == 0 ? callLabel : argsLabel,
-          file);
-
-      IROperand **args =
-          malloc(funType->data.funPtr.argTypes.size * sizeof(IROperand *));
-      size_t curr = argsLabel;
-      for (size_t idx = 0; idx < e->data.funCallExp.arguments->size; ++idx) {
-        Node const *arg = e->data.funCallExp.arguments->elements[idx];
-        if (idx == e->data.funCallExp.arguments->size - 1) {
-          args[idx] =
-              translateExpressionValue(blocks, arg, curr, callLabel, file);
-        } else {
-          size_t next = fresh(file);
-          args[idx] = translateExpressionValue(blocks, arg, curr, next, file);
-          curr = next;
-        }
-      }
+      IRBlock *b;
+      IROperand **args;
+      IROperand *fun = translateCallOperands(blocks, e, label, &b, &args, file);
 
-      IRBlock *b = BLOCK(callLabel, blocks);
       IROperand *retVal = generateFunctionCall(b, fun, args, funType, file);
       IR(b, JUMP(nextLabel));
       return retVal;
@@ -3119,9 +3576,10 @@ static IROperand *translateExpressionValue(LinkedList *blocks, Node const *e,
       IRBlock *b = BLOCK(label, blocks);
       IROperand *dest = TEMPOF(fresh(file), expressionTypeof(e));
       if (e->data.scopedId.entry->kind == SK_VARIABLE) {
-        IR(b,
-           MEM_LOAD(irOperandCopy(dest),
-                    GLOBAL(getMangledName(e->data.scopedId.entry)), OFFSET(0)));
+        IROperand *addr = GLOBAL(getMangledName(e->data.scopedId.entry));
+        if (typeVolatile(expressionTypeof(e)))
+          addr = markVolatileAddress(b, addr, file);
+        IR(b, MEM_LOAD(irOperandCopy(dest), addr, OFFSET(0)));
       } else if (e->data.scopedId.entry->kind == SK_ENUMCONST) {
         switch (e->data.scopedId.entry->data.enumConst.parent->data.enumType
                     .backingType->data.keyword.keyword) {
@@ -3204,11 +3662,14 @@ static IROperand *translateExpressionValue(LinkedList *blocks, Node const *e,
       IRBlock *b = BLOCK(label, blocks);
       IROperand *dest = TEMPOF(fresh(file), expressionTypeof(e));
       if (e->data.id.entry->kind == SK_VARIABLE) {
-        if (e->data.id.entry->data.variable.temp == 0)
-          IR(b, MEM_LOAD(irOperandCopy(dest),
-                         GLOBAL(getMangledName(e->data.id.entry)), OFFSET(0)));
-        else
+        if (e->data.id.entry->data.variable.temp == 0) {
+          IROperand *addr = GLOBAL(getMangledName(e->data.id.entry));
+          if (typeVolatile(expressionTypeof(e)))
+            addr = markVolatileAddress(b, addr, file);
+          IR(b, MEM_LOAD(irOperandCopy(dest), addr, OFFSET(0)));
+        } else {
           IR(b, MOVE(irOperandCopy(dest), TEMPVAR(e->data.id.entry)));
+        }
       } else {
         IR(b,
            MOVE(irOperandCopy(dest), GLOBAL(getMangledName(e->data.id.entry))));
@@ -3444,6 +3905,38 @@ static void translateExpressionVoid(LinkedList *blocks, Node const *e,
   }
 }
 
+/**
+ * translate a local variable's initializer, converted to the variable's type
+ *
+ * Zero and uniform fills of aggregates become a single fill constant instead
+ * of element-by-element stores.
+ *
+ * @param blocks vector to put new blocks in
+ * @param initializer initializer to translate
+ * @param type type of the variable
+ * @param label this block's label
+ * @param b output block the value is available in, which must be ended
+ * @param file file the initializer is in
+ * @returns operand with the converted value
+ */
+static IROperand *translateVariableInitializer(LinkedList *blocks,
+                                               Node const *initializer,
+                                               Type const *type, size_t label,
+                                               IRBlock **b,
+                                               FileListEntry *file) {
+  IROperand *fill = translateFillInitializer(type, initializer, file);
+  if (fill != NULL) {
+    *b = BLOCK(label, blocks);
+    return fill;
+  }
+
+  size_t moveLabel = fresh(file);
+  IROperand *o =
+      translateExpressionValue(blocks, initializer, label, moveLabel, file);
+  *b = BLOCK(moveLabel, blocks);
+  return translateCast(*b, o, expressionTypeof(initializer), type, file);
+}
+
 /**
  * translate a statement
  *
@@ -3522,16 +4015,21 @@ static void translateStmt(LinkedList *blocks, Node *stmt, size_t label,
       break;
     }
     case NT_WHILESTMT: {
-      //               /------------v
-      // condition check -> body -| next
-      //               ^----------/
+      // rotated, so each iteration only takes the one conditional jump
+      //
+      //            /------------------------------v
+      // condition guard -> body -> condition check -> next
+      //                    ^-----------------|
 
       size_t bodyLabel = fresh(file);
+      size_t conditionLabel = fresh(file);
       translateExpressionPredicate(blocks, stmt->data.whileStmt.condition,
                                    label, bodyLabel, nextLabel, file);
-      translateStmt(blocks, stmt->data.whileStmt.body, bodyLabel, label,
-                    returnLabel, nextLabel, label, returnValueTemp, returnType,
-                    file);
+      translateStmt(blocks, stmt->data.whileStmt.body, bodyLabel,
+                    conditionLabel, returnLabel, nextLabel, conditionLabel,
+                    returnValueTemp, returnType, file);
+      translateExpressionPredicate(blocks, stmt->data.whileStmt.condition,
+                                   conditionLabel, bodyLabel, nextLabel, file);
       break;
     }
     case NT_DOWHILESTMT: {
@@ -3547,16 +4045,18 @@ static void translateStmt(LinkedList *blocks, Node *stmt, size_t label,
       break;
     }
     case NT_FORSTMT: {
-      size_t conditionLabel = fresh(file);
-      translateStmt(blocks, stmt->data.forStmt.initializer, label,
-                    conditionLabel, 0, 0, 0, returnValueTemp, returnType, file);
+      // rotated, like a while loop
+      size_t guardLabel = fresh(file);
+      translateStmt(blocks, stmt->data.forStmt.initializer, label, guardLabel,
+                    0, 0, 0, returnValueTemp, returnType, file);
       size_t bodyLabel = fresh(file);
+      size_t conditionLabel = fresh(file);
       translateExpressionPredicate(blocks, stmt->data.forStmt.condition,
-                                   conditionLabel, bodyLabel, nextLabel, file);
+                                   guardLabel, bodyLabel, nextLabel, file);
       if (stmt->data.forStmt.increment != NULL) {
-        //                       /----------------------v
-        // init -> condition check -> body -> increment next
-        //                       ^------------|
+        //               /------------------------------------------------v
+        // init -> condition guard -> body -> increment -> condition check next
+        //                            ^-------------------------------|
 
         size_t incrementLabel = fresh(file);
         translateStmt(blocks, stmt->data.forStmt.body, bodyLabel,
@@ -3565,14 +4065,16 @@ static void translateStmt(LinkedList *blocks, Node *stmt, size_t label,
         translateExpressionVoid(blocks, stmt->data.forStmt.increment,
                                 incrementLabel, conditionLabel, file);
       } else {
-        //                       /---------v
-        // init -> condition check -> body next
-        //                       ^-------|
+        //               /-------------------------------v
+        // init -> condition guard -> body -> condition check next
+        //                            ^-----------------|
 
         translateStmt(blocks, stmt->data.forStmt.body, bodyLabel,
                       conditionLabel, returnLabel, nextLabel, conditionLabel,
                       returnValueTemp, returnType, file);
       }
+      translateExpressionPredicate(blocks, stmt->data.forStmt.condition,
+                                   conditionLabel, bodyLabel, nextLabel, file);
       break;
     }
     case NT_SWITCHSTMT: {
@@ -3608,12 +4110,12 @@ static void translateStmt(LinkedList *blocks, Node *stmt, size_t label,
       for (size_t idx = 0; idx < cases->size; ++idx)
         caseLabels[idx] = fresh(file);
 
-      size_t defaultLabel = 0;
+      size_t defaultLabel = nextLabel;
       size_t jumpTableLen = 0;
       for (size_t idx = 0; idx < cases->size; ++idx) {
         Node const *caseNode = cases->elements[idx];
         if (caseNode->type == NT_SWITCHDEFAULT) {
-          defaultLabel = idx;
+          defaultLabel = caseLabels[idx];
         } else {
           jumpTableLen += caseNode->data.switchCase.values->size;
         }
@@ -3763,147 +4265,18 @@ static void translateStmt(LinkedList *blocks, Node *stmt, size_t label,
             (int (*)(void const *,
                      void const *))(isSigned ? compareSignedJumpTableEntry
                                              : compareUnsignedJumpTableEntry));
-      if (defaultLabel == 0) defaultLabel = nextLabel;
-      size_t curr = jumpSectionLabel;
-      if (isSigned) {
-        for (size_t entryIdx = 0; entryIdx < jumpTableLen; ++entryIdx) {
-          if (entryIdx == jumpTableLen - 1 ||
-              jumpTable[entryIdx].value.signedVal !=
-                  jumpTable[entryIdx + 1].value.signedVal - 1) {
-            // singleton
-            IRBlock *b = BLOCK(curr, blocks);
-            IR(b, CJUMP(IO_J2E, jumpTable[entryIdx].label,
-                        entryIdx == jumpTableLen - 1 ? defaultLabel
-                                                     : (curr = fresh(file)),
-                        irOperandCopy(o),
-                        signedJumpTableEntryToConstant(&jumpTable[entryIdx],
-                                                       size)));
-          } else {
-            // not a singleton
-            size_t end = entryIdx + 1;
-            while (end < jumpTableLen - 1 &&
-                   jumpTable[end].value.signedVal ==
-                       jumpTable[end + 1].value.signedVal - 1)
-              ++end;
-
-            size_t next = end == jumpTableLen - 1 ? defaultLabel : fresh(file);
-            size_t tableLabel = fresh(file);
-            IRFrag *table =
-                localDataFragCreate(FT_RODATA, tableLabel, POINTER_WIDTH);
-            vectorInsert(&file->irFrags, table);
-            for (size_t blockIdx = entryIdx; blockIdx <= end; ++blockIdx)
-              vectorInsert(&table->data.data.data,
-                           localLabelDatumCreate(jumpTable[blockIdx].label));
-
-            size_t gtFallthroughLabel = fresh(file);
-            IRBlock *b = BLOCK(curr, blocks);
-            IR(b,
-               CJUMP(
-                   IO_J2L, defaultLabel, gtFallthroughLabel, irOperandCopy(o),
-                   signedJumpTableEntryToConstant(&jumpTable[entryIdx], size)));
-
-            size_t tableDerefLabel = fresh(file);
-            b = BLOCK(gtFallthroughLabel, blocks);
-            IR(b, CJUMP(IO_J2G, next, tableDerefLabel, irOperandCopy(o),
-                        signedJumpTableEntryToConstant(&jumpTable[end], size)));
-
-            size_t offset = fresh(file);
-            size_t castOffset;
-            size_t multipliedOffset = fresh(file);
-            size_t target = fresh(file);
-            b = BLOCK(tableDerefLabel, blocks);
-            IR(b, BINOP(IO_SUB, TEMPOF(offset, switchedType), irOperandCopy(o),
-                        signedJumpTableEntryToConstant(&jumpTable[entryIdx],
-                                                       size)));
-            if (size != POINTER_WIDTH) {
-              castOffset = fresh(file);
-              IR(b, UNOP(IO_SX, TEMPPTR(castOffset),
-                         TEMPOF(offset, switchedType)));
-            } else {
-              castOffset = offset;
-            }
-
-            IR(b,
-               BINOP(IO_SMUL, TEMPPTR(multipliedOffset), TEMPPTR(castOffset),
-                     CONSTANT(POINTER_WIDTH, longDatumCreate(POINTER_WIDTH))));
-            IR(b, BINOP(IO_ADD, TEMPPTR(target), TEMPPTR(multipliedOffset),
-                        LOCAL(tableLabel)));
-            IR(b, JUMPTABLE(TEMPPTR(target), tableLabel));
-
-            curr = next;
-            entryIdx = end;
-          }
-        }
+      SwitchInfo info = {jumpTable, o,        switchedType,
+                         size,      isSigned, defaultLabel};
+      if (jumpTableLen == 0) {
+        IRBlock *b = BLOCK(jumpSectionLabel, blocks);
+        IR(b, JUMP(defaultLabel));
       } else {
-        for (size_t entryIdx = 0; entryIdx < jumpTableLen; ++entryIdx) {
-          if (entryIdx == jumpTableLen - 1 ||
-              jumpTable[entryIdx].value.unsignedVal !=
-                  jumpTable[entryIdx + 1].value.unsignedVal - 1) {
-            // singleton
-            IRBlock *b = BLOCK(curr, blocks);
-            IR(b, CJUMP(IO_J2E, jumpTable[entryIdx].label,
-                        entryIdx == jumpTableLen - 1 ? defaultLabel
-                                                     : (curr = fresh(file)),
-                        irOperandCopy(o),
-                        unsignedJumpTableEntryToConstant(&jumpTable[entryIdx],
-                                                         size)));
-          } else {
-            // not a singleton
-            size_t end = entryIdx + 1;
-            while (end < jumpTableLen - 1 &&
-                   jumpTable[end].value.unsignedVal ==
-                       jumpTable[end + 1].value.unsignedVal - 1)
-              ++end;
-
-            size_t next = end == jumpTableLen - 1 ? defaultLabel : fresh(file);
-            size_t tableLabel = fresh(file);
-            IRFrag *table =
-                localDataFragCreate(FT_RODATA, tableLabel, POINTER_WIDTH);
-            vectorInsert(&file->irFrags, table);
-            for (size_t blockIdx = entryIdx; blockIdx <= end; ++blockIdx)
-              vectorInsert(&table->data.data.data,
-                           localLabelDatumCreate(jumpTable[blockIdx].label));
-
-            size_t gtFallthroughLabel = fresh(file);
-            IRBlock *b = BLOCK(curr, blocks);
-            IR(b,
-               CJUMP(IO_J2B, defaultLabel, gtFallthroughLabel, irOperandCopy(o),
-                     unsignedJumpTableEntryToConstant(&jumpTable[entryIdx],
-                                                      size)));
-
-            size_t tableDerefLabel = fresh(file);
-            b = BLOCK(gtFallthroughLabel, blocks);
-            IR(b,
-               CJUMP(IO_J2A, next, tableDerefLabel, irOperandCopy(o),
-                     unsignedJumpTableEntryToConstant(&jumpTable[end], size)));
-
-            size_t offset = fresh(file);
-            size_t castOffset;
-            size_t multipliedOffset = fresh(file);
-            size_t target = fresh(file);
-            b = BLOCK(tableDerefLabel, blocks);
-            IR(b, BINOP(IO_SUB, TEMPOF(offset, switchedType), irOperandCopy(o),
-                        unsignedJumpTableEntryToConstant(&jumpTable[entryIdx],
-                                                         size)));
-            if (size != POINTER_WIDTH) {
-              castOffset = fresh(file);
-              IR(b, UNOP(IO_ZX, TEMPPTR(castOffset),
-                         TEMPOF(offset, switchedType)));
-            } else {
-              castOffset = offset;
-            }
-
-            IR(b,
-               BINOP(IO_UMUL, TEMPPTR(multipliedOffset), TEMPPTR(castOffset),
-                     CONSTANT(POINTER_WIDTH, longDatumCreate(POINTER_WIDTH))));
-            IR(b, BINOP(IO_ADD, TEMPPTR(target), TEMPPTR(multipliedOffset),
-                        LOCAL(tableLabel)));
-            IR(b, JUMPTABLE(TEMPPTR(target), tableLabel));
-
-            curr = next;
-            entryIdx = end;
-          }
-        }
+        size_t numClusters;
+        SwitchCluster *clusters =
+            clusterSwitchCases(jumpTable, jumpTableLen, &numClusters);
+        translateSwitchTree(blocks, jumpSectionLabel, clusters, numClusters,
+                            &info, file);
+        free(clusters);
       }
       irOperandFree(o);
       free(jumpTable);
@@ -3920,7 +4293,19 @@ static void translateStmt(LinkedList *blocks, Node *stmt, size_t label,
       break;
     }
     case NT_RETURNSTMT: {
-      if (stmt->data.returnStmt.value != NULL) {
+      Node const *value = stmt->data.returnStmt.value;
+      if (value != NULL && value->type == NT_FUNCALLEXP &&
+          typeEqual(expressionTypeof(value), returnType) &&
+          tailCallPossible(expressionTypeof(value->data.funCallExp.function))) {
+        // call in tail position - the callee returns directly to our caller
+        IRBlock *b;
+        IROperand **args;
+        IROperand *fun =
+            translateCallOperands(blocks, value, label, &b, &args, file);
+        generateTailCall(b, fun, args,
+                         expressionTypeof(value->data.funCallExp.function),
+                         file);
+      } else if (stmt->data.returnStmt.value != NULL) {
         size_t returnMoveLabel = fresh(file);
         IROperand *value = translateExpressionValue(
             blocks, stmt->data.returnStmt.value, label, returnMoveLabel, file);
@@ -3952,30 +4337,19 @@ static void translateStmt(LinkedList *blocks, Node *stmt, size_t label,
             IR(b, MARK_TEMP(IO_UNINITIALIZED, TEMPVAR(e)));
             IR(b, JUMP(nextLabel));
           } else {
+            IRBlock *b;
+            IROperand *value = translateVariableInitializer(
+                blocks, initializer, e->data.variable.type, curr, &b, file);
             if (e->data.variable.escapes) {
-              size_t moveToMemLabel = fresh(file);
-              IROperand *o = translateExpressionValue(blocks, initializer, curr,
-                                                      moveToMemLabel, file);
-              IRBlock *b = BLOCK(moveToMemLabel, blocks);
-              IROperand *cast =
-                  translateCast(b, o, expressionTypeof(initializer),
-                                e->data.variable.type, file);
               IROperand *memTemp =
                   TEMP(fresh(file), typeAlignof(e->data.variable.type),
                        typeSizeof(e->data.variable.type), AH_MEM);
-              IR(b, MOVE(memTemp, cast));
+              IR(b, MOVE(memTemp, value));
               IR(b, JUMP(nextLabel));
               e->data.variable.temp = memTemp->data.temp.name;
             } else {
-              size_t moveLabel = fresh(file);
-              IROperand *o = translateExpressionValue(blocks, initializer, curr,
-                                                      moveLabel, file);
-              IRBlock *b = BLOCK(moveLabel, blocks);
-              IROperand *cast =
-                  translateCast(b, o, expressionTypeof(initializer),
-                                e->data.variable.type, file);
               IROperand *temp = TEMPOF(fresh(file), e->data.variable.type);
-              IR(b, MOVE(temp, cast));
+              IR(b, MOVE(temp, value));
               IR(b, JUMP(nextLabel));
               e->data.variable.temp = temp->data.temp.name;
             }
@@ -3990,33 +4364,21 @@ static void translateStmt(LinkedList *blocks, Node *stmt, size_t label,
             curr = next;
           } else {
             size_t next = fresh(file);
+            IRBlock *b;
+            IROperand *value = translateVariableInitializer(
+                blocks, initializer, e->data.variable.type, curr, &b, file);
             if (e->data.variable.escapes) {
-              size_t moveToMemLabel = fresh(file);
-              IROperand *o = translateExpressionValue(blocks, initializer, curr,
-                                                      moveToMemLabel, file);
-              IRBlock *b = BLOCK(moveToMemLabel, blocks);
-              IROperand *cast =
-                  translateCast(b, o, expressionTypeof(initializer),
-                                e->data.variable.type, file);
               IROperand *memTemp =
                   TEMP(fresh(file), typeAlignof(e->data.variable.type),
                        typeSizeof(e->data.variable.type), AH_MEM);
-              IR(b, MOVE(memTemp, cast));
+              IR(b, MOVE(memTemp, value));
               IR(b, JUMP(next));
               e->data.variable.temp = memTemp->data.temp.name;
             } else {
-              size_t moveLabel = fresh(file);
-              IROperand *o = translateExpressionValue(blocks, initializer, curr,
-                                                      moveLabel, file);
-              IRBlock *b = BLOCK(moveLabel, blocks);
-              IROperand *cast =
-                  translateCast(b, o, expressionTypeof(initializer),
-                                e->data.variable.type, file);
               IROperand *temp = TEMPOF(fresh(file), e->data.variable.type);
-              IR(b, MOVE(temp, cast));
+              IR(b, MOVE(temp, value));
               IR(b, JUMP(next));
               e->data.variable.temp = temp->data.temp.name;
-              irOperandFree(o);
             }
             curr = next;
           }
@@ -4037,6 +4399,188 @@ static void translateStmt(LinkedList *blocks, Node *stmt, size_t label,
   }
 }
 
+/**
+ * turn tail calls back into regular calls if the function takes the address
+ * of anything in its frame - the callee might be given a pointer into it
+ */
+static void demoteTailCalls(LinkedList *blocks) {
+  bool addressTaken = false;
+  for (ListNode *currBlock = blocks->head->next;
+       currBlock != blocks->tail && !addressTaken;
+       currBlock = currBlock->next) {
+    IRBlock *b = currBlock->data;
+    for (ListNode *currInst = b->instructions.head->next;
+         currInst != b->instructions.tail; currInst = currInst->next) {
+      IRInstruction *i = currInst->data;
+      if (i->op == IO_ADDROF) {
+        addressTaken = true;
+        break;
+      }
+    }
+  }
+  if (!addressTaken) return;
+
+  for (ListNode *currBlock = blocks->head->next; currBlock != blocks->tail;
+       currBlock = currBlock->next) {
+    IRBlock *b = currBlock->data;
+    IRInstruction *last = b->instructions.tail->prev->data;
+    if (last->op == IO_TAIL_CALL) {
+      // return value is already in place - just return it
+      last->op = IO_CALL;
+      IR(b, RETURN());
+    }
+  }
+}
+
+/**
+ * is the given block label ever jumped to
+ *
+ * conservatively assumes that any jump table might jump to it
+ */
+static bool labelReferenced(LinkedList const *blocks, size_t label) {
+  for (ListNode *currBlock = blocks->head->next; currBlock != blocks->tail;
+       currBlock = currBlock->next) {
+    IRBlock *b = currBlock->data;
+    IRInstruction *last = b->instructions.tail->prev->data;
+    switch (last->op) {
+      case IO_JUMP: {
+        if (localOperandName(last->args[0]) == label) return true;
+        break;
+      }
+      case IO_JUMPTABLE: {
+        return true;
+      }
+      case IO_J2L:
+      case IO_J2LE:
+      case IO_J2E:
+      case IO_J2NE:
+      case IO_J2G:
+      case IO_J2GE:
+      case IO_J2A:
+      case IO_J2AE:
+      case IO_J2B:
+      case IO_J2BE:
+      case IO_J2FL:
+      case IO_J2FLE:
+      case IO_J2FE:
+      case IO_J2FNE:
+      case IO_J2FG:
+      case IO_J2FGE:
+      case IO_J2Z:
+      case IO_J2NZ: {
+        if (localOperandName(last->args[0]) == label ||
+            localOperandName(last->args[1]) == label)
+          return true;
+        break;
+      }
+      default: {
+        // leaves the function
+        break;
+      }
+    }
+  }
+  return false;
+}
+
+/**
+ * get the string a rodata frag holds, escaped and tagged with its width, or
+ * NULL if it's not a lone string literal
+ */
+static char *stringLiteralKey(IRFrag const *frag) {
+  if (frag->type != FT_RODATA || frag->nameType != FNT_LOCAL ||
+      frag->data.data.data.size != 1)
+    return NULL;
+
+  IRDatum const *d = frag->data.data.data.elements[0];
+  char *escaped;
+  char tag;
+  if (d->type == DT_STRING) {
+    escaped = escapeTString(d->data.string);
+    tag = 's';
+  } else if (d->type == DT_WSTRING) {
+    escaped = escapeTWString(d->data.wstring);
+    tag = 'w';
+  } else {
+    return NULL;
+  }
+  char *key = format("%c%s", tag, escaped);
+  free(escaped);
+  return key;
+}
+static void relabelData(Vector *data, size_t const *replacements) {
+  for (size_t idx = 0; idx < data->size; ++idx) {
+    IRDatum *d = data->elements[idx];
+    if (d->type == DT_LOCAL)
+      d->data.localLabel = replacements[d->data.localLabel];
+  }
+}
+/**
+ * merge identical string literals in a file into one rodata frag each
+ */
+static void poolStringLiterals(FileListEntry *file) {
+  Vector *frags = &file->irFrags;
+  size_t *replacements = malloc(file->nextId * sizeof(size_t));
+  for (size_t idx = 0; idx < file->nextId; ++idx) replacements[idx] = idx;
+
+  // keep the first frag holding each string
+  HashMap pool;
+  hashMapInit(&pool);
+  Vector keys;
+  vectorInit(&keys);
+  bool pooled = false;
+  for (size_t idx = 0; idx < frags->size; ++idx) {
+    IRFrag *frag = frags->elements[idx];
+    char *key = stringLiteralKey(frag);
+    if (key == NULL) continue;
+
+    IRFrag *kept = hashMapGet(&pool, key);
+    if (kept == NULL) {
+      hashMapPut(&pool, key, frag);
+      vectorInsert(&keys, key);
+    } else {
+      replacements[frag->name.local] = kept->name.local;
+      pooled = true;
+      free(key);
+    }
+  }
+  hashMapUninit(&pool, nullDtor);
+  vectorUninit(&keys, free);
+
+  if (pooled) {
+    // point references at the kept frags, then drop the duplicates
+    size_t kept = 0;
+    for (size_t idx = 0; idx < frags->size; ++idx) {
+      IRFrag *frag = frags->elements[idx];
+      if (frag->type == FT_TEXT) {
+        for (ListNode *currBlock = frag->data.text.blocks.head->next;
+             currBlock != frag->data.text.blocks.tail;
+             currBlock = currBlock->next) {
+          IRBlock *b = currBlock->data;
+          for (ListNode *currInst = b->instructions.head->next;
+               currInst != b->instructions.tail; currInst = currInst->next) {
+            IRInstruction *i = currInst->data;
+            for (size_t argIdx = 0; argIdx < irOperatorArity(i->op); ++argIdx)
+              if (i->args[argIdx]->kind == OK_CONSTANT)
+                relabelData(&i->args[argIdx]->data.constant.data,
+                            replacements);
+          }
+        }
+      } else {
+        relabelData(&frag->data.data.data, replacements);
+      }
+
+      if (frag->nameType == FNT_LOCAL &&
+          replacements[frag->name.local] != frag->name.local)
+        irFragFree(frag);
+      else
+        frags->elements[kept++] = frag;
+    }
+    frags->size = kept;
+  }
+
+  free(replacements);
+}
+
 /**
  * translate the given file
  */
@@ -4068,6 +4612,12 @@ static void translateFile(FileListEntry *file) {
 
         generateFunctionExit(blocks, entry, returnValueAddressTemp,
                              returnValueTemp, exitLabel, file);
+
+        demoteTailCalls(blocks);
+
+        // every path ended in a tail call - nothing returns through the exit
+        if (!labelReferenced(blocks, exitLabel))
+          irBlockFree(removeNode(blocks->tail->prev));
         break;
       }
       case NT_VARDEFN: {
@@ -4085,6 +4635,8 @@ static void translateFile(FileListEntry *file) {
     }
   }
   free(namePrefix);
+
+  poolStringLiterals(file);
 }
 
 void translate(void) {
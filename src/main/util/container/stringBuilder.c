@@ -38,6 +38,18 @@ void stringBuilderPush(StringBuilder *sb, char c) {
   }
   sb->string[sb->size++] = c;
 }
+void stringBuilderAppend(StringBuilder *sb, char const *data, size_t length) {
+  if (sb->size + length > sb->capacity) {
+    while (sb->size + length > sb->capacity)
+      sb->capacity *= VECTOR_GROWTH_FACTOR;
+    sb->string = realloc(sb->string, sb->capacity * sizeof(char));
+  }
+  memcpy(sb->string + sb->size, data, length * sizeof(char));
+  sb->size += length;
+}
+void stringBuilderAppendString(StringBuilder *sb, char const *s) {
+  stringBuilderAppend(sb, s, strlen(s));
+}
 char *stringBuilderData(StringBuilder const *sb) {
   char *string = malloc((sb->size + 1) * sizeof(char));
   memcpy(string, sb->string, sb->size * sizeof(char));
@@ -48,6 +48,21 @@ void stringBuilderInit(StringBuilder *sb);
  * @param c character to add
  */
 void stringBuilderPush(StringBuilder *sb, char c);
+/**
+ * adds some characters to the end of the string
+ *
+ * @param sb builder to add on to
+ * @param data characters to add
+ * @param length number of characters to add
+ */
+void stringBuilderAppend(StringBuilder *sb, char const *data, size_t length);
+/**
+ * adds a c-string to the end of the string
+ *
+ * @param sb builder to add on to
+ * @param s c-string to add
+ */
+void stringBuilderAppendString(StringBuilder *sb, char const *s);
 /**
  * produces a new null terminated c-string that copies current data
  *
@@ -448,10 +448,16 @@ static uint64_t floatOrDoubleStringToBits(
 }
 
 uint32_t floatStringToBits(char const *string) {
-  return (uint32_t)floatOrDoubleStringToBits(
-      string, FLOAT_MANTISSA_BITS, FLOAT_EXPONENT_MAX, FLOAT_EXPONENT_MIN,
+  // literals from the lexer keep their 'f' suffix
+  char *digits = strdup(string);
+  size_t length = strlen(digits);
+  if (length != 0 && digits[length - 1] == 'f') digits[length - 1] = '\0';
+  uint32_t bits = (uint32_t)floatOrDoubleStringToBits(
+      digits, FLOAT_MANTISSA_BITS, FLOAT_EXPONENT_MAX, FLOAT_EXPONENT_MIN,
       FLOAT_EXPONENT_MIN_SUBNORMAL, FLOAT_SIGN_MASK, FLOAT_EXPONENT_MASK,
       FLOAT_SIGN_MASK | FLOAT_EXPONENT_MASK, FLOAT_MANTISSA_MASK);
+  free(digits);
+  return bits;
 }
 
 uint64_t doubleStringToBits(char const *string) {
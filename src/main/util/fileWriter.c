@@ -0,0 +1,161 @@
+// Copyright 2021 Justin Hu
+//
+// This file is part of the T Language Compiler.
+//
+// The T Language Compiler is free software: you can redistribute it and/or
+// modify it under the terms of the GNU General Public License as published by
+// the Free Software Foundation, either version 3 of the License, or (at your
+// option) any later version.
+//
+// The T Language Compiler is distributed in the hope that it will be useful,
+// but WITHOUT ANY WARRANTY; without even the implied warranty of
+// MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the GNU General
+// Public License for more details.
+//
+// You should have received a copy of the GNU General Public License along with
+// the T Language Compiler. If not see <https://www.gnu.org/licenses/>.
+//
+// SPDX-License-Identifier: GPL-3.0-or-later
+
+#include "util/fileWriter.h"
+
+#include <errno.h>
+#include <fcntl.h>
+#include <stdlib.h>
+#include <string.h>
+#include <unistd.h>
+
+int fileWriterInit(FileWriter *w, char const *filename) {
+  w->fd = open(filename, O_WRONLY | O_CREAT | O_TRUNC, 0666);
+  if (w->fd == -1) return -1;
+  w->errored = false;
+  w->buffer = malloc(FILE_WRITER_BUFFER_SIZE);
+  w->size = 0;
+  w->queued = 0;
+  w->numPieces = 0;
+  return 0;
+}
+
+/**
+ * queue the part of the buffer written since the last queued piece
+ */
+static void queueBuffer(FileWriter *w) {
+  if (w->size == w->queued) return;
+  w->pieces[w->numPieces].iov_base = w->buffer + w->queued;
+  w->pieces[w->numPieces].iov_len = w->size - w->queued;
+  w->owned[w->numPieces] = NULL;
+  ++w->numPieces;
+  w->queued = w->size;
+}
+
+/**
+ * write out everything queued and buffered
+ */
+static void flush(FileWriter *w) {
+  queueBuffer(w);
+
+  struct iovec *pieces = w->pieces;
+  size_t numPieces = w->numPieces;
+  while (numPieces > 0 && !w->errored) {
+    ssize_t written = writev(w->fd, pieces, (int)numPieces);
+    if (written == -1) {
+      if (errno != EINTR) w->errored = true;
+      continue;
+    }
+
+    // skip over what was written, which may end partway through a piece
+    size_t remaining = (size_t)written;
+    while (numPieces > 0 && remaining >= pieces->iov_len) {
+      remaining -= pieces->iov_len;
+      ++pieces;
+      --numPieces;
+    }
+    if (numPieces > 0) {
+      pieces->iov_base = (char *)pieces->iov_base + remaining;
+      pieces->iov_len -= remaining;
+    }
+  }
+
+  for (size_t idx = 0; idx < w->numPieces; ++idx) free(w->owned[idx]);
+  w->numPieces = 0;
+  w->size = 0;
+  w->queued = 0;
+}
+
+/**
+ * write bytes straight to the file, bypassing the buffer - everything
+ * buffered must have been flushed first
+ */
+static void writeDirectly(FileWriter *w, char const *data, size_t length) {
+  while (length > 0 && !w->errored) {
+    ssize_t written = write(w->fd, data, length);
+    if (written == -1) {
+      if (errno != EINTR) w->errored = true;
+      continue;
+    }
+    data += written;
+    length -= (size_t)written;
+  }
+}
+
+void fileWriterWrite(FileWriter *w, char const *data, size_t length) {
+  if (w->size + length > FILE_WRITER_BUFFER_SIZE ||
+      w->numPieces == FILE_WRITER_MAX_PIECES)
+    flush(w);
+  if (length > FILE_WRITER_BUFFER_SIZE) {
+    // too big to buffer
+    writeDirectly(w, data, length);
+    return;
+  }
+  memcpy(w->buffer + w->size, data, length);
+  w->size += length;
+}
+void fileWriterWriteString(FileWriter *w, char const *s) {
+  fileWriterWrite(w, s, strlen(s));
+}
+void fileWriterWriteOwnedString(FileWriter *w, char *s) {
+  size_t length = strlen(s);
+  if (length < 256) {
+    // cheaper to copy than to queue
+    fileWriterWrite(w, s, length);
+    free(s);
+    return;
+  }
+
+  if (w->numPieces + 2 > FILE_WRITER_MAX_PIECES) flush(w);
+  queueBuffer(w);
+  w->pieces[w->numPieces].iov_base = s;
+  w->pieces[w->numPieces].iov_len = length;
+  w->owned[w->numPieces] = s;
+  ++w->numPieces;
+}
+void fileWriterWriteChar(FileWriter *w, char c) {
+  if (w->size == FILE_WRITER_BUFFER_SIZE ||
+      w->numPieces == FILE_WRITER_MAX_PIECES)
+    flush(w);
+  w->buffer[w->size++] = c;
+}
+void fileWriterWriteUnsigned(FileWriter *w, uint64_t n) {
+  char digits[20];
+  size_t numDigits = 0;
+  do {
+    digits[sizeof(digits) - ++numDigits] = (char)('0' + n % 10);
+    n /= 10;
+  } while (n != 0);
+  fileWriterWrite(w, digits + sizeof(digits) - numDigits, numDigits);
+}
+void fileWriterWriteSigned(FileWriter *w, int64_t n) {
+  if (n < 0) {
+    fileWriterWriteChar(w, '-');
+    fileWriterWriteUnsigned(w, -(uint64_t)n);
+  } else {
+    fileWriterWriteUnsigned(w, (uint64_t)n);
+  }
+}
+
+int fileWriterUninit(FileWriter *w) {
+  flush(w);
+  free(w->buffer);
+  if (close(w->fd) != 0) w->errored = true;
+  return w->errored ? -1 : 0;
+}
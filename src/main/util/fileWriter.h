@@ -0,0 +1,97 @@
+// Copyright 2021 Justin Hu
+//
+// This file is part of the T Language Compiler.
+//
+// The T Language Compiler is free software: you can redistribute it and/or
+// modify it under the terms of the GNU General Public License as published by
+// the Free Software Foundation, either version 3 of the License, or (at your
+// option) any later version.
+//
+// The T Language Compiler is distributed in the hope that it will be useful,
+// but WITHOUT ANY WARRANTY; without even the implied warranty of
+// MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the GNU General
+// Public License for more details.
+//
+// You should have received a copy of the GNU General Public License along with
+// the T Language Compiler. If not see <https://www.gnu.org/licenses/>.
+//
+// SPDX-License-Identifier: GPL-3.0-or-later
+
+/**
+ * @file
+ * Buffered output files
+ */
+
+#ifndef TLC_UTIL_FILEWRITER_H_
+#define TLC_UTIL_FILEWRITER_H_
+
+#include <stdbool.h>
+#include <stddef.h>
+#include <stdint.h>
+#include <sys/uio.h>
+
+/** bytes buffered before a flush */
+#define FILE_WRITER_BUFFER_SIZE ((size_t)1 << 20)
+/** pieces queued before a flush */
+#define FILE_WRITER_MAX_PIECES 64
+
+/**
+ * an output file that buffers small writes and queues whole strings, then
+ * hands everything to the OS in one writev
+ */
+typedef struct {
+  int fd;
+  bool errored; /**< has any write failed */
+  char *buffer;
+  size_t size;   /**< bytes used in buffer */
+  size_t queued; /**< bytes of buffer already queued as a piece */
+  struct iovec pieces[FILE_WRITER_MAX_PIECES];
+  char *owned[FILE_WRITER_MAX_PIECES]; /**< string to free after each piece */
+  size_t numPieces;
+} FileWriter;
+
+/**
+ * in-place ctor - opens (and truncates) the file
+ *
+ * @param w writer to initialize
+ * @param filename name of the file to write to
+ * @returns status code (0 = OK)
+ */
+int fileWriterInit(FileWriter *w, char const *filename);
+/**
+ * writes some bytes - anything too big for the buffer is written immediately
+ *
+ * @param w writer to write to
+ * @param data bytes to write
+ * @param length number of bytes
+ */
+void fileWriterWrite(FileWriter *w, char const *data, size_t length);
+/**
+ * writes a c-string
+ */
+void fileWriterWriteString(FileWriter *w, char const *s);
+/**
+ * writes a c-string without copying it, taking ownership of it
+ */
+void fileWriterWriteOwnedString(FileWriter *w, char *s);
+/**
+ * writes one character
+ */
+void fileWriterWriteChar(FileWriter *w, char c);
+/**
+ * writes a number in decimal
+ */
+void fileWriterWriteUnsigned(FileWriter *w, uint64_t n);
+/**
+ * writes a number in decimal
+ */
+void fileWriterWriteSigned(FileWriter *w, int64_t n);
+/**
+ * in-place dtor - flushes and closes the file
+ *
+ * @param w writer to close
+ * @returns status code (0 = OK, nonzero if any write failed)
+ */
+int fileWriterUninit(FileWriter *w);
+
+#endif  // TLC_UTIL_FILEWRITER_H_
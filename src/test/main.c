@@ -44,6 +44,8 @@ int main(int argc, char *argv[]) {
     testBigInteger();
   if (argc <= 1 || containsString((size_t)argc, argv, "conversions"))
     testConversions();
+  if (argc <= 1 || containsString((size_t)argc, argv, "fileWriter"))
+    testFileWriter();
 
   if (argc <= 1 || containsString((size_t)argc, argv, "commandLineArgs"))
     testCommandLineArgs();
@@ -59,6 +61,18 @@ int main(int argc, char *argv[]) {
     testTraceScheduling();
   if (argc <= 1 || containsString((size_t)argc, argv, "scheduledOptimization"))
     testScheduledOptimization();
+  if (argc <= 1 || containsString((size_t)argc, argv, "registerAllocation"))
+    testRegisterAllocation();
+  if (argc <= 1 || containsString((size_t)argc, argv, "frame")) testFrame();
+  if (argc <= 1 || containsString((size_t)argc, argv, "peephole"))
+    testPeephole();
+  if (argc <= 1 || containsString((size_t)argc, argv, "encoder"))
+    testEncoder();
+  if (argc <= 1 || containsString((size_t)argc, argv, "jit")) testJit();
+  if (argc <= 1 || containsString((size_t)argc, argv, "objectWriter"))
+    testObjectWriter();
+  if (argc <= 1 || containsString((size_t)argc, argv, "assembly"))
+    testAssembly();
 
   return testStatusStatus();
 }
\ No newline at end of file
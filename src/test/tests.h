@@ -29,6 +29,8 @@
 void testBigInteger(void);
 /** tests numeric conversions */
 void testConversions(void);
+/** tests buffered output files */
+void testFileWriter(void);
 /** tests command line argument parsing */
 void testCommandLineArgs(void);
 /** tests lexing */
@@ -45,5 +47,19 @@ void testBlockedOptimization(void);
 void testTraceScheduling(void);
 /** tests optimzation after scheduling */
 void testScheduledOptimization(void);
+/** tests x86_64 linux register allocation */
+void testRegisterAllocation(void);
+/** tests x86_64 linux stack frame layout */
+void testFrame(void);
+/** tests x86_64 linux peephole optimization */
+void testPeephole(void);
+/** tests the x86_64 linux machine code encoder */
+void testEncoder(void);
+/** tests running programs in-process */
+void testJit(void);
+/** tests object file output */
+void testObjectWriter(void);
+/** tests assembly output */
+void testAssembly(void);
 
 #endif  // TLC_TEST_TESTS_H_
\ No newline at end of file
@@ -0,0 +1,140 @@
+// Copyright 2021 Justin Hu
+//
+// This file is part of the T Language Compiler.
+//
+// The T Language Compiler is free software: you can redistribute it and/or
+// modify it under the terms of the GNU General Public License as published by
+// the Free Software Foundation, either version 3 of the License, or (at your
+// option) any later version.
+//
+// The T Language Compiler is distributed in the hope that it will be useful,
+// but WITHOUT ANY WARRANTY; without even the implied warranty of
+// MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the GNU General
+// Public License for more details.
+//
+// You should have received a copy of the GNU General Public License along with
+// the T Language Compiler. If not see <https://www.gnu.org/licenses/>.
+//
+// SPDX-License-Identifier: GPL-3.0-or-later
+
+/**
+ * @file
+ * tests for assembly output
+ */
+
+#include <assert.h>
+#include <dirent.h>
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+
+#include "arch/interface.h"
+#include "engine.h"
+#include "fileList.h"
+#include "optimization/optimization.h"
+#include "options.h"
+#include "parser/parser.h"
+#include "tests.h"
+#include "translation/traceSchedule.h"
+#include "translation/translation.h"
+#include "typechecker/typechecker.h"
+#include "util/dump.h"
+#include "util/filesystem.h"
+
+/**
+ * dump the assembly file written for a code file
+ */
+static void assemblyFileDump(FILE *out, FileListEntry *entry) {
+  char *filename = format("%.*s.s", (int)(strlen(entry->inputFilename) - 3),
+                          entry->inputFilename);
+  FILE *file = fopen(filename, "r");
+  assert("couldn't open written assembly file" && file != NULL);
+  for (int c = fgetc(file); c != EOF; c = fgetc(file)) fputc(c, out);
+  fclose(file);
+  remove(filename);
+  free(filename);
+}
+
+void testAssembly(void) {
+  Options original;
+  memcpy(&original, &options, sizeof(Options));
+
+  DIR *archs = opendir("testFiles/assembly");
+  assert("couldn't open arch dir" && archs != NULL);
+
+  for (struct dirent *arch = readdir(archs); arch != NULL;
+       arch = readdir(archs)) {
+    if (strncmp(arch->d_name, ".", 1) == 0) continue;
+
+    if (strcmp(arch->d_name, "x86_64-linux") == 0) {
+      options.arch = OPTION_A_X86_64_LINUX;
+    } else {
+      assert("unrecognized arch folder name" && false);
+    }
+
+    char *inputFolder = format("testFiles/assembly/%s/input", arch->d_name);
+    char *expectedFolder =
+        format("testFiles/assembly/%s/expected", arch->d_name);
+
+    struct dirent **input;
+    int inputLen = scandir(inputFolder, &input, noHiddenFilter, alphasort);
+    assert("couldn't open input files dir" && inputLen != -1);
+
+    struct dirent **expected;
+    int expectedLen =
+        scandir(expectedFolder, &expected, noHiddenFilter, alphasort);
+    assert("couldn't open expected files dir" && expectedLen != -1);
+    assert("different numbers of files in input and expected dirs" &&
+           inputLen == expectedLen);
+
+    for (int idx = 0; idx < inputLen; ++idx) {
+      struct dirent *entry = input[idx];
+      struct dirent *expectedEntry = expected[idx];
+      FileListEntry entries[1];
+      fileList.entries = &entries[0];
+      fileList.size = 1;
+
+      char *name = format("testFiles/assembly/%s/input/%s", arch->d_name,
+                          entry->d_name);
+      fileListEntryInit(&entries[0], name, true);
+
+      int parseStatus = parse();
+      assert("couldn't parse file in testAssembly's file list" &&
+             parseStatus == 0);
+      int typecheckStatus = typecheck();
+      assert("couldn't typecheck file in testAssembly's file list" &&
+             typecheckStatus == 0);
+      translate();
+      nodeFree(entries[0].ast);
+      optimizeBlockedIr();
+      traceSchedule();
+      optimizeScheduledIr();
+
+      options.emit = OPTION_EMIT_ASM;
+      options.run = NULL;
+      int exitCode = 0;
+      int backendStatus = backend(&exitCode);
+      testDynamic(format("%s is compiled", entries[0].inputFilename),
+                  backendStatus == 0);
+
+      char *expectedName = format("testFiles/assembly/%s/expected/%s",
+                                  arch->d_name, expectedEntry->d_name);
+      if (backendStatus == 0)
+        testDynamic(
+            format("assembly of %s is correct", entries[0].inputFilename),
+            dumpEqual(&entries[0], assemblyFileDump, expectedName));
+
+      free(expectedName);
+      free(name);
+      free(entry);
+      free(expectedEntry);
+    }
+    free(input);
+    free(expected);
+    free(inputFolder);
+    free(expectedFolder);
+  }
+  closedir(archs);
+
+  memcpy(&options, &original, sizeof(Options));
+}
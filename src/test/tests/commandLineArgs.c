@@ -339,6 +339,125 @@ static void testOptions(void) {
        retval == 0);
   test("debug-dump ir option is correctly set",
        options.dump == OPTION_DD_SCHEDULED_OPTIMIZATION);
+
+  // --inline-threshold=...
+  argc = 3;
+  char const *const argv20[] = {
+      "./tlc",
+      "--inline-threshold=42",
+      "foo.tc",
+  };
+  retval = parseArgs(argc, argv20, &numFiles);
+
+  test("command line with inline-threshold=42 passes", retval == 0);
+  test("inline-threshold option is correctly set",
+       options.inlineThreshold == 42);
+
+  argc = 3;
+  char const *const argv21[] = {
+      "./tlc",
+      "--inline-threshold=many",
+      "foo.tc",
+  };
+  retval = parseArgs(argc, argv21, &numFiles);
+
+  test("command line with non-numeric inline-threshold fails", retval != 0);
+
+  // --register-allocator=...
+  argc = 3;
+  char const *const argv22[] = {
+      "./tlc",
+      "--register-allocator=linear-scan",
+      "foo.tc",
+  };
+  retval = parseArgs(argc, argv22, &numFiles);
+
+  test("command line with register-allocator=linear-scan passes",
+       retval == 0);
+  test("register-allocator option is correctly set",
+       options.registerAllocator == OPTION_RA_LINEAR_SCAN);
+
+  argc = 3;
+  char const *const argv23[] = {
+      "./tlc",
+      "--register-allocator=graph-coloring",
+      "foo.tc",
+  };
+  retval = parseArgs(argc, argv23, &numFiles);
+
+  test("command line with register-allocator=graph-coloring passes",
+       retval == 0);
+  test("register-allocator option is correctly set",
+       options.registerAllocator == OPTION_RA_GRAPH_COLORING);
+
+  // --linear-scan-threshold=...
+  argc = 3;
+  char const *const argv24[] = {
+      "./tlc",
+      "--linear-scan-threshold=100",
+      "foo.tc",
+  };
+  retval = parseArgs(argc, argv24, &numFiles);
+
+  test("command line with linear-scan-threshold=100 passes", retval == 0);
+  test("linear-scan-threshold option is correctly set",
+       options.linearScanThreshold == 100);
+
+  argc = 3;
+  char const *const argv25[] = {
+      "./tlc",
+      "--linear-scan-threshold=",
+      "foo.tc",
+  };
+  retval = parseArgs(argc, argv25, &numFiles);
+
+  test("command line with empty linear-scan-threshold fails", retval != 0);
+
+  // --emit=...
+  argc = 3;
+  char const *const argv26[] = {
+      "./tlc",
+      "--emit=obj",
+      "foo.tc",
+  };
+  retval = parseArgs(argc, argv26, &numFiles);
+
+  test("command line with emit=obj passes", retval == 0);
+  test("emit option is correctly set", options.emit == OPTION_EMIT_OBJ);
+
+  argc = 3;
+  char const *const argv27[] = {
+      "./tlc",
+      "--emit=asm",
+      "foo.tc",
+  };
+  retval = parseArgs(argc, argv27, &numFiles);
+
+  test("command line with emit=asm passes", retval == 0);
+  test("emit option is correctly set", options.emit == OPTION_EMIT_ASM);
+
+  // --run=...
+  argc = 3;
+  char const *const argv28[] = {
+      "./tlc",
+      "--run=foo::main",
+      "foo.tc",
+  };
+  retval = parseArgs(argc, argv28, &numFiles);
+
+  test("command line with run passes", retval == 0);
+  test("run option is correctly set",
+       options.run != NULL && strcmp(options.run, "foo::main") == 0);
+
+  argc = 3;
+  char const *const argv29[] = {
+      "./tlc",
+      "--run=",
+      "foo.tc",
+  };
+  retval = parseArgs(argc, argv29, &numFiles);
+
+  test("command line with empty run fails", retval != 0);
 }
 
 void testCommandLineArgs(void) {
@@ -0,0 +1,258 @@
+// Copyright 2020-2021 Justin Hu
+//
+// This file is part of the T Language Compiler.
+//
+// The T Language Compiler is free software: you can redistribute it and/or
+// modify it under the terms of the GNU General Public License as published by
+// the Free Software Foundation, either version 3 of the License, or (at your
+// option) any later version.
+//
+// The T Language Compiler is distributed in the hope that it will be useful,
+// but WITHOUT ANY WARRANTY; without even the implied warranty of
+// MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the GNU General
+// Public License for more details.
+//
+// You should have received a copy of the GNU General Public License along with
+// the T Language Compiler. If not see <https://www.gnu.org/licenses/>.
+//
+// SPDX-License-Identifier: GPL-3.0-or-later
+
+/**
+ * @file
+ * tests for the x86_64 linux machine code encoder
+ */
+
+#include "arch/x86_64-linux/encoder.h"
+
+#include <stdlib.h>
+#include <string.h>
+
+#include "engine.h"
+#include "tests.h"
+
+/**
+ * create a stack slot operand
+ */
+static X86_64LinuxOperand *stackOperand(X86_64LinuxRegister base,
+                                        int64_t offset, size_t size) {
+  X86_64LinuxOperand *o = malloc(sizeof(X86_64LinuxOperand));
+  o->kind = X86_64_LINUX_OK_STACK;
+  o->data.stack.base = base;
+  o->data.stack.offset = offset;
+  o->data.stack.size = size;
+  return o;
+}
+
+/**
+ * create an rbp-relative offset operand, as used in indexed stack addresses
+ */
+static X86_64LinuxOperand *offsetOperand(int64_t offset) {
+  X86_64LinuxOperand *o = malloc(sizeof(X86_64LinuxOperand));
+  o->kind = X86_64_LINUX_OK_OFFSET;
+  o->data.offset.offset = offset;
+  return o;
+}
+
+/**
+ * encode an instruction and compare it to the expected bytes, freeing the
+ * instruction
+ */
+static bool encodesTo(X86_64LinuxInstruction *i, uint8_t const *expected,
+                      size_t length) {
+  TStringBuilder out;
+  tstringBuilderInit(&out);
+  Vector references;
+  vectorInit(&references);
+  bool ok = x86_64LinuxEncodeInstruction(i, &out, &references) == 0 &&
+            out.size == length && memcmp(out.string, expected, length) == 0 &&
+            references.size == 0;
+  vectorUninit(&references, (void (*)(void *))x86_64LinuxReferenceFree);
+  tstringBuilderUninit(&out);
+  x86_64LinuxInstructionFree(i);
+  return ok;
+}
+
+static X86_64LinuxInstruction *instruction(char const *skeleton) {
+  return x86_64LinuxInstructionCreate(X86_64_LINUX_IK_REGULAR,
+                                      strdup(skeleton));
+}
+
+static void testRegisterAndMemoryForms(void) {
+  X86_64LinuxInstruction *i = instruction("\tmov `d, `u\n");
+  vectorInsert(&i->defines, x86_64LinuxRegOperandCreate(X86_64_LINUX_R10, 8));
+  vectorInsert(&i->uses, x86_64LinuxRegOperandCreate(X86_64_LINUX_RBX, 8));
+  uint8_t const movRegReg[] = {0x49, 0x89, 0xda};
+  test("encoder encodes register to register moves",
+       encodesTo(i, movRegReg, sizeof(movRegReg)));
+
+  i = instruction("\tmov `o, `u\n");
+  vectorInsert(&i->other, stackOperand(X86_64_LINUX_RBP, -12, 4));
+  vectorInsert(&i->uses, x86_64LinuxRegOperandCreate(X86_64_LINUX_RSI, 4));
+  uint8_t const movStore[] = {0x89, 0x75, 0xf4};
+  test("encoder encodes stores to stack slots",
+       encodesTo(i, movStore, sizeof(movStore)));
+
+  i = instruction("\tmov `d, `o\n");
+  vectorInsert(&i->defines, x86_64LinuxRegOperandCreate(X86_64_LINUX_R9, 2));
+  vectorInsert(&i->other, stackOperand(X86_64_LINUX_RBP, -8, 2));
+  uint8_t const movLoad[] = {0x66, 0x44, 0x8b, 0x4d, 0xf8};
+  test("encoder encodes word loads from stack slots",
+       encodesTo(i, movLoad, sizeof(movLoad)));
+
+  i = instruction("\tmov `o, `u\n");
+  vectorInsert(&i->other, stackOperand(X86_64_LINUX_RSP, -12, 4));
+  vectorInsert(&i->uses, x86_64LinuxRegOperandCreate(X86_64_LINUX_RSI, 4));
+  uint8_t const redZoneStore[] = {0x89, 0x74, 0x24, 0xf4};
+  test("encoder encodes stores to red zone slots",
+       encodesTo(i, redZoneStore, sizeof(redZoneStore)));
+
+  i = instruction("\tlea `d, [`u + 8]\n");
+  vectorInsert(&i->defines, x86_64LinuxRegOperandCreate(X86_64_LINUX_RDI, 8));
+  vectorInsert(&i->uses, x86_64LinuxRegOperandCreate(X86_64_LINUX_RSP, 8));
+  uint8_t const lea[] = {0x48, 0x8d, 0x7c, 0x24, 0x08};
+  test("encoder encodes rsp-based addresses with a sib byte",
+       encodesTo(i, lea, sizeof(lea)));
+
+  i = instruction("\tlea `d, [`u + 4]\n");
+  vectorInsert(&i->defines, x86_64LinuxRegOperandCreate(X86_64_LINUX_RAX, 4));
+  vectorInsert(&i->uses, x86_64LinuxRegOperandCreate(X86_64_LINUX_RCX, 8));
+  uint8_t const lea32[] = {0x8d, 0x41, 0x04};
+  test("encoder encodes 32 bit leas of 64 bit addresses",
+       encodesTo(i, lea32, sizeof(lea32)));
+
+  i = instruction("\tmov `d, [`u + `u*8 + 16]\n");
+  vectorInsert(&i->defines, x86_64LinuxRegOperandCreate(X86_64_LINUX_RAX, 8));
+  vectorInsert(&i->uses, x86_64LinuxRegOperandCreate(X86_64_LINUX_R13, 8));
+  vectorInsert(&i->uses, x86_64LinuxRegOperandCreate(X86_64_LINUX_R12, 8));
+  uint8_t const movIndexed[] = {0x4b, 0x8b, 0x44, 0xe5, 0x10};
+  test("encoder encodes scaled index addresses",
+       encodesTo(i, movIndexed, sizeof(movIndexed)));
+
+  i = instruction("\tmov [rbp + `u*4 + `o], `u\n");
+  vectorInsert(&i->uses, x86_64LinuxRegOperandCreate(X86_64_LINUX_RCX, 8));
+  vectorInsert(&i->other, offsetOperand(-64));
+  vectorInsert(&i->uses, x86_64LinuxRegOperandCreate(X86_64_LINUX_RSI, 4));
+  uint8_t const movFrame[] = {0x89, 0x74, 0x8d, 0xc0};
+  test("encoder encodes indexed stack addresses",
+       encodesTo(i, movFrame, sizeof(movFrame)));
+
+  i = instruction("\txor `d, `u\n");
+  vectorInsert(&i->defines, x86_64LinuxRegOperandCreate(X86_64_LINUX_RAX, 4));
+  vectorInsert(&i->uses, x86_64LinuxRegOperandCreate(X86_64_LINUX_RAX, 4));
+  uint8_t const xor[] = {0x31, 0xc0};
+  test("encoder encodes 32 bit arithmetic without a REX prefix",
+       encodesTo(i, xor, sizeof(xor)));
+}
+
+static void testImmediateForms(void) {
+  X86_64LinuxInstruction *i = instruction("\tmov `d, 5\n");
+  vectorInsert(&i->defines, x86_64LinuxRegOperandCreate(X86_64_LINUX_RSI, 1));
+  uint8_t const movByte[] = {0x40, 0xb6, 0x05};
+  test("encoder adds an empty REX prefix for sil",
+       encodesTo(i, movByte, sizeof(movByte)));
+
+  i = instruction("\tmov `d, 18446744073709551615\n");
+  vectorInsert(&i->defines, x86_64LinuxRegOperandCreate(X86_64_LINUX_RAX, 8));
+  uint8_t const movNegative[] = {0x48, 0xc7, 0xc0, 0xff, 0xff, 0xff, 0xff};
+  test("encoder sign-extends small negative 64 bit immediates",
+       encodesTo(i, movNegative, sizeof(movNegative)));
+
+  i = instruction("\tadd `d, 300\n");
+  vectorInsert(&i->defines, x86_64LinuxRegOperandCreate(X86_64_LINUX_R12, 8));
+  uint8_t const add[] = {0x49, 0x81, 0xc4, 0x2c, 0x01, 0x00, 0x00};
+  test("encoder encodes 32 bit immediates",
+       encodesTo(i, add, sizeof(add)));
+
+  i = instruction("\tsub rsp, 96\n");
+  uint8_t const sub[] = {0x48, 0x83, 0xec, 0x60};
+  test("encoder encodes literal registers and byte immediates",
+       encodesTo(i, sub, sizeof(sub)));
+}
+
+static void testOtherForms(void) {
+  X86_64LinuxInstruction *i = instruction("\tpush `u\n");
+  vectorInsert(&i->uses, x86_64LinuxRegOperandCreate(X86_64_LINUX_R13, 8));
+  uint8_t const push[] = {0x41, 0x55};
+  test("encoder encodes pushes of extended registers",
+       encodesTo(i, push, sizeof(push)));
+
+  i = instruction("\trep movsq\n");
+  uint8_t const repMovsq[] = {0xf3, 0x48, 0xa5};
+  test("encoder encodes rep movsq", encodesTo(i, repMovsq, sizeof(repMovsq)));
+
+  i = instruction("\trep stosq\n");
+  uint8_t const repStosq[] = {0xf3, 0x48, 0xab};
+  test("encoder encodes rep stosq", encodesTo(i, repStosq, sizeof(repStosq)));
+
+  i = instruction("\tmovdqu [`u + 16], `u\n");
+  vectorInsert(&i->uses, x86_64LinuxRegOperandCreate(X86_64_LINUX_R9, 8));
+  vectorInsert(&i->uses, x86_64LinuxRegOperandCreate(X86_64_LINUX_XMM10, 16));
+  uint8_t const movdqu[] = {0xf3, 0x45, 0x0f, 0x7f, 0x51, 0x10};
+  test("encoder encodes sse stores", encodesTo(i, movdqu, sizeof(movdqu)));
+
+  i = instruction("\tmovd `d, [`u]\n");
+  vectorInsert(&i->defines, x86_64LinuxRegOperandCreate(X86_64_LINUX_XMM3, 4));
+  vectorInsert(&i->uses, x86_64LinuxRegOperandCreate(X86_64_LINUX_R9, 8));
+  uint8_t const movd[] = {0x66, 0x41, 0x0f, 0x6e, 0x19};
+  test("encoder encodes doubleword sse loads",
+       encodesTo(i, movd, sizeof(movd)));
+
+  i = x86_64LinuxInstructionCreate(X86_64_LINUX_IK_TAIL_CALL,
+                                   strdup("\tjmp `u\n"));
+  vectorInsert(&i->uses, x86_64LinuxRegOperandCreate(X86_64_LINUX_R11, 8));
+  uint8_t const jmp[] = {0x41, 0xff, 0xe3};
+  test("encoder encodes indirect tail jumps", encodesTo(i, jmp, sizeof(jmp)));
+
+  i = instruction("\tcall _T3foo3bar\n");
+  TStringBuilder out;
+  tstringBuilderInit(&out);
+  Vector references;
+  vectorInit(&references);
+  int retval = x86_64LinuxEncodeInstruction(i, &out, &references);
+  X86_64LinuxReference const *r =
+      references.size == 1 ? references.elements[0] : NULL;
+  test("encoder encodes calls to symbols",
+       retval == 0 && out.size == 5 && out.string[0] == 0xe8 && r != NULL &&
+           r->kind == X86_64_LINUX_RK_PLT32 && r->offset == 1 &&
+           r->addend == -4 && strcmp(r->symbol, "_T3foo3bar") == 0);
+  vectorUninit(&references, (void (*)(void *))x86_64LinuxReferenceFree);
+  tstringBuilderUninit(&out);
+  x86_64LinuxInstructionFree(i);
+}
+
+static void testUnencodable(void) {
+  TStringBuilder out;
+  tstringBuilderInit(&out);
+  Vector references;
+  vectorInit(&references);
+
+  X86_64LinuxInstruction *i = instruction("\tfrobnicate\n");
+  test("encoder rejects unknown instructions",
+       x86_64LinuxEncodeInstruction(i, &out, &references) != 0);
+  x86_64LinuxInstructionFree(i);
+
+  i = instruction("\tmov `d, `u\n");
+  vectorInsert(&i->defines, x86_64LinuxRegOperandCreate(X86_64_LINUX_RAX, 8));
+  vectorInsert(&i->uses, x86_64LinuxRegOperandCreate(X86_64_LINUX_RBX, 4));
+  test("encoder rejects mismatched operand sizes",
+       x86_64LinuxEncodeInstruction(i, &out, &references) != 0);
+  x86_64LinuxInstructionFree(i);
+
+  i = instruction("\tjmp *`u\n");
+  vectorInsert(&i->uses, x86_64LinuxRegOperandCreate(X86_64_LINUX_RAX, 8));
+  test("encoder rejects AT&T style indirect jumps",
+       x86_64LinuxEncodeInstruction(i, &out, &references) != 0);
+  x86_64LinuxInstructionFree(i);
+
+  test("encoder leaves no output after a rejected instruction",
+       out.size == 0 && references.size == 0);
+  vectorUninit(&references, (void (*)(void *))x86_64LinuxReferenceFree);
+  tstringBuilderUninit(&out);
+}
+
+void testEncoder(void) {
+  testRegisterAndMemoryForms();
+  testImmediateForms();
+  testOtherForms();
+  testUnencodable();
+}
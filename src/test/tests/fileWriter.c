@@ -0,0 +1,151 @@
+// Copyright 2021 Justin Hu
+//
+// This file is part of the T Language Compiler.
+//
+// The T Language Compiler is free software: you can redistribute it and/or
+// modify it under the terms of the GNU General Public License as published by
+// the Free Software Foundation, either version 3 of the License, or (at your
+// option) any later version.
+//
+// The T Language Compiler is distributed in the hope that it will be useful,
+// but WITHOUT ANY WARRANTY; without even the implied warranty of
+// MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the GNU General
+// Public License for more details.
+//
+// You should have received a copy of the GNU General Public License along with
+// the T Language Compiler. If not see <https://www.gnu.org/licenses/>.
+//
+// SPDX-License-Identifier: GPL-3.0-or-later
+
+/**
+ * @file
+ * tests for buffered output files
+ */
+
+#include "util/fileWriter.h"
+
+#include <stdint.h>
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include <sys/stat.h>
+#include <unistd.h>
+
+#include "engine.h"
+#include "tests.h"
+#include "util/format.h"
+
+/** make an empty file to write to, returning its name */
+static char *temporaryFile(void) {
+  char *filename = strdup("/tmp/tlcFileWriterXXXXXX");
+  int fd = mkstemp(filename);
+  if (fd != -1) close(fd);
+  return filename;
+}
+
+static size_t fileSize(char const *filename) {
+  struct stat s;
+  if (stat(filename, &s) != 0) return SIZE_MAX;
+  return (size_t)s.st_size;
+}
+
+/** does the file hold exactly the expected bytes */
+static bool fileHolds(char const *filename, char const *expected,
+                      size_t length) {
+  if (fileSize(filename) != length) return false;
+  FILE *file = fopen(filename, "rb");
+  if (file == NULL) return false;
+  char *contents = malloc(length + 1);
+  bool ok = fread(contents, 1, length + 1, file) == length &&
+            memcmp(contents, expected, length) == 0;
+  free(contents);
+  fclose(file);
+  return ok;
+}
+
+static void testBuffered(void) {
+  char *filename = temporaryFile();
+  FileWriter w;
+  test("file writer opens a file", fileWriterInit(&w, filename) == 0);
+  fileWriterWriteString(&w, "mov eax, ");
+  fileWriterWriteUnsigned(&w, 18446744073709551615UL);
+  fileWriterWriteChar(&w, '\n');
+  fileWriterWrite(&w, "add eax, 12345", 9);
+  fileWriterWriteSigned(&w, INT64_MIN);
+  fileWriterWriteChar(&w, ' ');
+  fileWriterWriteSigned(&w, 0);
+  fileWriterWriteChar(&w, ' ');
+  fileWriterWriteSigned(&w, 42);
+  fileWriterWriteOwnedString(&w, strdup("\nret\n"));
+  test("file writer buffers small writes", fileSize(filename) == 0);
+  test("file writer closes the file", fileWriterUninit(&w) == 0);
+
+  char const *expected =
+      "mov eax, 18446744073709551615\n"
+      "add eax, -9223372036854775808 0 42\n"
+      "ret\n";
+  test("file writer flushes buffered writes",
+       fileHolds(filename, expected, strlen(expected)));
+  remove(filename);
+  free(filename);
+}
+
+static void testLargeWrite(void) {
+  size_t length = FILE_WRITER_BUFFER_SIZE + 1;
+  char *expected = malloc(length + 8);
+  memcpy(expected, "head", 4);
+  for (size_t idx = 0; idx < length; ++idx)
+    expected[4 + idx] = (char)('a' + idx % 26);
+  memcpy(expected + 4 + length, "tail", 4);
+
+  char *filename = temporaryFile();
+  FileWriter w;
+  fileWriterInit(&w, filename);
+  fileWriterWriteString(&w, "head");
+  fileWriterWrite(&w, expected + 4, length);
+  test("file writer writes large writes through immediately",
+       fileHolds(filename, expected, length + 4));
+  fileWriterWriteString(&w, "tail");
+  test("file writer closes the file after a large write",
+       fileWriterUninit(&w) == 0);
+  test("file writer keeps large writes in order",
+       fileHolds(filename, expected, length + 8));
+  remove(filename);
+  free(filename);
+  free(expected);
+}
+
+static void testOwnedStrings(void) {
+  // more owned strings than can be queued at once, between buffered writes
+  size_t const numStrings = FILE_WRITER_MAX_PIECES * 3;
+  size_t const stringLength = 300;
+  size_t length = numStrings * (stringLength + 1);
+  char *expected = malloc(length);
+
+  char *filename = temporaryFile();
+  FileWriter w;
+  fileWriterInit(&w, filename);
+  for (size_t string = 0; string < numStrings; ++string) {
+    char *s = malloc(stringLength + 1);
+    memset(s, 'a' + (int)(string % 26), stringLength);
+    s[stringLength] = '\0';
+    memcpy(expected + string * (stringLength + 1), s, stringLength);
+    expected[string * (stringLength + 1) + stringLength] = '\n';
+
+    fileWriterWriteOwnedString(&w, s);
+    fileWriterWriteChar(&w, '\n');
+  }
+  test("file writer closes the file after queued strings",
+       fileWriterUninit(&w) == 0);
+  test("file writer writes queued strings in order",
+       fileHolds(filename, expected, length));
+  remove(filename);
+  free(filename);
+  free(expected);
+}
+
+void testFileWriter(void) {
+  testBuffered();
+  testLargeWrite();
+  testOwnedStrings();
+}
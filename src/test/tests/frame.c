@@ -0,0 +1,226 @@
+// Copyright 2021 Justin Hu
+//
+// This file is part of the T Language Compiler.
+//
+// The T Language Compiler is free software: you can redistribute it and/or
+// modify it under the terms of the GNU General Public License as published by
+// the Free Software Foundation, either version 3 of the License, or (at your
+// option) any later version.
+//
+// The T Language Compiler is distributed in the hope that it will be useful,
+// but WITHOUT ANY WARRANTY; without even the implied warranty of
+// MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the GNU General
+// Public License for more details.
+//
+// You should have received a copy of the GNU General Public License along with
+// the T Language Compiler. If not see <https://www.gnu.org/licenses/>.
+//
+// SPDX-License-Identifier: GPL-3.0-or-later
+
+/**
+ * @file
+ * tests for x86_64 linux stack frame layout
+ */
+
+#include "arch/x86_64-linux/frame.h"
+
+#include <string.h>
+
+#include "arch/x86_64-linux/asm.h"
+#include "engine.h"
+#include "tests.h"
+#include "util/asmFixture.h"
+
+/**
+ * add an instruction using a mem temp
+ *
+ * @returns the operand, to look at once it's been given a slot
+ */
+static X86_64LinuxOperand *reference(AsmFixture *f, size_t name, size_t size,
+                                     bool escapes) {
+  X86_64LinuxOperand *o = asmFixtureTemp(name, size, AH_MEM);
+  o->data.temp.escapes = escapes;
+  X86_64LinuxInstruction *i =
+      asmFixtureAdd(f, X86_64_LINUX_IK_REGULAR, "\tuse `u\n");
+  vectorInsert(&i->uses, o);
+  return o;
+}
+/**
+ * add references to some eight byte locals that are all live at once
+ *
+ * @returns an operand referring to one of them
+ */
+static X86_64LinuxOperand *liveLocals(AsmFixture *f, size_t count) {
+  size_t first = f->entry.nextId;
+  X86_64LinuxOperand *o = NULL;
+  for (size_t idx = 0; idx < count; ++idx)
+    o = reference(f, asmFixtureFresh(f), 8, false);
+  for (size_t idx = 0; idx < count; ++idx) reference(f, first + idx, 8, false);
+  return o;
+}
+
+/** do two operands refer to the same stack slot */
+static bool sameSlot(X86_64LinuxOperand const *a, X86_64LinuxOperand const *b) {
+  return a->kind == X86_64_LINUX_OK_STACK &&
+         b->kind == X86_64_LINUX_OK_STACK &&
+         a->data.stack.base == b->data.stack.base &&
+         a->data.stack.offset == b->data.stack.offset;
+}
+/** do two operands refer to distinct, non-overlapping stack slots */
+static bool distinctSlots(X86_64LinuxOperand const *a,
+                          X86_64LinuxOperand const *b) {
+  return a->kind == X86_64_LINUX_OK_STACK &&
+         b->kind == X86_64_LINUX_OK_STACK &&
+         a->data.stack.base == b->data.stack.base &&
+         (a->data.stack.offset + (int64_t)a->data.stack.size <=
+              b->data.stack.offset ||
+          b->data.stack.offset + (int64_t)b->data.stack.size <=
+              a->data.stack.offset);
+}
+
+/**
+ * does the function set up a frame on entry and tear it down before leaving
+ */
+static bool hasFrame(AsmFixture *f) {
+  X86_64LinuxInstruction const *first = f->instructions->head->next->data;
+  X86_64LinuxInstruction const *last = f->instructions->tail->prev->data;
+  X86_64LinuxInstruction const *beforeLast =
+      f->instructions->tail->prev->prev->data;
+  return strcmp(first->skeleton, "\tpush rbp\n") == 0 &&
+         (last->kind == X86_64_LINUX_IK_LEAVE ||
+          last->kind == X86_64_LINUX_IK_TAIL_CALL) &&
+         strcmp(beforeLast->skeleton, "\tleave\n") == 0;
+}
+/**
+ * does the function have no prologue or epilogue at all
+ */
+static bool noFrame(AsmFixture *f) {
+  for (ListNode *curr = f->instructions->head->next;
+       curr != f->instructions->tail; curr = curr->next) {
+    X86_64LinuxInstruction const *i = curr->data;
+    if (strcmp(i->skeleton, "\tpush rbp\n") == 0 ||
+        strcmp(i->skeleton, "\tleave\n") == 0)
+      return false;
+  }
+  return true;
+}
+/** lowest offset any stack slot starts at */
+static int64_t lowestOffset(AsmFixture *f) {
+  int64_t lowest = 0;
+  for (ListNode *curr = f->instructions->head->next;
+       curr != f->instructions->tail; curr = curr->next) {
+    X86_64LinuxInstruction const *i = curr->data;
+    for (size_t idx = 0; idx < i->uses.size; ++idx) {
+      X86_64LinuxOperand const *o = i->uses.elements[idx];
+      if (o->kind == X86_64_LINUX_OK_STACK && o->data.stack.offset < lowest)
+        lowest = o->data.stack.offset;
+    }
+  }
+  return lowest;
+}
+
+static void testSlotSharing(void) {
+  AsmFixture f;
+  asmFixtureInit(&f);
+  size_t a = asmFixtureFresh(&f);
+  size_t b = asmFixtureFresh(&f);
+  X86_64LinuxOperand *first = reference(&f, a, 8, false);
+  reference(&f, a, 8, false);
+  X86_64LinuxOperand *second = reference(&f, b, 8, false);
+  reference(&f, b, 8, false);
+  asmFixtureReturn(&f);
+  x86_64LinuxLayoutFrames();
+  test("frame layout shares a slot between disjoint locals",
+       sameSlot(first, second));
+  asmFixtureUninit(&f);
+
+  asmFixtureInit(&f);
+  a = asmFixtureFresh(&f);
+  b = asmFixtureFresh(&f);
+  first = reference(&f, a, 8, false);
+  second = reference(&f, b, 8, false);
+  reference(&f, a, 8, false);
+  asmFixtureReturn(&f);
+  x86_64LinuxLayoutFrames();
+  test("frame layout doesn't share a slot between overlapping locals",
+       distinctSlots(first, second));
+  asmFixtureUninit(&f);
+
+  asmFixtureInit(&f);
+  a = asmFixtureFresh(&f);
+  b = asmFixtureFresh(&f);
+  size_t c = asmFixtureFresh(&f);
+  first = reference(&f, a, 8, false);
+  second = reference(&f, b, 8, true);
+  X86_64LinuxOperand *third = reference(&f, c, 8, false);
+  asmFixtureReturn(&f);
+  x86_64LinuxLayoutFrames();
+  test("frame layout never shares an escaping local's slot",
+       distinctSlots(first, second) && distinctSlots(second, third));
+  asmFixtureUninit(&f);
+
+  asmFixtureInit(&f);
+  size_t head = asmFixtureFresh(&f);
+  a = asmFixtureFresh(&f);
+  b = asmFixtureFresh(&f);
+  asmFixtureLabel(&f, head);
+  first = reference(&f, a, 8, false);
+  second = reference(&f, b, 8, false);
+  asmFixtureJump(&f, X86_64_LINUX_IK_CJUMP, "jl", head);
+  asmFixtureReturn(&f);
+  x86_64LinuxLayoutFrames();
+  test("frame layout doesn't share slots between locals in a loop",
+       distinctSlots(first, second));
+  asmFixtureUninit(&f);
+}
+
+static void testFrameless(void) {
+  // 15 slots take up the red zone, less the eight bytes rbp would be saved in
+  AsmFixture f;
+  asmFixtureInit(&f);
+  X86_64LinuxOperand *o = liveLocals(&f, 15);
+  asmFixtureReturn(&f);
+  x86_64LinuxLayoutFrames();
+  test("frame layout leaves out the frame of a leaf fitting in the red zone",
+       noFrame(&f) && o->data.stack.base == X86_64_LINUX_RSP);
+  test("frame layout keeps frameless slots in the red zone",
+       lowestOffset(&f) == -128);
+  asmFixtureUninit(&f);
+
+  asmFixtureInit(&f);
+  o = liveLocals(&f, 16);
+  asmFixtureReturn(&f);
+  x86_64LinuxLayoutFrames();
+  test("frame layout gives a frame to a leaf too big for the red zone",
+       hasFrame(&f) && o->data.stack.base == X86_64_LINUX_RBP);
+  asmFixtureUninit(&f);
+
+  asmFixtureInit(&f);
+  o = liveLocals(&f, 1);
+  asmFixtureAdd(&f, X86_64_LINUX_IK_CALL, "\tcall foo\n");
+  asmFixtureReturn(&f);
+  x86_64LinuxLayoutFrames();
+  test("frame layout gives a frame to a function that calls",
+       hasFrame(&f) && o->data.stack.base == X86_64_LINUX_RBP);
+  asmFixtureUninit(&f);
+
+  asmFixtureInit(&f);
+  o = liveLocals(&f, 1);
+  asmFixtureAdd(&f, X86_64_LINUX_IK_TAIL_CALL, "\tjmp foo\n");
+  x86_64LinuxLayoutFrames();
+  test("frame layout gives a frame to a function that tail calls",
+       hasFrame(&f) && o->data.stack.base == X86_64_LINUX_RBP);
+  asmFixtureUninit(&f);
+
+  asmFixtureInit(&f);
+  asmFixtureAdd(&f, X86_64_LINUX_IK_TAIL_CALL, "\tjmp foo\n");
+  x86_64LinuxLayoutFrames();
+  test("frame layout leaves out the frame of a tail call with no locals",
+       noFrame(&f));
+  asmFixtureUninit(&f);
+}
+
+void testFrame(void) {
+  testSlotSharing();
+  testFrameless();
+}
@@ -0,0 +1,105 @@
+// Copyright 2021 Justin Hu
+//
+// This file is part of the T Language Compiler.
+//
+// The T Language Compiler is free software: you can redistribute it and/or
+// modify it under the terms of the GNU General Public License as published by
+// the Free Software Foundation, either version 3 of the License, or (at your
+// option) any later version.
+//
+// The T Language Compiler is distributed in the hope that it will be useful,
+// but WITHOUT ANY WARRANTY; without even the implied warranty of
+// MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the GNU General
+// Public License for more details.
+//
+// You should have received a copy of the GNU General Public License along with
+// the T Language Compiler. If not see <https://www.gnu.org/licenses/>.
+//
+// SPDX-License-Identifier: GPL-3.0-or-later
+
+/**
+ * @file
+ * tests for running programs in-process
+ */
+
+#include <assert.h>
+#include <dirent.h>
+#include <stdlib.h>
+#include <string.h>
+
+#include "arch/interface.h"
+#include "engine.h"
+#include "fileList.h"
+#include "optimization/optimization.h"
+#include "options.h"
+#include "parser/parser.h"
+#include "tests.h"
+#include "translation/traceSchedule.h"
+#include "translation/translation.h"
+#include "typechecker/typechecker.h"
+#include "util/filesystem.h"
+
+void testJit(void) {
+  assert("can't bless jit tests" && !status.bless);
+
+  Options original;
+  memcpy(&original, &options, sizeof(Options));
+
+  DIR *archs = opendir("testFiles/jit");
+  assert("couldn't open arch dir" && archs != NULL);
+
+  for (struct dirent *arch = readdir(archs); arch != NULL;
+       arch = readdir(archs)) {
+    if (strncmp(arch->d_name, ".", 1) == 0) continue;
+
+    if (strcmp(arch->d_name, "x86_64-linux") == 0) {
+      options.arch = OPTION_A_X86_64_LINUX;
+    } else {
+      assert("unrecognized arch folder name" && false);
+    }
+
+    char *inputFolder = format("testFiles/jit/%s", arch->d_name);
+
+    struct dirent **input;
+    int inputLen = scandir(inputFolder, &input, noHiddenFilter, alphasort);
+    assert("couldn't open input files dir" && inputLen != -1);
+
+    for (int idx = 0; idx < inputLen; ++idx) {
+      struct dirent *entry = input[idx];
+      FileListEntry entries[1];
+      fileList.entries = &entries[0];
+      fileList.size = 1;
+
+      char *name = format("testFiles/jit/%s/%s", arch->d_name, entry->d_name);
+      fileListEntryInit(&entries[0], name, true);
+
+      // every program's entry point returns 42
+      int parseStatus = parse();
+      assert("couldn't parse file in testJit's file list" && parseStatus == 0);
+      int typecheckStatus = typecheck();
+      assert("couldn't typecheck file in testJit's file list" &&
+             typecheckStatus == 0);
+      translate();
+      nodeFree(entries[0].ast);
+      optimizeBlockedIr();
+      traceSchedule();
+      optimizeScheduledIr();
+
+      options.run = "jit::main";
+      int exitCode = 0;
+      int backendStatus = backend(&exitCode);
+      testDynamic(format("%s runs", entries[0].inputFilename),
+                  backendStatus == 0);
+      testDynamic(format("%s returns 42", entries[0].inputFilename),
+                  exitCode == 42);
+
+      free(name);
+      free(entry);
+    }
+    free(input);
+    free(inputFolder);
+  }
+  closedir(archs);
+
+  memcpy(&options, &original, sizeof(Options));
+}
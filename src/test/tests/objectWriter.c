@@ -0,0 +1,317 @@
+// Copyright 2021 Justin Hu
+//
+// This file is part of the T Language Compiler.
+//
+// The T Language Compiler is free software: you can redistribute it and/or
+// modify it under the terms of the GNU General Public License as published by
+// the Free Software Foundation, either version 3 of the License, or (at your
+// option) any later version.
+//
+// The T Language Compiler is distributed in the hope that it will be useful,
+// but WITHOUT ANY WARRANTY; without even the implied warranty of
+// MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the GNU General
+// Public License for more details.
+//
+// You should have received a copy of the GNU General Public License along with
+// the T Language Compiler. If not see <https://www.gnu.org/licenses/>.
+//
+// SPDX-License-Identifier: GPL-3.0-or-later
+
+/**
+ * @file
+ * tests for object file output
+ */
+
+#include <assert.h>
+#include <dirent.h>
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+
+#include "arch/interface.h"
+#include "engine.h"
+#include "fileList.h"
+#include "optimization/optimization.h"
+#include "options.h"
+#include "parser/parser.h"
+#include "tests.h"
+#include "translation/traceSchedule.h"
+#include "translation/translation.h"
+#include "typechecker/typechecker.h"
+#include "util/dump.h"
+#include "util/filesystem.h"
+
+/** read a little-endian value out of an ELF file */
+static uint64_t readValue(uint8_t const *bytes, size_t width) {
+  uint64_t value = 0;
+  for (size_t idx = 0; idx < width; ++idx)
+    value |= (uint64_t)bytes[idx] << (8 * idx);
+  return value;
+}
+
+/** a section header, as read back from an ELF file */
+typedef struct {
+  char const *name;
+  uint32_t type;
+  uint64_t flags;
+  uint8_t const *contents;
+  uint64_t size;
+  uint32_t link;
+  uint64_t alignment;
+} SectionHeader;
+
+static char const *sectionTypeName(uint32_t type) {
+  switch (type) {
+    case 1: {
+      return "PROGBITS";
+    }
+    case 2: {
+      return "SYMTAB";
+    }
+    case 3: {
+      return "STRTAB";
+    }
+    case 4: {
+      return "RELA";
+    }
+    case 8: {
+      return "NOBITS";
+    }
+    default: {
+      return "?";
+    }
+  }
+}
+static char const *symbolTypeName(uint8_t type) {
+  switch (type) {
+    case 0: {
+      return "NOTYPE";
+    }
+    case 1: {
+      return "OBJECT";
+    }
+    case 2: {
+      return "FUNC";
+    }
+    case 3: {
+      return "SECTION";
+    }
+    default: {
+      return "?";
+    }
+  }
+}
+static char const *relocationTypeName(uint32_t type) {
+  switch (type) {
+    case 1: {
+      return "R_X86_64_64";
+    }
+    case 2: {
+      return "R_X86_64_PC32";
+    }
+    case 4: {
+      return "R_X86_64_PLT32";
+    }
+    case 10: {
+      return "R_X86_64_32";
+    }
+    case 11: {
+      return "R_X86_64_32S";
+    }
+    default: {
+      return "?";
+    }
+  }
+}
+
+/** get the name of a symbol table entry */
+static char const *symbolName(SectionHeader const *headers,
+                              SectionHeader const *symtab, uint64_t index) {
+  uint8_t const *symbol = symtab->contents + index * 24;
+  if ((symbol[4] & 0xf) == 3) return headers[readValue(symbol + 6, 2)].name;
+  return (char const *)headers[symtab->link].contents + readValue(symbol, 4);
+}
+
+/**
+ * dump an ELF64 relocatable file's sections, symbols, and relocations, in
+ * roughly the style of readelf
+ */
+static void dumpElf(FILE *out, uint8_t const *elf) {
+  uint64_t headersOffset = readValue(elf + 0x28, 8);
+  size_t numHeaders = readValue(elf + 0x3c, 2);
+  size_t namesIndex = readValue(elf + 0x3e, 2);
+  fprintf(out, "type %lu, machine %lu\n", readValue(elf + 0x10, 2),
+          readValue(elf + 0x12, 2));
+
+  SectionHeader *headers = malloc(numHeaders * sizeof(SectionHeader));
+  for (size_t idx = 0; idx < numHeaders; ++idx) {
+    uint8_t const *header = elf + headersOffset + idx * 64;
+    headers[idx].type = (uint32_t)readValue(header + 4, 4);
+    headers[idx].flags = readValue(header + 8, 8);
+    headers[idx].contents = elf + readValue(header + 24, 8);
+    headers[idx].size = readValue(header + 32, 8);
+    headers[idx].link = (uint32_t)readValue(header + 40, 4);
+    headers[idx].alignment = readValue(header + 48, 8);
+  }
+  uint8_t const *names = headers[namesIndex].contents;
+  for (size_t idx = 0; idx < numHeaders; ++idx)
+    headers[idx].name = (char const *)names +
+                        readValue(elf + headersOffset + idx * 64, 4);
+
+  for (size_t idx = 1; idx < numHeaders; ++idx) {
+    SectionHeader const *h = &headers[idx];
+    fprintf(out, "section %zu: %s %s%s%s%s align %lu size %lu\n", idx, h->name,
+            sectionTypeName(h->type), (h->flags & 0x1) != 0 ? " W" : "",
+            (h->flags & 0x2) != 0 ? " A" : "",
+            (h->flags & 0x4) != 0 ? " X" : "", h->alignment, h->size);
+    switch (h->type) {
+      case 1: {
+        for (size_t offset = 0; offset < h->size; offset += 16) {
+          fprintf(out, "  %04zx:", offset);
+          for (size_t byte = offset; byte < offset + 16 && byte < h->size;
+               ++byte)
+            fprintf(out, " %02x", h->contents[byte]);
+          fprintf(out, "\n");
+        }
+        break;
+      }
+      case 2: {
+        for (size_t symbol = 1; symbol < h->size / 24; ++symbol) {
+          uint8_t const *s = h->contents + symbol * 24;
+          uint64_t section = readValue(s + 6, 2);
+          fprintf(out, "  %zu: %s %s %s %s + %lu size %lu\n", symbol,
+                  symbolName(headers, h, symbol),
+                  s[4] >> 4 == 0 ? "LOCAL" : "GLOBAL",
+                  symbolTypeName(s[4] & 0xf),
+                  section == 0 ? "UND" : headers[section].name,
+                  readValue(s + 8, 8), readValue(s + 16, 8));
+        }
+        break;
+      }
+      case 4: {
+        for (size_t r = 0; r < h->size / 24; ++r) {
+          uint8_t const *rela = h->contents + r * 24;
+          uint64_t info = readValue(rela + 8, 8);
+          fprintf(out, "  %04lx: %s %s %+ld\n", readValue(rela, 8),
+                  relocationTypeName((uint32_t)info),
+                  symbolName(headers, &headers[h->link], info >> 32),
+                  (int64_t)readValue(rela + 16, 8));
+        }
+        break;
+      }
+      default: {
+        // string tables are shown through the names that use them
+        break;
+      }
+    }
+  }
+  free(headers);
+}
+
+/**
+ * dump the object file written for a code file
+ */
+static void objectFileDump(FILE *out, FileListEntry *entry) {
+  char *filename = format("%.*s.o", (int)(strlen(entry->inputFilename) - 3),
+                          entry->inputFilename);
+  FILE *file = fopen(filename, "rb");
+  assert("couldn't open written object file" && file != NULL);
+  fseek(file, 0, SEEK_END);
+  long length = ftell(file);
+  assert("couldn't get length of object file" && length >= 0);
+  rewind(file);
+  uint8_t *elf = malloc((size_t)length);
+  size_t readLength = fread(elf, 1, (size_t)length, file);
+  assert("couldn't read object file" && readLength == (size_t)length);
+  fclose(file);
+  remove(filename);
+  free(filename);
+
+  dumpElf(out, elf);
+  free(elf);
+}
+
+void testObjectWriter(void) {
+  Options original;
+  memcpy(&original, &options, sizeof(Options));
+
+  DIR *archs = opendir("testFiles/objectWriter");
+  assert("couldn't open arch dir" && archs != NULL);
+
+  for (struct dirent *arch = readdir(archs); arch != NULL;
+       arch = readdir(archs)) {
+    if (strncmp(arch->d_name, ".", 1) == 0) continue;
+
+    if (strcmp(arch->d_name, "x86_64-linux") == 0) {
+      options.arch = OPTION_A_X86_64_LINUX;
+    } else {
+      assert("unrecognized arch folder name" && false);
+    }
+
+    char *inputFolder =
+        format("testFiles/objectWriter/%s/input", arch->d_name);
+    char *expectedFolder =
+        format("testFiles/objectWriter/%s/expected", arch->d_name);
+
+    struct dirent **input;
+    int inputLen = scandir(inputFolder, &input, noHiddenFilter, alphasort);
+    assert("couldn't open input files dir" && inputLen != -1);
+
+    struct dirent **expected;
+    int expectedLen =
+        scandir(expectedFolder, &expected, noHiddenFilter, alphasort);
+    assert("couldn't open expected files dir" && expectedLen != -1);
+    assert("different numbers of files in input and expected dirs" &&
+           inputLen == expectedLen);
+
+    for (int idx = 0; idx < inputLen; ++idx) {
+      struct dirent *entry = input[idx];
+      struct dirent *expectedEntry = expected[idx];
+      FileListEntry entries[1];
+      fileList.entries = &entries[0];
+      fileList.size = 1;
+
+      char *name = format("testFiles/objectWriter/%s/input/%s", arch->d_name,
+                          entry->d_name);
+      fileListEntryInit(&entries[0], name, true);
+
+      int parseStatus = parse();
+      assert("couldn't parse file in testObjectWriter's file list" &&
+             parseStatus == 0);
+      int typecheckStatus = typecheck();
+      assert("couldn't typecheck file in testObjectWriter's file list" &&
+             typecheckStatus == 0);
+      translate();
+      nodeFree(entries[0].ast);
+      optimizeBlockedIr();
+      traceSchedule();
+      optimizeScheduledIr();
+
+      options.emit = OPTION_EMIT_OBJ;
+      options.run = NULL;
+      int exitCode = 0;
+      int backendStatus = backend(&exitCode);
+      testDynamic(format("%s is assembled", entries[0].inputFilename),
+                  backendStatus == 0);
+
+      char *expectedName = format("testFiles/objectWriter/%s/expected/%s",
+                                  arch->d_name, expectedEntry->d_name);
+      if (backendStatus == 0)
+        testDynamic(
+            format("object file of %s is correct", entries[0].inputFilename),
+            dumpEqual(&entries[0], objectFileDump, expectedName));
+
+      free(expectedName);
+      free(name);
+      free(entry);
+      free(expectedEntry);
+    }
+    free(input);
+    free(expected);
+    free(inputFolder);
+    free(expectedFolder);
+  }
+  closedir(archs);
+
+  memcpy(&options, &original, sizeof(Options));
+}
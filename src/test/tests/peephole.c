@@ -0,0 +1,249 @@
+// Copyright 2021 Justin Hu
+//
+// This file is part of the T Language Compiler.
+//
+// The T Language Compiler is free software: you can redistribute it and/or
+// modify it under the terms of the GNU General Public License as published by
+// the Free Software Foundation, either version 3 of the License, or (at your
+// option) any later version.
+//
+// The T Language Compiler is distributed in the hope that it will be useful,
+// but WITHOUT ANY WARRANTY; without even the implied warranty of
+// MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the GNU General
+// Public License for more details.
+//
+// You should have received a copy of the GNU General Public License along with
+// the T Language Compiler. If not see <https://www.gnu.org/licenses/>.
+//
+// SPDX-License-Identifier: GPL-3.0-or-later
+
+/**
+ * @file
+ * tests for x86_64 linux peephole optimization
+ */
+
+#include "arch/x86_64-linux/peephole.h"
+
+#include <string.h>
+
+#include "arch/x86_64-linux/asm.h"
+#include "engine.h"
+#include "tests.h"
+#include "util/asmFixture.h"
+#include "util/container/stringBuilder.h"
+
+static X86_64LinuxOperand *reg(X86_64LinuxRegister r, size_t size) {
+  return x86_64LinuxRegOperandCreate(r, size);
+}
+/** add an instruction with the given defined and used registers */
+static X86_64LinuxInstruction *regular(AsmFixture *f, char const *skeleton,
+                                       X86_64LinuxOperand *define,
+                                       X86_64LinuxOperand *use) {
+  X86_64LinuxInstruction *i =
+      asmFixtureAdd(f, X86_64_LINUX_IK_REGULAR, skeleton);
+  if (define != NULL) vectorInsert(&i->defines, define);
+  if (use != NULL) vectorInsert(&i->uses, use);
+  return i;
+}
+static void move(AsmFixture *f, X86_64LinuxOperand *to,
+                 X86_64LinuxOperand *from) {
+  insertNodeEnd(f->instructions, x86_64LinuxMoveInstructionCreate(to, from));
+}
+static void zeroTest(AsmFixture *f, X86_64LinuxRegister r, size_t size) {
+  X86_64LinuxInstruction *i = regular(f, "\ttest `u, `u\n", NULL, reg(r, size));
+  vectorInsert(&i->uses, reg(r, size));
+}
+
+/**
+ * optimize the fixture and compare the skeletons left to the expected ones,
+ * concatenated
+ */
+static bool optimizesTo(AsmFixture *f, bool allocated, char const *expected) {
+  x86_64LinuxPeepholeOptimize(allocated);
+  StringBuilder skeletons;
+  stringBuilderInit(&skeletons);
+  for (ListNode *curr = f->instructions->head->next;
+       curr != f->instructions->tail; curr = curr->next) {
+    X86_64LinuxInstruction const *i = curr->data;
+    stringBuilderAppendString(&skeletons, i->skeleton);
+  }
+  bool ok = skeletons.size == strlen(expected) &&
+            memcmp(skeletons.string, expected, skeletons.size) == 0;
+  stringBuilderUninit(&skeletons);
+  return ok;
+}
+
+static void testJumpToNext(void) {
+  AsmFixture f;
+  asmFixtureInit(&f);
+  asmFixtureJump(&f, X86_64_LINUX_IK_JUMP, "jmp", 2);
+  asmFixtureLabel(&f, 1);
+  asmFixtureLabel(&f, 2);
+  asmFixtureReturn(&f);
+  test("peephole removes jumps to the next instruction",
+       optimizesTo(&f, false, "L1:\nL2:\n\tret\n"));
+  asmFixtureUninit(&f);
+
+  asmFixtureInit(&f);
+  asmFixtureJump(&f, X86_64_LINUX_IK_JUMP, "jmp", 2);
+  asmFixtureLabel(&f, 1);
+  move(&f, reg(X86_64_LINUX_RAX, 8), reg(X86_64_LINUX_RDI, 8));
+  asmFixtureLabel(&f, 2);
+  asmFixtureReturn(&f);
+  test("peephole keeps jumps over instructions",
+       optimizesTo(&f, false, "\tjmp L2\nL1:\n\tmov `d, `u\nL2:\n\tret\n"));
+  asmFixtureUninit(&f);
+}
+
+static void testSelfMove(void) {
+  AsmFixture f;
+  asmFixtureInit(&f);
+  move(&f, reg(X86_64_LINUX_RAX, 4), reg(X86_64_LINUX_RAX, 4));
+  asmFixtureReturn(&f);
+  test("peephole keeps self moves before allocation",
+       optimizesTo(&f, false, "\tmov `d, `u\n\tret\n"));
+  test("peephole removes self moves", optimizesTo(&f, true, "\tret\n"));
+  asmFixtureUninit(&f);
+
+  asmFixtureInit(&f);
+  move(&f, reg(X86_64_LINUX_RAX, 4), reg(X86_64_LINUX_RCX, 4));
+  asmFixtureReturn(&f);
+  test("peephole keeps moves between registers",
+       optimizesTo(&f, true, "\tmov `d, `u\n\tret\n"));
+  asmFixtureUninit(&f);
+}
+
+static void testZeroWithXor(void) {
+  AsmFixture f;
+  asmFixtureInit(&f);
+  regular(&f, "\tmov `d, 0\n", reg(X86_64_LINUX_RAX, 8), NULL);
+  asmFixtureReturn(&f);
+  bool optimized = optimizesTo(&f, true, "\txor `d, `u\n\tret\n");
+  X86_64LinuxInstruction const *xor = f.instructions->head->next->data;
+  X86_64LinuxOperand const *defined = xor->defines.elements[0];
+  X86_64LinuxOperand const *used = xor->uses.elements[0];
+  test("peephole zeroes registers with a 32 bit xor",
+       optimized && defined->data.reg.reg == X86_64_LINUX_RAX &&
+           defined->data.reg.size == 4 &&
+           used->data.reg.reg == X86_64_LINUX_RAX &&
+           used->data.reg.size == 4);
+  asmFixtureUninit(&f);
+
+  asmFixtureInit(&f);
+  regular(&f, "\tcmp `u, 0\n", NULL, reg(X86_64_LINUX_RDI, 4));
+  regular(&f, "\tmov `d, 0\n", reg(X86_64_LINUX_RAX, 4), NULL);
+  asmFixtureJump(&f, X86_64_LINUX_IK_CJUMP, "jl", 1);
+  asmFixtureReturn(&f);
+  asmFixtureLabel(&f, 1);
+  asmFixtureReturn(&f);
+  test("peephole keeps zeroing moves while the flags are live",
+       optimizesTo(&f, true,
+                   "\tcmp `u, 0\n\tmov `d, 0\n\tjl L1\n\tret\nL1:\n\tret\n"));
+  asmFixtureUninit(&f);
+}
+
+static void testMoveAddToLea(void) {
+  AsmFixture f;
+  asmFixtureInit(&f);
+  move(&f, reg(X86_64_LINUX_RAX, 4), reg(X86_64_LINUX_RDI, 4));
+  regular(&f, "\tadd `d, 4\n", reg(X86_64_LINUX_RAX, 4),
+          reg(X86_64_LINUX_RAX, 4));
+  asmFixtureReturn(&f);
+  bool optimized = optimizesTo(&f, true, "\tlea `d, [`u + 4]\n\tret\n");
+  X86_64LinuxInstruction const *lea = f.instructions->head->next->data;
+  X86_64LinuxOperand const *dest = lea->defines.elements[0];
+  X86_64LinuxOperand const *base = lea->uses.elements[0];
+  test("peephole turns a move and an add into a lea",
+       optimized && base->data.reg.reg == X86_64_LINUX_RDI);
+  test("peephole addresses a 32 bit lea with the 64 bit register",
+       optimized && base->data.reg.size == 8 && dest->data.reg.size == 4);
+  asmFixtureUninit(&f);
+
+  asmFixtureInit(&f);
+  move(&f, reg(X86_64_LINUX_RAX, 8), reg(X86_64_LINUX_RDI, 8));
+  regular(&f, "\tsub `d, 8\n", reg(X86_64_LINUX_RAX, 8),
+          reg(X86_64_LINUX_RAX, 8));
+  asmFixtureReturn(&f);
+  test("peephole turns a move and a sub into a lea",
+       optimizesTo(&f, true, "\tlea `d, [`u - 8]\n\tret\n"));
+  asmFixtureUninit(&f);
+
+  asmFixtureInit(&f);
+  move(&f, reg(X86_64_LINUX_RAX, 4), reg(X86_64_LINUX_RDI, 4));
+  regular(&f, "\tadd `d, 4\n", reg(X86_64_LINUX_RAX, 4),
+          reg(X86_64_LINUX_RAX, 4));
+  asmFixtureJump(&f, X86_64_LINUX_IK_CJUMP, "jo", 1);
+  asmFixtureReturn(&f);
+  asmFixtureLabel(&f, 1);
+  asmFixtureReturn(&f);
+  test("peephole keeps adds whose flags are read",
+       optimizesTo(&f, true,
+                   "\tmov `d, `u\n\tadd `d, 4\n\tjo L1\n\tret\nL1:\n\tret\n"));
+  asmFixtureUninit(&f);
+}
+
+static void testRedundantTest(void) {
+  AsmFixture f;
+  asmFixtureInit(&f);
+  regular(&f, "\tand `d, `u\n", reg(X86_64_LINUX_RDI, 4),
+          reg(X86_64_LINUX_RSI, 4));
+  move(&f, reg(X86_64_LINUX_RAX, 4), reg(X86_64_LINUX_RCX, 4));
+  zeroTest(&f, X86_64_LINUX_RDI, 4);
+  asmFixtureJump(&f, X86_64_LINUX_IK_CJUMP, "jg", 1);
+  asmFixtureReturn(&f);
+  asmFixtureLabel(&f, 1);
+  asmFixtureReturn(&f);
+  test("peephole removes tests of logical results",
+       optimizesTo(&f, true,
+                   "\tand `d, `u\n\tmov `d, `u\n\tjg L1\n\tret\nL1:\n\tret\n"));
+  asmFixtureUninit(&f);
+
+  asmFixtureInit(&f);
+  regular(&f, "\tadd `d, `u\n", reg(X86_64_LINUX_RDI, 4),
+          reg(X86_64_LINUX_RSI, 4));
+  zeroTest(&f, X86_64_LINUX_RDI, 4);
+  asmFixtureJump(&f, X86_64_LINUX_IK_CJUMP, "je", 1);
+  asmFixtureReturn(&f);
+  asmFixtureLabel(&f, 1);
+  asmFixtureReturn(&f);
+  test("peephole removes tests of sums if only zero is checked",
+       optimizesTo(&f, true, "\tadd `d, `u\n\tje L1\n\tret\nL1:\n\tret\n"));
+  asmFixtureUninit(&f);
+
+  asmFixtureInit(&f);
+  regular(&f, "\tadd `d, `u\n", reg(X86_64_LINUX_RDI, 4),
+          reg(X86_64_LINUX_RSI, 4));
+  zeroTest(&f, X86_64_LINUX_RDI, 4);
+  asmFixtureJump(&f, X86_64_LINUX_IK_CJUMP, "jl", 1);
+  asmFixtureReturn(&f);
+  asmFixtureLabel(&f, 1);
+  asmFixtureReturn(&f);
+  test("peephole keeps tests of sums if the overflow flag is read",
+       optimizesTo(&f, true,
+                   "\tadd `d, `u\n\ttest `u, `u\n\tjl L1\n"
+                   "\tret\nL1:\n\tret\n"));
+  asmFixtureUninit(&f);
+
+  asmFixtureInit(&f);
+  regular(&f, "\tand `d, `u\n", reg(X86_64_LINUX_RDI, 4),
+          reg(X86_64_LINUX_RSI, 4));
+  move(&f, reg(X86_64_LINUX_RDI, 4), reg(X86_64_LINUX_RCX, 4));
+  zeroTest(&f, X86_64_LINUX_RDI, 4);
+  asmFixtureJump(&f, X86_64_LINUX_IK_CJUMP, "je", 1);
+  asmFixtureReturn(&f);
+  asmFixtureLabel(&f, 1);
+  asmFixtureReturn(&f);
+  test("peephole keeps tests of overwritten registers",
+       optimizesTo(&f, true,
+                   "\tand `d, `u\n\tmov `d, `u\n\ttest `u, `u\n\tje L1\n"
+                   "\tret\nL1:\n\tret\n"));
+  asmFixtureUninit(&f);
+}
+
+void testPeephole(void) {
+  testJumpToNext();
+  testSelfMove();
+  testZeroWithXor();
+  testMoveAddToLea();
+  testRedundantTest();
+}
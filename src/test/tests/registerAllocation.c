@@ -0,0 +1,445 @@
+// Copyright 2021 Justin Hu
+//
+// This file is part of the T Language Compiler.
+//
+// The T Language Compiler is free software: you can redistribute it and/or
+// modify it under the terms of the GNU General Public License as published by
+// the Free Software Foundation, either version 3 of the License, or (at your
+// option) any later version.
+//
+// The T Language Compiler is distributed in the hope that it will be useful,
+// but WITHOUT ANY WARRANTY; without even the implied warranty of
+// MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the GNU General
+// Public License for more details.
+//
+// You should have received a copy of the GNU General Public License along with
+// the T Language Compiler. If not see <https://www.gnu.org/licenses/>.
+//
+// SPDX-License-Identifier: GPL-3.0-or-later
+
+/**
+ * @file
+ * tests for x86_64 linux register allocation
+ */
+
+#include "arch/x86_64-linux/registerAllocation.h"
+
+#include <stdlib.h>
+#include <string.h>
+
+#include "arch/x86_64-linux/asm.h"
+#include "engine.h"
+#include "options.h"
+#include "tests.h"
+#include "util/asmFixture.h"
+#include "util/format.h"
+
+#define NUM_REGISTERS ((size_t)X86_64_LINUX_XMM15 + 1)
+/** most operations a fixture can hold */
+#define MAX_OPS 128
+/** most registers or temps an operation can use */
+#define MAX_USES 8
+/** most temps a fixture can have */
+#define MAX_TEMPS 1024
+/** value each register holds on entry is ENTRY_VALUE + its number */
+#define ENTRY_VALUE ((size_t)1000)
+
+/**
+ * a function to allocate, along with the values each of its operations should
+ * read
+ *
+ * operation k writes value k + 1 into the temp it defines
+ */
+typedef struct {
+  AsmFixture base;
+  X86_64LinuxInstruction *ops[MAX_OPS];
+  size_t expected[MAX_OPS][MAX_USES]; /**< value each use should read */
+  size_t numOps;
+  size_t values[MAX_TEMPS]; /**< value of each temp as the ops are added */
+} Fixture;
+
+static void fixtureInit(Fixture *f) {
+  asmFixtureInit(&f->base);
+  f->numOps = 0;
+}
+
+static size_t temp(Fixture *f) { return asmFixtureFresh(&f->base); }
+static X86_64LinuxOperand *tempOperand(size_t name) {
+  return asmFixtureTemp(name, 8, AH_GP);
+}
+
+/**
+ * add an operation reading some temps and defining one
+ *
+ * @param define temp to define, or SIZE_MAX if none
+ */
+static void op(Fixture *f, size_t define, size_t const *uses,
+               size_t numUses) {
+  char *skeleton = format("\top%zu\n", f->numOps);
+  X86_64LinuxInstruction *i =
+      asmFixtureAdd(&f->base, X86_64_LINUX_IK_REGULAR, skeleton);
+  free(skeleton);
+  for (size_t idx = 0; idx < numUses; ++idx) {
+    vectorInsert(&i->uses, tempOperand(uses[idx]));
+    f->expected[f->numOps][idx] = f->values[uses[idx]];
+  }
+  if (define != SIZE_MAX) {
+    vectorInsert(&i->defines, tempOperand(define));
+    f->values[define] = f->numOps + 1;
+  }
+  f->ops[f->numOps++] = i;
+}
+/** add an operation defining a temp from nothing */
+static size_t constant(Fixture *f) {
+  size_t name = temp(f);
+  op(f, name, NULL, 0);
+  return name;
+}
+/** add an operation combining two temps into the first */
+static void combine(Fixture *f, size_t into, size_t from) {
+  size_t uses[] = {into, from};
+  op(f, into, uses, 2);
+}
+static void move(Fixture *f, size_t to, size_t from) {
+  insertNodeEnd(f->base.instructions, x86_64LinuxMoveInstructionCreate(
+                                     tempOperand(to), tempOperand(from)));
+  f->values[to] = f->values[from];
+}
+static bool isCalleeSave(X86_64LinuxRegister reg) {
+  for (size_t idx = 0; idx < X86_64_LINUX_NUM_CALLEE_SAVE_REGISTERS; ++idx) {
+    if (X86_64_LINUX_CALLEE_SAVE_REGISTERS[idx] == reg) return true;
+  }
+  return false;
+}
+static void moveFromRegister(Fixture *f, size_t to, X86_64LinuxRegister from) {
+  insertNodeEnd(f->base.instructions,
+                x86_64LinuxMoveInstructionCreate(
+                    tempOperand(to), x86_64LinuxRegOperandCreate(from, 8)));
+}
+/** add a temp holding the first argument */
+static size_t argument(Fixture *f) {
+  size_t name = temp(f);
+  moveFromRegister(f, name, X86_64_LINUX_RDI);
+  f->values[name] = ENTRY_VALUE + X86_64_LINUX_RDI;
+  return name;
+}
+/**
+ * add a call through a temp passing another, which clobbers every
+ * caller-save gp register
+ *
+ * @returns temp holding the result
+ */
+static size_t call(Fixture *f, size_t passed) {
+  size_t target = constant(f);
+  insertNodeEnd(f->base.instructions,
+                x86_64LinuxMoveInstructionCreate(
+                    x86_64LinuxRegOperandCreate(X86_64_LINUX_RDI, 8),
+                    tempOperand(passed)));
+  X86_64LinuxInstruction *i =
+      asmFixtureAdd(&f->base, X86_64_LINUX_IK_CALL, "\tcall `u\n");
+  vectorInsert(&i->uses, tempOperand(target));
+  f->expected[f->numOps][0] = f->values[target];
+  vectorInsert(&i->uses, x86_64LinuxRegOperandCreate(X86_64_LINUX_RDI, 8));
+  f->expected[f->numOps][1] = f->values[passed];
+  for (X86_64LinuxRegister reg = X86_64_LINUX_RAX; reg <= X86_64_LINUX_R15;
+       ++reg) {
+    if (reg != X86_64_LINUX_RSP && reg != X86_64_LINUX_RBP &&
+        !isCalleeSave(reg))
+      vectorInsert(&i->defines, x86_64LinuxRegOperandCreate(reg, 8));
+  }
+  f->ops[f->numOps++] = i;
+
+  size_t result = temp(f);
+  moveFromRegister(f, result, X86_64_LINUX_RAX);
+  f->values[result] = f->numOps;
+  return result;
+}
+/**
+ * return a temp, expecting the callee-save registers to be restored
+ */
+static void ret(Fixture *f, size_t returned) {
+  insertNodeEnd(f->base.instructions,
+                x86_64LinuxMoveInstructionCreate(
+                    x86_64LinuxRegOperandCreate(X86_64_LINUX_RAX, 8),
+                    tempOperand(returned)));
+  X86_64LinuxInstruction *i = asmFixtureReturn(&f->base);
+  vectorInsert(&i->uses, x86_64LinuxRegOperandCreate(X86_64_LINUX_RAX, 8));
+  f->expected[f->numOps][0] = f->values[returned];
+  for (size_t idx = 0; idx < X86_64_LINUX_NUM_CALLEE_SAVE_REGISTERS; ++idx) {
+    X86_64LinuxRegister reg = X86_64_LINUX_CALLEE_SAVE_REGISTERS[idx];
+    vectorInsert(&i->uses, x86_64LinuxRegOperandCreate(reg, 8));
+    f->expected[f->numOps][idx + 1] = ENTRY_VALUE + reg;
+  }
+  f->ops[f->numOps++] = i;
+}
+
+static ListNode *findLabel(Fixture *f, size_t name) {
+  for (ListNode *curr = f->base.instructions->head->next;
+       curr != f->base.instructions->tail; curr = curr->next) {
+    X86_64LinuxInstruction const *i = curr->data;
+    if (i->kind == X86_64_LINUX_IK_LABEL && i->data.labelName == name)
+      return curr;
+  }
+  return NULL;
+}
+
+/**
+ * get where an allocated operand's value is kept
+ *
+ * @returns a register, a spill slot after the registers, or SIZE_MAX if the
+ * operand wasn't allocated
+ */
+static size_t location(X86_64LinuxOperand const *o) {
+  if (o->kind == X86_64_LINUX_OK_REG) return o->data.reg.reg;
+  if (o->kind == X86_64_LINUX_OK_TEMP && o->data.temp.kind == AH_MEM &&
+      o->data.temp.name < MAX_TEMPS)
+    return NUM_REGISTERS + o->data.temp.name;
+  return SIZE_MAX;
+}
+
+/**
+ * run the allocated instructions, checking that every operation reads the
+ * values it should
+ *
+ * @param taken number of conditional jumps to take before falling through
+ * @returns whether every value read was right, up to the first return
+ */
+static bool runsCorrectly(Fixture *f, size_t taken) {
+  size_t *values = calloc(NUM_REGISTERS + MAX_TEMPS, sizeof(size_t));
+  for (size_t reg = 0; reg < NUM_REGISTERS; ++reg)
+    values[reg] = ENTRY_VALUE + reg;
+
+  bool ok = true;
+  for (ListNode *curr = f->base.instructions->head->next;
+       ok && curr != f->base.instructions->tail;) {
+    X86_64LinuxInstruction const *i = curr->data;
+    curr = curr->next;
+    if (i->kind == X86_64_LINUX_IK_JUMP ||
+        (i->kind == X86_64_LINUX_IK_CJUMP && taken-- > 0)) {
+      curr = findLabel(f, i->data.jumpTargets.elements[0]);
+      ok = curr != NULL;
+      continue;
+    }
+
+    Vector const *operands[] = {&i->uses, &i->defines};
+    for (size_t vecIdx = 0; vecIdx < 2; ++vecIdx) {
+      for (size_t opIdx = 0; opIdx < operands[vecIdx]->size; ++opIdx) {
+        if (location(operands[vecIdx]->elements[opIdx]) == SIZE_MAX)
+          ok = false;
+      }
+    }
+    if (!ok) break;
+
+    if (i->kind == X86_64_LINUX_IK_REGULAR && i->data.move.from != NULL) {
+      values[location(i->data.move.to)] = values[location(i->data.move.from)];
+      continue;
+    }
+    size_t opIdx = 0;
+    while (opIdx < f->numOps && f->ops[opIdx] != i) ++opIdx;
+    if (opIdx == f->numOps) continue;  // label
+    for (size_t useIdx = 0; useIdx < i->uses.size; ++useIdx) {
+      if (values[location(i->uses.elements[useIdx])] !=
+          f->expected[opIdx][useIdx])
+        ok = false;
+    }
+    for (size_t defIdx = 0; defIdx < i->defines.size; ++defIdx)
+      values[location(i->defines.elements[defIdx])] = opIdx + 1;
+    if (i->kind == X86_64_LINUX_IK_LEAVE) break;
+  }
+
+  free(values);
+  return ok;
+}
+
+/** count the register to register moves left */
+static size_t countMoves(Fixture *f) {
+  size_t count = 0;
+  for (ListNode *curr = f->base.instructions->head->next;
+       curr != f->base.instructions->tail; curr = curr->next) {
+    X86_64LinuxInstruction const *i = curr->data;
+    if (i->kind == X86_64_LINUX_IK_REGULAR && i->data.move.from != NULL &&
+        i->data.move.from->kind == X86_64_LINUX_OK_REG &&
+        i->data.move.to->kind == X86_64_LINUX_OK_REG)
+      ++count;
+  }
+  return count;
+}
+/** count the moves from one callee-save register into another */
+static size_t countCalleeSaveMoves(Fixture *f) {
+  size_t count = 0;
+  for (ListNode *curr = f->base.instructions->head->next;
+       curr != f->base.instructions->tail; curr = curr->next) {
+    X86_64LinuxInstruction const *i = curr->data;
+    if (i->kind == X86_64_LINUX_IK_REGULAR && i->data.move.from != NULL &&
+        i->data.move.from->kind == X86_64_LINUX_OK_REG &&
+        i->data.move.to->kind == X86_64_LINUX_OK_REG &&
+        isCalleeSave(i->data.move.from->data.reg.reg) &&
+        isCalleeSave(i->data.move.to->data.reg.reg))
+      ++count;
+  }
+  return count;
+}
+/** count the references to spill slots */
+static size_t countSpills(Fixture *f) {
+  size_t count = 0;
+  for (ListNode *curr = f->base.instructions->head->next;
+       curr != f->base.instructions->tail; curr = curr->next) {
+    X86_64LinuxInstruction const *i = curr->data;
+    Vector const *operands[] = {&i->uses, &i->defines};
+    for (size_t vecIdx = 0; vecIdx < 2; ++vecIdx) {
+      for (size_t opIdx = 0; opIdx < operands[vecIdx]->size; ++opIdx) {
+        X86_64LinuxOperand const *o = operands[vecIdx]->elements[opIdx];
+        if (o->kind == X86_64_LINUX_OK_TEMP && o->data.temp.kind == AH_MEM)
+          ++count;
+      }
+    }
+  }
+  return count;
+}
+/** does anything write the register */
+static bool writesRegister(Fixture *f, X86_64LinuxRegister reg) {
+  for (ListNode *curr = f->base.instructions->head->next;
+       curr != f->base.instructions->tail; curr = curr->next) {
+    X86_64LinuxInstruction const *i = curr->data;
+    for (size_t idx = 0; idx < i->defines.size; ++idx) {
+      X86_64LinuxOperand const *o = i->defines.elements[idx];
+      if (o->kind == X86_64_LINUX_OK_REG && o->data.reg.reg == reg)
+        return true;
+    }
+  }
+  return false;
+}
+
+/**
+ * add more simultaneously live temps than there are registers, then sum them
+ *
+ * each temp is read a few times, so it costs more to spill than a callee-save
+ * register does
+ *
+ * @returns the sum
+ */
+static size_t highPressure(Fixture *f) {
+  size_t temps[20];
+  for (size_t idx = 0; idx < 20; ++idx) temps[idx] = constant(f);
+  for (size_t idx = 1; idx < 20; ++idx) {
+    for (size_t use = 0; use < 4; ++use) combine(f, temps[0], temps[idx]);
+  }
+  return temps[0];
+}
+
+/** name of the allocator being tested */
+static char const *allocatorName(void) {
+  return options.registerAllocator == OPTION_RA_LINEAR_SCAN ? "linear scan"
+                                                            : "graph coloring";
+}
+
+static void testSpilling(void) {
+  Fixture f;
+  fixtureInit(&f);
+  ret(&f, highPressure(&f));
+  x86_64LinuxAllocateRegisters();
+  testDynamic(format("%s spills interfering temps", allocatorName()),
+              countSpills(&f) != 0);
+  testDynamic(format("%s keeps spilled values", allocatorName()),
+              runsCorrectly(&f, 0));
+  asmFixtureUninit(&f.base);
+}
+
+static void testCoalescing(void) {
+  Fixture f;
+  fixtureInit(&f);
+  size_t a = constant(&f);
+  size_t b = temp(&f);
+  move(&f, b, a);
+  size_t c = constant(&f);
+  combine(&f, b, c);
+  ret(&f, b);
+  x86_64LinuxAllocateRegisters();
+  testDynamic(format("%s coalesces moves", allocatorName()),
+              countMoves(&f) == 0);
+  testDynamic(format("%s keeps coalesced values", allocatorName()),
+              runsCorrectly(&f, 0));
+  asmFixtureUninit(&f.base);
+}
+
+static void testCalleeSaves(void) {
+  Fixture f;
+  fixtureInit(&f);
+  size_t sum = highPressure(&f);
+  size_t other = temp(&f);
+  asmFixtureJump(&f.base, X86_64_LINUX_IK_CJUMP, "jl", other);
+  ret(&f, sum);
+  asmFixtureLabel(&f.base, other);
+  combine(&f, sum, sum);
+  ret(&f, sum);
+  x86_64LinuxAllocateRegisters();
+  bool written = false;
+  for (size_t idx = 0; idx < X86_64_LINUX_NUM_CALLEE_SAVE_REGISTERS; ++idx) {
+    if (writesRegister(&f, X86_64_LINUX_CALLEE_SAVE_REGISTERS[idx]))
+      written = true;
+  }
+  testDynamic(format("%s uses callee-save registers", allocatorName()),
+              written);
+  testDynamic(
+      format("%s restores callee-save registers at the first return",
+             allocatorName()),
+      runsCorrectly(&f, 0));
+  testDynamic(
+      format("%s restores callee-save registers at the second return",
+             allocatorName()),
+      runsCorrectly(&f, 1));
+  asmFixtureUninit(&f.base);
+
+  fixtureInit(&f);
+  size_t a = argument(&f);
+  size_t b = call(&f, a);
+  combine(&f, b, a);
+  ret(&f, b);
+  x86_64LinuxAllocateRegisters();
+  testDynamic(format("%s keeps values live across calls", allocatorName()),
+              runsCorrectly(&f, 0));
+  testDynamic(format("%s doesn't shuffle callee-save registers",
+                     allocatorName()),
+              countCalleeSaveMoves(&f) == 0);
+  asmFixtureUninit(&f.base);
+}
+
+static void testLoops(void) {
+  Fixture f;
+  fixtureInit(&f);
+  size_t outer = constant(&f);
+  size_t head = temp(&f);
+  asmFixtureLabel(&f.base, head);
+  size_t inner = constant(&f);
+  combine(&f, inner, outer);
+  size_t sum = highPressure(&f);
+  combine(&f, sum, inner);
+  asmFixtureJump(&f.base, X86_64_LINUX_IK_CJUMP, "jl", head);
+  ret(&f, sum);
+  x86_64LinuxAllocateRegisters();
+  testDynamic(format("%s keeps values live around a loop", allocatorName()),
+              runsCorrectly(&f, 1));
+  testDynamic(format("%s keeps values live over several iterations",
+                     allocatorName()),
+              runsCorrectly(&f, 2));
+  asmFixtureUninit(&f.base);
+}
+
+void testRegisterAllocation(void) {
+  Options original;
+  memcpy(&original, &options, sizeof(Options));
+
+  options.registerAllocator = OPTION_RA_GRAPH_COLORING;
+  testSpilling();
+  testCoalescing();
+  testCalleeSaves();
+  testLoops();
+
+  options.registerAllocator = OPTION_RA_LINEAR_SCAN;
+  testSpilling();
+  testCoalescing();
+  testCalleeSaves();
+  testLoops();
+
+  memcpy(&options, &original, sizeof(Options));
+}
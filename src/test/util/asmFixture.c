@@ -0,0 +1,76 @@
+// Copyright 2021 Justin Hu
+//
+// This file is part of the T Language Compiler.
+//
+// The T Language Compiler is free software: you can redistribute it and/or
+// modify it under the terms of the GNU General Public License as published by
+// the Free Software Foundation, either version 3 of the License, or (at your
+// option) any later version.
+//
+// The T Language Compiler is distributed in the hope that it will be useful,
+// but WITHOUT ANY WARRANTY; without even the implied warranty of
+// MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the GNU General
+// Public License for more details.
+//
+// You should have received a copy of the GNU General Public License along with
+// the T Language Compiler. If not see <https://www.gnu.org/licenses/>.
+//
+// SPDX-License-Identifier: GPL-3.0-or-later
+
+#include "util/asmFixture.h"
+
+#include <stdlib.h>
+#include <string.h>
+
+#include "util/format.h"
+
+void asmFixtureInit(AsmFixture *f) {
+  f->entry.asmFile = &f->file;
+  f->entry.nextId = 1;
+  fileList.entries = &f->entry;
+  fileList.size = 1;
+  vectorInit(&f->file.frags);
+  X86_64LinuxFrag *frag = x86_64LinuxTextFragCreate(strdup(""), strdup(""));
+  vectorInsert(&f->file.frags, frag);
+  f->instructions = &frag->data.text.instructions;
+}
+void asmFixtureUninit(AsmFixture *f) {
+  vectorUninit(&f->file.frags, (void (*)(void *))x86_64LinuxFragFree);
+}
+
+size_t asmFixtureFresh(AsmFixture *f) { return f->entry.nextId++; }
+X86_64LinuxOperand *asmFixtureTemp(size_t name, size_t size, AllocHint kind) {
+  X86_64LinuxOperand *o = malloc(sizeof(X86_64LinuxOperand));
+  o->kind = X86_64_LINUX_OK_TEMP;
+  o->data.temp.name = name;
+  o->data.temp.size = size;
+  o->data.temp.alignment = size;
+  o->data.temp.kind = kind;
+  o->data.temp.escapes = false;
+  return o;
+}
+
+X86_64LinuxInstruction *asmFixtureAdd(AsmFixture *f,
+                                      X86_64LinuxInstructionKind kind,
+                                      char const *skeleton) {
+  X86_64LinuxInstruction *i =
+      x86_64LinuxInstructionCreate(kind, strdup(skeleton));
+  insertNodeEnd(f->instructions, i);
+  return i;
+}
+void asmFixtureLabel(AsmFixture *f, size_t name) {
+  X86_64LinuxInstruction *i = x86_64LinuxInstructionCreate(
+      X86_64_LINUX_IK_LABEL, format("L%zu:\n", name));
+  i->data.labelName = name;
+  insertNodeEnd(f->instructions, i);
+}
+void asmFixtureJump(AsmFixture *f, X86_64LinuxInstructionKind kind,
+                    char const *mnemonic, size_t target) {
+  X86_64LinuxInstruction *i = x86_64LinuxInstructionCreate(
+      kind, format("\t%s L%zu\n", mnemonic, target));
+  sizeVectorInsert(&i->data.jumpTargets, target);
+  insertNodeEnd(f->instructions, i);
+}
+X86_64LinuxInstruction *asmFixtureReturn(AsmFixture *f) {
+  return asmFixtureAdd(f, X86_64_LINUX_IK_LEAVE, "\tret\n");
+}
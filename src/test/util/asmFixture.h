@@ -0,0 +1,77 @@
+// Copyright 2021 Justin Hu
+//
+// This file is part of the T Language Compiler.
+//
+// The T Language Compiler is free software: you can redistribute it and/or
+// modify it under the terms of the GNU General Public License as published by
+// the Free Software Foundation, either version 3 of the License, or (at your
+// option) any later version.
+//
+// The T Language Compiler is distributed in the hope that it will be useful,
+// but WITHOUT ANY WARRANTY; without even the implied warranty of
+// MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the GNU General
+// Public License for more details.
+//
+// You should have received a copy of the GNU General Public License along with
+// the T Language Compiler. If not see <https://www.gnu.org/licenses/>.
+//
+// SPDX-License-Identifier: GPL-3.0-or-later
+
+/**
+ * @file
+ * a single-function x86_64 linux file to build instruction lists in, for
+ * testing the passes after instruction selection
+ */
+
+#ifndef TLC_TEST_UTIL_ASMFIXTURE_H_
+#define TLC_TEST_UTIL_ASMFIXTURE_H_
+
+#include <stddef.h>
+
+#include "arch/x86_64-linux/asm.h"
+#include "fileList.h"
+
+/** a file with a single, initially empty, text fragment */
+typedef struct {
+  FileListEntry entry;
+  X86_64LinuxFile file;
+  LinkedList *instructions; /**< instructions of the fragment */
+} AsmFixture;
+
+/**
+ * ctor - makes the fixture's file the only file in the file list
+ */
+void asmFixtureInit(AsmFixture *f);
+/** dtor */
+void asmFixtureUninit(AsmFixture *f);
+
+/**
+ * @returns a name for a new temp or label
+ */
+size_t asmFixtureFresh(AsmFixture *f);
+/**
+ * create a temp operand, with alignment equal to its size
+ */
+X86_64LinuxOperand *asmFixtureTemp(size_t name, size_t size, AllocHint kind);
+
+/**
+ * add an instruction with no operands
+ *
+ * @returns the instruction, to add operands to
+ */
+X86_64LinuxInstruction *asmFixtureAdd(AsmFixture *f,
+                                      X86_64LinuxInstructionKind kind,
+                                      char const *skeleton);
+/** add a label */
+void asmFixtureLabel(AsmFixture *f, size_t name);
+/** add a jump of some kind, with the given mnemonic, to a label */
+void asmFixtureJump(AsmFixture *f, X86_64LinuxInstructionKind kind,
+                    char const *mnemonic, size_t target);
+/**
+ * add a ret
+ *
+ * @returns the ret, to add uses to
+ */
+X86_64LinuxInstruction *asmFixtureReturn(AsmFixture *f);
+
+#endif  // TLC_TEST_UTIL_ASMFIXTURE_H_